@@ -11,6 +11,19 @@ newoption {
     default = "all"
 }
 
+newoption {
+    trigger = "sanitize",
+    value = "value",
+    description = "Builds with a sanitizer enabled (gcc/clang only)",
+    allowed = {
+        {"none", "No sanitizer"},
+        {"thread", "ThreadSanitizer, for the asset loader threads and other shared state"},
+        {"address", "AddressSanitizer and UndefinedBehaviorSanitizer"},
+    },
+
+    default = "none"
+}
+
 workspace "Guacamole"
     configurations {"Debug", "Release"}
     architecture "x86_64"
@@ -88,7 +101,9 @@ project "spdlog"
 
 group ""
 
-project "Guacamole"
+-- The engine and everything it links against, main is the file with main() in it
+function EngineProject(name, main)
+project(name)
 -- All platforms
     kind "ConsoleApp"
     language "C++"
@@ -106,9 +121,17 @@ project "Guacamole"
 
     files {
         "src/**.cpp",
-        "src/**.h"
+        "src/**.h",
+        main
     }
 
+    -- Tools bring their own main
+    if main ~= "src/Guacamole/main.cpp" then
+        removefiles {
+            "src/Guacamole/main.cpp"
+        }
+    end
+
     includedirs {
         "src/",
         "%{IncludeDir.Vulkan}",
@@ -154,6 +177,25 @@ project "Guacamole"
             "src/Guacamole/platform/android/**.cpp"
         }
 
+    filter {"system:linux", "options:sanitize=thread"}
+        buildoptions {
+            "-fsanitize=thread"
+        }
+
+        linkoptions {
+            "-fsanitize=thread"
+        }
+
+    filter {"system:linux", "options:sanitize=address"}
+        buildoptions {
+            "-fsanitize=address,undefined",
+            "-fno-omit-frame-pointer"
+        }
+
+        linkoptions {
+            "-fsanitize=address,undefined"
+        }
+
     filter {"system:linux", "options:window-system=all or options:window-system=xcb"}
         defines {
             "VK_USE_PLATFORM_XCB_KHR",
@@ -217,8 +259,110 @@ project "Guacamole"
         }        
 
     filter {}
+end
+
+-- Console tools that only need a few of the engine's sources and no Vulkan device
+function ToolProject(name, dir, sources)
+project(name)
+    kind "ConsoleApp"
+    language "C++"
+    location "build/"
+    cppdialect "C++17"
+
+    dependson "spdlog"
+
+    defines {
+        "SPDLOG_COMPILED_LIB",
+    }
+
+    files {
+        dir .. "/**.cpp"
+    }
+
+    files(sources)
+
+    includedirs {
+        "src/",
+        "%{IncludeDir.Vulkan}",
+        "%{IncludeDir.entt}",
+        "%{IncludeDir.spdlog}",
+        "%{IncludeDir.stb}"
+    }
+
+    filter "system:linux"
+
+        buildoptions {
+            "-Wall",
+            "-Wno-reorder",
+            "-mavx2",
+            "-mfma"
+        }
+
+        defines {
+            "GM_LINUX",
+        }
+
+        files {
+            "src/Guacamole/platform/linux/fileview.cpp"
+        }
+
+        links {
+            "pthread",
+            "spdlog"
+        }
+
+    filter "system:windows"
+
+        defines {
+            "GM_WINDOWS",
+            "_CRT_SECURE_NO_WARNINGS"
+        }
+
+        files {
+            "src/Guacamole/platform/windows/fileview.cpp"
+        }
+
+        links {
+            "spdlog"
+        }
+
+    filter {"system:windows", "Debug"}
+        buildoptions {
+            "/MD"
+        }
+
+    filter {}
+end
+
+EngineProject("Guacamole", "src/Guacamole/main.cpp")
 
+group "tools"
 
-   
+EngineProject("LoadBench", "tools/loadbench/main.cpp")
 
-    
\ No newline at end of file
+ToolProject("AssetPacker", "tools/assetpacker", {
+    "src/Guacamole/asset/assetarchive.cpp",
+    "src/Guacamole/util/util.cpp"
+})
+
+ToolProject("DecodeBench", "tools/decodebench", {
+    "src/Guacamole/util/util.cpp"
+})
+
+ToolProject("BCBench", "tools/bcbench", {
+    "src/Guacamole/util/util.cpp",
+    "src/Guacamole/util/bc.cpp"
+})
+
+ToolProject("MeshBench", "tools/meshbench", {
+    "src/Guacamole/renderer/meshimporter.cpp",
+    "src/Guacamole/renderer/gltfimporter.cpp",
+    "src/Guacamole/util/json.cpp",
+    "src/Guacamole/util/meshoptimizer.cpp",
+    "src/Guacamole/util/vertexcodec.cpp",
+    "src/Guacamole/core/math/vec2.cpp",
+    "src/Guacamole/core/math/vec3.cpp",
+    "src/Guacamole/core/math/vec4.cpp"
+})
+
+group ""
@@ -5,12 +5,14 @@ layout (location = 1) in vec2 iUV;
 
 layout (location = 0) out vec4 oColor;
 
-layout (binding = 0, set = 1) uniform sampler2D uTexture;
+layout (binding = 0, set = 1) uniform sampler2DArray uTexture;
 
-layout (binding = 1, set = 1) uniform MaterialData {
-    vec4 mColor;
+// Follows the vertex stage's model matrix
+layout (push_constant) uniform MaterialData {
+    layout (offset = 64) vec4 mColor;
+    uint mLayer;
 } uMaterialData;
 
 void main() {
-    oColor = uMaterialData.mColor * texture(uTexture, iUV);
+    oColor = uMaterialData.mColor * texture(uTexture, vec3(iUV, uMaterialData.mLayer));
 }
\ No newline at end of file
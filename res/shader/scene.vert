@@ -1,6 +1,6 @@
 #version 430 core
 
-layout (location = 0) in vec3 iPosition;
+layout (location = 0) in vec4 iPosition;
 layout (location = 1) in vec3 iNormal;
 layout (location = 2) in vec2 iUV;
 
@@ -13,12 +13,24 @@ layout (binding = 0, set = 0) uniform SceneData {
 } uSceneData;
 
 layout (push_constant) uniform ModelData {
-    mat4 mModel;
+    mat4 mModel; // Includes the mesh's position dequantization
+    // The fragment stage's material data sits in between
+    layout (offset = 96) vec4 mUVTransform; // xy scale, zw offset
+    uint mOctahedralNormal;
 } uModelData;
 
+vec3 DecodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+
+    return normalize(n);
+}
+
 void main() {
-    oNormal = iNormal;
-    oUV = iUV;
-    gl_Position = uSceneData.mProjection * uSceneData.mView * uModelData.mModel * vec4(iPosition, 1);
+    oNormal = uModelData.mOctahedralNormal != 0 ? DecodeOctahedral(iNormal.xy) : iNormal;
+    oUV = iUV * uModelData.mUVTransform.xy + uModelData.mUVTransform.zw;
+    gl_Position = uSceneData.mProjection * uSceneData.mView * uModelData.mModel * vec4(iPosition.xyz, 1);
 }
 
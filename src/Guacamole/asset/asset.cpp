@@ -31,7 +31,7 @@ SOFTWARE.
 namespace Guacamole {
 
 Asset::Asset(const std::filesystem::path& filePath, AssetType type) 
-    : mHandle(), mFilePath(filePath), mFlags(0), mType(type) {}
+    : mHandle(), mUUID(), mFilePath(Util::NormalizePath(filePath)), mPathHash(filePath.empty() ? 0 : Util::HashPath(filePath)), mFlags(0), mType(type), mMemoryUsage(0), mPendingDependencies(0), mLastUsedFrame(0), mLoadCount(0), mReplaces(nullptr), mReloadPending(false) {}
 
 Asset::~Asset() {
   
@@ -46,4 +46,20 @@ void Asset::Unload() {
     GM_ASSERT_MSG(false, "Asset::Unload not implemented");
 }
 
+Asset* Asset::CreateReloadInstance() const {
+    return nullptr;
+}
+
+void Asset::AddDependency(AssetHandle handle) {
+    GM_ASSERT_MSG(mHandle.IsNull(), "Dependencies must be added before the asset is added to the AssetManager");
+
+    if (handle.IsNull()) return;
+
+    for (const AssetHandle& dependency : mDependencies) {
+        if (dependency == handle) return;
+    }
+
+    mDependencies.push_back(handle);
+}
+
 }
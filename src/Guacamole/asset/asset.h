@@ -27,6 +27,8 @@ SOFTWARE.
 #include <Guacamole.h>
 
 #include <filesystem>
+#include <atomic>
+#include <vector>
 
 #include <Guacamole/core/uuid.h>
 
@@ -44,41 +46,95 @@ enum class AssetType {
     Sampler
 };
 
-using AssetHandle = UUID;
+// Runtime handle, an index into the AssetManager slot map and a generation to detect stale handles.
+// Only valid for the current session, use the assets UUID for anything that's serialized.
+class AssetHandle {
+public:
+    AssetHandle() : mIndex(0), mGeneration(0) {}
+    AssetHandle(uint32_t index, uint32_t generation) : mIndex(index), mGeneration(generation) {}
+
+    inline bool operator==(const AssetHandle& other) const { return mIndex == other.mIndex && mGeneration == other.mGeneration; }
+    inline bool operator!=(const AssetHandle& other) const { return !(*this == other); }
+    operator uint64_t () const { return ((uint64_t)mGeneration << 32) | mIndex; }
+
+    inline bool IsNull() const { return mGeneration == 0; }
+    static AssetHandle Null() { return AssetHandle(); }
+
+public:
+    uint32_t mIndex;
+    uint32_t mGeneration;
+};
 
 enum AssetFlags {
     AssetFlag_Loaded = 0x01, // asset is loaded
     AssetFlag_MemoryAsset = 0x02, // asset is loaded from memory
     AssetFlag_OwnsMemory = 0x04, // asset owns and controls memory (asset manager will free the memory)
-    AssetFlag_Loading = 0x08, // asset is in the asset queue and is wating to be loaded    
+    AssetFlag_Loading = 0x08, // asset is waiting for dependencies, is in the asset queue or is being loaded
+    AssetFlag_Evicted = 0x10, // asset was unloaded to stay under the memory budget and is reloaded on the next request
 };
 
 class Asset {
 protected:
-    AssetHandle mHandle;
-    std::filesystem::path mFilePath;
+    AssetHandle mHandle; // Assigned by the AssetManager
+    UUID mUUID;
+    std::filesystem::path mFilePath; // Normalized
+    uint64_t mPathHash; // Util::HashPath(mFilePath), 0 if the asset has no path
     AssetType mType;
-    uint32_t mFlags;
+    std::atomic<uint32_t> mFlags;
+    // Assets that must be ready before this asset is loaded, must be added to the AssetManager before this asset
+    std::vector<AssetHandle> mDependencies;
+    // Resident bytes, kept up to date by Load/Unload
+    uint64_t mMemoryUsage;
 
     Asset(const std::filesystem::path& filePath, AssetType type);
+
+    // Only valid before the asset is added to the AssetManager
+    void AddDependency(AssetHandle handle);
 public:
     virtual ~Asset();
 
     // Returns true if the commandbuffer/stagingbuffer was used
     virtual bool Load();
     virtual void Unload();
+    // Unloaded copy with the same source and settings, loaded in the background and swapped in on hot reload.
+    // nullptr if the asset type can't be hot reloaded
+    virtual Asset* CreateReloadInstance() const;
 
     inline AssetHandle GetHandle() const { return mHandle; }
+    inline UUID GetUUID() const { return mUUID; }
     inline const std::filesystem::path& GetPath() const { return mFilePath; }
     inline std::string GetPathAsString() const { return mFilePath.string(); }
+    inline uint64_t GetPathHash() const { return mPathHash; }
     inline bool IsLoaded() const { return mFlags & AssetFlag_Loaded; }
     inline bool IsLoading() const { return mFlags & AssetFlag_Loading; }
     inline AssetType GetType() const { return mType; }
     inline uint32_t GetFlags() const { return mFlags; }
+    inline const std::vector<AssetHandle>& GetDependencies() const { return mDependencies; }
+    inline uint64_t GetMemoryUsage() const { return mMemoryUsage; }
+    inline uint64_t GetLastUsedFrame() const { return mLastUsedFrame.load(std::memory_order_relaxed); }
+    // Changes every time the asset is (re)loaded, anything caching the assets GPU handles should compare against it
+    inline uint32_t GetLoadCount() const { return mLoadCount; }
 
 private:
+    uint32_t mPendingDependencies; // Guarded by the AssetManager queue mutex
+    std::atomic<uint64_t> mLastUsedFrame;
+    std::atomic<uint32_t> mLoadCount;
+    Asset* mReplaces; // Set on hot reload instances
+    bool mReloadPending; // Guarded by the AssetManager queue mutex
+
     friend class AssetManager;
 };
 
 
-}
\ No newline at end of file
+}
+
+namespace std {
+template<>
+struct hash<Guacamole::AssetHandle> {
+
+    std::size_t operator()(const Guacamole::AssetHandle& handle) const {
+        return (uint64_t)handle;
+    }
+
+};
+}
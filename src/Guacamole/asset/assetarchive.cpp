@@ -0,0 +1,247 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "assetarchive.h"
+
+#include <Guacamole/util/util.h>
+
+#include <algorithm>
+
+namespace Guacamole {
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Written so a corrupt offset or length can't wrap around
+static bool IsInRange(uint64_t offset, uint64_t length, uint64_t size) {
+    return offset <= size && length <= size - offset;
+}
+
+AssetArchive::AssetArchive() : mHeader(nullptr), mEntries(nullptr) {}
+
+bool AssetArchive::Open(const std::filesystem::path& path) {
+    Close();
+
+    if (!mView.Open(path)) return false;
+
+    const uint8_t* data = mView.GetData();
+    uint64_t size = mView.GetSize();
+
+    const ArchiveHeader* header = (const ArchiveHeader*)data;
+
+    if (size < sizeof(ArchiveHeader) || header->mMagic != Magic) {
+        GM_LOG_CRITICAL("[AssetArchive] \"{}\" is not an asset archive", path.string().c_str());
+        mView.Close();
+        return false;
+    }
+
+    if (header->mVersion != Version) {
+        GM_LOG_CRITICAL("[AssetArchive] \"{}\" has version {}, expected {}", path.string().c_str(), header->mVersion, Version);
+        mView.Close();
+        return false;
+    }
+
+    if (header->mFileSize != size || !IsInRange(header->mEntryOffset, (uint64_t)header->mEntryCount * sizeof(ArchiveEntry), size)) {
+        GM_LOG_CRITICAL("[AssetArchive] \"{}\" is truncated", path.string().c_str());
+        mView.Close();
+        return false;
+    }
+
+    const ArchiveEntry* entries = (const ArchiveEntry*)(data + header->mEntryOffset);
+
+    // Validate once here so Find can trust the table
+    for (uint32_t i = 0; i < header->mEntryCount; i++) {
+        const ArchiveEntry& entry = entries[i];
+
+        if (!IsInRange(entry.mOffset, entry.mSize, size) || !IsInRange(entry.mPathOffset, entry.mPathSize, size) || (i > 0 && entries[i - 1].mPathHash > entry.mPathHash)) {
+            GM_LOG_CRITICAL("[AssetArchive] \"{}\" has a corrupt table of contents", path.string().c_str());
+            mView.Close();
+            return false;
+        }
+    }
+
+    mHeader = header;
+    mEntries = entries;
+    mPath = path;
+
+    GM_LOG_DEBUG("[AssetArchive] Mounted \"{}\" with {} assets ({:.2f}MB)", path.string().c_str(), header->mEntryCount, size / 1000000.0);
+
+    return true;
+}
+
+void AssetArchive::Close() {
+    mView.Close();
+    mHeader = nullptr;
+    mEntries = nullptr;
+    mPath.clear();
+}
+
+bool AssetArchive::Find(const std::filesystem::path& path, const uint8_t** data, uint64_t* size) const {
+    if (mHeader == nullptr) return false;
+
+    std::string normalized = Util::NormalizePath(path).generic_string();
+    uint64_t hash = Util::Hash64(normalized.data(), normalized.size());
+
+    const ArchiveEntry* end = mEntries + mHeader->mEntryCount;
+    const ArchiveEntry* entry = std::lower_bound(mEntries, end, hash, [](const ArchiveEntry& e, uint64_t h) { return e.mPathHash < h; });
+
+    for (; entry != end && entry->mPathHash == hash; entry++) {
+        const char* entryPath = (const char*)mView.GetData() + entry->mPathOffset;
+
+        // Guard against hash collisions
+        if (entry->mPathSize != normalized.size() || memcmp(entryPath, normalized.data(), normalized.size()) != 0) continue;
+
+        *data = mView.GetData() + entry->mOffset;
+        *size = entry->mSize;
+
+        return true;
+    }
+
+    return false;
+}
+
+bool AssetArchive::Prefetch(const std::filesystem::path& path) const {
+    const uint8_t* data = nullptr;
+    uint64_t size = 0;
+
+    if (!Find(path, &data, &size)) return false;
+
+    if (size > 0) mView.Prefetch(data, size);
+
+    return true;
+}
+
+void AssetArchiveWriter::AddFile(const std::filesystem::path& archivePath, const std::filesystem::path& file) {
+    std::string normalized = Util::NormalizePath(archivePath).generic_string();
+
+    mFiles.push_back({ normalized, file, Util::Hash64(normalized.data(), normalized.size()) });
+}
+
+bool AssetArchiveWriter::Write(const std::filesystem::path& output) {
+    std::sort(mFiles.begin(), mFiles.end(), [](const PendingFile& a, const PendingFile& b) { 
+        return a.mPathHash < b.mPathHash || (a.mPathHash == b.mPathHash && a.mArchivePath < b.mArchivePath); 
+    });
+
+    for (size_t i = 1; i < mFiles.size(); i++) {
+        if (mFiles[i - 1].mArchivePath == mFiles[i].mArchivePath) {
+            GM_LOG_CRITICAL("[AssetArchive] \"{}\" added more than once", mFiles[i].mArchivePath.c_str());
+            return false;
+        }
+    }
+
+    ArchiveHeader header;
+
+    header.mMagic = AssetArchive::Magic;
+    header.mVersion = AssetArchive::Version;
+    header.mEntryCount = (uint32_t)mFiles.size();
+    header.mReserved = 0;
+    header.mEntryOffset = sizeof(ArchiveHeader);
+
+    std::vector<ArchiveEntry> entries(mFiles.size());
+
+    uint64_t offset = header.mEntryOffset + entries.size() * sizeof(ArchiveEntry);
+
+    for (size_t i = 0; i < mFiles.size(); i++) {
+        entries[i].mPathHash = mFiles[i].mPathHash;
+        entries[i].mPathOffset = (uint32_t)offset;
+        entries[i].mPathSize = (uint32_t)mFiles[i].mArchivePath.size();
+
+        offset += mFiles[i].mArchivePath.size();
+    }
+
+    for (size_t i = 0; i < mFiles.size(); i++) {
+        std::error_code err;
+        uint64_t size = std::filesystem::file_size(mFiles[i].mFile, err);
+
+        if (err) {
+            GM_LOG_CRITICAL("[AssetArchive] Failed to read size of \"{}\"", mFiles[i].mFile.string().c_str());
+            return false;
+        }
+
+        offset = AlignUp(offset, AssetArchive::BlobAlignment);
+
+        entries[i].mOffset = offset;
+        entries[i].mSize = size;
+
+        offset += size;
+    }
+
+    header.mFileSize = offset;
+
+    FILE* f = fopen(output.string().c_str(), "wb");
+
+    if (f == nullptr) {
+        GM_LOG_CRITICAL("[AssetArchive] Failed to open \"{}\" for writing", output.string().c_str());
+        return false;
+    }
+
+    bool res = fwrite(&header, sizeof(ArchiveHeader), 1, f) == 1;
+
+    if (!entries.empty()) {
+        res = res && fwrite(entries.data(), sizeof(ArchiveEntry) * entries.size(), 1, f) == 1;
+    }
+
+    for (const PendingFile& file : mFiles) {
+        res = res && fwrite(file.mArchivePath.data(), file.mArchivePath.size(), 1, f) == 1;
+    }
+
+    static const uint8_t padding[AssetArchive::BlobAlignment] = {};
+
+    for (size_t i = 0; i < mFiles.size() && res; i++) {
+        uint64_t position = (uint64_t)ftell(f);
+
+        if (entries[i].mOffset > position) {
+            res = fwrite(padding, entries[i].mOffset - position, 1, f) == 1;
+        }
+
+        if (entries[i].mSize == 0) continue;
+
+        FileView view;
+
+        if (!view.Open(mFiles[i].mFile, true) || view.GetSize() != entries[i].mSize) {
+            GM_LOG_CRITICAL("[AssetArchive] \"{}\" changed while packing", mFiles[i].mFile.string().c_str());
+            res = false;
+            break;
+        }
+
+        res = res && fwrite(view.GetData(), view.GetSize(), 1, f) == 1;
+    }
+
+    fclose(f);
+
+    if (!res) {
+        GM_LOG_CRITICAL("[AssetArchive] Failed to write \"{}\"", output.string().c_str());
+        std::filesystem::remove(output);
+        return false;
+    }
+
+    GM_LOG_INFO("[AssetArchive] Wrote {} assets to \"{}\" ({:.2f}MB)", mFiles.size(), output.string().c_str(), header.mFileSize / 1000000.0);
+
+    return true;
+}
+
+}
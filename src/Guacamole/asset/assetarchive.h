@@ -0,0 +1,126 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include <Guacamole/util/fileview.h>
+#include <Guacamole/util/asyncfilereader.h>
+
+#include <filesystem>
+
+namespace Guacamole {
+
+// Packed asset archive. The whole archive is mapped once and assets are read straight from the mapping.
+//
+// Layout:
+//   ArchiveHeader
+//   ArchiveEntry[mEntryCount], sorted by mPathHash
+//   Path strings, normalized and not null terminated
+//   Blobs, each aligned to AssetArchive::BlobAlignment
+struct ArchiveHeader {
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mEntryCount;
+    uint32_t mReserved;
+    uint64_t mEntryOffset;
+    uint64_t mFileSize;
+};
+
+struct ArchiveEntry {
+    uint64_t mPathHash; // Util::HashPath
+    uint64_t mOffset;
+    uint64_t mSize;
+    uint32_t mPathOffset;
+    uint32_t mPathSize;
+};
+
+class AssetArchive {
+public:
+    static constexpr uint32_t Magic = 0x4B504D47; // "GMPK"
+    static constexpr uint32_t Version = 1;
+    static constexpr uint64_t BlobAlignment = 16;
+
+public:
+    AssetArchive();
+
+    bool Open(const std::filesystem::path& path);
+    void Close();
+
+    // data points into the mapping and stays valid until the archive is closed
+    bool Find(const std::filesystem::path& path, const uint8_t** data, uint64_t* size) const;
+    // Starts paging in the asset in the background, returns false if it isn't in the archive
+    bool Prefetch(const std::filesystem::path& path) const;
+
+    inline bool IsOpen() const { return mHeader != nullptr; }
+    inline uint32_t GetEntryCount() const { return mHeader ? mHeader->mEntryCount : 0; }
+    inline const std::filesystem::path& GetPath() const { return mPath; }
+
+private:
+    FileView mView;
+    const ArchiveHeader* mHeader;
+    const ArchiveEntry* mEntries;
+    std::filesystem::path mPath;
+};
+
+// Raw bytes of an asset, pointing into a mounted archive, a mapping of the loose file or a finished read ahead
+class AssetData {
+public:
+    AssetData() : mData(nullptr), mSize(0), mRead(nullptr) {}
+    ~AssetData() { delete mRead; }
+
+    inline const uint8_t* GetData() const { return mData; }
+    inline uint64_t GetSize() const { return mSize; }
+
+private:
+    const uint8_t* mData;
+    uint64_t mSize;
+    FileView mView; // Only open for loose files and cache entries
+    FileRead* mRead;
+
+    friend class AssetManager;
+    friend class AssetCache;
+};
+
+// Used by the AssetPacker tool
+class AssetArchiveWriter {
+public:
+    // archivePath is the path the asset is requested with at runtime, file is where it's read from
+    void AddFile(const std::filesystem::path& archivePath, const std::filesystem::path& file);
+    bool Write(const std::filesystem::path& output);
+
+    inline uint32_t GetFileCount() const { return (uint32_t)mFiles.size(); }
+
+private:
+    struct PendingFile {
+        std::string mArchivePath;
+        std::filesystem::path mFile;
+        uint64_t mPathHash;
+    };
+
+    std::vector<PendingFile> mFiles;
+};
+
+}
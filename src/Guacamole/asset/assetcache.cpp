@@ -0,0 +1,171 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "assetcache.h"
+
+#include <Guacamole/util/util.h>
+
+#include <thread>
+
+namespace Guacamole {
+
+static constexpr uint32_t CacheMagic = 0x41434D47; // "GMCA"
+
+std::filesystem::path AssetCache::mDirectory;
+std::atomic<uint32_t> AssetCache::mHits;
+std::atomic<uint32_t> AssetCache::mMisses;
+
+void AssetCache::Init(const std::filesystem::path& directory) {
+    mHits = 0;
+    mMisses = 0;
+    mDirectory.clear();
+
+    if (directory.empty()) return;
+
+    std::error_code err;
+    std::filesystem::create_directories(directory, err);
+
+    if (err) {
+        GM_LOG_WARNING("[AssetCache] Failed to create \"{}\", cache disabled", directory.string().c_str());
+        return;
+    }
+
+    mDirectory = directory;
+
+    GM_LOG_DEBUG("[AssetCache] Using \"{}\"", directory.string().c_str());
+}
+
+void AssetCache::Shutdown() {
+    if (!IsEnabled()) return;
+
+    GM_LOG_DEBUG("[AssetCache] {} hits, {} misses", mHits.load(), mMisses.load());
+
+    mDirectory.clear();
+}
+
+uint64_t AssetCache::MakeKey(const void* source, uint64_t sourceSize, const void* params, uint64_t paramsSize) {
+    uint64_t paramsHash = Util::Hash64(params, paramsSize, Version);
+
+    return Util::Hash64(source, sourceSize, paramsHash);
+}
+
+bool AssetCache::Load(uint64_t key, AssetData* data) {
+    GM_ASSERT(data);
+
+    if (!IsEnabled()) return false;
+
+    std::filesystem::path path = GetEntryPath(key);
+
+    std::error_code err;
+
+    if (!std::filesystem::exists(path, err)) {
+        mMisses++;
+        return false;
+    }
+
+    if (!data->mView.Open(path)) {
+        mMisses++;
+        return false;
+    }
+
+    const EntryHeader* header = (const EntryHeader*)data->mView.GetData();
+    uint64_t size = data->mView.GetSize();
+
+    if (size < sizeof(EntryHeader) || header->mMagic != CacheMagic || header->mVersion != Version || 
+        header->mKey != key || header->mPayloadSize != size - sizeof(EntryHeader)) {
+        GM_LOG_WARNING("[AssetCache] Discarding invalid entry \"{}\"", path.string().c_str());
+        data->mView.Close();
+        std::filesystem::remove(path, err);
+        mMisses++;
+        return false;
+    }
+
+    data->mData = data->mView.GetData() + sizeof(EntryHeader);
+    data->mSize = header->mPayloadSize;
+
+    mHits++;
+
+    return true;
+}
+
+bool AssetCache::Store(uint64_t key, const std::vector<std::pair<const void*, uint64_t>>& parts) {
+    if (!IsEnabled()) return false;
+
+    EntryHeader header;
+
+    header.mMagic = CacheMagic;
+    header.mVersion = Version;
+    header.mKey = key;
+    header.mPayloadSize = 0;
+    header.mReserved = 0;
+
+    for (const auto& [data, size] : parts) {
+        header.mPayloadSize += size;
+    }
+
+    std::filesystem::path path = GetEntryPath(key);
+
+    // Written to a unique temp file and renamed into place so readers never see a partial entry
+    std::filesystem::path tmpPath = path;
+    tmpPath += fmt::format(".{:x}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+    FILE* f = fopen(tmpPath.string().c_str(), "wb");
+
+    if (f == nullptr) {
+        GM_LOG_WARNING("[AssetCache] Failed to open \"{}\" for writing", tmpPath.string().c_str());
+        return false;
+    }
+
+    bool res = fwrite(&header, sizeof(EntryHeader), 1, f) == 1;
+
+    for (const auto& [data, size] : parts) {
+        if (size == 0) continue;
+
+        res = res && fwrite(data, size, 1, f) == 1;
+    }
+
+    res = fclose(f) == 0 && res;
+
+    std::error_code err;
+
+    if (res) {
+        std::filesystem::rename(tmpPath, path, err);
+        res = !err;
+    }
+
+    if (!res) {
+        GM_LOG_WARNING("[AssetCache] Failed to write \"{}\"", path.string().c_str());
+        std::filesystem::remove(tmpPath, err);
+    }
+
+    return res;
+}
+
+std::filesystem::path AssetCache::GetEntryPath(uint64_t key) {
+    return mDirectory / fmt::format("{:016x}.gmc", key);
+}
+
+}
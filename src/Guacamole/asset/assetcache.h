@@ -0,0 +1,73 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include "assetarchive.h"
+
+#include <filesystem>
+#include <atomic>
+
+namespace Guacamole {
+
+// On disk cache of cooked asset data (decoded texels, compiled SPIR-V...).
+// Entries are keyed by a hash of the source bytes and the parameters they were cooked with,
+// so a changed source or changed cook settings simply miss and get recooked.
+class AssetCache {
+public:
+    // Bump when the layout of any cooked data changes
+    static constexpr uint32_t Version = 2;
+
+    // An empty directory disables the cache
+    static void Init(const std::filesystem::path& directory);
+    static void Shutdown();
+
+    static uint64_t MakeKey(const void* source, uint64_t sourceSize, const void* params, uint64_t paramsSize);
+
+    // data points at the cooked payload, returns false on a miss
+    static bool Load(uint64_t key, AssetData* data);
+    // Concatenates the parts into one entry, safe to call from multiple threads
+    static bool Store(uint64_t key, const std::vector<std::pair<const void*, uint64_t>>& parts);
+
+    inline static bool IsEnabled() { return !mDirectory.empty(); }
+
+private:
+    struct EntryHeader {
+        uint32_t mMagic;
+        uint32_t mVersion;
+        uint64_t mKey;
+        uint64_t mPayloadSize;
+        uint64_t mReserved;
+    };
+
+    static std::filesystem::path GetEntryPath(uint64_t key);
+
+    static std::filesystem::path mDirectory;
+    static std::atomic<uint32_t> mHits;
+    static std::atomic<uint32_t> mMisses;
+};
+
+}
@@ -25,10 +25,15 @@ SOFTWARE.
 #include <Guacamole.h>
 
 #include "assetmanager.h"
+#include "filewatcher.h"
 
 #include <Guacamole/vulkan/buffer/commandbuffer.h>
 #include <Guacamole/vulkan/buffer/stagingbuffer.h>
 #include <Guacamole/vulkan/device.h>
+#include <Guacamole/vulkan/deletionqueue.h>
+#include <Guacamole/util/util.h>
+
+#include <algorithm>
 
 #if defined(GM_LINUX)
 /*
@@ -46,59 +51,291 @@ namespace std {
 namespace Guacamole {
 
 Device* AssetManager::mDevice;
-bool AssetManager::mShouldStop;
-std::thread AssetManager::mLoaderThread;
+std::atomic<bool> AssetManager::mShouldStop;
+std::vector<std::thread> AssetManager::mWorkers;
 std::mutex AssetManager::mQueueMutex;
+std::condition_variable AssetManager::mQueueCondition;
 std::mutex AssetManager::mCommandBufferMutex;
-std::unordered_map<AssetHandle, Asset*> AssetManager::mAssets;
-std::vector<Asset*> AssetManager::mAssetQueue;
+std::mutex AssetManager::mLoadMutex;
+std::condition_variable AssetManager::mLoadCondition;
+std::unordered_map<AssetHandle, std::vector<std::pair<AssetCallback, AssetCallbackThread>>> AssetManager::mLoadCallbacks;
+std::vector<std::pair<AssetCallback, Asset*>> AssetManager::mMainThreadCallbacks;
+std::vector<Asset*> AssetManager::mPendingReloads;
+std::unordered_map<AssetHandle, std::vector<std::pair<uint64_t, AssetCallback>>> AssetManager::mReloadCallbacks;
+uint64_t AssetManager::mNextReloadCallbackId;
+bool AssetManager::mHotReload;
+std::thread::id AssetManager::mMainThreadId;
+SlotMap<AssetHandle, Asset> AssetManager::mAssets;
+ConcurrentMap<uint64_t, AssetHandle> AssetManager::mPathIndex;
+ConcurrentMap<UUID, AssetHandle> AssetManager::mUUIDIndex;
+std::unordered_map<AssetType, Asset*> AssetManager::mFallbackAssets;
+std::deque<Asset*> AssetManager::mAssetQueue;
+std::atomic<uint64_t> AssetManager::mFrameIndex;
+std::atomic<uint64_t> AssetManager::mMemoryUsage[(uint32_t)AssetMemoryType::Count];
+uint64_t AssetManager::mMemoryBudgets[(uint32_t)AssetMemoryType::Count];
+std::shared_mutex AssetManager::mArchiveMutex;
+std::vector<AssetArchive*> AssetManager::mArchives;
+std::unordered_set<uint64_t> AssetManager::mChangedFiles;
+std::mutex AssetManager::mPrefetchMutex;
+std::unordered_map<uint64_t, std::pair<std::filesystem::path, FileRead*>> AssetManager::mPrefetches;
+uint64_t AssetManager::mPrefetchedBytes;
+std::unordered_map<AssetHandle, std::vector<Asset*>> AssetManager::mDependents;
+uint32_t AssetManager::mActiveWorkers;
+AssetManager::LoadStats AssetManager::mLoadStats;
 
-void AssetManager::Init(Device* device) {
+void AssetManager::Init(Device* device, uint32_t workerCount, bool hotReload) {
     mShouldStop = false;
     mDevice = device;
-    mLoaderThread = std::thread(&AssetManager::QueueWorker);
+    mActiveWorkers = 0;
+    mMainThreadId = std::this_thread::get_id();
+    mFrameIndex = 0;
+    mNextReloadCallbackId = 1;
+    mPrefetchedBytes = 0;
+
+    AsyncFileReader::Init();
+
+    for (uint32_t i = 0; i < (uint32_t)AssetMemoryType::Count; i++) {
+        mMemoryUsage[i] = 0;
+        mMemoryBudgets[i] = 0;
+    }
+
+    if (workerCount == 0) {
+        // Leave one thread for the main thread, every worker allocates its own 24MB staging buffer so keep it reasonable
+        uint32_t hwThreads = std::thread::hardware_concurrency();
+        workerCount = hwThreads > 1 ? std::min(hwThreads - 1, 8u) : 1;
+    }
+
+    mWorkers.reserve(workerCount);
+
+    for (uint32_t i = 0; i < workerCount; i++) {
+        mWorkers.emplace_back(&AssetManager::QueueWorker, i);
+    }
+
+    GM_LOG_DEBUG("[AssetManager] Started {} loader threads", workerCount);
+
+    mHotReload = hotReload && FileWatcher::Init([](const std::filesystem::path& file) {
+        AssetHandle handle = GetAssetHandleFromPath(file);
+
+        if (handle.IsNull()) return;
+
+        GM_LOG_INFO("[AssetManager] \"{}\" changed, reloading", file.string().c_str());
+
+        mArchiveMutex.lock();
+        mChangedFiles.insert(Util::HashPath(file));
+        mArchiveMutex.unlock();
+
+        ReloadAsset(handle);
+    });
 }
 
 void AssetManager::Shutdown() {
+    // Stop the watcher first so it can't queue reloads while the workers are stopping
+    if (mHotReload) FileWatcher::Shutdown();
+
+    mHotReload = false;
+
+    mQueueMutex.lock();
     mShouldStop = true;
-    mLoaderThread.join();
+    mQueueMutex.unlock();
+    mQueueCondition.notify_all();
+
+    // Workers may be waiting for their last upload to be picked up by a frame that never comes
+    StagingManager::CancelCollectionWaits();
+
+    for (std::thread& worker : mWorkers) {
+        worker.join();
+    }
+
+    mWorkers.clear();
+
+    // Reload instances aren't in mAssets, they're only owned by the queue until they're swapped in
+    mLoadMutex.lock();
 
-    for (auto [handle, asset] : mAssets) {
+    for (Asset* asset : mAssetQueue) {
+        if (asset->mReplaces) {
+            delete asset;
+        } else {
+            asset->mFlags &= ~AssetFlag_Loading;
+        }
+    }
+
+    // Dependents waiting on a dependency were never queued, an asset is listed once per dependency it waits on
+    std::unordered_set<Asset*> dependents;
+
+    for (auto& [handle, waiting] : mDependents) {
+        dependents.insert(waiting.begin(), waiting.end());
+    }
+
+    for (Asset* asset : dependents) {
+        if (asset->mReplaces) {
+            delete asset;
+        } else {
+            asset->mFlags &= ~AssetFlag_Loading;
+        }
+    }
+
+    mDependents.clear();
+    mLoadMutex.unlock();
+    mLoadCondition.notify_all();
+
+    for (Asset* asset : mPendingReloads) {
+        delete asset;
+    }
+
+    mAssetQueue.clear();
+    mPendingReloads.clear();
+
+    // Completes or fails everything that's in flight
+    AsyncFileReader::Shutdown();
+
+    for (auto& [hash, prefetch] : mPrefetches) {
+        prefetch.second->Wait();
+        delete prefetch.second;
+    }
+
+    mPrefetches.clear();
+    mReloadCallbacks.clear();
+    mLoadCallbacks.clear();
+    mMainThreadCallbacks.clear();
+    mFallbackAssets.clear();
+
+    mAssets.ForEach([](const AssetHandle& handle, Asset* asset) {
         if (asset->mFlags & AssetFlag_MemoryAsset) {
             if (asset->mFlags & AssetFlag_OwnsMemory) delete asset;
         } else {
             delete asset;
         }
+    });
+
+    mAssets.Clear();
+    mPathIndex.Clear();
+    mUUIDIndex.Clear();
+
+    for (AssetArchive* archive : mArchives) {
+        delete archive;
     }
+
+    mArchives.clear();
+    mChangedFiles.clear();
 }
 
-AssetHandle AssetManager::AddAsset(Asset* asset, bool asyncLoad) {
-    AssetHandle handle = asset->mHandle;
+bool AssetManager::MountArchive(const std::filesystem::path& path) {
+    AssetArchive* archive = new AssetArchive;
+
+    if (!archive->Open(path)) {
+        delete archive;
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mArchiveMutex);
+    mArchives.push_back(archive);
+
+    return true;
+}
+
+bool AssetManager::ReadAssetData(const std::filesystem::path& path, AssetData* data) {
+    GM_ASSERT(data);
+
+    {
+        std::shared_lock<std::shared_mutex> lock(mArchiveMutex);
+
+        bool changed = !mChangedFiles.empty() && mChangedFiles.find(Util::HashPath(path)) != mChangedFiles.end();
+
+        for (auto it = mArchives.rbegin(); !changed && it != mArchives.rend(); it++) {
+            if ((*it)->Find(path, &data->mData, &data->mSize)) return true;
+        }
+    }
+
+    FileRead* read = TakePrefetch(path);
+
+    if (read) {
+        if (read->Wait()) {
+            data->mRead = read;
+            data->mData = read->GetData();
+            data->mSize = read->GetSize();
+
+            return true;
+        }
+
+        // Mapping it logs why it failed
+        delete read;
+    }
+
+    // Read in full right away, populating avoids taking a page fault for every page
+    if (!data->mView.Open(path, true)) return false;
 
+    data->mData = data->mView.GetData();
+    data->mSize = data->mView.GetSize();
+
+    return true;
+}
+
+AssetHandle AssetManager::AddAsset(Asset* asset, bool asyncLoad) {
     if (asset->mFilePath.empty()) {
-        GM_LOG_CRITICAL("Asset \"AssetHandle: 0x{:08x}\" has no path!", handle);
+        GM_LOG_CRITICAL("Asset \"UUID: 0x{:08x}\" has no path!", asset->mUUID);
         return AssetHandle::Null();
     }
 
-    AssetHandle tmp = GetAssetHandleFromPath(asset->mFilePath);
+    if (!asset->mHandle.IsNull()) {
+        GM_LOG_CRITICAL("Asset Path: \"{}\" already added!", asset->GetPathAsString().c_str());
+        return asset->mHandle;
+    }
+
+    // Flag it before it's visible to other threads so they wait for it instead of seeing an unloaded asset
+    asset->mFlags |= AssetFlag_Loading;
 
-    if (tmp != AssetHandle::Null()) {
-        GM_LOG_CRITICAL("Asset Path: \"{}\" already exist!", asset->GetPathAsString().c_str());
-        return tmp;
+    AssetHandle handle = mAssets.Insert(asset);
+    asset->mHandle = handle;
+
+    // Claiming the path is atomic, if two threads add the same path only one of them wins
+    if (!mPathIndex.Insert(asset->mPathHash, handle)) {
+        mAssets.Remove(handle);
+        asset->mHandle = AssetHandle::Null();
+        asset->mFlags &= ~AssetFlag_Loading;
+
+        AssetHandle existing = AssetHandle::Null();
+        mPathIndex.Find(asset->mPathHash, &existing);
+
+        Asset* existingAsset = mAssets.Get(existing);
+
+        if (existingAsset && existingAsset->mFilePath == asset->mFilePath) {
+            GM_LOG_CRITICAL("Asset Path: \"{}\" already exist!", asset->GetPathAsString().c_str());
+            return existing;
+        }
+
+        // The handle belongs to a different file
+        GM_LOG_CRITICAL("Asset Path: \"{}\" hash collides with \"{}\"!", asset->GetPathAsString().c_str(), 
+            existingAsset ? existingAsset->GetPathAsString().c_str() : "");
+
+        return AssetHandle::Null();
     }
 
-    mAssets[handle] = asset;
+    mUUIDIndex.Set(asset->mUUID, handle);
+
+    if (mHotReload) FileWatcher::Watch(asset->mFilePath);
     
     GM_LOG_DEBUG("Added asset Path: \"{}\" AssetHandle: 0x{:08x}", asset->GetPathAsString().c_str(), handle);
 
     if (asyncLoad) {
         mQueueMutex.lock();
-        asset->mFlags |= AssetFlag_Loading;
-        mAssetQueue.push_back(asset);
-        mQueueMutex.unlock();
-        GM_LOG_DEBUG("Asset Path: \"{}\" AssetHandle: 0x{:08x} Added To Queue!", asset->GetPathAsString().c_str(), handle);
+
+        uint32_t pending = RegisterDependencies(asset);
+
+        if (pending == 0) {
+            QueueAsset(asset);
+            mQueueMutex.unlock();
+            AsyncFileReader::Submit();
+            mQueueCondition.notify_one();
+            GM_LOG_DEBUG("Asset Path: \"{}\" AssetHandle: 0x{:08x} Added To Queue!", asset->GetPathAsString().c_str(), handle);
+        } else {
+            // Queued by FinishLoading once the last dependency is done
+            mQueueMutex.unlock();
+            GM_LOG_DEBUG("Asset Path: \"{}\" AssetHandle: 0x{:08x} Waiting on {} dependencies", asset->GetPathAsString().c_str(), handle, pending);
+        }
     } else {
+        WaitForDependencies(asset);
         asset->Load();
+        FinishLoading(asset);
         GM_LOG_DEBUG("Asset Path: \"{}\" AssetHandle: 0x{:08x} Loaded!", asset->GetPathAsString().c_str(), handle);
     }
 
@@ -106,84 +343,658 @@ AssetHandle AssetManager::AddAsset(Asset* asset, bool asyncLoad) {
 }
 
 AssetHandle AssetManager::AddMemoryAsset(Asset* asset, bool takeOwnershipOfMemory) {
-    AssetHandle handle = asset->mHandle;
-
-    if (mAssets.find(handle) != mAssets.end()) {
-        GM_LOG_CRITICAL("Asset \"AssetHandle: 0x{:08x}\" already exist!", handle);
+    if (!asset->mHandle.IsNull()) {
+        GM_LOG_CRITICAL("Asset \"AssetHandle: 0x{:08x}\" already exist!", asset->mHandle);
         return AssetHandle::Null();
     }
 
-    mAssets[handle] = asset;
-
     asset->mFlags |= AssetFlag_MemoryAsset;
 
     if (takeOwnershipOfMemory) {
         asset->mFlags |= AssetFlag_OwnsMemory;
     }
 
+    AssetHandle handle;
+
+    if (asset->mDependencies.empty()) {
+        handle = mAssets.Insert(asset);
+    } else {
+        // Memory assets are already loaded, they are only held back until their dependencies are ready
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+
+        if (RegisterDependencies(asset) > 0) {
+            asset->mFlags |= AssetFlag_Loading;
+        }
+
+        handle = mAssets.Insert(asset);
+    }
+
+    asset->mHandle = handle;
+
+    mUUIDIndex.Set(asset->mUUID, handle);
+    AddMemoryUsage(asset, asset->mMemoryUsage);
+
     GM_LOG_DEBUG("Added Asset \"AssetHandle: {:08x}\"", handle);
 
     return handle;
 }
 
-Asset* AssetManager::GetAssetInternal(AssetHandle handle) {
-    const auto& itr = mAssets.find(handle);
+AssetHandle AssetManager::GetAssetHandleFromUUID(UUID uuid) {
+    AssetHandle handle = AssetHandle::Null();
+
+    mUUIDIndex.Find(uuid, &handle);
+
+    return handle;
+}
+
+void AssetManager::Update() {
+    SwapReloadedAssets();
+
+    mLoadMutex.lock();
+    std::vector<std::pair<AssetCallback, Asset*>> callbacks = std::move(mMainThreadCallbacks);
+    mMainThreadCallbacks.clear();
+    mLoadMutex.unlock();
+
+    for (auto& [callback, asset] : callbacks) {
+        callback(asset);
+    }
+
+    mFrameIndex++;
+
+    EvictAssets();
+}
+
+void AssetManager::SetMemoryBudget(AssetMemoryType type, uint64_t bytes) {
+    mMemoryBudgets[(uint32_t)type] = bytes;
+}
+
+void AssetManager::OnLoaded(AssetHandle handle, AssetCallback callback, AssetCallbackThread thread) {
+    Asset* asset = FindAsset(handle);
+
+    if (asset == nullptr) return;
+
+    mLoadMutex.lock();
+
+    if (asset->IsLoading()) {
+        mLoadCallbacks[handle].emplace_back(std::move(callback), thread);
+        mLoadMutex.unlock();
+        return;
+    }
+
+    if (thread == AssetCallbackThread::Main && std::this_thread::get_id() != mMainThreadId) {
+        mMainThreadCallbacks.emplace_back(std::move(callback), asset);
+        mLoadMutex.unlock();
+        return;
+    }
+
+    mLoadMutex.unlock();
+
+    // Already loaded and we're on the right thread
+    callback(asset);
+}
+
+bool AssetManager::ReloadAsset(AssetHandle handle) {
+    Asset* asset = FindAsset(handle);
+
+    if (asset == nullptr) return false;
+
+    std::unique_lock<std::mutex> lock(mQueueMutex);
+
+    if (asset->mFlags & AssetFlag_MemoryAsset) {
+        GM_LOG_WARNING("Asset [handle: {:08x}] is a memory asset and can't be reloaded", handle);
+        return false;
+    }
+
+    // A reload is already on the way, evicted and loading assets read the new file when they're loaded anyway
+    if (asset->mReloadPending || (asset->mFlags & (AssetFlag_Loading | AssetFlag_Evicted))) return true;
+
+    Asset* instance = asset->CreateReloadInstance();
 
-    if (itr == mAssets.end()) {
+    if (instance == nullptr) {
+        GM_LOG_WARNING("Asset Path: \"{}\" doesn't support reloading", asset->GetPathAsString().c_str());
+        return false;
+    }
+
+    instance->mHandle = handle;
+    instance->mReplaces = asset;
+    instance->mFlags |= AssetFlag_Loading;
+    asset->mReloadPending = true;
+
+    QueueAsset(instance);
+    lock.unlock();
+    AsyncFileReader::Submit();
+    mQueueCondition.notify_one();
+
+    return true;
+}
+
+uint64_t AssetManager::OnReloaded(AssetHandle handle, AssetCallback callback) {
+    std::lock_guard<std::mutex> lock(mLoadMutex);
+
+    uint64_t id = mNextReloadCallbackId++;
+
+    mReloadCallbacks[handle].emplace_back(id, std::move(callback));
+
+    return id;
+}
+
+void AssetManager::RemoveReloadCallback(AssetHandle handle, uint64_t id) {
+    std::lock_guard<std::mutex> lock(mLoadMutex);
+
+    auto it = mReloadCallbacks.find(handle);
+
+    if (it == mReloadCallbacks.end()) return;
+
+    std::vector<std::pair<uint64_t, AssetCallback>>& callbacks = it->second;
+
+    callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(), [id](const auto& callback) { return callback.first == id; }), callbacks.end());
+
+    if (callbacks.empty()) mReloadCallbacks.erase(it);
+}
+
+void AssetManager::SwapReloadedAssets() {
+    mLoadMutex.lock();
+    std::vector<Asset*> reloads = std::move(mPendingReloads);
+    mPendingReloads.clear();
+    mLoadMutex.unlock();
+
+    for (Asset* instance : reloads) {
+        Asset* old = instance->mReplaces;
+        AssetHandle handle = old->mHandle;
+
+        mQueueMutex.lock();
+        old->mReloadPending = false;
+        mQueueMutex.unlock();
+
+        // Keep the old version on screen, the file might just be half saved
+        if (!instance->IsLoaded()) {
+            GM_LOG_WARNING("Asset Path: \"{}\" failed to reload, keeping the previous version", old->GetPathAsString().c_str());
+            DeletionQueue::Push([instance]() { delete instance; });
+            continue;
+        }
+
+        instance->mReplaces = nullptr;
+        instance->mUUID = old->mUUID;
+        instance->mDependencies = old->mDependencies;
+        instance->mLoadCount = old->mLoadCount + 1;
+        MarkUsed(instance);
+
+        mAssets.Replace(handle, instance);
+
+        if (old->IsLoaded()) AddMemoryUsage(old, -(int64_t)old->mMemoryUsage);
+        AddMemoryUsage(instance, instance->mMemoryUsage);
+
+        // Frames in flight may still reference the old resources
+        DeletionQueue::Push([old]() { delete old; });
+
+        mLoadMutex.lock();
+        std::vector<std::pair<uint64_t, AssetCallback>> callbacks;
+        auto it = mReloadCallbacks.find(handle);
+        if (it != mReloadCallbacks.end()) callbacks = it->second;
+        mLoadMutex.unlock();
+
+        for (auto& [id, callback] : callbacks) {
+            callback(instance);
+        }
+
+        GM_LOG_INFO("Asset Path: \"{}\" AssetHandle: 0x{:08x} Reloaded", instance->GetPathAsString().c_str(), handle);
+    }
+}
+
+Asset* AssetManager::FindAsset(AssetHandle handle) {
+    Asset* asset = mAssets.Get(handle);
+
+    if (asset == nullptr) {
         GM_LOG_CRITICAL("Asset [handle: {:08x}] doesn't exist", handle);
         return nullptr;
     }
 
-    Asset* asset = itr->second;
+    return asset;
+}
+
+Asset* AssetManager::GetAssetInternal(AssetHandle handle) {
+    Asset* asset = FindAsset(handle);
+
+    if (asset == nullptr) return nullptr;
+
+    MarkUsed(asset);
 
-    while (!asset->IsLoaded()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (asset->mFlags & AssetFlag_Evicted) RequestReload(asset);
+
+    WaitUntilLoaded(asset);
+
+    if (!asset->IsLoaded()) {
+        GM_LOG_CRITICAL("Asset [handle: {:08x}] failed to load", handle);
+        return nullptr;
     }
 
     return asset;
 }
 
+Asset* AssetManager::TryGetAssetInternal(AssetHandle handle) {
+    Asset* asset = FindAsset(handle);
+
+    if (asset == nullptr) return nullptr;
+
+    MarkUsed(asset);
+
+    if (asset->mFlags & AssetFlag_Evicted) RequestReload(asset);
+    if (asset->IsLoading() || !asset->IsLoaded()) return nullptr;
+
+    return asset;
+}
+
+void AssetManager::WaitUntilLoaded(Asset* asset) {
+    if (!asset->IsLoading()) return;
+
+    std::unique_lock<std::mutex> lock(mLoadMutex);
+
+    if (!IsMainThread()) {
+        mLoadCondition.wait(lock, [asset]() { return !asset->IsLoading(); });
+        return;
+    }
+
+    // Workers don't take the next asset until Present has picked up their last upload, and Present can't run while
+    // the main thread waits here. Their uploads are submitted from here instead until the asset is done
+    while (asset->IsLoading()) {
+        lock.unlock();
+        StagingManager::SubmitPendingStagingBuffers(mDevice);
+        lock.lock();
+
+        mLoadCondition.wait_for(lock, std::chrono::milliseconds(1), [asset]() { return !asset->IsLoading(); });
+    }
+}
+
+Asset* AssetManager::TryGetAssetOrFallbackInternal(AssetHandle handle, AssetType type) {
+    Asset* asset = mAssets.Get(handle);
+
+    if (asset) {
+        MarkUsed(asset);
+
+        if (asset->mFlags & AssetFlag_Evicted) RequestReload(asset);
+        if (!asset->IsLoading() && asset->IsLoaded()) return asset;
+    }
+
+    const auto& fallback = mFallbackAssets.find(type);
+
+    if (fallback == mFallbackAssets.end()) return nullptr;
+
+    return fallback->second;
+}
+
+void AssetManager::SetFallbackAsset(AssetType type, AssetHandle handle) {
+    Asset* asset = FindAsset(handle);
+
+    if (asset == nullptr) return;
+
+    GM_ASSERT_MSG(asset->mType == type, "Fallback asset type missmatch");
+    GM_ASSERT_MSG(asset->mFlags & AssetFlag_MemoryAsset, "Fallback asset must be a memory asset");
+
+    mFallbackAssets[type] = asset;
+}
+
+AssetHandle AssetManager::GetFallbackAsset(AssetType type) {
+    const auto& itr = mFallbackAssets.find(type);
+
+    if (itr == mFallbackAssets.end()) return AssetHandle::Null();
+
+    return itr->second->mHandle;
+}
+
 bool AssetManager::IsAssetLoaded(AssetHandle handle) {
-    return mAssets.at(handle)->IsLoaded();
+    Asset* asset = mAssets.Get(handle);
+
+    if (asset == nullptr) return false;
+
+    return asset->IsLoaded();
 }
 
 AssetHandle AssetManager::GetAssetHandleFromPath(const std::filesystem::path& path) {
-    for (auto [handle, asset] : mAssets) {
-        if (asset->mFilePath == path) return handle;
-    }
+    AssetHandle handle = AssetHandle::Null();
+
+    if (!mPathIndex.Find(Util::HashPath(path), &handle)) return AssetHandle::Null();
 
-    return AssetHandle::Null();
+    Asset* asset = mAssets.Get(handle);
+
+    if (asset == nullptr) return AssetHandle::Null();
+
+    // Guard against hash collisions
+    if (asset->mFilePath != Util::NormalizePath(path)) return AssetHandle::Null();
+
+    return handle;
 }
 
-void AssetManager::QueueWorker() {
-    StagingManager::AllocateCommonStagingBuffer(mDevice, std::this_thread::get_id(), 24000000, true); // 24MB
+void AssetManager::QueueWorker(uint32_t workerIndex) {
+    // Every worker records into its own staging buffer and command pool
+    StagingManager::AllocateCommonStagingBuffer(mDevice, std::this_thread::get_id(), 24000000, false); // 24MB
+    StagingBuffer* buf = StagingManager::GetCommonStagingBuffer();
 
-    while (!mShouldStop) {
-        mQueueMutex.lock();
+    while (true) {
+        // The previous upload from this worker has to be picked up before the buffer is reused. That's waited for
+        // before taking an asset, so a waiting worker never holds one the main thread might be waiting for
+        if (!StagingManager::WaitForCollection(buf)) break;
 
-        if (mAssetQueue.size() == 0) {
-            mQueueMutex.unlock();
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            continue;
-        }
+        std::unique_lock<std::mutex> queueLock(mQueueMutex);
 
-        StagingBuffer* buf = StagingManager::GetCommonStagingBuffer();
+        mQueueCondition.wait(queueLock, []() { return mShouldStop || !mAssetQueue.empty(); });
 
-        buf->Begin();
+        if (mShouldStop) break;
 
         Asset* currentAsset = mAssetQueue.front();
 
-        mAssetQueue.erase(mAssetQueue.begin());
-        mQueueMutex.unlock();
+        mAssetQueue.pop_front();
+        mActiveWorkers++;
+        queueLock.unlock();
+
+        // Already collected, only waits for the GPU to finish with the last upload
+        buf->Begin();
 
         bool usedBuffer = LoadAssetFunction(currentAsset);
-        currentAsset->mFlags &= ~AssetFlag_Loading;
+        uint64_t stagedBytes = buf->GetAllocated();
 
         if (usedBuffer) {
             StagingManager::SubmitStagingBuffer(buf, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
         } else {
             buf->GetCommandBuffer()->End();
         }
+
+        // Not done until the upload is submitted
+        FinishLoading(currentAsset);
+
+        queueLock.lock();
+        mActiveWorkers--;
+        mLoadStats.mAssetCount++;
+        mLoadStats.mStagedBytes += usedBuffer ? stagedBytes : 0;
+
+        if (mAssetQueue.empty() && mActiveWorkers == 0) {
+            auto end = std::chrono::high_resolution_clock::now();
+            double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - mLoadStats.mStart).count() / 1000000.0;
+            double megabytes = mLoadStats.mStagedBytes / 1000000.0;
+
+            GM_LOG_DEBUG("[AssetManager] Loaded {} assets ({:.2f}MB staged) in {:.2f}ms on {} workers: {:.1f} assets/s {:.2f}MB/s", 
+                mLoadStats.mAssetCount, megabytes, seconds * 1000.0, mWorkers.size(), mLoadStats.mAssetCount / seconds, megabytes / seconds);
+        }
+    }
+
+    GM_LOG_DEBUG("[AssetManager] Loader thread {} stopped", workerIndex);
+}
+
+void AssetManager::FinishLoading(Asset* asset) {
+    // Reload instances have no waiters or dependents of their own, they're handed to the main thread to be swapped in
+    if (asset->mReplaces) {
+        std::lock_guard<std::mutex> lock(mLoadMutex);
+        asset->mFlags &= ~AssetFlag_Loading;
+        mPendingReloads.push_back(asset);
+        return;
+    }
+
+    std::vector<std::pair<AssetCallback, AssetCallbackThread>> callbacks;
+    std::vector<Asset*> readyMemoryAssets;
+    bool queuedDependents = false;
+
+    // The loading flag is cleared under mQueueMutex so RegisterDependencies never misses a dependency finishing
+    mQueueMutex.lock();
+
+    if (asset->IsLoaded()) {
+        asset->mLoadCount++;
+        AddMemoryUsage(asset, asset->mMemoryUsage);
+        MarkUsed(asset);
+    }
+
+    mLoadMutex.lock();
+    asset->mFlags &= ~AssetFlag_Loading;
+
+    auto callbackIt = mLoadCallbacks.find(asset->mHandle);
+
+    if (callbackIt != mLoadCallbacks.end()) {
+        callbacks = std::move(callbackIt->second);
+        mLoadCallbacks.erase(callbackIt);
+
+        for (auto& [callback, thread] : callbacks) {
+            if (thread == AssetCallbackThread::Main) mMainThreadCallbacks.emplace_back(std::move(callback), asset);
+        }
+    }
+
+    mLoadMutex.unlock();
+
+    auto dependentIt = mDependents.find(asset->mHandle);
+
+    if (dependentIt != mDependents.end()) {
+        if (!asset->IsLoaded()) {
+            GM_LOG_WARNING("Asset Path: \"{}\" failed to load, {} dependents will use fallbacks", asset->GetPathAsString().c_str(), dependentIt->second.size());
+        }
+
+        for (Asset* dependent : dependentIt->second) {
+            if (--dependent->mPendingDependencies > 0) continue;
+
+            if (dependent->mFlags & AssetFlag_MemoryAsset) {
+                readyMemoryAssets.push_back(dependent);
+            } else {
+                // Front of the queue, finish the branches that are already started before starting new ones
+                mAssetQueue.push_front(dependent);
+                Prefetch(dependent);
+                queuedDependents = true;
+            }
+        }
+
+        mDependents.erase(dependentIt);
+    }
+
+    mQueueMutex.unlock();
+    mLoadCondition.notify_all();
+
+    if (queuedDependents) {
+        AsyncFileReader::Submit();
+        mQueueCondition.notify_all();
+    }
+
+    for (auto& [callback, thread] : callbacks) {
+        if (thread == AssetCallbackThread::Loader) callback(asset);
+    }
+
+    for (Asset* dependent : readyMemoryAssets) {
+        FinishLoading(dependent);
+    }
+}
+
+uint32_t AssetManager::RegisterDependencies(Asset* asset) {
+    uint32_t pending = 0;
+
+    // Dependencies have to exist before the dependent is added, so the graph can't contain cycles
+    for (const AssetHandle& handle : asset->mDependencies) {
+        Asset* dependency = mAssets.Get(handle);
+
+        if (dependency == nullptr) {
+            GM_LOG_WARNING("Asset dependency [handle: {:08x}] doesn't exist", handle);
+            continue;
+        }
+
+        if (!dependency->IsLoading()) continue;
+
+        mDependents[handle].push_back(asset);
+        pending++;
+    }
+
+    asset->mPendingDependencies = pending;
+
+    return pending;
+}
+
+void AssetManager::QueueAsset(Asset* asset) {
+    if (mAssetQueue.empty() && mActiveWorkers == 0) {
+        mLoadStats.mStart = std::chrono::high_resolution_clock::now();
+        mLoadStats.mAssetCount = 0;
+        mLoadStats.mStagedBytes = 0;
+    }
+
+    mAssetQueue.push_back(asset);
+
+    Prefetch(asset);
+}
+
+void AssetManager::Prefetch(Asset* asset) {
+    if (asset->mFlags & AssetFlag_MemoryAsset) return;
+
+    {
+        std::shared_lock<std::shared_mutex> lock(mArchiveMutex);
+
+        bool changed = !mChangedFiles.empty() && mChangedFiles.find(asset->mPathHash) != mChangedFiles.end();
+
+        for (auto it = mArchives.rbegin(); !changed && it != mArchives.rend(); it++) {
+            if ((*it)->Prefetch(asset->mFilePath)) return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mPrefetchMutex);
+
+    // The worker maps the file itself once too much has been read ahead
+    if (mPrefetchedBytes >= MaxPrefetchBytes || mPrefetches.find(asset->mPathHash) != mPrefetches.end()) return;
+
+    FileRead* read = AsyncFileReader::Read(asset->mFilePath);
+
+    if (read == nullptr) return;
+
+    mPrefetches[asset->mPathHash] = { asset->mFilePath, read };
+    mPrefetchedBytes += read->GetSize();
+}
+
+FileRead* AssetManager::TakePrefetch(const std::filesystem::path& path) {
+    std::lock_guard<std::mutex> lock(mPrefetchMutex);
+
+    auto it = mPrefetches.find(Util::HashPath(path));
+
+    if (it == mPrefetches.end() || it->second.first != Util::NormalizePath(path)) return nullptr;
+
+    FileRead* read = it->second.second;
+
+    mPrefetchedBytes -= read->GetSize();
+    mPrefetches.erase(it);
+
+    return read;
+}
+
+bool AssetManager::RequestReload(Asset* asset) {
+    mQueueMutex.lock();
+
+    if (!(asset->mFlags & AssetFlag_Evicted)) {
+        mQueueMutex.unlock();
+        return false;
+    }
+
+    asset->mFlags &= ~AssetFlag_Evicted;
+    asset->mFlags |= AssetFlag_Loading;
+
+    bool queued = RegisterDependencies(asset) == 0;
+
+    if (queued) QueueAsset(asset);
+
+    mQueueMutex.unlock();
+
+    if (queued) {
+        AsyncFileReader::Submit();
+        mQueueCondition.notify_one();
+    }
+
+    GM_LOG_DEBUG("Asset Path: \"{}\" AssetHandle: 0x{:08x} Reloading after eviction", asset->GetPathAsString().c_str(), asset->mHandle);
+
+    return true;
+}
+
+void AssetManager::EvictAssets() {
+    uint64_t frame = mFrameIndex;
+
+    if (frame < EvictionMinUnusedFrames) return;
+
+    // Unload destroys the GPU objects right away instead of going through the DeletionQueue. That's only safe because
+    // nothing a frame in flight uses can be a candidate, which holds as long as the window is at least the queue's delay
+    GM_ASSERT_MSG(EvictionMinUnusedFrames >= DeletionQueue::GetFrameDelay(), "More frames in flight than EvictionMinUnusedFrames covers");
+
+    constexpr uint32_t stateMask = AssetFlag_Loaded | AssetFlag_Loading | AssetFlag_Evicted;
+
+    for (uint32_t i = 0; i < (uint32_t)AssetMemoryType::Count; i++) {
+        uint64_t budget = mMemoryBudgets[i];
+
+        if (budget == 0 || mMemoryUsage[i] <= budget) continue;
+
+        std::vector<Asset*> candidates;
+
+        mAssets.ForEach([i, frame, &candidates](const AssetHandle& handle, Asset* asset) {
+            AssetMemoryType type;
+
+            if (!GetMemoryType(asset->mType, &type) || (uint32_t)type != i) return;
+            // Memory assets have nothing to reload from
+            if (asset->mFlags & AssetFlag_MemoryAsset) return;
+            // Pooled textures share their array's memory, unloading one doesn't free any
+            if (asset->mMemoryUsage == 0) return;
+            if ((asset->mFlags & stateMask) != AssetFlag_Loaded || asset->mReloadPending) return;
+            if (asset->GetLastUsedFrame() + EvictionMinUnusedFrames > frame) return;
+
+            candidates.push_back(asset);
+        });
+
+        std::sort(candidates.begin(), candidates.end(), [](Asset* a, Asset* b) { return a->GetLastUsedFrame() < b->GetLastUsedFrame(); });
+
+        uint32_t evictedCount = 0;
+        uint64_t evictedBytes = 0;
+
+        for (Asset* asset : candidates) {
+            if (mMemoryUsage[i] <= budget) break;
+
+            std::lock_guard<std::mutex> lock(mQueueMutex);
+
+            // May have been requested since it was picked
+            if ((asset->mFlags & stateMask) != AssetFlag_Loaded || asset->mReloadPending || asset->GetLastUsedFrame() + EvictionMinUnusedFrames > frame) continue;
+
+            uint64_t size = asset->mMemoryUsage;
+
+            asset->Unload();
+            asset->mFlags |= AssetFlag_Evicted;
+
+            AddMemoryUsage(asset, -(int64_t)size);
+
+            evictedCount++;
+            evictedBytes += size;
+        }
+
+        if (evictedCount > 0) {
+            GM_LOG_DEBUG("[AssetManager] Evicted {} assets ({:.2f}MB), {:.2f}MB of {:.2f}MB budget in use", evictedCount, evictedBytes / 1000000.0, 
+                mMemoryUsage[i] / 1000000.0, budget / 1000000.0);
+        }
+    }
+}
+
+bool AssetManager::GetMemoryType(AssetType type, AssetMemoryType* memoryType) {
+    switch (type) {
+        case AssetType::Texture:
+            *memoryType = AssetMemoryType::Texture;
+            return true;
+        case AssetType::Mesh:
+            *memoryType = AssetMemoryType::Mesh;
+            return true;
+        case AssetType::Binary:
+        case AssetType::Text:
+        case AssetType::Audio:
+            *memoryType = AssetMemoryType::Blob;
+            return true;
+        default:
+            // Shader sources are held by their shaders, materials and samplers are tiny
+            return false;
+    }
+}
+
+void AssetManager::AddMemoryUsage(Asset* asset, int64_t bytes) {
+    AssetMemoryType type;
+
+    if (bytes == 0 || !GetMemoryType(asset->mType, &type)) return;
+
+    mMemoryUsage[(uint32_t)type] += (uint64_t)bytes;
+}
+
+void AssetManager::WaitForDependencies(Asset* asset) {
+    for (const AssetHandle& handle : asset->mDependencies) {
+        Asset* dependency = mAssets.Get(handle);
+
+        if (dependency) WaitUntilLoaded(dependency);
     }
 }
 
@@ -194,6 +1005,14 @@ bool AssetManager::LoadAssetFunction(Asset* asset) {
 
     bool usedBuffer = asset->Load();
 
+    // Assets that don't read their file through ReadAssetData leave the read ahead behind
+    FileRead* unused = TakePrefetch(asset->mFilePath);
+
+    if (unused) {
+        unused->Wait();
+        delete unused;
+    }
+
     if (asset->IsLoaded()) {
         GM_LOG_DEBUG("Asset Path: \"{}\" AssetHandle: 0x{:08x} Loaded!", asset->GetPathAsString().c_str(), handle);
     } else {
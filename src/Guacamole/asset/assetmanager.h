@@ -27,15 +27,45 @@ SOFTWARE.
 #include <Guacamole.h>
 
 #include "asset.h"
+#include "assetarchive.h"
 
 #include <Guacamole/core/uuid.h>
 #include <Guacamole/vulkan/buffer/commandbuffer.h>
+#include <Guacamole/util/concurrentmap.h>
+#include <Guacamole/util/slotmap.h>
 
 #include <unordered_map>
+#include <unordered_set>
 #include <thread>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <shared_mutex>
+#include <functional>
 
 namespace Guacamole {
 
+template<typename T>
+class AssetFuture;
+
+// Which thread an OnLoaded callback is invoked on
+enum class AssetCallbackThread {
+    Loader, // The loader thread that finished the asset, or the calling thread if it's already loaded
+    Main // During AssetManager::Update on the main thread
+};
+
+using AssetCallback = std::function<void(Asset* asset)>;
+
+// Memory budget categories
+enum class AssetMemoryType {
+    Texture, // VRAM
+    Mesh, // VRAM
+    Blob, // System memory (Binary, Text, Audio)
+    Count
+};
+
 class AssetManager {
 public:
     struct FinishedAsset {
@@ -44,30 +74,163 @@ public:
     };
 
 public:
-    static void Init(Device* device);
+    // workerCount = 0 picks a worker count based on the number of hardware threads
+    // hotReload watches the files of added assets and reloads them when they change on disk
+    static void Init(Device* device, uint32_t workerCount = 0, bool hotReload = false);
     static void Shutdown();
     static AssetHandle AddAsset(Asset* asset, bool asyncLoad);
     static AssetHandle AddMemoryAsset(Asset* asset, bool takeOwnershipOfMemory = true);
 
+    // Called once per frame on the main thread
+    static void Update();
+
+    // Blocks until the asset is loaded
     template<typename T = Asset>
     static T* GetAsset(AssetHandle handle) { return (T*)GetAssetInternal(handle); }
+    // Returns nullptr if the asset isn't ready yet
+    template<typename T = Asset>
+    static T* TryGetAsset(AssetHandle handle) { return (T*)TryGetAssetInternal(handle); }
+    // Returns the fallback asset for the type if the asset isn't ready yet
+    template<typename T = Asset>
+    static T* TryGetAssetOrFallback(AssetHandle handle, AssetType type) { return (T*)TryGetAssetOrFallbackInternal(handle, type); }
+    template<typename T = Asset>
+    static AssetFuture<T> GetAssetFuture(AssetHandle handle) { return AssetFuture<T>(handle, FindAsset(handle)); }
+    // The callback is called once the asset is done loading, asset->IsLoaded() is false if the load failed
+    static void OnLoaded(AssetHandle handle, AssetCallback callback, AssetCallbackThread thread = AssetCallbackThread::Main);
+
+    // Loads a new instance of the asset on a loader thread, it replaces the current one during the next Update.
+    // The old instance is deleted once no frame in flight can use it. Returns false if the asset can't be reloaded
+    static bool ReloadAsset(AssetHandle handle);
+    // The callback is called on the main thread every time the asset has been replaced, returns an id for RemoveReloadCallback
+    static uint64_t OnReloaded(AssetHandle handle, AssetCallback callback);
+    static void RemoveReloadCallback(AssetHandle handle, uint64_t id);
+
     static AssetType GetAssetType(AssetHandle handle) { return GetAssetInternal(handle)->mType; }
     static bool IsAssetLoaded(AssetHandle handle);
+    // Blocks until the asset is no longer in the load queue, must not be called from a loader thread
+    static void WaitUntilLoaded(Asset* asset);
     static AssetHandle GetAssetHandleFromPath(const std::filesystem::path& path);
+    static AssetHandle GetAssetHandleFromUUID(UUID uuid);
+    static uint32_t GetWorkerCount() { return (uint32_t)mWorkers.size(); }
+    static bool IsMainThread() { return std::this_thread::get_id() == mMainThreadId; }
+
+    // Archives mounted later take precedence over earlier ones and loose files
+    static bool MountArchive(const std::filesystem::path& path);
+    // Looks the path up in the mounted archives and maps the loose file if it isn't packed. Files that hot reload saw
+    // change are always read loose, the packed copy is older
+    static bool ReadAssetData(const std::filesystem::path& path, AssetData* data);
+
+    // Least recently used assets of the type are evicted once the budget is exceeded and reloaded on the next request. 0 = unlimited
+    // Texture arrays of the TexturePool count in full against the texture budget, the textures pooled in them are never evicted
+    static void SetMemoryBudget(AssetMemoryType type, uint64_t bytes);
+    static uint64_t GetMemoryBudget(AssetMemoryType type) { return mMemoryBudgets[(uint32_t)type]; }
+    static uint64_t GetMemoryUsage(AssetMemoryType type) { return mMemoryUsage[(uint32_t)type]; }
+    static uint64_t GetFrameIndex() { return mFrameIndex; }
+    // For loaded assets whose resident size changes, like textures streaming levels in and out
+    static void AddMemoryUsage(Asset* asset, int64_t bytes);
+
+    // Fallback assets must be loaded memory assets
+    static void SetFallbackAsset(AssetType type, AssetHandle handle);
+    static AssetHandle GetFallbackAsset(AssetType type);
 private:
+    static Asset* FindAsset(AssetHandle handle);
     static Asset* GetAssetInternal(AssetHandle handle);
+    static Asset* TryGetAssetInternal(AssetHandle handle);
+    static Asset* TryGetAssetOrFallbackInternal(AssetHandle handle, AssetType type);
     
-    static void QueueWorker();
+    static void QueueWorker(uint32_t workerIndex);
     static bool LoadAssetFunction(Asset* asset);
+    // Clears the loading flag, wakes up waiters, dispatches OnLoaded callbacks and schedules dependents that are now ready
+    static void FinishLoading(Asset* asset);
+    // Must be called with mQueueMutex held, returns the number of dependencies that are still loading
+    static uint32_t RegisterDependencies(Asset* asset);
+    static void WaitForDependencies(Asset* asset);
+
+    inline static void MarkUsed(Asset* asset) { asset->mLastUsedFrame.store(mFrameIndex.load(std::memory_order_relaxed), std::memory_order_relaxed); }
+    // Must be called with mQueueMutex held
+    static void QueueAsset(Asset* asset);
+    // Starts reading the asset's file in the background so the worker doesn't block on it, AsyncFileReader::Submit kicks it off
+    static void Prefetch(Asset* asset);
+    static FileRead* TakePrefetch(const std::filesystem::path& path);
+    // Requeues an evicted asset, returns false if the asset isn't evicted
+    static bool RequestReload(Asset* asset);
+    static void EvictAssets();
+    static bool GetMemoryType(AssetType type, AssetMemoryType* memoryType);
+    // Swaps finished reload instances into their slots, main thread only
+    static void SwapReloadedAssets();
 
 private:
+    // Throughput of the current burst of queued assets, from the first push to the queue running dry
+    struct LoadStats {
+        std::chrono::high_resolution_clock::time_point mStart;
+        uint32_t mAssetCount;
+        uint64_t mStagedBytes;
+    };
+
     static Device* mDevice;
-    static bool mShouldStop;
-    static std::thread mLoaderThread;
+    static std::atomic<bool> mShouldStop;
+    static std::vector<std::thread> mWorkers;
     static std::mutex mQueueMutex;
+    static std::condition_variable mQueueCondition;
     static std::mutex mCommandBufferMutex;
-    static std::unordered_map<AssetHandle, Asset*> mAssets;
-    static std::vector<Asset*> mAssetQueue;
+    // Signaled every time a queued asset finishes loading
+    static std::mutex mLoadMutex;
+    static std::condition_variable mLoadCondition;
+    // Guarded by mLoadMutex
+    static std::unordered_map<AssetHandle, std::vector<std::pair<AssetCallback, AssetCallbackThread>>> mLoadCallbacks;
+    static std::vector<std::pair<AssetCallback, Asset*>> mMainThreadCallbacks;
+    // Reload instances that are done loading, successfully or not
+    static std::vector<Asset*> mPendingReloads;
+    static std::unordered_map<AssetHandle, std::vector<std::pair<uint64_t, AssetCallback>>> mReloadCallbacks;
+    static uint64_t mNextReloadCallbackId;
+    static bool mHotReload;
+    static std::thread::id mMainThreadId;
+    static SlotMap<AssetHandle, Asset> mAssets;
+    // Util::HashPath -> handle for every asset with a path
+    static ConcurrentMap<uint64_t, AssetHandle> mPathIndex;
+    static ConcurrentMap<UUID, AssetHandle> mUUIDIndex;
+    static std::unordered_map<AssetType, Asset*> mFallbackAssets;
+    static std::deque<Asset*> mAssetQueue;
+    // Assets that weren't used for this many frames can be evicted, covers every frame that might still be in flight
+    static constexpr uint64_t EvictionMinUnusedFrames = 8;
+
+    static std::atomic<uint64_t> mFrameIndex;
+    static std::atomic<uint64_t> mMemoryUsage[(uint32_t)AssetMemoryType::Count];
+    static uint64_t mMemoryBudgets[(uint32_t)AssetMemoryType::Count];
+
+    static std::shared_mutex mArchiveMutex;
+    static std::vector<AssetArchive*> mArchives;
+    // Util::HashPath of the files that changed on disk since they were packed, guarded by mArchiveMutex
+    static std::unordered_set<uint64_t> mChangedFiles;
+
+    // Files read ahead for queued assets, keyed by Util::HashPath
+    static constexpr uint64_t MaxPrefetchBytes = 256000000;
+    static std::mutex mPrefetchMutex;
+    static std::unordered_map<uint64_t, std::pair<std::filesystem::path, FileRead*>> mPrefetches;
+    static uint64_t mPrefetchedBytes;
+
+    // Guarded by mQueueMutex
+    // Assets waiting on the key asset to finish loading
+    static std::unordered_map<AssetHandle, std::vector<Asset*>> mDependents;
+    static uint32_t mActiveWorkers;
+    static LoadStats mLoadStats;
+};
+
+template<typename T = Asset>
+class AssetFuture {
+public:
+    AssetFuture(AssetHandle handle, Asset* asset) : mHandle(handle), mAsset(asset) {}
+
+    // Loaded and uploaded
+    inline bool IsReady() const { return mAsset && !mAsset->IsLoading() && mAsset->IsLoaded(); }
+    inline bool HasFailed() const { return !mAsset || (!mAsset->IsLoading() && !mAsset->IsLoaded()); }
+    inline T* TryGet() const { return IsReady() ? (T*)mAsset : nullptr; }
+    inline T* Get() const { return AssetManager::GetAsset<T>(mHandle); }
+    inline AssetHandle GetHandle() const { return mHandle; }
+
+private:
+    AssetHandle mHandle;
+    Asset* mAsset;
 };
 
 }
\ No newline at end of file
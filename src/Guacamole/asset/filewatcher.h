@@ -0,0 +1,49 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include <filesystem>
+#include <functional>
+
+namespace Guacamole {
+
+// Watches files for changes on a background thread. Bursts of events are coalesced
+// so a file that's written in several steps is only reported once.
+class FileWatcher {
+public:
+    // Invoked on the watcher thread with the normalized path of the changed file
+    using Callback = std::function<void(const std::filesystem::path& file)>;
+
+    static bool Init(Callback callback);
+    static void Shutdown();
+
+    // Watches the directory containing the file, safe to call from any thread
+    static void Watch(const std::filesystem::path& file);
+    static bool IsRunning();
+};
+
+}
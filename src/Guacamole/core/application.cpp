@@ -27,10 +27,15 @@ SOFTWARE.
 #include "application.h"
 
 #include <Guacamole/vulkan/context.h>
+#include <Guacamole/vulkan/deletionqueue.h>
+#include <Guacamole/vulkan/shader/texturepool.h>
+#include <Guacamole/vulkan/shader/texturestreamer.h>
 #include <Guacamole/asset/assetmanager.h>
+#include <Guacamole/asset/assetcache.h>
 #include <Guacamole/core/video/event.h>
 #include <Guacamole/vulkan/buffer/stagingbuffer.h>
 #include <Guacamole/renderer/meshfactory.h>
+#include <Guacamole/renderer/defaultassets.h>
 #include <Guacamole/core/input.h>
 
 #include <chrono>
@@ -58,6 +63,9 @@ void Application::Run() {
         commonStaging->Begin();
 
         mWindow->ProcessEvents();
+        AssetManager::Update();
+        TextureStreamer::Update();
+        DeletionQueue::Update();
 
         bool shouldRender = mSwapchain->Begin();
 
@@ -79,9 +87,13 @@ void Application::Run() {
 
     Input::Shutdown();
     EventManager::Shutdown();
+    TextureStreamer::Shutdown();
+    AssetManager::Shutdown(); // Must stop the loader threads before their staging buffers are destroyed
+    DeletionQueue::Shutdown();
+    TexturePool::Shutdown(); // Freed layers are returned through the deletion queue
+    AssetCache::Shutdown();
     StagingManager::Shutdown();
     MeshFactory::Shutdown();
-    AssetManager::Shutdown();
     Swapchain::Shutdown();
     Context::Shutdown();
     delete mWindow;
@@ -111,9 +123,20 @@ void Application::Init(const WindowSpec& windowSpec, const AppInitSpec& appSpec)
     ss.mDevice = mMainDevice;
 
     mSwapchain = Swapchain::CreateNew(ss);
-    AssetManager::Init(mMainDevice);
+    DeletionQueue::Init(mSwapchain->GetFramesInFlight() + 1);
+    AssetCache::Init(appSpec.assetCacheDirectory);
+    Texture2D::SetCompression(appSpec.textureCompression);
+    TexturePool::Init(appSpec.texturePoolMaxExtent);
+    TextureStreamer::Init(mMainDevice, appSpec.textureStreamingExtent);
+    AssetManager::Init(mMainDevice, appSpec.assetWorkerCount, appSpec.assetHotReload);
+
+    for (const std::filesystem::path& archive : appSpec.assetArchives) {
+        AssetManager::MountArchive(archive);
+    }
+
     StagingManager::AllocateCommonStagingBuffer(ss.mDevice, std::this_thread::get_id(), 50000000, true);
     MeshFactory::Init(ss.mDevice);
+    DefaultAssets::Init(ss.mDevice);
     Input::Init();
     
     EventManager::Init(mWindow);
@@ -30,6 +30,7 @@ SOFTWARE.
 #include <Guacamole/core/video/window.h>
 #include <Guacamole/core/video/event.h>
 #include <Guacamole/vulkan/device.h>
+#include <Guacamole/vulkan/shader/texture.h>
 
 namespace Guacamole {
 
@@ -40,6 +41,13 @@ struct ApplicationSpec {
 struct AppInitSpec {
     std::string appName;
     uint32_t deviceIndex;
+    uint32_t assetWorkerCount; // 0 = pick based on hardware threads
+    std::vector<std::filesystem::path> assetArchives; // Mounted in order, later archives override earlier ones
+    std::filesystem::path assetCacheDirectory; // Cooked asset cache, empty = disabled
+    bool assetHotReload; // Reload assets when their files change on disk
+    TextureCompression textureCompression; // BC compression when textures are cooked
+    uint32_t texturePoolMaxExtent; // Textures up to this size share texture arrays, 0 = disabled
+    uint32_t textureStreamingExtent; // Larger textures keep the levels up to this size resident and stream the rest, 0 = disabled
 };
 
 class Application {
@@ -51,6 +51,8 @@ public:
     inline uint32_t GetWidth() const { return mSpec.Width; }
     inline uint32_t GetHeight() const { return mSpec.Height; }
     inline Type GetType() const { return mWindowType; }
+    // Ends Application::Run after the current frame
+    inline void Close() { mShouldClose = true; }
     
     virtual void CaptureInput() = 0;
     virtual void ReleaseInput() = 0;
@@ -70,20 +70,31 @@ public:
 
         initSpec.appName = "TestApp";
         initSpec.deviceIndex = ~0;
+        initSpec.assetWorkerCount = 0;
+        initSpec.assetCacheDirectory = "cache";
+        initSpec.assetHotReload = true;
+        initSpec.textureCompression = TextureCompression::Best;
+        initSpec.texturePoolMaxExtent = 256;
+        initSpec.textureStreamingExtent = 128;
+
+        // Built with: AssetPacker res.gmpk res
+        if (std::filesystem::exists("res.gmpk")) {
+            initSpec.assetArchives.push_back("res.gmpk");
+        }
 
         Init(windowSpec, initSpec);
 
         mScene = new Scene(this);
 
-        AssetHandle brickTexture = AssetManager::AddAsset(new Texture2D(mMainDevice, "res/texture/brick_pavement.jpg"), false);
-        AssetHandle sheetTexture = AssetManager::AddAsset(new Texture2D(mMainDevice, "res/texture/sheet.png"), false);
+        AssetHandle brickTexture = AssetManager::AddAsset(new Texture2D(mMainDevice, "res/texture/brick_pavement.jpg"), true);
+        AssetHandle sheetTexture = AssetManager::AddAsset(new Texture2D(mMainDevice, "res/texture/sheet.png"), true);
         AssetHandle basicSampler = AssetManager::AddMemoryAsset(new BasicSampler(mMainDevice));
         AssetHandle sheetMaterial = AssetManager::AddMemoryAsset(new Material(vec4(1.0f), sheetTexture, basicSampler));
         AssetHandle brickMaterial = AssetManager::AddMemoryAsset(new Material(vec4(1.0f), brickTexture, basicSampler));
 
         Entity cube = mScene->CreateEntity("Cube");
 
-        cube.AddComponent<MeshComponent>(MeshFactory::GetQuadAsset());
+        cube.AddComponent<MeshComponent>(MeshFactory::GetCubeAsset());
         cube.AddComponent<MaterialComponent>(sheetMaterial);
         cube.AddComponent<TransformComponent>(vec3(0, 0, 0));
 
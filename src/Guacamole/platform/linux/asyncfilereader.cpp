@@ -0,0 +1,465 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include <Guacamole/util/asyncfilereader.h>
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+namespace Guacamole {
+
+// io_uring lengths are 32 bit, larger files are read in several pieces
+static constexpr uint64_t MaxReadChunk = 1ull << 30;
+static constexpr uint32_t FallbackThreadCount = 2;
+
+static bool sInitialized = false;
+static bool sStop = false;
+// Guards everything below except the done condition
+static std::mutex sMutex;
+static std::deque<FileRead*> sQueued;
+static std::mutex sDoneMutex;
+static std::condition_variable sDoneCondition;
+
+// There's no liburing dependency, the rings are set up by hand
+static int sRingFd = -1;
+static uint32_t sQueueDepth = 0;
+static uint32_t sInFlight = 0;
+static uint32_t sUnsubmitted = 0;
+static void* sSqRing = MAP_FAILED;
+static void* sCqRing = MAP_FAILED;
+static size_t sSqRingSize = 0;
+static size_t sCqRingSize = 0;
+static io_uring_sqe* sSqes = (io_uring_sqe*)MAP_FAILED;
+static size_t sSqesSize = 0;
+static uint32_t* sSqTail;
+static uint32_t* sSqMask;
+static uint32_t* sSqArray;
+static uint32_t* sCqHead;
+static uint32_t* sCqTail;
+static uint32_t* sCqMask;
+static io_uring_cqe* sCqes;
+static std::thread sCompletionThread;
+
+static std::vector<std::thread> sWorkers;
+static std::condition_variable sWorkCondition;
+
+static int IoUringSetup(uint32_t entries, io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int IoUringEnter(int fd, uint32_t toSubmit, uint32_t minComplete, uint32_t flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+static int IoUringRegister(int fd, uint32_t opcode, void* arg, uint32_t count) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+static void DestroyRing() {
+    if (sSqes != MAP_FAILED) munmap(sSqes, sSqesSize);
+    if (sCqRing != MAP_FAILED && sCqRing != sSqRing) munmap(sCqRing, sCqRingSize);
+    if (sSqRing != MAP_FAILED) munmap(sSqRing, sSqRingSize);
+    if (sRingFd >= 0) close(sRingFd);
+
+    sSqes = (io_uring_sqe*)MAP_FAILED;
+    sCqRing = MAP_FAILED;
+    sSqRing = MAP_FAILED;
+    sRingFd = -1;
+}
+
+static bool CreateRing(uint32_t queueDepth) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    // Fails with ENOSYS on old kernels and EPERM when it's disabled by seccomp or sysctl
+    sRingFd = IoUringSetup(queueDepth, &params);
+
+    if (sRingFd < 0) return false;
+
+    sSqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    sCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sSqRingSize = sCqRingSize = std::max(sSqRingSize, sCqRingSize);
+    }
+
+    sSqRing = mmap(nullptr, sSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sRingFd, IORING_OFF_SQ_RING);
+
+    if (sSqRing == MAP_FAILED) {
+        DestroyRing();
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sCqRing = sSqRing;
+    } else {
+        sCqRing = mmap(nullptr, sCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sRingFd, IORING_OFF_CQ_RING);
+    }
+
+    sSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sSqes = (io_uring_sqe*)mmap(nullptr, sSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sRingFd, IORING_OFF_SQES);
+
+    if (sCqRing == MAP_FAILED || sSqes == MAP_FAILED) {
+        DestroyRing();
+        return false;
+    }
+
+    // IORING_OP_READ is newer than io_uring itself (5.6)
+    uint8_t probeBuffer[sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op)];
+    io_uring_probe* probe = (io_uring_probe*)probeBuffer;
+    memset(probeBuffer, 0, sizeof(probeBuffer));
+
+    if (IoUringRegister(sRingFd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0 || 
+        probe->last_op < IORING_OP_READ || !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)) {
+        DestroyRing();
+        return false;
+    }
+
+    uint8_t* sq = (uint8_t*)sSqRing;
+    uint8_t* cq = (uint8_t*)sCqRing;
+
+    sSqTail = (uint32_t*)(sq + params.sq_off.tail);
+    sSqMask = (uint32_t*)(sq + params.sq_off.ring_mask);
+    sSqArray = (uint32_t*)(sq + params.sq_off.array);
+    sCqHead = (uint32_t*)(cq + params.cq_off.head);
+    sCqTail = (uint32_t*)(cq + params.cq_off.tail);
+    sCqMask = (uint32_t*)(cq + params.cq_off.ring_mask);
+    sCqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    // The completion ring is twice as large, it can't overflow as long as no more than this are in flight
+    sQueueDepth = params.sq_entries;
+
+    return true;
+}
+
+// sMutex must be held, user_data 0 is the shutdown nop
+static void PushSqe(uint8_t opcode, uint64_t userData, int fd, void* dst, uint32_t size, uint64_t offset) {
+    uint32_t tail = *sSqTail;
+    uint32_t index = tail & *sSqMask;
+    io_uring_sqe* sqe = &sSqes[index];
+
+    memset(sqe, 0, sizeof(io_uring_sqe));
+
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)dst;
+    sqe->len = size;
+    sqe->off = offset;
+    sqe->user_data = userData;
+
+    sSqArray[index] = index;
+
+    // The entry must be visible before the new tail
+    __atomic_store_n(sSqTail, tail + 1, __ATOMIC_RELEASE);
+
+    sInFlight++;
+    sUnsubmitted++;
+}
+
+// sMutex must be held
+static void SubmitRing() {
+    while (sUnsubmitted > 0) {
+        int res = IoUringEnter(sRingFd, sUnsubmitted, 0, 0);
+
+        if (res < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+            GM_LOG_CRITICAL("[AsyncFileReader] io_uring_enter failed: {}", errno);
+            return;
+        }
+
+        sUnsubmitted -= (uint32_t)res;
+    }
+}
+
+void AsyncFileReader::FillRing() {
+    // The last entry is kept free for the shutdown nop, it must never overwrite a read the kernel hasn't consumed
+    while (!sQueued.empty() && sInFlight + 1 < sQueueDepth) {
+        FileRead* read = sQueued.front();
+        sQueued.pop_front();
+
+        uint32_t size = (uint32_t)std::min(read->mSize - read->mOffset, MaxReadChunk);
+
+        PushSqe(IORING_OP_READ, (uint64_t)read, read->mFile, read->mData + read->mOffset, size, read->mOffset);
+    }
+}
+
+void AsyncFileReader::CompletionThread() {
+    while (true) {
+        int res = IoUringEnter(sRingFd, 0, 1, IORING_ENTER_GETEVENTS);
+
+        if (res < 0 && errno != EINTR) {
+            GM_LOG_CRITICAL("[AsyncFileReader] io_uring_enter failed: {}", errno);
+            break;
+        }
+
+        std::vector<std::pair<FileRead*, bool>> finished;
+        std::vector<FileRead*> partial;
+        uint32_t completed = 0;
+
+        uint32_t head = *sCqHead;
+        uint32_t tail = __atomic_load_n(sCqTail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; head++) {
+            const io_uring_cqe& cqe = sCqes[head & *sCqMask];
+            FileRead* read = (FileRead*)cqe.user_data;
+
+            completed++;
+
+            if (read == nullptr) continue;
+
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                partial.push_back(read);
+            } else if (cqe.res <= 0) {
+                // 0 means the file was truncated after it was opened
+                finished.emplace_back(read, true);
+            } else {
+                read->mOffset += (uint64_t)cqe.res;
+
+                if (read->mOffset < read->mSize) {
+                    partial.push_back(read);
+                } else {
+                    finished.emplace_back(read, false);
+                }
+            }
+        }
+
+        __atomic_store_n(sCqHead, head, __ATOMIC_RELEASE);
+
+        for (auto& [read, failed] : finished) {
+            Complete(read, failed);
+        }
+
+        std::lock_guard<std::mutex> lock(sMutex);
+
+        sInFlight -= completed;
+
+        // Remaining pieces go first, they're already holding a buffer
+        for (auto it = partial.rbegin(); it != partial.rend(); it++) {
+            sQueued.push_front(*it);
+        }
+
+        // Slots were freed up, keep the ring full
+        FillRing();
+        SubmitRing();
+
+        if (sStop && sInFlight == 0) break;
+    }
+}
+
+void AsyncFileReader::WorkerThread() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(sMutex);
+
+        sWorkCondition.wait(lock, []() { return sStop || !sQueued.empty(); });
+
+        if (sStop) break;
+
+        FileRead* read = sQueued.front();
+        sQueued.pop_front();
+
+        lock.unlock();
+
+        bool failed = false;
+
+        while (read->mOffset < read->mSize) {
+            ssize_t res = pread(read->mFile, read->mData + read->mOffset, read->mSize - read->mOffset, read->mOffset);
+
+            if (res < 0 && errno == EINTR) continue;
+
+            if (res <= 0) {
+                failed = true;
+                break;
+            }
+
+            read->mOffset += (uint64_t)res;
+        }
+
+        Complete(read, failed);
+    }
+}
+
+void AsyncFileReader::Init(uint32_t queueDepth) {
+    GM_ASSERT_MSG(!sInitialized, "AsyncFileReader already initialized");
+
+    sStop = false;
+    sInFlight = 0;
+    sUnsubmitted = 0;
+
+    // One entry is reserved for the shutdown nop, so at least two are needed to read anything
+    if (CreateRing(std::max(queueDepth, 2u))) {
+        sCompletionThread = std::thread(&AsyncFileReader::CompletionThread);
+        GM_LOG_DEBUG("[AsyncFileReader] Using io_uring with {} entries", sQueueDepth);
+    } else {
+        for (uint32_t i = 0; i < FallbackThreadCount; i++) {
+            sWorkers.emplace_back(&AsyncFileReader::WorkerThread);
+        }
+
+        GM_LOG_DEBUG("[AsyncFileReader] io_uring not available, using {} reader threads", FallbackThreadCount);
+    }
+
+    sInitialized = true;
+}
+
+void AsyncFileReader::Shutdown() {
+    if (!sInitialized) return;
+
+    std::deque<FileRead*> queued;
+
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+
+        queued = std::move(sQueued);
+        sQueued.clear();
+        sStop = true;
+
+        // Wakes up the completion thread, it leaves once everything that's in flight has completed
+        if (sRingFd >= 0) {
+            GM_ASSERT(sInFlight < sQueueDepth);
+            PushSqe(IORING_OP_NOP, 0, -1, nullptr, 0, 0);
+            SubmitRing();
+        }
+    }
+
+    sWorkCondition.notify_all();
+
+    if (sCompletionThread.joinable()) sCompletionThread.join();
+
+    for (std::thread& worker : sWorkers) {
+        worker.join();
+    }
+
+    sWorkers.clear();
+
+    DestroyRing();
+
+    // Never submitted, the owners may still be waiting on them
+    for (FileRead* read : queued) {
+        Complete(read, true);
+    }
+
+    sInitialized = false;
+}
+
+FileRead* AsyncFileReader::Read(const std::filesystem::path& path) {
+    GM_ASSERT(sInitialized);
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    FileRead* read = new FileRead;
+
+    read->mFile = fd;
+    read->mSize = (uint64_t)st.st_size;
+    read->mData = new uint8_t[read->mSize];
+
+    std::lock_guard<std::mutex> lock(sMutex);
+
+    if (sStop) {
+        Complete(read, true);
+        return read;
+    }
+
+    sQueued.push_back(read);
+
+    return read;
+}
+
+void AsyncFileReader::Submit() {
+    if (!sInitialized) return;
+
+    if (sRingFd < 0) {
+        sWorkCondition.notify_all();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(sMutex);
+
+    if (sStop) return;
+
+    FillRing();
+    SubmitRing();
+}
+
+bool AsyncFileReader::IsInitialized() {
+    return sInitialized;
+}
+
+bool AsyncFileReader::IsUsingIoUring() {
+    return sRingFd >= 0;
+}
+
+void AsyncFileReader::Complete(FileRead* read, bool failed) {
+    close(read->mFile);
+    read->mFile = -1;
+
+    if (failed) {
+        delete[] read->mData;
+        read->mData = nullptr;
+        read->mFailed = true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sDoneMutex);
+        read->mDone.store(true, std::memory_order_release);
+    }
+
+    sDoneCondition.notify_all();
+}
+
+FileRead::~FileRead() {
+    GM_ASSERT_MSG(IsDone(), "FileRead deleted while it's still in flight");
+
+    delete[] mData;
+}
+
+bool FileRead::Wait() {
+    if (!IsDone()) {
+        std::unique_lock<std::mutex> lock(sDoneMutex);
+        sDoneCondition.wait(lock, [this]() { return IsDone(); });
+    }
+
+    return !mFailed;
+}
+
+}
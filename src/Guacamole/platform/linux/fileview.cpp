@@ -0,0 +1,95 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include <Guacamole/util/fileview.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Guacamole {
+
+FileView::FileView() : mData(nullptr), mSize(0) {}
+
+FileView::~FileView() {
+    Close();
+}
+
+bool FileView::Open(const std::filesystem::path& path, bool populate) {
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        GM_LOG_CRITICAL("[FileView] Failed to open \"{}\"", path.string().c_str());
+        return false;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        GM_LOG_CRITICAL("[FileView] \"{}\" is empty or can't be stat'ed", path.string().c_str());
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | (populate ? MAP_POPULATE : 0), fd, 0);
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        GM_LOG_CRITICAL("[FileView] Failed to map \"{}\"", path.string().c_str());
+        return false;
+    }
+
+    mData = (uint8_t*)data;
+    mSize = (uint64_t)st.st_size;
+
+    return true;
+}
+
+void FileView::Prefetch(const uint8_t* data, uint64_t size) const {
+    GM_ASSERT(data >= mData && data + size <= mData + mSize);
+
+    // madvise wants a page aligned address
+    uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)data & ~(pageSize - 1);
+
+    madvise((void*)begin, (uintptr_t)data + size - begin, MADV_WILLNEED);
+}
+
+void FileView::Close() {
+    if (mData == nullptr) return;
+
+    munmap(mData, mSize);
+
+    mData = nullptr;
+    mSize = 0;
+}
+
+}
@@ -0,0 +1,179 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include <Guacamole/asset/filewatcher.h>
+#include <Guacamole/util/util.h>
+
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <thread>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Guacamole {
+
+// Events for the same file that arrive within this window are reported once
+static constexpr int DebounceMs = 50;
+
+static FileWatcher::Callback sCallback;
+static std::thread sThread;
+static int sInotifyFd = -1;
+static int sWakeFd = -1;
+static std::mutex sMutex;
+static std::unordered_map<int, std::filesystem::path> sWatches;
+static std::unordered_set<std::string> sWatchedDirectories;
+
+static void WatcherThread() {
+    // inotify_event is variable sized, the buffer must be aligned for it
+    alignas(inotify_event) char buffer[4096];
+    std::unordered_set<std::string> changed;
+
+    pollfd fds[2];
+
+    fds[0].fd = sInotifyFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = sWakeFd;
+    fds[1].events = POLLIN;
+
+    while (true) {
+        int res = poll(fds, 2, changed.empty() ? -1 : DebounceMs);
+
+        if (res < 0) {
+            if (errno == EINTR) continue;
+            GM_LOG_CRITICAL("[FileWatcher] poll failed: {}", errno);
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) break;
+
+        if (res == 0) {
+            // Quiet for DebounceMs, report everything that changed
+            for (const std::string& file : changed) {
+                GM_LOG_DEBUG("[FileWatcher] \"{}\" changed", file.c_str());
+                sCallback(file);
+            }
+
+            changed.clear();
+            continue;
+        }
+
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        ssize_t size = read(sInotifyFd, buffer, sizeof(buffer));
+
+        if (size <= 0) continue;
+
+        std::lock_guard<std::mutex> lock(sMutex);
+
+        for (char* ptr = buffer; ptr < buffer + size; ptr += sizeof(inotify_event) + ((inotify_event*)ptr)->len) {
+            const inotify_event* event = (const inotify_event*)ptr;
+
+            if (event->len == 0) continue;
+
+            auto it = sWatches.find(event->wd);
+
+            if (it == sWatches.end()) continue;
+
+            changed.insert(Util::NormalizePath(it->second / event->name).string());
+        }
+    }
+}
+
+bool FileWatcher::Init(Callback callback) {
+    GM_ASSERT_MSG(sInotifyFd < 0, "FileWatcher already initialized");
+
+    sInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (sInotifyFd < 0) {
+        GM_LOG_CRITICAL("[FileWatcher] inotify_init1 failed: {}", errno);
+        return false;
+    }
+
+    sWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (sWakeFd < 0) {
+        GM_LOG_CRITICAL("[FileWatcher] eventfd failed: {}", errno);
+        close(sInotifyFd);
+        sInotifyFd = -1;
+        return false;
+    }
+
+    sCallback = std::move(callback);
+    sThread = std::thread(&WatcherThread);
+
+    return true;
+}
+
+void FileWatcher::Shutdown() {
+    if (sInotifyFd < 0) return;
+
+    uint64_t value = 1;
+    write(sWakeFd, &value, sizeof(value));
+
+    sThread.join();
+
+    close(sWakeFd);
+    close(sInotifyFd);
+
+    sWakeFd = -1;
+    sInotifyFd = -1;
+    sCallback = nullptr;
+    sWatches.clear();
+    sWatchedDirectories.clear();
+}
+
+void FileWatcher::Watch(const std::filesystem::path& file) {
+    if (sInotifyFd < 0) return;
+
+    std::filesystem::path directory = Util::NormalizePath(file).parent_path();
+
+    if (directory.empty()) directory = ".";
+
+    std::lock_guard<std::mutex> lock(sMutex);
+
+    if (!sWatchedDirectories.insert(directory.string()).second) return;
+
+    // Editors either write in place or write a temp file and rename it over the original
+    int wd = inotify_add_watch(sInotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+    if (wd < 0) {
+        // Packed assets don't have a directory on disk
+        GM_LOG_DEBUG("[FileWatcher] Can't watch \"{}\"", directory.string().c_str());
+        return;
+    }
+
+    sWatches[wd] = directory;
+}
+
+bool FileWatcher::IsRunning() {
+    return sInotifyFd >= 0;
+}
+
+}
@@ -0,0 +1,200 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include <Guacamole/util/asyncfilereader.h>
+
+#include <Windows.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+namespace Guacamole {
+
+// Windows reads on a small pool of threads with blocking ReadFile calls, the same as the Linux fallback when
+// io_uring isn't available. Reads are whole files into one buffer, so overlapped IO wouldn't save any copies
+static constexpr uint32_t ReaderThreadCount = 2;
+
+static bool sInitialized = false;
+static bool sStop = false;
+static std::mutex sMutex;
+static std::deque<FileRead*> sQueued;
+static std::mutex sDoneMutex;
+static std::condition_variable sDoneCondition;
+static std::vector<std::thread> sWorkers;
+static std::condition_variable sWorkCondition;
+
+void AsyncFileReader::WorkerThread() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(sMutex);
+
+        sWorkCondition.wait(lock, []() { return sStop || !sQueued.empty(); });
+
+        if (sStop) break;
+
+        FileRead* read = sQueued.front();
+        sQueued.pop_front();
+
+        lock.unlock();
+
+        bool failed = false;
+
+        while (read->mOffset < read->mSize) {
+            DWORD toRead = (DWORD)std::min<uint64_t>(read->mSize - read->mOffset, 1ull << 30);
+            DWORD bytesRead = 0;
+
+            if (!ReadFile((HANDLE)read->mFile, read->mData + read->mOffset, toRead, &bytesRead, nullptr) || bytesRead == 0) {
+                failed = true;
+                break;
+            }
+
+            read->mOffset += bytesRead;
+        }
+
+        Complete(read, failed);
+    }
+}
+
+void AsyncFileReader::Init(uint32_t queueDepth) {
+    GM_ASSERT_MSG(!sInitialized, "AsyncFileReader already initialized");
+
+    sStop = false;
+
+    for (uint32_t i = 0; i < ReaderThreadCount; i++) {
+        sWorkers.emplace_back(&AsyncFileReader::WorkerThread);
+    }
+
+    sInitialized = true;
+}
+
+void AsyncFileReader::Shutdown() {
+    if (!sInitialized) return;
+
+    std::deque<FileRead*> queued;
+
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+
+        queued = std::move(sQueued);
+        sQueued.clear();
+        sStop = true;
+    }
+
+    sWorkCondition.notify_all();
+
+    for (std::thread& worker : sWorkers) {
+        worker.join();
+    }
+
+    sWorkers.clear();
+
+    for (FileRead* read : queued) {
+        Complete(read, true);
+    }
+
+    sInitialized = false;
+}
+
+FileRead* AsyncFileReader::Read(const std::filesystem::path& path) {
+    GM_ASSERT(sInitialized);
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    FileRead* read = new FileRead;
+
+    read->mFile = file;
+    read->mSize = (uint64_t)size.QuadPart;
+    read->mData = new uint8_t[read->mSize];
+
+    std::lock_guard<std::mutex> lock(sMutex);
+
+    if (sStop) {
+        Complete(read, true);
+        return read;
+    }
+
+    sQueued.push_back(read);
+
+    return read;
+}
+
+void AsyncFileReader::Submit() {
+    if (sInitialized) sWorkCondition.notify_all();
+}
+
+bool AsyncFileReader::IsInitialized() {
+    return sInitialized;
+}
+
+bool AsyncFileReader::IsUsingIoUring() {
+    return false;
+}
+
+void AsyncFileReader::Complete(FileRead* read, bool failed) {
+    CloseHandle((HANDLE)read->mFile);
+    read->mFile = nullptr;
+
+    if (failed) {
+        delete[] read->mData;
+        read->mData = nullptr;
+        read->mFailed = true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sDoneMutex);
+        read->mDone.store(true, std::memory_order_release);
+    }
+
+    sDoneCondition.notify_all();
+}
+
+FileRead::~FileRead() {
+    GM_ASSERT_MSG(IsDone(), "FileRead deleted while it's still in flight");
+
+    delete[] mData;
+}
+
+bool FileRead::Wait() {
+    if (!IsDone()) {
+        std::unique_lock<std::mutex> lock(sDoneMutex);
+        sDoneCondition.wait(lock, [this]() { return IsDone(); });
+    }
+
+    return !mFailed;
+}
+
+}
@@ -0,0 +1,109 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include <Guacamole/util/fileview.h>
+
+#include <Windows.h>
+
+namespace Guacamole {
+
+FileView::FileView() : mData(nullptr), mSize(0), mFileHandle(INVALID_HANDLE_VALUE), mMappingHandle(nullptr) {}
+
+FileView::~FileView() {
+    Close();
+}
+
+bool FileView::Open(const std::filesystem::path& path, bool populate) {
+    Close();
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE) {
+        GM_LOG_CRITICAL("[FileView] Failed to open \"{}\"", path.string().c_str());
+        return false;
+    }
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        GM_LOG_CRITICAL("[FileView] \"{}\" is empty or can't be stat'ed", path.string().c_str());
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (mapping == nullptr) {
+        GM_LOG_CRITICAL("[FileView] Failed to create mapping for \"{}\"", path.string().c_str());
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (data == nullptr) {
+        GM_LOG_CRITICAL("[FileView] Failed to map \"{}\"", path.string().c_str());
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    mFileHandle = file;
+    mMappingHandle = mapping;
+    mData = (uint8_t*)data;
+    mSize = (uint64_t)size.QuadPart;
+
+    // There's no MAP_POPULATE, prefetching the whole view is the closest thing
+    if (populate) Prefetch(mData, mSize);
+
+    return true;
+}
+
+void FileView::Prefetch(const uint8_t* data, uint64_t size) const {
+    GM_ASSERT(data >= mData && data + size <= mData + mSize);
+
+    WIN32_MEMORY_RANGE_ENTRY range;
+
+    range.VirtualAddress = (PVOID)data;
+    range.NumberOfBytes = (SIZE_T)size;
+
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+void FileView::Close() {
+    if (mData == nullptr) return;
+
+    UnmapViewOfFile(mData);
+    CloseHandle(mMappingHandle);
+    CloseHandle(mFileHandle);
+
+    mData = nullptr;
+    mSize = 0;
+    mFileHandle = INVALID_HANDLE_VALUE;
+    mMappingHandle = nullptr;
+}
+
+}
@@ -0,0 +1,240 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <Guacamole.h>
+
+#include <Guacamole/asset/filewatcher.h>
+#include <Guacamole/util/util.h>
+
+#include <Windows.h>
+
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+
+namespace Guacamole {
+
+// Events for the same file that arrive within this window are reported once
+static constexpr DWORD DebounceMs = 50;
+
+// Completion keys that aren't a DirectoryWatch
+static constexpr ULONG_PTR ShutdownKey = 0;
+static constexpr ULONG_PTR AddKey = 1;
+
+struct DirectoryWatch {
+    std::filesystem::path mDirectory;
+    HANDLE mHandle;
+    OVERLAPPED mOverlapped;
+    // FILE_NOTIFY_INFORMATION is variable sized, the buffer must be aligned for it
+    alignas(DWORD) uint8_t mBuffer[16384];
+};
+
+static FileWatcher::Callback sCallback;
+static std::thread sThread;
+static HANDLE sPort = nullptr;
+static std::mutex sMutex;
+static std::vector<std::filesystem::path> sPending;
+static std::unordered_set<std::wstring> sWatchedDirectories;
+// Only touched by the watcher thread, overlapped reads are cancelled if the thread that issued them exits
+static std::vector<DirectoryWatch*> sWatches;
+
+static bool IssueRead(DirectoryWatch* watch) {
+    memset(&watch->mOverlapped, 0, sizeof(OVERLAPPED));
+
+    // Editors either write in place or write a temp file and rename it over the original
+    return ReadDirectoryChangesW(watch->mHandle, watch->mBuffer, sizeof(watch->mBuffer), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, 
+        nullptr, &watch->mOverlapped, nullptr) != 0;
+}
+
+static void CloseWatch(DirectoryWatch* watch) {
+    DWORD bytes = 0;
+
+    // The buffer must outlive the read
+    if (CancelIoEx(watch->mHandle, &watch->mOverlapped)) GetOverlappedResult(watch->mHandle, &watch->mOverlapped, &bytes, TRUE);
+
+    CloseHandle(watch->mHandle);
+    delete watch;
+}
+
+static void AddWatch(const std::filesystem::path& directory) {
+    HANDLE handle = CreateFileW(directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+
+    if (handle == INVALID_HANDLE_VALUE) {
+        // Packed assets don't have a directory on disk
+        GM_LOG_DEBUG("[FileWatcher] Can't watch \"{}\"", directory.u8string().c_str());
+        return;
+    }
+
+    DirectoryWatch* watch = new DirectoryWatch;
+
+    watch->mDirectory = directory;
+    watch->mHandle = handle;
+
+    if (CreateIoCompletionPort(handle, sPort, (ULONG_PTR)watch, 0) == nullptr || !IssueRead(watch)) {
+        GM_LOG_DEBUG("[FileWatcher] Can't watch \"{}\": {}", directory.u8string().c_str(), GetLastError());
+        CloseHandle(handle);
+        delete watch;
+        return;
+    }
+
+    sWatches.push_back(watch);
+}
+
+static void WatcherThread() {
+    std::unordered_set<std::wstring> changed;
+
+    while (true) {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED* overlapped = nullptr;
+
+        BOOL res = GetQueuedCompletionStatus(sPort, &bytes, &key, &overlapped, changed.empty() ? INFINITE : DebounceMs);
+
+        if (!res && overlapped == nullptr) {
+            if (GetLastError() != WAIT_TIMEOUT) {
+                GM_LOG_CRITICAL("[FileWatcher] GetQueuedCompletionStatus failed: {}", GetLastError());
+                break;
+            }
+
+            // Quiet for DebounceMs, report everything that changed
+            for (const std::wstring& file : changed) {
+                GM_LOG_DEBUG("[FileWatcher] \"{}\" changed", std::filesystem::path(file).u8string().c_str());
+                sCallback(file);
+            }
+
+            changed.clear();
+            continue;
+        }
+
+        if (key == ShutdownKey) break;
+
+        if (key == AddKey) {
+            std::vector<std::filesystem::path> pending;
+
+            {
+                std::lock_guard<std::mutex> lock(sMutex);
+                pending.swap(sPending);
+            }
+
+            for (const std::filesystem::path& directory : pending) {
+                AddWatch(directory);
+            }
+
+            continue;
+        }
+
+        DirectoryWatch* watch = (DirectoryWatch*)key;
+
+        // 0 bytes means the buffer overflowed and the changes are lost
+        for (uint8_t* ptr = watch->mBuffer; res && bytes > 0;) {
+            const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)ptr;
+
+            if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME) {
+                std::wstring name(info->FileName, info->FileNameLength / sizeof(WCHAR));
+
+                changed.insert(Util::NormalizePath(watch->mDirectory / name).wstring());
+            }
+
+            if (info->NextEntryOffset == 0) break;
+
+            ptr += info->NextEntryOffset;
+        }
+
+        if (!res || !IssueRead(watch)) {
+            // The directory was deleted or renamed
+            GM_LOG_DEBUG("[FileWatcher] Stopped watching \"{}\": {}", watch->mDirectory.u8string().c_str(), GetLastError());
+
+            {
+                std::lock_guard<std::mutex> lock(sMutex);
+                sWatchedDirectories.erase(watch->mDirectory.wstring());
+            }
+
+            sWatches.erase(std::find(sWatches.begin(), sWatches.end(), watch));
+            CloseWatch(watch);
+        }
+    }
+}
+
+bool FileWatcher::Init(Callback callback) {
+    GM_ASSERT_MSG(sPort == nullptr, "FileWatcher already initialized");
+
+    sPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+
+    if (sPort == nullptr) {
+        GM_LOG_CRITICAL("[FileWatcher] CreateIoCompletionPort failed: {}", GetLastError());
+        return false;
+    }
+
+    sCallback = std::move(callback);
+    sThread = std::thread(&WatcherThread);
+
+    return true;
+}
+
+void FileWatcher::Shutdown() {
+    if (sPort == nullptr) return;
+
+    PostQueuedCompletionStatus(sPort, 0, ShutdownKey, nullptr);
+
+    sThread.join();
+
+    for (DirectoryWatch* watch : sWatches) {
+        CloseWatch(watch);
+    }
+
+    CloseHandle(sPort);
+
+    sPort = nullptr;
+    sCallback = nullptr;
+    sWatches.clear();
+    sPending.clear();
+    sWatchedDirectories.clear();
+}
+
+void FileWatcher::Watch(const std::filesystem::path& file) {
+    if (sPort == nullptr) return;
+
+    std::filesystem::path directory = Util::NormalizePath(file).parent_path();
+
+    if (directory.empty()) directory = ".";
+
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+
+        if (!sWatchedDirectories.insert(directory.wstring()).second) return;
+
+        sPending.push_back(directory);
+    }
+
+    // The watcher thread opens the directory and issues the reads
+    PostQueuedCompletionStatus(sPort, 0, AddKey, nullptr);
+}
+
+bool FileWatcher::IsRunning() {
+    return sPort != nullptr;
+}
+
+}
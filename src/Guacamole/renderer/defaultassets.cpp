@@ -0,0 +1,62 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "defaultassets.h"
+#include "meshfactory.h"
+#include "material.h"
+
+#include <Guacamole/asset/assetmanager.h>
+#include <Guacamole/vulkan/device.h>
+#include <Guacamole/vulkan/shader/texture.h>
+#include <Guacamole/vulkan/buffer/stagingbuffer.h>
+
+namespace Guacamole {
+
+AssetHandle DefaultAssets::mTextureAsset = AssetHandle::Null();
+AssetHandle DefaultAssets::mSamplerAsset = AssetHandle::Null();
+AssetHandle DefaultAssets::mMaterialAsset = AssetHandle::Null();
+
+void DefaultAssets::Init(Device* device) {
+    // 2x2 magenta/black checker, sampled with nearest filtering so it stays a checker
+    const uint32_t checker[] = {
+        0xFFFF00FF, 0xFF000000,
+        0xFF000000, 0xFFFF00FF
+    };
+
+    Texture2D* texture = new Texture2D(device, 2, 2, VK_FORMAT_R8G8B8A8_UNORM);
+    memcpy(StagingManager::GetCommonStagingBuffer()->AllocateImage(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture), checker, sizeof(checker));
+
+    mTextureAsset = AssetManager::AddMemoryAsset(texture, true);
+    mSamplerAsset = AssetManager::AddMemoryAsset(new BasicSampler(device, VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT), true);
+    mMaterialAsset = AssetManager::AddMemoryAsset(new Material(vec4(1.0f), mTextureAsset, mSamplerAsset), true);
+
+    AssetManager::SetFallbackAsset(AssetType::Texture, mTextureAsset);
+    AssetManager::SetFallbackAsset(AssetType::Sampler, mSamplerAsset);
+    AssetManager::SetFallbackAsset(AssetType::Material, mMaterialAsset);
+    AssetManager::SetFallbackAsset(AssetType::Mesh, MeshFactory::GetCubeAsset());
+}
+
+}
@@ -0,0 +1,51 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include <Guacamole/asset/asset.h>
+
+namespace Guacamole {
+
+class Device;
+
+// Placeholder assets that are rendered in place of assets that are still loading.
+// Must be initialized after MeshFactory and while the main thread staging buffer is recording.
+// The AssetManager owns them, they're freed with the rest of the assets in AssetManager::Shutdown.
+class DefaultAssets {
+public:
+    static void Init(Device* device);
+
+    static AssetHandle GetTextureAsset() { return mTextureAsset; }
+    static AssetHandle GetSamplerAsset() { return mSamplerAsset; }
+    static AssetHandle GetMaterialAsset() { return mMaterialAsset; }
+private:
+    static AssetHandle mTextureAsset;
+    static AssetHandle mSamplerAsset;
+    static AssetHandle mMaterialAsset;
+};
+
+}
@@ -0,0 +1,672 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "meshimporter.h"
+
+#include <thread>
+
+namespace Guacamole {
+
+static constexpr uint32_t GlbMagic = 0x46546C67; // glTF
+static constexpr uint32_t GlbChunkJson = 0x4E4F534A;
+static constexpr uint32_t GlbChunkBin = 0x004E4942;
+
+static constexpr uint32_t ComponentByte = 5120;
+static constexpr uint32_t ComponentUnsignedByte = 5121;
+static constexpr uint32_t ComponentShort = 5122;
+static constexpr uint32_t ComponentUnsignedShort = 5123;
+static constexpr uint32_t ComponentUnsignedInt = 5125;
+static constexpr uint32_t ComponentFloat = 5126;
+
+static constexpr uint32_t ModeTriangles = 4;
+// Guards against cycles, which the spec forbids but files don't always respect
+static constexpr uint32_t MaxNodeDepth = 64;
+
+static uint32_t GetComponentSize(uint32_t componentType) {
+    switch (componentType) {
+        case ComponentByte:
+        case ComponentUnsignedByte:
+            return 1;
+        case ComponentShort:
+        case ComponentUnsignedShort:
+            return 2;
+        case ComponentUnsignedInt:
+        case ComponentFloat:
+            return 4;
+    }
+
+    return 0;
+}
+
+static bool DecodeBase64(std::string_view text, std::vector<uint8_t>* out) {
+    uint32_t bits = 0;
+    uint32_t bitCount = 0;
+
+    out->reserve(text.size() / 4 * 3);
+
+    for (char c : text) {
+        uint32_t value;
+
+        if (c >= 'A' && c <= 'Z') value = c - 'A';
+        else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') value = c - '0' + 52;
+        else if (c == '+') value = 62;
+        else if (c == '/') value = 63;
+        else if (c == '=') break;
+        else return false;
+
+        bits = (bits << 6) | value;
+        bitCount += 6;
+
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            out->push_back((uint8_t)(bits >> bitCount));
+        }
+    }
+
+    return true;
+}
+
+// Relative URIs may percent encode spaces and such
+static std::string DecodeURI(std::string_view uri) {
+    std::string decoded;
+
+    for (uint64_t i = 0; i < uri.size(); i++) {
+        if (uri[i] == '%' && i + 2 < uri.size()) {
+            decoded += (char)strtoul(std::string(uri.substr(i + 1, 2)).c_str(), nullptr, 16);
+            i += 2;
+        } else {
+            decoded += uri[i];
+        }
+    }
+
+    return decoded;
+}
+
+// Column major, out = a * b. out may not alias
+static void MultiplyMatrix(const float* a, const float* b, float* out) {
+    for (uint32_t column = 0; column < 4; column++) {
+        for (uint32_t row = 0; row < 4; row++) {
+            float sum = 0.0f;
+
+            for (uint32_t k = 0; k < 4; k++) {
+                sum += a[k * 4 + row] * b[column * 4 + k];
+            }
+
+            out[column * 4 + row] = sum;
+        }
+    }
+}
+
+static void GetNodeMatrix(const Util::JsonValue& node, float* out) {
+    const Util::JsonValue& matrix = node["matrix"];
+
+    if (matrix.GetSize() == 16) {
+        for (uint32_t i = 0; i < 16; i++) {
+            out[i] = (float)matrix[i].GetNumber();
+        }
+
+        return;
+    }
+
+    const Util::JsonValue& translation = node["translation"];
+    const Util::JsonValue& rotation = node["rotation"];
+    const Util::JsonValue& scale = node["scale"];
+
+    float t[3] = { (float)translation[0].GetNumber(), (float)translation[1].GetNumber(), (float)translation[2].GetNumber() };
+    float q[4] = { (float)rotation[0].GetNumber(), (float)rotation[1].GetNumber(), (float)rotation[2].GetNumber(), (float)rotation[3].GetNumber(1.0) };
+    float s[3] = { (float)scale[0].GetNumber(1.0), (float)scale[1].GetNumber(1.0), (float)scale[2].GetNumber(1.0) };
+
+    float xx = q[0] * q[0], yy = q[1] * q[1], zz = q[2] * q[2];
+    float xy = q[0] * q[1], xz = q[0] * q[2], yz = q[1] * q[2];
+    float xw = q[0] * q[3], yw = q[1] * q[3], zw = q[2] * q[3];
+
+    // T * R * S
+    out[0] = (1.0f - 2.0f * (yy + zz)) * s[0];
+    out[1] = 2.0f * (xy + zw) * s[0];
+    out[2] = 2.0f * (xz - yw) * s[0];
+    out[3] = 0.0f;
+    out[4] = 2.0f * (xy - zw) * s[1];
+    out[5] = (1.0f - 2.0f * (xx + zz)) * s[1];
+    out[6] = 2.0f * (yz + xw) * s[1];
+    out[7] = 0.0f;
+    out[8] = 2.0f * (xz + yw) * s[2];
+    out[9] = 2.0f * (yz - xw) * s[2];
+    out[10] = (1.0f - 2.0f * (xx + yy)) * s[2];
+    out[11] = 0.0f;
+    out[12] = t[0];
+    out[13] = t[1];
+    out[14] = t[2];
+    out[15] = 1.0f;
+}
+
+static const float sIdentity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+bool GltfImporter::Parse(const std::filesystem::path& path, const uint8_t* data, uint64_t size, const MeshFileReader& reader, uint32_t threadCount) {
+    mThreadCount = threadCount == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : threadCount;
+
+    const char* json = (const char*)data;
+    uint64_t jsonSize = size;
+    const uint8_t* binChunk = nullptr;
+    uint64_t binSize = 0;
+
+    if (size >= 12 && *(const uint32_t*)data == GlbMagic) {
+        uint32_t version = *(const uint32_t*)(data + 4);
+        uint64_t length = std::min((uint64_t)*(const uint32_t*)(data + 8), size);
+        uint64_t offset = 12;
+
+        if (version != 2) {
+            GM_LOG_CRITICAL("[GltfImporter] \"{}\" is GLB version {}, only 2 is supported", path.string(), version);
+            return false;
+        }
+
+        json = nullptr;
+
+        // Chunks are 4 byte aligned, the first one is always the JSON
+        while (offset + 8 <= length) {
+            uint64_t chunkSize = *(const uint32_t*)(data + offset);
+            uint32_t chunkType = *(const uint32_t*)(data + offset + 4);
+
+            if (offset + 8 + chunkSize > length) break;
+
+            if (chunkType == GlbChunkJson && json == nullptr) {
+                json = (const char*)data + offset + 8;
+                jsonSize = chunkSize;
+            } else if (chunkType == GlbChunkBin && binChunk == nullptr) {
+                binChunk = data + offset + 8;
+                binSize = chunkSize;
+            }
+
+            offset += 8 + ((chunkSize + 3) & ~3ull);
+        }
+
+        if (json == nullptr) {
+            GM_LOG_CRITICAL("[GltfImporter] \"{}\" has no JSON chunk", path.string());
+            return false;
+        }
+    } else if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        // UTF-8 BOM
+        json += 3;
+        jsonSize -= 3;
+    }
+
+    if (!Util::JsonValue::Parse(json, jsonSize, &mDocument)) {
+        GM_LOG_CRITICAL("[GltfImporter] \"{}\" isn't valid JSON", path.string());
+        return false;
+    }
+
+    if (mDocument["asset"]["version"].GetString().substr(0, 2) != "2.") {
+        GM_LOG_CRITICAL("[GltfImporter] \"{}\" isn't glTF 2.0", path.string());
+        return false;
+    }
+
+    if (!LoadBuffers(path, binChunk, binSize, reader)) return false;
+
+    const Util::JsonValue& scenes = mDocument["scenes"];
+
+    if (scenes.GetSize() > 0) {
+        const Util::JsonValue& scene = scenes[(uint64_t)mDocument["scene"].GetNumber()];
+        const Util::JsonValue& nodes = scene["nodes"];
+
+        for (uint64_t i = 0; i < nodes.GetSize(); i++) {
+            if (!AddNode((uint64_t)nodes[i].GetNumber(), sIdentity, 0)) return false;
+        }
+    } else {
+        // No scene to place the meshes, they're used as is
+        const Util::JsonValue& meshes = mDocument["meshes"];
+
+        for (uint64_t i = 0; i < meshes.GetSize(); i++) {
+            const Util::JsonValue& primitives = meshes[i]["primitives"];
+
+            for (uint64_t j = 0; j < primitives.GetSize(); j++) {
+                if (!AddPrimitive(primitives[j], sIdentity)) return false;
+            }
+        }
+    }
+
+    if (mIndices.empty()) {
+        GM_LOG_CRITICAL("[GltfImporter] \"{}\" has no triangles", path.string());
+        return false;
+    }
+
+    bool missingNormals = false;
+
+    for (const Primitive& primitive : mPrimitives) {
+        missingNormals |= primitive.mNormal.mData == nullptr;
+    }
+
+    // Generated in model space before the transform like loaded ones
+    if (missingNormals) {
+        mGeneratedNormals.assign(mVertexCount * 3, 0.0f);
+
+        for (Primitive& primitive : mPrimitives) {
+            if (primitive.mNormal.mData != nullptr) continue;
+
+            float* normals = &mGeneratedNormals[primitive.mFirstVertex * 3];
+
+            for (uint64_t i = primitive.mFirstIndex; i < primitive.mFirstIndex + primitive.mIndexCount; i += 3) {
+                uint64_t v[3];
+                float p[3][3];
+
+                for (uint32_t j = 0; j < 3; j++) {
+                    v[j] = mIndices[i + j] - primitive.mFirstVertex;
+                    ReadAttribute(primitive.mPosition, v[j], 3, p[j]);
+                }
+
+                AccumulateNormal(p[0], p[1], p[2], normals + v[0] * 3, normals + v[1] * 3, normals + v[2] * 3);
+            }
+
+            NormalizeNormals(normals, primitive.mVertexCount);
+
+            primitive.mNormal.mData = (const uint8_t*)normals;
+            primitive.mNormal.mStride = sizeof(float) * 3;
+            primitive.mNormal.mComponentType = ComponentFloat;
+        }
+    }
+
+    for (const Primitive& primitive : mPrimitives) {
+        const float* m = primitive.mTransform;
+        float det = m[0] * (m[5] * m[10] - m[9] * m[6]) - m[4] * (m[1] * m[10] - m[9] * m[2]) + m[8] * (m[1] * m[6] - m[5] * m[2]);
+
+        // Mirroring transforms already turn the triangles around
+        if (det >= 0.0f) FlipWinding(primitive.mFirstIndex, primitive.mIndexCount);
+
+        for (uint64_t i = 0; i < primitive.mVertexCount; i++) {
+            float local[3];
+            float position[3];
+
+            ReadAttribute(primitive.mPosition, i, 3, local);
+            TransformPosition(primitive, local, position);
+            AddBounds(position[0], position[1], position[2]);
+        }
+
+        for (uint64_t i = 0; i < primitive.mVertexCount && primitive.mUV.mData != nullptr; i++) {
+            float uv[2];
+
+            ReadAttribute(primitive.mUV, i, 2, uv);
+            AddUVBounds(uv[0], uv[1]);
+        }
+
+        if (primitive.mUV.mData == nullptr) AddUVBounds(0.0f, 0.0f);
+    }
+
+    return true;
+}
+
+bool GltfImporter::LoadBuffers(const std::filesystem::path& path, const uint8_t* binChunk, uint64_t binSize, const MeshFileReader& reader) {
+    const Util::JsonValue& buffers = mDocument["buffers"];
+
+    mDecodedBuffers.reserve(buffers.GetSize());
+
+    for (uint64_t i = 0; i < buffers.GetSize(); i++) {
+        const Util::JsonValue& buffer = buffers[i];
+        uint64_t byteLength = (uint64_t)buffer["byteLength"].GetNumber();
+        std::string_view uri = buffer["uri"].GetString();
+        const uint8_t* data = nullptr;
+        uint64_t size = 0;
+
+        if (uri.empty()) {
+            // Only the first buffer of a GLB may refer to the BIN chunk
+            data = i == 0 ? binChunk : nullptr;
+            size = binSize;
+        } else if (uri.substr(0, 5) == "data:") {
+            uint64_t comma = uri.find(',');
+
+            if (comma != std::string_view::npos && uri.substr(0, comma).find(";base64") != std::string_view::npos) {
+                std::vector<uint8_t>& decoded = mDecodedBuffers.emplace_back();
+
+                if (DecodeBase64(uri.substr(comma + 1), &decoded)) {
+                    data = decoded.data();
+                    size = decoded.size();
+                }
+            }
+        } else {
+            data = reader(path.parent_path() / DecodeURI(uri), &size);
+        }
+
+        if (data == nullptr || size < byteLength) {
+            GM_LOG_CRITICAL("[GltfImporter] Couldn't load buffer {} of \"{}\"", i, path.string());
+            return false;
+        }
+
+        mBuffers.emplace_back(data, byteLength);
+    }
+
+    return true;
+}
+
+bool GltfImporter::GetAccessor(uint64_t index, uint32_t componentCount, Attribute* attribute, uint64_t* count) const {
+    static const char* sTypes[] = { "SCALAR", "VEC2", "VEC3", "VEC4" };
+
+    const Util::JsonValue& accessor = mDocument["accessors"][index];
+    const Util::JsonValue& view = mDocument["bufferViews"][(uint64_t)(int64_t)accessor["bufferView"].GetNumber(-1.0)];
+
+    // Sparse and view-less (all zero) accessors aren't worth supporting for meshes
+    if (!accessor.IsObject() || !view.IsObject() || accessor["sparse"].IsObject()) return false;
+    if (accessor["type"].GetString() != sTypes[componentCount - 1]) return false;
+
+    uint64_t bufferIndex = (uint64_t)view["buffer"].GetNumber();
+
+    if (bufferIndex >= mBuffers.size()) return false;
+
+    uint32_t componentType = (uint32_t)accessor["componentType"].GetNumber();
+    uint64_t elementSize = (uint64_t)GetComponentSize(componentType) * componentCount;
+    uint64_t viewOffset = (uint64_t)view["byteOffset"].GetNumber();
+    uint64_t viewLength = (uint64_t)view["byteLength"].GetNumber();
+    uint64_t offset = (uint64_t)accessor["byteOffset"].GetNumber();
+    uint64_t stride = (uint64_t)view["byteStride"].GetNumber((double)elementSize);
+
+    *count = (uint64_t)accessor["count"].GetNumber();
+
+    if (elementSize == 0 || *count == 0 || viewOffset + viewLength > mBuffers[bufferIndex].second) return false;
+    if (offset + stride * (*count - 1) + elementSize > viewLength) return false;
+
+    attribute->mData = mBuffers[bufferIndex].first + viewOffset + offset;
+    attribute->mStride = stride;
+    attribute->mComponentType = componentType;
+    attribute->mNormalized = accessor["normalized"].GetBool();
+
+    return true;
+}
+
+bool GltfImporter::AddNode(uint64_t index, const float* parentTransform, uint32_t depth) {
+    const Util::JsonValue& node = mDocument["nodes"][index];
+
+    if (!node.IsObject() || depth > MaxNodeDepth) {
+        GM_LOG_CRITICAL("[GltfImporter] Invalid node hierarchy");
+        return false;
+    }
+
+    float local[16];
+    float transform[16];
+
+    GetNodeMatrix(node, local);
+    MultiplyMatrix(parentTransform, local, transform);
+
+    const Util::JsonValue& mesh = node["mesh"];
+
+    if (mesh.IsNumber()) {
+        const Util::JsonValue& primitives = mDocument["meshes"][(uint64_t)mesh.GetNumber()]["primitives"];
+
+        for (uint64_t i = 0; i < primitives.GetSize(); i++) {
+            if (!AddPrimitive(primitives[i], transform)) return false;
+        }
+    }
+
+    const Util::JsonValue& children = node["children"];
+
+    for (uint64_t i = 0; i < children.GetSize(); i++) {
+        if (!AddNode((uint64_t)children[i].GetNumber(), transform, depth + 1)) return false;
+    }
+
+    return true;
+}
+
+bool GltfImporter::AddPrimitive(const Util::JsonValue& json, const float* transform) {
+    if ((uint32_t)json["mode"].GetNumber(ModeTriangles) != ModeTriangles) {
+        GM_LOG_WARNING("[GltfImporter] Skipping a primitive that isn't a triangle list");
+        return true;
+    }
+
+    const Util::JsonValue& attributes = json["attributes"];
+    Primitive primitive;
+    uint64_t count;
+
+    primitive.mFirstVertex = mVertexCount;
+    primitive.mFirstIndex = mIndices.size();
+
+    if (!GetAccessor((uint64_t)(int64_t)attributes["POSITION"].GetNumber(-1.0), 3, &primitive.mPosition, &primitive.mVertexCount) || primitive.mPosition.mComponentType != ComponentFloat) {
+        GM_LOG_CRITICAL("[GltfImporter] Primitive without a usable POSITION accessor");
+        return false;
+    }
+
+    if (attributes["NORMAL"].IsNumber()) {
+        if (!GetAccessor((uint64_t)attributes["NORMAL"].GetNumber(), 3, &primitive.mNormal, &count) || count != primitive.mVertexCount || primitive.mNormal.mComponentType != ComponentFloat) {
+            GM_LOG_CRITICAL("[GltfImporter] Invalid NORMAL accessor");
+            return false;
+        }
+    }
+
+    if (attributes["TEXCOORD_0"].IsNumber()) {
+        if (!GetAccessor((uint64_t)attributes["TEXCOORD_0"].GetNumber(), 2, &primitive.mUV, &count) || count != primitive.mVertexCount ||
+            primitive.mUV.mComponentType == ComponentUnsignedInt) {
+            GM_LOG_CRITICAL("[GltfImporter] Invalid TEXCOORD_0 accessor");
+            return false;
+        }
+    }
+
+    if (json["indices"].IsNumber()) {
+        Attribute indices;
+
+        if (!GetAccessor((uint64_t)json["indices"].GetNumber(), 1, &indices, &count) || count % 3 != 0) {
+            GM_LOG_CRITICAL("[GltfImporter] Invalid indices accessor");
+            return false;
+        }
+
+        mIndices.resize(mIndices.size() + count);
+
+        uint32_t* out = mIndices.data() + primitive.mFirstIndex;
+
+        for (uint64_t i = 0; i < count; i++) {
+            const uint8_t* element = indices.mData + i * indices.mStride;
+            uint32_t index;
+
+            switch (indices.mComponentType) {
+                case ComponentUnsignedByte:
+                    index = *element;
+                    break;
+                case ComponentUnsignedShort:
+                    index = *(const uint16_t*)element;
+                    break;
+                case ComponentUnsignedInt:
+                    index = *(const uint32_t*)element;
+                    break;
+                default:
+                    GM_LOG_CRITICAL("[GltfImporter] Invalid index type {}", indices.mComponentType);
+                    return false;
+            }
+
+            if (index >= primitive.mVertexCount) {
+                GM_LOG_CRITICAL("[GltfImporter] Index out of range");
+                return false;
+            }
+
+            out[i] = (uint32_t)primitive.mFirstVertex + index;
+        }
+    } else {
+        if (primitive.mVertexCount % 3 != 0) return false;
+
+        for (uint64_t i = 0; i < primitive.mVertexCount; i++) {
+            mIndices.push_back((uint32_t)(primitive.mFirstVertex + i));
+        }
+    }
+
+    primitive.mIndexCount = mIndices.size() - primitive.mFirstIndex;
+
+    memcpy(primitive.mTransform, transform, sizeof(primitive.mTransform));
+
+    // Cofactors of the upper 3x3, the inverse transpose up to the determinant. Only its sign matters here
+    float a[3][3];
+
+    for (uint32_t row = 0; row < 3; row++) {
+        for (uint32_t column = 0; column < 3; column++) {
+            a[row][column] = transform[column * 4 + row];
+        }
+    }
+
+    float* n = primitive.mNormalTransform;
+
+    n[0] = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+    n[1] = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+    n[2] = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+    n[3] = a[0][2] * a[2][1] - a[0][1] * a[2][2];
+    n[4] = a[0][0] * a[2][2] - a[0][2] * a[2][0];
+    n[5] = a[0][1] * a[2][0] - a[0][0] * a[2][1];
+    n[6] = a[0][1] * a[1][2] - a[0][2] * a[1][1];
+    n[7] = a[0][2] * a[1][0] - a[0][0] * a[1][2];
+    n[8] = a[0][0] * a[1][1] - a[0][1] * a[1][0];
+
+    float det = a[0][0] * n[0] + a[0][1] * n[1] + a[0][2] * n[2];
+
+    if (det < 0.0f) {
+        for (uint32_t i = 0; i < 9; i++) {
+            n[i] = -n[i];
+        }
+    }
+
+    mVertexCount += primitive.mVertexCount;
+    mPrimitives.push_back(primitive);
+
+    return true;
+}
+
+void GltfImporter::ReadAttribute(const Attribute& attribute, uint64_t index, uint32_t componentCount, float* out) {
+    const uint8_t* element = attribute.mData + index * attribute.mStride;
+
+    for (uint32_t i = 0; i < componentCount; i++) {
+        switch (attribute.mComponentType) {
+            case ComponentFloat:
+                memcpy(out + i, element + i * 4, sizeof(float));
+                break;
+            case ComponentUnsignedByte:
+                out[i] = attribute.mNormalized ? element[i] / 255.0f : element[i];
+                break;
+            case ComponentByte:
+                out[i] = attribute.mNormalized ? std::max((int8_t)element[i] / 127.0f, -1.0f) : (int8_t)element[i];
+                break;
+            case ComponentUnsignedShort: {
+                uint16_t value;
+                memcpy(&value, element + i * 2, sizeof(value));
+                out[i] = attribute.mNormalized ? value / 65535.0f : value;
+                break;
+            }
+            case ComponentShort: {
+                int16_t value;
+                memcpy(&value, element + i * 2, sizeof(value));
+                out[i] = attribute.mNormalized ? std::max(value / 32767.0f, -1.0f) : value;
+                break;
+            }
+            default:
+                out[i] = 0.0f;
+                break;
+        }
+    }
+}
+
+void GltfImporter::TransformPosition(const Primitive& primitive, const float* in, float* out) {
+    const float* m = primitive.mTransform;
+
+    for (uint32_t row = 0; row < 3; row++) {
+        out[row] = m[row] * in[0] + m[4 + row] * in[1] + m[8 + row] * in[2] + m[12 + row];
+    }
+}
+
+void GltfImporter::ReadPositions(float* dst) const {
+    for (const Primitive& primitive : mPrimitives) {
+        for (uint64_t i = 0; i < primitive.mVertexCount; i++) {
+            float position[3];
+
+            ReadAttribute(primitive.mPosition, i, 3, position);
+            TransformPosition(primitive, position, dst + (primitive.mFirstVertex + i) * 3);
+        }
+    }
+}
+
+void GltfImporter::RemapVertices(const uint32_t* source, uint64_t vertexCount) {
+    std::vector<uint32_t> order(vertexCount);
+
+    for (uint64_t i = 0; i < vertexCount; i++) {
+        order[i] = mVertexOrder.empty() ? source[i] : mVertexOrder[source[i]];
+    }
+
+    mVertexOrder = std::move(order);
+}
+
+void GltfImporter::WriteVertex(const Primitive& primitive, uint64_t local, Vertex* vertex) const {
+    float position[3];
+    float normal[3];
+    float transformed[3];
+
+    ReadAttribute(primitive.mPosition, local, 3, position);
+    TransformPosition(primitive, position, transformed);
+
+    vertex->Position.x = transformed[0];
+    vertex->Position.y = transformed[1];
+    vertex->Position.z = transformed[2];
+
+    ReadAttribute(primitive.mNormal, local, 3, normal);
+
+    const float* n = primitive.mNormalTransform;
+
+    for (uint32_t row = 0; row < 3; row++) {
+        transformed[row] = n[row * 3] * normal[0] + n[row * 3 + 1] * normal[1] + n[row * 3 + 2] * normal[2];
+    }
+
+    float length = sqrtf(transformed[0] * transformed[0] + transformed[1] * transformed[1] + transformed[2] * transformed[2]);
+    float scale = length > 0.0f ? 1.0f / length : 0.0f;
+
+    vertex->Normal.x = transformed[0] * scale;
+    vertex->Normal.y = transformed[1] * scale;
+    vertex->Normal.z = transformed[2] * scale;
+
+    if (primitive.mUV.mData != nullptr) {
+        float uv[2];
+
+        ReadAttribute(primitive.mUV, local, 2, uv);
+
+        vertex->UV.x = uv[0];
+        vertex->UV.y = uv[1];
+    } else {
+        vertex->UV.x = 0.0f;
+        vertex->UV.y = 0.0f;
+    }
+}
+
+void GltfImporter::WriteVertexRange(Vertex* dst, uint64_t first, uint64_t count) const {
+    auto findPrimitive = [this](uint64_t vertex) {
+        // Last primitive starting at or before the vertex
+        auto it = std::upper_bound(mPrimitives.begin(), mPrimitives.end(), vertex, [](uint64_t vertex, const Primitive& primitive) { return vertex < primitive.mFirstVertex; });
+
+        return (uint64_t)(it - mPrimitives.begin()) - 1;
+    };
+
+    uint64_t primitiveIndex = findPrimitive(mVertexOrder.empty() ? first : mVertexOrder[first]);
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t vertexIndex = mVertexOrder.empty() ? first + i : mVertexOrder[first + i];
+        const Primitive* primitive = &mPrimitives[primitiveIndex];
+
+        // Remapped vertices mostly stay within a primitive for a while, so the search is rare
+        if (vertexIndex < primitive->mFirstVertex || vertexIndex >= primitive->mFirstVertex + primitive->mVertexCount) {
+            primitiveIndex = findPrimitive(vertexIndex);
+            primitive = &mPrimitives[primitiveIndex];
+        }
+
+        WriteVertex(*primitive, vertexIndex - primitive->mFirstVertex, dst + i);
+    }
+}
+
+}
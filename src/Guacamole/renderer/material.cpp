@@ -30,6 +30,10 @@ namespace Guacamole {
 
 Material::Material(vec4 albedo, AssetHandle texture, AssetHandle sampler) : Asset("", AssetType::Material), mAlbedo(albedo), mTextureHandle(texture), mSamplerHandle(sampler) {
     mFlags |= AssetFlag_Loaded;
+
+    // The material isn't ready for rendering until the texture and sampler are
+    AddDependency(texture);
+    AddDependency(sampler);
 }
     
 }
\ No newline at end of file
@@ -25,15 +25,23 @@ SOFTWARE.
 #include <Guacamole.h>
 
 #include "mesh.h"
+#include "meshimporter.h"
 
 #include <Guacamole/vulkan/device.h>
 #include <Guacamole/vulkan/buffer/stagingbuffer.h>
+#include <Guacamole/asset/assetmanager.h>
 
 namespace Guacamole {
 
-Mesh::Mesh(Device* device, const std::filesystem::path& file) 
+// Vertices decoded at a time before being packed into CompactVertex
+static constexpr uint64_t CompactBatchSize = 65536;
+// Smaller meshes are culled whole, checking their meshlets would cost more than drawing them
+static constexpr uint64_t MinMeshletTriangles = 4096;
+
+Mesh::Mesh(Device* device, const std::filesystem::path& file, VertexFormat vertexFormat) 
     : Asset(file, AssetType::Mesh), mVBO(nullptr), 
-      mIBO(nullptr), mDevice(device) {}
+      mIBO(nullptr), mDevice(device), mBoundsRadius(0.0f), mVertexFormat(vertexFormat), 
+      mPositionTransform(1.0f), mUVTransform(1.0f, 1.0f, 0.0f, 0.0f) {}
 
 Mesh::~Mesh() {
     delete mVBO;
@@ -42,47 +50,264 @@ Mesh::~Mesh() {
 
 bool Mesh::Load() {
     LoadFromFile(mFilePath);
-    return false;
+    return IsLoaded();
 }
 
 void Mesh::Unload() {
     delete mVBO;
     delete mIBO;
+
+    mVBO = nullptr;
+    mIBO = nullptr;
+    mSubmeshes.clear();
+    mMeshlets.clear();
+    mMemoryUsage = 0;
+    mFlags &= ~AssetFlag_Loaded;
+}
+
+Asset* Mesh::CreateReloadInstance() const {
+    return new Mesh(mDevice, mFilePath, mVertexFormat);
+}
+
+uint32_t Mesh::GetVertexSize(VertexFormat format) {
+    return format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+}
+
+std::vector<std::pair<uint32_t, VkFormat>> Mesh::GetVertexAttributes(VertexFormat format) {
+    if (format == VertexFormat::Compact) {
+        return { { 0, VK_FORMAT_R16G16B16A16_SNORM }, { 1, VK_FORMAT_R16G16_SNORM }, { 2, VK_FORMAT_R16G16_UNORM } };
+    }
+
+    return { { 0, VK_FORMAT_R32G32B32_SFLOAT }, { 1, VK_FORMAT_R32G32B32_SFLOAT }, { 2, VK_FORMAT_R32G32_SFLOAT } };
 }
 
 Mesh::Mesh(Device* device) 
     : Asset("", AssetType::Mesh), mVBO(nullptr), 
-      mIBO(nullptr), mDevice(device) {
+      mIBO(nullptr), mDevice(device), mBoundsRadius(0.0f), mVertexFormat(VertexFormat::Float), 
+      mPositionTransform(1.0f), mUVTransform(1.0f, 1.0f, 0.0f, 0.0f) {
 
     mFlags |= AssetFlag_Loaded;
 }
 
 void Mesh::CreateVBO(Vertex* data, uint64_t count) {
-    GM_ASSERT(mVBO == nullptr);
+    GM_ASSERT(mVBO == nullptr && mVertexFormat == VertexFormat::Float);
 
     uint64_t size = count * sizeof(Vertex);
 
     mVBO = new VertexBuffer(mDevice, size);
+    mMemoryUsage += size;
+
+    Upload(mVBO, sizeof(Vertex), count, [data](void* dst, uint64_t first, uint64_t count) { memcpy(dst, data + first, count * sizeof(Vertex)); });
+
+    ComputeBounds(data, count);
+}
+
+void Mesh::ComputeBounds(const Vertex* vertices, uint64_t count) {
+    if (count == 0) return;
+
+    // Centered on the AABB, close enough to the minimal sphere for screen size estimates
+    vec3 min = vertices[0].Position;
+    vec3 max = vertices[0].Position;
+
+    for (uint64_t i = 1; i < count; i++) {
+        const vec3& p = vertices[i].Position;
+
+        min = vec3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+        max = vec3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+    }
 
-    memcpy(StagingManager::GetCommonStagingBuffer()->Allocate(size, mVBO), data, size);
+    mBoundsCenter = vec3((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+
+    float radiusSq = 0.0f;
+
+    for (uint64_t i = 0; i < count; i++) {
+        vec3 d = vertices[i].Position - mBoundsCenter;
+
+        radiusSq = std::max(radiusSq, d.x * d.x + d.y * d.y + d.z * d.z);
+    }
+
+    mBoundsRadius = sqrtf(radiusSq);
 }
 
-void Mesh::CreateIBO(void* data, uint32_t count, VkIndexType indexType) {
+void Mesh::CreateIBO(const uint32_t* data, uint32_t count, uint64_t vertexCount) {
     GM_ASSERT(mIBO == nullptr);
 
+    VkIndexType indexType = IndexBuffer::GetIndexType(mDevice, vertexCount);
+
     mIBO = new IndexBuffer(mDevice, count, indexType);
+    mSubmeshes = { { 0, count, 0, 0, 0 } };
+    mMemoryUsage += mIBO->GetSize();
+
+    Upload(mIBO, IndexBuffer::GetIndexSize(indexType), count, [data, indexType](void* dst, uint64_t first, uint64_t count) {
+        const uint32_t* src = data + first;
+
+        for (uint64_t i = 0; i < count; i++) {
+            if (indexType == VK_INDEX_TYPE_UINT8_EXT) {
+                ((uint8_t*)dst)[i] = (uint8_t)src[i];
+            } else if (indexType == VK_INDEX_TYPE_UINT16) {
+                ((uint16_t*)dst)[i] = (uint16_t)src[i];
+            } else {
+                ((uint32_t*)dst)[i] = src[i];
+            }
+        }
+    });
+}
+
+bool Mesh::Upload(Buffer* buffer, uint64_t elementSize, uint64_t count, const std::function<void(void*, uint64_t, uint64_t)>& write) {
+    StagingBuffer* stagingBuffer = StagingManager::GetCommonStagingBuffer();
+    uint64_t first = 0;
+
+    while (first < count) {
+        // The 8 covers the alignment Allocate adds
+        uint64_t available = stagingBuffer->GetSize() - std::min(stagingBuffer->GetAllocated() + 8, stagingBuffer->GetSize());
+        uint64_t elements = std::min(count - first, available / elementSize);
 
-    uint64_t size = mIBO->GetSize();
+        if (elements == 0) {
+            GM_ASSERT_MSG(!AssetManager::IsMainThread(), "Mesh doesn't fit in the main thread's staging buffer, load it on a loader thread");
 
-    memcpy(StagingManager::GetCommonStagingBuffer()->Allocate(size, mIBO), data, size);
+            if (AssetManager::IsMainThread() || !StagingManager::FlushStagingBuffer(stagingBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT)) return false;
+
+            continue;
+        }
+
+        write(stagingBuffer->Allocate(elements * elementSize, buffer, first * elementSize), first, elements);
+        first += elements;
+    }
+
+    return true;
+}
+
+void Mesh::SetQuantization(const Util::VertexQuantization& quantization) {
+    const float* scale = quantization.mPositionScale;
+    const float* offset = quantization.mPositionOffset;
+
+    mQuantization = quantization;
+    mPositionTransform = mat4::Translate(vec3(offset[0], offset[1], offset[2])) * mat4::Scale(vec3(scale[0], scale[1], scale[2]));
+    mUVTransform = vec4(quantization.mUVScale[0], quantization.mUVScale[1], quantization.mUVOffset[0], quantization.mUVOffset[1]);
 }
 
+void Mesh::EncodeVertices(const Vertex* vertices, uint64_t count, CompactVertex* dst) const {
+    const Util::VertexQuantization& q = mQuantization;
+
+    for (uint64_t i = 0; i < count; i++) {
+        const Vertex& vertex = vertices[i];
+        CompactVertex& compact = dst[i];
+        float normal[3] = { vertex.Normal.x, vertex.Normal.y, vertex.Normal.z };
+
+        compact.Position[0] = Util::EncodeSnorm16((vertex.Position.x - q.mPositionOffset[0]) / q.mPositionScale[0]);
+        compact.Position[1] = Util::EncodeSnorm16((vertex.Position.y - q.mPositionOffset[1]) / q.mPositionScale[1]);
+        compact.Position[2] = Util::EncodeSnorm16((vertex.Position.z - q.mPositionOffset[2]) / q.mPositionScale[2]);
+        compact.Position[3] = 0;
+
+        Util::EncodeOctahedral(normal, compact.Normal);
+
+        compact.UV[0] = Util::EncodeUnorm16((vertex.UV.x - q.mUVOffset[0]) / q.mUVScale[0]);
+        compact.UV[1] = Util::EncodeUnorm16((vertex.UV.y - q.mUVOffset[1]) / q.mUVScale[1]);
+    }
+}
 
 void Mesh::LoadFromFile(const std::filesystem::path& path) {
-    GM_ASSERT(false);
+    MeshImporter* importer = MeshImporter::Create(path);
+
+    if (importer == nullptr) {
+        GM_LOG_CRITICAL("[Mesh] Unsupported mesh format \"{}\"", path.string());
+        return;
+    }
+
+    AssetData data;
+    // Files the mesh references, they have to stay mapped until the vertices are written
+    std::vector<AssetData*> files;
+
+    MeshFileReader reader = [&files](const std::filesystem::path& file, uint64_t* size) -> const uint8_t* {
+        AssetData* fileData = files.emplace_back(new AssetData);
+
+        if (!AssetManager::ReadAssetData(file, fileData)) return nullptr;
+
+        *size = fileData->GetSize();
+
+        return fileData->GetData();
+    };
+
+    bool loaded = false;
+
+    if (!AssetManager::ReadAssetData(path, &data)) {
+        GM_LOG_CRITICAL("[Mesh] Failed to read \"{}\"", path.string());
+    } else if (importer->Parse(path, data.GetData(), data.GetSize(), reader)) {
+        Util::VertexCacheStats before;
+        Util::VertexCacheStats after;
+
+        importer->Optimize(&before, &after, importer->GetIndexCount() / 3 >= MinMeshletTriangles);
+
+        GM_LOG_DEBUG("[Mesh] Optimized \"{}\", ACMR: {:.3f} -> {:.3f}, ATVR: {:.3f} -> {:.3f}", path.string(), before.mACMR, after.mACMR, before.mATVR, after.mATVR);
+
+        uint32_t vertexSize = GetVertexSize(mVertexFormat);
+        VkIndexType indexType = IndexBuffer::GetIndexType(mDevice, importer->GetVertexCount());
+
+        // Duplicates the vertices shared between submeshes, only done if that's less than the index memory it saves
+        if (indexType == VK_INDEX_TYPE_UINT32 && importer->SplitSubmeshes(vertexSize, &mSubmeshes)) {
+            indexType = VK_INDEX_TYPE_UINT16;
+
+            GM_LOG_DEBUG("[Mesh] Split \"{}\" into {} submeshes for 16 bit indices", path.string(), mSubmeshes.size());
+        } else {
+            mSubmeshes = { { 0, (uint32_t)importer->GetIndexCount(), 0, 0, (uint32_t)importer->GetMeshlets().size() } };
+        }
+
+        mMeshlets = importer->GetMeshlets();
+
+        uint64_t vertexCount = importer->GetVertexCount();
+        uint64_t indexCount = importer->GetIndexCount();
+        const vec3& min = importer->GetBoundsMin();
+        const vec3& max = importer->GetBoundsMax();
+        vec3 extent = max - min;
+
+        mVBO = new VertexBuffer(mDevice, vertexCount * vertexSize);
+        mIBO = new IndexBuffer(mDevice, (uint32_t)indexCount, indexType);
+        mMemoryUsage += mVBO->GetSize() + mIBO->GetSize();
+
+        if (mVertexFormat == VertexFormat::Compact) {
+            float positionMin[3] = { min.x, min.y, min.z };
+            float positionMax[3] = { max.x, max.y, max.z };
+            float uvMin[2] = { importer->GetUVBoundsMin().x, importer->GetUVBoundsMin().y };
+            float uvMax[2] = { importer->GetUVBoundsMax().x, importer->GetUVBoundsMax().y };
+
+            SetQuantization(Util::ComputeVertexQuantization(positionMin, positionMax, uvMin, uvMax));
+        }
+
+        auto writeVertices = [this, importer](void* dst, uint64_t first, uint64_t count) {
+            // The importer writes straight into staging memory, compact vertices go through a small batch first
+            if (mVertexFormat == VertexFormat::Float) {
+                importer->WriteVertices((Vertex*)dst, first, count);
+                return;
+            }
+
+            std::vector<Vertex> batch(std::min(count, CompactBatchSize));
+
+            for (uint64_t offset = 0; offset < count; offset += batch.size()) {
+                uint64_t batchCount = std::min(count - offset, (uint64_t)batch.size());
+
+                importer->WriteVertices(batch.data(), first + offset, batchCount);
+                EncodeVertices(batch.data(), batchCount, (CompactVertex*)dst + offset);
+            }
+        };
+
+        loaded = Upload(mVBO, vertexSize, vertexCount, writeVertices) &&
+                 Upload(mIBO, IndexBuffer::GetIndexSize(indexType), indexCount, [importer, indexType](void* dst, uint64_t first, uint64_t count) { importer->WriteIndices(dst, indexType, first, count); });
+
+        // Half the AABB diagonal, a bit looser than ComputeBounds but it doesn't need the vertices
+        mBoundsCenter = vec3((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+        mBoundsRadius = sqrtf(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z) * 0.5f;
+    }
+
+    for (AssetData* fileData : files) {
+        delete fileData;
+    }
+
+    delete importer;
+
+    if (loaded) mFlags |= AssetFlag_Loaded;
 }
 
-Mesh* Mesh::GenerateQuad(Device* device) {
+Mesh* Mesh::GenerateCube(Device* device) {
     Vertex vertices[4 * 6] = {
         // Front
         {{-0.5,  0.5, 0.5}, {0, 0, 1}, {0, 0}},
@@ -116,7 +341,7 @@ Mesh* Mesh::GenerateQuad(Device* device) {
         {{-0.5, -0.5, -0.5}, {-1, 0, 0}, {0, 1}},
     };
 
-    uint16_t indices[6 * 6] = {
+    uint32_t indices[6 * 6] = {
         0,  1, 2,  2,  3,  0, 
         4,  5, 6,  6,  7,  4, 
         8,  9, 10, 10, 11, 8,
@@ -128,7 +353,7 @@ Mesh* Mesh::GenerateQuad(Device* device) {
     Mesh* mesh = new Mesh(device);
 
     mesh->CreateVBO(vertices, 4 * 6);
-    mesh->CreateIBO(indices, 6 * 6, VK_INDEX_TYPE_UINT16);
+    mesh->CreateIBO(indices, 6 * 6, 4 * 6);
 
     mesh->mFlags |= AssetFlag_Loaded;
 
@@ -143,14 +368,14 @@ Mesh* Mesh::GeneratePlane(Device* device) {
         {{-0.5, -0.5, 0}, {0, 0, 1}, {0, 1}}
     };
 
-    uint16_t indices[6] = {
+    uint32_t indices[6] = {
         0, 1, 2, 2, 3, 0
     };
 
     Mesh* mesh = new Mesh(device);
 
     mesh->CreateVBO(vertices, 4);
-    mesh->CreateIBO(indices, 6, VK_INDEX_TYPE_UINT16);
+    mesh->CreateIBO(indices, 6, 4);
 
     mesh->mFlags |= AssetFlag_Loaded;
 
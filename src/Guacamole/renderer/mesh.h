@@ -29,6 +29,11 @@ SOFTWARE.
 #include <Guacamole/vulkan/buffer/buffer.h>
 #include <Guacamole/asset/asset.h>
 #include <Guacamole/core/math/vec.h>
+#include <Guacamole/core/math/mat.h>
+#include <Guacamole/util/vertexcodec.h>
+#include <Guacamole/util/meshoptimizer.h>
+
+#include <functional>
 
 namespace Guacamole {
 
@@ -38,14 +43,39 @@ struct Vertex {
     vec2 UV;
 };
 
+// Half the size of Vertex. The position is SNORM16 within the mesh's bounds and the UV UNORM16 within its UV range,
+// GetPositionTransform and GetUVTransform map them back. The normal is octahedral encoded
+struct CompactVertex {
+    int16_t Position[4]; // w is unused, three component 16 bit formats aren't required for vertex buffers
+    int16_t Normal[2];
+    uint16_t UV[2];
+};
+
+// Range of the index buffer drawn with its own vertex offset, lets a mesh with more than 65536 vertices use 16 bit indices
+struct Submesh {
+    uint32_t mFirstIndex;
+    uint32_t mIndexCount;
+    int32_t mVertexOffset;
+    // The meshlets covering the range, none if the mesh has no meshlets
+    uint32_t mFirstMeshlet;
+    uint32_t mMeshletCount;
+};
+
+enum class VertexFormat {
+    Float,   // Vertex
+    Compact, // CompactVertex
+    Count
+};
+
 class Device;
 class Mesh : public Asset {
 public:
-    Mesh(Device* device, const std::filesystem::path& file);
+    Mesh(Device* device, const std::filesystem::path& file, VertexFormat vertexFormat = VertexFormat::Compact);
     ~Mesh();
 
     bool Load() override;
     void Unload() override;
+    Asset* CreateReloadInstance() const override;
 
     inline VertexBuffer* GetVBO() const { return mVBO; }
     inline IndexBuffer* GetIBO() const { return mIBO; }
@@ -53,20 +83,54 @@ public:
     inline const VkBuffer& GetIBOHandle() const { return mIBO->GetHandle(); }
     inline VkIndexType GetIndexType() const { return mIBO->GetIndexType(); }
     inline uint32_t GetIndexCount() const { return mIBO->GetCount(); }
+    // Together they cover the whole index buffer, one draw each
+    inline const std::vector<Submesh>& GetSubmeshes() const { return mSubmeshes; }
+    // Only large meshes have them, in model space like the bounds
+    inline const std::vector<Util::Meshlet>& GetMeshlets() const { return mMeshlets; }
+    // Bounding sphere in model space
+    inline const vec3& GetBoundsCenter() const { return mBoundsCenter; }
+    inline float GetBoundsRadius() const { return mBoundsRadius; }
+    inline VertexFormat GetVertexFormat() const { return mVertexFormat; }
+    // Dequantizes compact positions, goes in front of the model matrix. Identity for Float
+    inline const mat4& GetPositionTransform() const { return mPositionTransform; }
+    // xy scale, zw offset
+    inline const vec4& GetUVTransform() const { return mUVTransform; }
+
+    static uint32_t GetVertexSize(VertexFormat format);
+    // Location and buffer format of each attribute, for Shader::GetVertexInputLayout
+    static std::vector<std::pair<uint32_t, VkFormat>> GetVertexAttributes(VertexFormat format);
 
 private:
     Mesh(Device* device);
 
     void CreateVBO(Vertex* data, uint64_t count);
-    void CreateIBO(void* data, uint32_t count, VkIndexType indexType);
+    void ComputeBounds(const Vertex* vertices, uint64_t count);
+    // Stored with the narrowest index type that can address vertexCount vertices
+    void CreateIBO(const uint32_t* data, uint32_t count, uint64_t vertexCount);
     void LoadFromFile(const std::filesystem::path& path);
+    void SetQuantization(const Util::VertexQuantization& quantization);
+    void EncodeVertices(const Vertex* vertices, uint64_t count, CompactVertex* dst) const;
+    // Fills buffer through the thread's staging buffer, write(dst, first, count) writes elements [first, first + count) to dst.
+    // Off the main thread a full staging buffer is flushed, so the buffer can be larger than it
+    bool Upload(Buffer* buffer, uint64_t elementSize, uint64_t count, const std::function<void(void*, uint64_t, uint64_t)>& write);
 
     VertexBuffer* mVBO;
     IndexBuffer* mIBO;
     Device* mDevice;
+    std::vector<Submesh> mSubmeshes;
+    std::vector<Util::Meshlet> mMeshlets;
+
+    vec3 mBoundsCenter;
+    float mBoundsRadius;
+
+    VertexFormat mVertexFormat;
+    Util::VertexQuantization mQuantization;
+    mat4 mPositionTransform;
+    vec4 mUVTransform;
 
 public:
-    static Mesh* GenerateQuad(Device* device);
+    // Unit cube around the origin, every face has its own vertices so the normals and UVs stay flat
+    static Mesh* GenerateCube(Device* device);
     static Mesh* GeneratePlane(Device* device);
 };
 
@@ -33,11 +33,11 @@ SOFTWARE.
 namespace Guacamole {
 
 AssetHandle MeshFactory::mPlaneAsset = AssetHandle::Null();
-AssetHandle MeshFactory::mQuadAsset = AssetHandle::Null();
+AssetHandle MeshFactory::mCubeAsset = AssetHandle::Null();
 
 void MeshFactory::Init(Device* device) {
     mPlaneAsset = AssetManager::AddMemoryAsset(Mesh::GeneratePlane(device), true);
-    mQuadAsset = AssetManager::AddMemoryAsset(Mesh::GenerateQuad(device), true);
+    mCubeAsset = AssetManager::AddMemoryAsset(Mesh::GenerateCube(device), true);
 }
 
 void MeshFactory::Shutdown() {
@@ -37,10 +37,10 @@ public:
     static void Shutdown();
 
     static AssetHandle GetPlaneAsset() { return mPlaneAsset; }
-    static AssetHandle GetQuadAsset() { return mQuadAsset; }
+    static AssetHandle GetCubeAsset() { return mCubeAsset; }
 private:
     static AssetHandle mPlaneAsset;
-    static AssetHandle mQuadAsset;
+    static AssetHandle mCubeAsset;
 };
 
 }
\ No newline at end of file
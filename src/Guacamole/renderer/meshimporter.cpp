@@ -0,0 +1,785 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "meshimporter.h"
+
+#include <thread>
+#include <atomic>
+
+namespace Guacamole {
+
+MeshImporter* MeshImporter::Create(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+
+    for (char& c : extension) {
+        c = (char)tolower(c);
+    }
+
+    if (extension == ".obj") return new ObjImporter;
+    if (extension == ".gltf" || extension == ".glb") return new GltfImporter;
+
+    return nullptr;
+}
+
+void MeshImporter::WriteVertices(Vertex* dst, uint64_t first, uint64_t count) const {
+    GM_ASSERT(first + count <= mVertexCount);
+
+    if (count == 0) return;
+
+    // Splitting small ranges costs more in thread starts than it saves
+    uint32_t threadCount = (uint32_t)std::min((uint64_t)mThreadCount, std::max(count / 65536, (uint64_t)1));
+    uint64_t perThread = (count + threadCount - 1) / threadCount;
+    std::vector<std::thread> threads;
+
+    for (uint32_t i = 1; i < threadCount; i++) {
+        uint64_t offset = std::min(perThread * i, count);
+
+        threads.emplace_back([=]() { WriteVertexRange(dst + offset, first + offset, std::min(perThread, count - offset)); });
+    }
+
+    WriteVertexRange(dst, first, std::min(perThread, count));
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void MeshImporter::WriteIndices(void* dst, VkIndexType indexType, uint64_t first, uint64_t count) const {
+    GM_ASSERT(first + count <= mIndices.size());
+
+    if (indexType == VK_INDEX_TYPE_UINT32) {
+        memcpy(dst, mIndices.data() + first, count * sizeof(uint32_t));
+        return;
+    }
+
+    if (indexType == VK_INDEX_TYPE_UINT8_EXT) {
+        uint8_t* out = (uint8_t*)dst;
+
+        for (uint64_t i = 0; i < count; i++) {
+            out[i] = (uint8_t)mIndices[first + i];
+        }
+
+        return;
+    }
+
+    uint16_t* out = (uint16_t*)dst;
+
+    for (uint64_t i = 0; i < count; i++) {
+        out[i] = (uint16_t)mIndices[first + i];
+    }
+}
+
+bool MeshImporter::SplitSubmeshes(uint32_t vertexSize, std::vector<Submesh>* submeshes) {
+    static constexpr uint64_t MaxSubmeshVertices = 65536;
+
+    std::vector<Submesh> result;
+    // Each submesh's vertices end up contiguous and in first use order, which keeps the fetch order Optimize made
+    std::vector<uint32_t> source;
+    std::vector<uint32_t> indices(mIndices.size());
+    // Index of the vertex within the submesh it was last added to
+    std::vector<uint32_t> local(mVertexCount);
+    std::vector<uint32_t> localSubmesh(mVertexCount, UINT32_MAX);
+    std::vector<uint32_t> counted(mVertexCount, UINT32_MAX);
+    uint64_t savedBytes = mIndices.size() * (sizeof(uint32_t) - sizeof(uint16_t));
+    uint64_t duplicates = 0;
+    Submesh submesh = { 0, 0, 0, 0, 0 };
+    // Meshlets are kept whole, without them every triangle is on its own
+    uint64_t unitCount = mMeshlets.empty() ? mIndices.size() / 3 : mMeshlets.size();
+
+    for (uint64_t unit = 0; unit < unitCount; unit++) {
+        uint64_t first = mMeshlets.empty() ? unit * 3 : mMeshlets[unit].mFirstIndex;
+        uint64_t count = mMeshlets.empty() ? 3 : mMeshlets[unit].mIndexCount;
+        uint32_t id = (uint32_t)result.size();
+        uint64_t added = 0;
+
+        for (uint64_t i = first; i < first + count; i++) {
+            uint32_t index = mIndices[i];
+
+            if (localSubmesh[index] == id || counted[index] == unit) continue;
+
+            counted[index] = (uint32_t)unit;
+            added++;
+        }
+
+        if (submesh.mIndexCount > 0 && source.size() - submesh.mVertexOffset + added > MaxSubmeshVertices) {
+            result.push_back(submesh);
+            submesh = { (uint32_t)first, 0, (int32_t)source.size(), (uint32_t)unit, 0 };
+            id++;
+        }
+
+        for (uint64_t i = first; i < first + count; i++) {
+            uint32_t index = mIndices[i];
+
+            if (localSubmesh[index] != id) {
+                duplicates += localSubmesh[index] != UINT32_MAX;
+                localSubmesh[index] = id;
+                local[index] = (uint32_t)(source.size() - submesh.mVertexOffset);
+                source.push_back(index);
+            }
+
+            indices[i] = local[index];
+        }
+
+        submesh.mIndexCount += (uint32_t)count;
+        submesh.mMeshletCount += !mMeshlets.empty();
+
+        if (duplicates * vertexSize >= savedBytes) return false;
+    }
+
+    if (submesh.mIndexCount > 0) result.push_back(submesh);
+
+    RemapVertices(source.data(), source.size());
+
+    mVertexCount = source.size();
+    mIndices = std::move(indices);
+    *submeshes = std::move(result);
+
+    return true;
+}
+
+void MeshImporter::Optimize(Util::VertexCacheStats* before, Util::VertexCacheStats* after, bool buildMeshlets) {
+    if (before) *before = Util::AnalyzeVertexCache(mIndices.data(), mIndices.size(), mVertexCount);
+
+    std::vector<float> positions(mVertexCount * 3);
+    std::vector<uint32_t> remap(mVertexCount);
+    std::vector<uint32_t> source;
+
+    ReadPositions(positions.data());
+
+    Util::OptimizeVertexCache(mIndices.data(), mIndices.size(), mVertexCount);
+    Util::OptimizeOverdraw(mIndices.data(), mIndices.size(), positions.data(), mVertexCount);
+
+    mMeshlets.clear();
+
+    if (buildMeshlets) Util::BuildMeshlets(mIndices.data(), mIndices.size(), positions.data(), mVertexCount, &mMeshlets);
+
+    uint64_t vertexCount = Util::OptimizeVertexFetch(mIndices.data(), mIndices.size(), mVertexCount, remap.data());
+
+    source.resize(vertexCount);
+
+    for (uint64_t i = 0; i < mVertexCount; i++) {
+        if (remap[i] != UINT32_MAX) source[remap[i]] = (uint32_t)i;
+    }
+
+    RemapVertices(source.data(), vertexCount);
+    mVertexCount = vertexCount;
+
+    if (after) *after = Util::AnalyzeVertexCache(mIndices.data(), mIndices.size(), mVertexCount);
+}
+
+void MeshImporter::AccumulateNormal(const float* p0, const float* p1, const float* p2, float* n0, float* n1, float* n2) {
+    float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+    // Not normalized, so larger triangles weigh more
+    float n[3] = {
+        e0[1] * e1[2] - e0[2] * e1[1],
+        e0[2] * e1[0] - e0[0] * e1[2],
+        e0[0] * e1[1] - e0[1] * e1[0]
+    };
+
+    for (uint32_t i = 0; i < 3; i++) {
+        n0[i] += n[i];
+        n1[i] += n[i];
+        n2[i] += n[i];
+    }
+}
+
+void MeshImporter::NormalizeNormals(float* normals, uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        float* n = normals + i * 3;
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+        if (length > 0.0f) {
+            n[0] /= length;
+            n[1] /= length;
+            n[2] /= length;
+        } else {
+            n[0] = 0.0f;
+            n[1] = 0.0f;
+            n[2] = 1.0f;
+        }
+    }
+}
+
+// OBJ
+
+// Below this the threads cost more than they save
+static constexpr uint64_t ObjMinChunkSize = 1 << 20;
+
+struct ObjImporter::Chunk {
+    const char* mBegin;
+    const char* mEnd;
+    // Counted in the first pass, the offsets are the counts of the chunks before
+    uint64_t mPositionCount = 0;
+    uint64_t mUVCount = 0;
+    uint64_t mNormalCount = 0;
+    uint64_t mFirstPosition = 0;
+    uint64_t mFirstUV = 0;
+    uint64_t mFirstNormal = 0;
+    // Triangulated, three per triangle
+    std::vector<Corner> mCorners;
+};
+
+static inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* SkipSpaces(const char* p, const char* end) {
+    while (p < end && IsSpace(*p)) p++;
+
+    return p;
+}
+
+static const double sPowersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// [+-]digits[.digits][(e|E)[+-]digits] with up to 19 significant digits is parsed here, anything else
+// (inf, nan, hex, very long mantissas) goes to strtof. Returns nullptr if there's no number
+static const char* ParseFloat(const char* p, const char* end, float* value) {
+    const char* start = p;
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int32_t digits = 0;
+    int32_t exponent = 0;
+    bool any = false;
+
+    while (p < end && (uint8_t)(*p - '0') < 10) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0) digits++;
+        } else {
+            exponent++;
+        }
+
+        any = true;
+        p++;
+    }
+
+    if (p < end && *p == '.') {
+        p++;
+
+        while (p < end && (uint8_t)(*p - '0') < 10) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0) digits++;
+                exponent--;
+            }
+
+            any = true;
+            p++;
+        }
+    }
+
+    if (any && p < end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        bool negativeExponent = false;
+
+        if (e < end && (*e == '-' || *e == '+')) negativeExponent = *e++ == '-';
+
+        if (e < end && (uint8_t)(*e - '0') < 10) {
+            int32_t explicitExponent = 0;
+
+            while (e < end && (uint8_t)(*e - '0') < 10) {
+                if (explicitExponent < 10000) explicitExponent = explicitExponent * 10 + (*e - '0');
+                e++;
+            }
+
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            p = e;
+        }
+    }
+
+    if (!any || (p < end && !IsSpace(*p) && *p != '\n' && *p != '/')) {
+        char buffer[64];
+        uint64_t length = 0;
+
+        for (p = start; p < end && !IsSpace(*p) && *p != '\n' && length < sizeof(buffer) - 1; p++) {
+            buffer[length++] = *p;
+        }
+
+        buffer[length] = '\0';
+
+        char* parsedEnd;
+        *value = strtof(buffer, &parsedEnd);
+
+        return parsedEnd == buffer ? nullptr : start + (parsedEnd - buffer);
+    }
+
+    double result = (double)mantissa;
+
+    // Exact as long as the mantissa fits a double, which covers practically everything exporters write
+    if (exponent < 0 && exponent >= -22) {
+        result /= sPowersOf10[-exponent];
+    } else if (exponent > 0 && exponent <= 22) {
+        result *= sPowersOf10[exponent];
+    } else if (exponent != 0) {
+        result *= pow(10.0, exponent);
+    }
+
+    *value = (float)(negative ? -result : result);
+
+    return p;
+}
+
+static inline const char* ParseInt(const char* p, const char* end, int64_t* value) {
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    if (p >= end || (uint8_t)(*p - '0') >= 10) return nullptr;
+
+    int64_t result = 0;
+
+    while (p < end && (uint8_t)(*p - '0') < 10) {
+        result = result * 10 + (*p++ - '0');
+    }
+
+    *value = negative ? -result : result;
+
+    return p;
+}
+
+void ObjImporter::CountLines(Chunk* chunk) {
+    const char* p = chunk->mBegin;
+
+    while (p < chunk->mEnd) {
+        const char* lineEnd = (const char*)memchr(p, '\n', chunk->mEnd - p);
+        if (lineEnd == nullptr) lineEnd = chunk->mEnd;
+
+        p = SkipSpaces(p, lineEnd);
+
+        if (lineEnd - p > 2 && p[0] == 'v') {
+            if (IsSpace(p[1])) {
+                chunk->mPositionCount++;
+            } else if (IsSpace(p[2])) {
+                if (p[1] == 't') chunk->mUVCount++;
+                if (p[1] == 'n') chunk->mNormalCount++;
+            }
+        }
+
+        p = lineEnd + 1;
+    }
+}
+
+bool ObjImporter::ParseChunk(Chunk* chunk) {
+    float* position = mPositions.data() + chunk->mFirstPosition * 3;
+    float* uv = mUVs.data() + chunk->mFirstUV * 2;
+    float* normal = mNormals.data() + chunk->mFirstNormal * 3;
+    // Relative indices count back from the attributes parsed so far
+    int64_t counts[3] = { (int64_t)chunk->mFirstPosition, (int64_t)chunk->mFirstUV, (int64_t)chunk->mFirstNormal };
+    std::vector<Corner> polygon;
+    const char* p = chunk->mBegin;
+
+    while (p < chunk->mEnd) {
+        const char* lineEnd = (const char*)memchr(p, '\n', chunk->mEnd - p);
+        if (lineEnd == nullptr) lineEnd = chunk->mEnd;
+
+        p = SkipSpaces(p, lineEnd);
+
+        if (lineEnd - p > 2 && p[0] == 'v') {
+            uint32_t components = 0;
+            float* out = nullptr;
+
+            if (IsSpace(p[1])) {
+                components = 3;
+                out = position;
+                position += 3;
+                counts[0]++;
+                p += 1;
+            } else if (IsSpace(p[2]) && p[1] == 't') {
+                components = 2;
+                out = uv;
+                uv += 2;
+                counts[1]++;
+                p += 2;
+            } else if (IsSpace(p[2]) && p[1] == 'n') {
+                components = 3;
+                out = normal;
+                normal += 3;
+                counts[2]++;
+                p += 2;
+            }
+
+            for (uint32_t i = 0; i < components; i++) {
+                p = ParseFloat(SkipSpaces(p, lineEnd), lineEnd, out + i);
+
+                // vt's v is optional
+                if (p == nullptr) {
+                    if (components != 2 || i == 0) return false;
+
+                    out[i] = 0.0f;
+                    p = lineEnd;
+                }
+            }
+
+            if (components == 2) {
+                // OBJ's v goes up, Vulkan's goes down
+                out[1] = 1.0f - out[1];
+            }
+        } else if (lineEnd - p > 1 && p[0] == 'f' && IsSpace(p[1])) {
+            polygon.clear();
+            p = SkipSpaces(p + 1, lineEnd);
+
+            while (p < lineEnd) {
+                int32_t indices[3] = { -1, -1, -1 };
+
+                for (uint32_t i = 0; i < 3; i++) {
+                    int64_t index;
+
+                    // Empty uv in v//vn
+                    if (i > 0 && p < lineEnd && *p == '/') {
+                        p++;
+                        continue;
+                    }
+
+                    const char* next = ParseInt(p, lineEnd, &index);
+
+                    if (next == nullptr || index == 0) return false;
+
+                    index = index > 0 ? index - 1 : counts[i] + index;
+
+                    if (index < 0 || index > INT32_MAX) return false;
+
+                    indices[i] = (int32_t)index;
+                    p = next;
+
+                    if (p >= lineEnd || *p != '/') break;
+
+                    p++;
+                }
+
+                polygon.push_back({ indices[0], indices[1], indices[2] });
+                p = SkipSpaces(p, lineEnd);
+            }
+
+            // Fan, fine for the convex polygons exporters write
+            for (uint64_t i = 2; i < polygon.size(); i++) {
+                chunk->mCorners.push_back(polygon[0]);
+                chunk->mCorners.push_back(polygon[i - 1]);
+                chunk->mCorners.push_back(polygon[i]);
+            }
+        }
+
+        p = lineEnd + 1;
+    }
+
+    return true;
+}
+
+static inline uint64_t HashCorner(int32_t position, int32_t uv, int32_t normal) {
+    uint64_t hash = (uint64_t)(uint32_t)position * 0x9E3779B97F4A7C15ull;
+
+    hash ^= (uint64_t)(uint32_t)uv * 0xC2B2AE3D27D4EB4Full;
+    hash ^= (uint64_t)(uint32_t)normal * 0x165667B19E3779F9ull;
+
+    return hash ^ (hash >> 29);
+}
+
+bool ObjImporter::DeduplicateCorners(const std::vector<Chunk>& chunks) {
+    int64_t positionCount = (int64_t)mPositions.size() / 3;
+    int64_t uvCount = (int64_t)mUVs.size() / 2;
+    int64_t normalCount = (int64_t)mNormals.size() / 3;
+    bool positionsOnly = true;
+
+    for (const Chunk& chunk : chunks) {
+        for (const Corner& corner : chunk.mCorners) {
+            if (corner.mPosition < 0 || corner.mPosition >= positionCount || corner.mUV >= uvCount || corner.mNormal >= normalCount) return false;
+
+            positionsOnly &= corner.mUV < 0 && corner.mNormal < 0;
+        }
+    }
+
+    // Every position is a vertex, no lookups needed
+    if (positionsOnly) {
+        mVertices.resize(positionCount);
+
+        for (int64_t i = 0; i < positionCount; i++) {
+            mVertices[i] = { (int32_t)i, -1, -1 };
+        }
+
+        uint32_t* index = mIndices.data();
+
+        for (const Chunk& chunk : chunks) {
+            for (const Corner& corner : chunk.mCorners) {
+                *index++ = (uint32_t)corner.mPosition;
+            }
+        }
+
+        return true;
+    }
+
+    // Open addressing with linear probing, vertex index or UINT32_MAX. Most meshes have about as many
+    // vertices as positions so that's the starting guess, the table doubles at half load
+    uint64_t capacity = 1024;
+
+    while (capacity < (uint64_t)positionCount * 2) capacity <<= 1;
+
+    std::vector<uint32_t> table(capacity, UINT32_MAX);
+    uint32_t* index = mIndices.data();
+
+    mVertices.reserve(positionCount);
+
+    for (const Chunk& chunk : chunks) {
+        for (const Corner& corner : chunk.mCorners) {
+            uint64_t mask = capacity - 1;
+            uint64_t slot = HashCorner(corner.mPosition, corner.mUV, corner.mNormal) & mask;
+
+            for (;;) {
+                uint32_t vertex = table[slot];
+
+                if (vertex == UINT32_MAX) {
+                    vertex = (uint32_t)mVertices.size();
+                    table[slot] = vertex;
+                    mVertices.push_back(corner);
+                    *index++ = vertex;
+                    break;
+                }
+
+                const Corner& existing = mVertices[vertex];
+
+                if (existing.mPosition == corner.mPosition && existing.mUV == corner.mUV && existing.mNormal == corner.mNormal) {
+                    *index++ = vertex;
+                    break;
+                }
+
+                slot = (slot + 1) & mask;
+            }
+
+            if (mVertices.size() * 2 > capacity) {
+                capacity <<= 1;
+                mask = capacity - 1;
+                table.assign(capacity, UINT32_MAX);
+
+                for (uint32_t i = 0; i < (uint32_t)mVertices.size(); i++) {
+                    const Corner& vertex = mVertices[i];
+
+                    slot = HashCorner(vertex.mPosition, vertex.mUV, vertex.mNormal) & mask;
+
+                    while (table[slot] != UINT32_MAX) slot = (slot + 1) & mask;
+
+                    table[slot] = i;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ObjImporter::Parse(const std::filesystem::path& path, const uint8_t* data, uint64_t size, const MeshFileReader& reader, uint32_t threadCount) {
+    const char* text = (const char*)data;
+    const char* end = text + size;
+
+    if (threadCount == 0) threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // A few chunks per thread so one dense chunk doesn't hold everything up
+    uint64_t chunkCount = std::max(std::min((uint64_t)threadCount * 4, size / ObjMinChunkSize), (uint64_t)1);
+    mThreadCount = threadCount;
+    threadCount = (uint32_t)std::min((uint64_t)threadCount, chunkCount);
+
+    std::vector<Chunk> chunks(chunkCount);
+    const char* chunkBegin = text;
+
+    for (uint64_t i = 0; i < chunkCount; i++) {
+        const char* chunkEnd = i + 1 == chunkCount ? end : std::max(text + size / chunkCount * (i + 1), chunkBegin);
+
+        // Chunks end after a newline so no line is split
+        if (chunkEnd < end) {
+            const char* newline = (const char*)memchr(chunkEnd, '\n', end - chunkEnd);
+            chunkEnd = newline ? newline + 1 : end;
+        }
+
+        chunks[i].mBegin = chunkBegin;
+        chunks[i].mEnd = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    std::atomic<uint64_t> nextChunk;
+    std::atomic<bool> failed(false);
+
+    auto runParallel = [&](const std::function<bool(Chunk*)>& function) {
+        nextChunk = 0;
+
+        auto worker = [&]() {
+            for (uint64_t i = nextChunk++; i < chunkCount; i = nextChunk++) {
+                if (!function(&chunks[i])) failed = true;
+            }
+        };
+
+        std::vector<std::thread> threads;
+
+        for (uint32_t i = 1; i < threadCount; i++) {
+            threads.emplace_back(worker);
+        }
+
+        worker();
+
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    };
+
+    // Counting first lets every chunk parse its attributes straight into place
+    runParallel([](Chunk* chunk) { CountLines(chunk); return true; });
+
+    uint64_t positionCount = 0;
+    uint64_t uvCount = 0;
+    uint64_t normalCount = 0;
+
+    for (Chunk& chunk : chunks) {
+        chunk.mFirstPosition = positionCount;
+        chunk.mFirstUV = uvCount;
+        chunk.mFirstNormal = normalCount;
+        positionCount += chunk.mPositionCount;
+        uvCount += chunk.mUVCount;
+        normalCount += chunk.mNormalCount;
+    }
+
+    mPositions.resize(positionCount * 3);
+    mUVs.resize(uvCount * 2);
+    mNormals.resize(normalCount * 3);
+
+    runParallel([this](Chunk* chunk) { return ParseChunk(chunk); });
+
+    if (failed) {
+        GM_LOG_CRITICAL("[ObjImporter] Malformed vertex or face in \"{}\"", path.string());
+        return false;
+    }
+
+    uint64_t cornerCount = 0;
+
+    for (const Chunk& chunk : chunks) {
+        cornerCount += chunk.mCorners.size();
+    }
+
+    if (cornerCount == 0) {
+        GM_LOG_CRITICAL("[ObjImporter] \"{}\" has no faces", path.string());
+        return false;
+    }
+
+    mIndices.resize(cornerCount);
+
+    if (!DeduplicateCorners(chunks)) {
+        GM_LOG_CRITICAL("[ObjImporter] Face index out of range in \"{}\"", path.string());
+        return false;
+    }
+
+    mVertexCount = mVertices.size();
+
+    bool missingNormals = false;
+
+    for (const Corner& vertex : mVertices) {
+        if (vertex.mNormal < 0) {
+            missingNormals = true;
+            break;
+        }
+    }
+
+    if (missingNormals) {
+        mGeneratedNormals.assign(positionCount * 3, 0.0f);
+
+        for (uint64_t i = 0; i < mIndices.size(); i += 3) {
+            uint64_t p0 = mVertices[mIndices[i]].mPosition;
+            uint64_t p1 = mVertices[mIndices[i + 1]].mPosition;
+            uint64_t p2 = mVertices[mIndices[i + 2]].mPosition;
+
+            AccumulateNormal(&mPositions[p0 * 3], &mPositions[p1 * 3], &mPositions[p2 * 3], &mGeneratedNormals[p0 * 3], &mGeneratedNormals[p1 * 3], &mGeneratedNormals[p2 * 3]);
+        }
+
+        NormalizeNormals(mGeneratedNormals.data(), positionCount);
+    }
+
+    // After generating the normals, they expect the file's winding
+    FlipWinding(0, mIndices.size());
+
+    for (uint64_t i = 0; i < positionCount; i++) {
+        AddBounds(mPositions[i * 3], mPositions[i * 3 + 1], mPositions[i * 3 + 2]);
+    }
+
+    bool missingUVs = false;
+
+    for (const Corner& vertex : mVertices) {
+        missingUVs |= vertex.mUV < 0;
+    }
+
+    for (uint64_t i = 0; i < uvCount; i++) {
+        AddUVBounds(mUVs[i * 2], mUVs[i * 2 + 1]);
+    }
+
+    if (missingUVs) AddUVBounds(0.0f, 0.0f);
+
+    return true;
+}
+
+void ObjImporter::ReadPositions(float* dst) const {
+    for (const Corner& vertex : mVertices) {
+        memcpy(dst, &mPositions[(uint64_t)vertex.mPosition * 3], sizeof(float) * 3);
+        dst += 3;
+    }
+}
+
+void ObjImporter::RemapVertices(const uint32_t* source, uint64_t vertexCount) {
+    std::vector<Corner> vertices(vertexCount);
+
+    for (uint64_t i = 0; i < vertexCount; i++) {
+        vertices[i] = mVertices[source[i]];
+    }
+
+    mVertices = std::move(vertices);
+}
+
+void ObjImporter::WriteVertexRange(Vertex* dst, uint64_t first, uint64_t count) const {
+    for (uint64_t i = 0; i < count; i++) {
+        const Corner& corner = mVertices[first + i];
+        Vertex& vertex = dst[i];
+
+        const float* position = &mPositions[(uint64_t)corner.mPosition * 3];
+        const float* normal = corner.mNormal >= 0 ? &mNormals[(uint64_t)corner.mNormal * 3] : &mGeneratedNormals[(uint64_t)corner.mPosition * 3];
+
+        vertex.Position.x = position[0];
+        vertex.Position.y = position[1];
+        vertex.Position.z = position[2];
+        vertex.Normal.x = normal[0];
+        vertex.Normal.y = normal[1];
+        vertex.Normal.z = normal[2];
+
+        if (corner.mUV >= 0) {
+            vertex.UV.x = mUVs[(uint64_t)corner.mUV * 2];
+            vertex.UV.y = mUVs[(uint64_t)corner.mUV * 2 + 1];
+        } else {
+            vertex.UV.x = 0.0f;
+            vertex.UV.y = 0.0f;
+        }
+    }
+}
+
+}
@@ -0,0 +1,205 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include "mesh.h"
+
+#include <Guacamole/util/json.h>
+#include <Guacamole/util/meshoptimizer.h>
+
+#include <functional>
+#include <cfloat>
+
+namespace Guacamole {
+
+// Reads files a mesh references, like glTF's external buffers. The data must stay valid until the importer is deleted
+using MeshFileReader = std::function<const uint8_t*(const std::filesystem::path& path, uint64_t* size)>;
+
+// Parses a mesh file into its indexed triangles. The final vertices aren't built until they're written out, so
+// the importer can fill the staging buffer directly and a mesh larger than the staging buffer can be written in pieces
+class MeshImporter {
+public:
+    virtual ~MeshImporter() {}
+
+    // The extension picks the importer, returns nullptr for unsupported formats
+    static MeshImporter* Create(const std::filesystem::path& path);
+
+    // threadCount 0 = hardware concurrency
+    virtual bool Parse(const std::filesystem::path& path, const uint8_t* data, uint64_t size, const MeshFileReader& reader, uint32_t threadCount = 0) = 0;
+    // Writes vertices [first, first + count), large ranges are split across the threads Parse used
+    void WriteVertices(Vertex* dst, uint64_t first, uint64_t count) const;
+    // Writes indices [first, first + count) as uint8, uint16 or uint32
+    void WriteIndices(void* dst, VkIndexType indexType, uint64_t first, uint64_t count) const;
+    // Reorders the triangles for the post-transform cache and then overdraw, and renumbers the vertices in first use order.
+    // The triangles themselves don't change. Fills in the simulated cache efficiency before and after if given.
+    // buildMeshlets also groups the triangles into meshlets for culling before the vertices are renumbered
+    void Optimize(Util::VertexCacheStats* before = nullptr, Util::VertexCacheStats* after = nullptr, bool buildMeshlets = false);
+    // Splits the triangles, in their current order, into submeshes of at most 65536 vertices so they can use 16 bit indices.
+    // Meshlets aren't split up. Vertices shared between submeshes are duplicated, returns false and changes nothing if the duplicates would take
+    // more memory than the narrower indices save
+    bool SplitSubmeshes(uint32_t vertexSize, std::vector<Submesh>* submeshes);
+
+    inline uint64_t GetVertexCount() const { return mVertexCount; }
+    inline uint64_t GetIndexCount() const { return mIndices.size(); }
+    inline const vec3& GetBoundsMin() const { return mBoundsMin; }
+    inline const vec3& GetBoundsMax() const { return mBoundsMax; }
+    inline const vec2& GetUVBoundsMin() const { return mUVBoundsMin; }
+    inline const vec2& GetUVBoundsMax() const { return mUVBoundsMax; }
+    // Built by Optimize, mFirstIndex is into the whole index buffer
+    inline const std::vector<Util::Meshlet>& GetMeshlets() const { return mMeshlets; }
+
+protected:
+    virtual void WriteVertexRange(Vertex* dst, uint64_t first, uint64_t count) const = 0;
+    // Tightly packed xyz of every vertex
+    virtual void ReadPositions(float* dst) const = 0;
+    // New vertex i is a copy of old vertex source[i], vertices can be reordered, dropped or duplicated
+    virtual void RemapVertices(const uint32_t* source, uint64_t vertexCount) = 0;
+
+    MeshImporter() : mThreadCount(1), mVertexCount(0), mBoundsMin(FLT_MAX), mBoundsMax(-FLT_MAX), mUVBoundsMin(FLT_MAX), mUVBoundsMax(-FLT_MAX) {}
+
+    inline void AddBounds(float x, float y, float z) {
+        mBoundsMin.x = std::min(mBoundsMin.x, x);
+        mBoundsMin.y = std::min(mBoundsMin.y, y);
+        mBoundsMin.z = std::min(mBoundsMin.z, z);
+        mBoundsMax.x = std::max(mBoundsMax.x, x);
+        mBoundsMax.y = std::max(mBoundsMax.y, y);
+        mBoundsMax.z = std::max(mBoundsMax.z, z);
+    }
+
+    inline void AddUVBounds(float u, float v) {
+        mUVBoundsMin.x = std::min(mUVBoundsMin.x, u);
+        mUVBoundsMin.y = std::min(mUVBoundsMin.y, v);
+        mUVBoundsMax.x = std::max(mUVBoundsMax.x, u);
+        mUVBoundsMax.y = std::max(mUVBoundsMax.y, v);
+    }
+
+    // Reverses the triangles in [first, first + count) indices. The engine's front faces are clockwise (see
+    // GraphicsPipeline) while OBJ and glTF use counter clockwise ones
+    inline void FlipWinding(uint64_t first, uint64_t count) {
+        for (uint64_t i = first; i + 2 < first + count; i += 3) {
+            std::swap(mIndices[i + 1], mIndices[i + 2]);
+        }
+    }
+
+    // Adds the triangle's area weighted normal to each corner's normal
+    static void AccumulateNormal(const float* p0, const float* p1, const float* p2, float* n0, float* n1, float* n2);
+    static void NormalizeNormals(float* normals, uint64_t count);
+
+    uint32_t mThreadCount;
+    uint64_t mVertexCount;
+    std::vector<uint32_t> mIndices;
+    std::vector<Util::Meshlet> mMeshlets;
+    vec3 mBoundsMin;
+    vec3 mBoundsMax;
+    vec2 mUVBoundsMin;
+    vec2 mUVBoundsMax;
+};
+
+// Wavefront OBJ. The file is split into chunks on line boundaries that are parsed on separate threads, then every
+// distinct position/uv/normal combination becomes a vertex. Polygons are fanned, missing normals are generated
+class ObjImporter : public MeshImporter {
+public:
+    bool Parse(const std::filesystem::path& path, const uint8_t* data, uint64_t size, const MeshFileReader& reader, uint32_t threadCount = 0) override;
+
+private:
+    void WriteVertexRange(Vertex* dst, uint64_t first, uint64_t count) const override;
+    void ReadPositions(float* dst) const override;
+    void RemapVertices(const uint32_t* source, uint64_t vertexCount) override;
+
+    // Indices into the attribute arrays, -1 if the face doesn't reference one
+    struct Corner {
+        int32_t mPosition;
+        int32_t mUV;
+        int32_t mNormal;
+    };
+
+    struct Chunk;
+
+    static void CountLines(Chunk* chunk);
+    bool ParseChunk(Chunk* chunk);
+    bool DeduplicateCorners(const std::vector<Chunk>& chunks);
+
+    // Tightly packed xyz, uv and xyz
+    std::vector<float> mPositions;
+    std::vector<float> mUVs;
+    std::vector<float> mNormals;
+    // Per position, only generated if some corner has no normal
+    std::vector<float> mGeneratedNormals;
+    // One per vertex
+    std::vector<Corner> mVertices;
+};
+
+// glTF 2.0, .gltf with external or data URI buffers and .glb. Every triangle primitive of every mesh in the default
+// scene is merged into one mesh with the node transforms applied, materials and animation are ignored
+class GltfImporter : public MeshImporter {
+public:
+    bool Parse(const std::filesystem::path& path, const uint8_t* data, uint64_t size, const MeshFileReader& reader, uint32_t threadCount = 0) override;
+
+private:
+    void WriteVertexRange(Vertex* dst, uint64_t first, uint64_t count) const override;
+    void ReadPositions(float* dst) const override;
+    void RemapVertices(const uint32_t* source, uint64_t vertexCount) override;
+
+    // Strided view of accessor data
+    struct Attribute {
+        const uint8_t* mData = nullptr;
+        uint64_t mStride = 0;
+        uint32_t mComponentType = 0;
+        bool mNormalized = false;
+    };
+
+    struct Primitive {
+        uint64_t mFirstVertex;
+        uint64_t mVertexCount;
+        uint64_t mFirstIndex;
+        uint64_t mIndexCount;
+        Attribute mPosition;
+        Attribute mNormal;
+        Attribute mUV;
+        float mTransform[16]; // Column major
+        float mNormalTransform[9]; // Inverse transpose of the upper 3x3, scaled by anything since normals get normalized
+    };
+
+    bool LoadBuffers(const std::filesystem::path& path, const uint8_t* binChunk, uint64_t binSize, const MeshFileReader& reader);
+    bool GetAccessor(uint64_t index, uint32_t componentCount, Attribute* attribute, uint64_t* count) const;
+    bool AddNode(uint64_t index, const float* parentTransform, uint32_t depth);
+    bool AddPrimitive(const Util::JsonValue& primitive, const float* transform);
+    static void ReadAttribute(const Attribute& attribute, uint64_t index, uint32_t componentCount, float* out);
+    static void TransformPosition(const Primitive& primitive, const float* in, float* out);
+    void WriteVertex(const Primitive& primitive, uint64_t local, Vertex* vertex) const;
+
+    Util::JsonValue mDocument;
+    std::vector<std::pair<const uint8_t*, uint64_t>> mBuffers;
+    std::vector<std::vector<uint8_t>> mDecodedBuffers; // Data URIs
+    std::vector<Primitive> mPrimitives;
+    // New vertex -> imported vertex once the vertices are remapped, empty before
+    std::vector<uint32_t> mVertexOrder;
+    // Primitives without normals point their normal attribute in here
+    std::vector<float> mGeneratedNormals;
+};
+
+}
@@ -28,43 +28,70 @@ SOFTWARE.
 
 #include <Guacamole/asset/assetmanager.h>
 #include <Guacamole/vulkan/swapchain.h>
+#include <Guacamole/vulkan/deletionqueue.h>
 #include <Guacamole/scene/scene.h>
 #include <Guacamole/core/application.h>
 #include <Guacamole/renderer/material.h>
+#include <Guacamole/vulkan/shader/texturepool.h>
 
 
 namespace Guacamole {
 
+// Planes of Vulkan's clip volume in the space transform maps from, normalized so the sphere test gets distances
+static void GetFrustumPlanes(const mat4& transform, vec4* planes) {
+    vec4 rows[4];
+
+    for (uint32_t i = 0; i < 4; i++) {
+        rows[i] = vec4(transform[i], transform[i + 4], transform[i + 8], transform[i + 12]);
+    }
+
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[2]; // Depth goes from 0 to w
+    planes[5] = rows[3] - rows[2];
+
+    for (uint32_t i = 0; i < 6; i++) {
+        vec4& plane = planes[i];
+        float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+
+        plane = plane / vec4(length);
+    }
+}
+
+static bool IsSphereVisible(const vec4* planes, const float* center, float radius) {
+    for (uint32_t i = 0; i < 6; i++) {
+        const vec4& plane = planes[i];
+
+        if (plane.x * center[0] + plane.y * center[1] + plane.z * center[2] + plane.w < -radius) return false;
+    }
+
+    return true;
+}
+
 SceneRenderer::SceneRenderer(Device* device, Swapchain* swapchain, uint32_t width, uint32_t height) : 
         mDevice(device), mSwapchain(swapchain),
         mStagingBuffer(device, 1024 * 10), 
         mSceneUniformSet(device, swapchain->GetFramesInFlight()), 
         mCommandPool(device),
-        mDescriptorPool(device, 100)  {
+        mWidth(width), mHeight(height), mShaderOutdated(false), mBoundImageSet(VK_NULL_HANDLE), mBoundVertexFormat(VertexFormat::Float), mProjectionScale(1.0f), mViewportHeight(0.0f)  {
 
-    AssetHandle vertHandle = AssetManager::AddAsset(new Shader::Source("res/shader/scene.vert", false, ShaderStage::Vertex), false);
-    AssetHandle fragHandle = AssetManager::AddAsset(new Shader::Source("res/shader/scene.frag", false, ShaderStage::Fragment), false);
+    mShaderSources[0] = AssetManager::AddAsset(new Shader::Source("res/shader/scene.vert", false, ShaderStage::Vertex), false);
+    mShaderSources[1] = AssetManager::AddAsset(new Shader::Source("res/shader/scene.frag", false, ShaderStage::Fragment), false);
 
     mShader = new Shader(mDevice);
-    mShader->AddModule(vertHandle, ShaderStage::Vertex);
-    mShader->AddModule(fragHandle, ShaderStage::Fragment);
+    mShader->AddModule(mShaderSources[0], ShaderStage::Vertex);
+    mShader->AddModule(mShaderSources[1], ShaderStage::Fragment);
     mShader->Compile();
 
-    mPipelineLayout = new PipelineLayout(mDevice, mShader->GetDescriptorSetLayouts(), mShader->GetPushConstants());
+    for (uint32_t i = 0; i < 2; i++) {
+        mReloadCallbacks[i] = AssetManager::OnReloaded(mShaderSources[i], [this](Asset*) { mShaderOutdated = true; });
+    }
 
     mRenderpass = new BasicRenderpass(mSwapchain, mDevice);
 
-    GraphicsPipelineInfo gInfo;
-
-    gInfo.mWidth = width;
-    gInfo.mHeight = height;
-    gInfo.mPipelineLayout = mPipelineLayout;
-    gInfo.mRenderpass = mRenderpass;
-    gInfo.mShader = mShader;
-    gInfo.mVertexInputAttributes = mShader->GetVertexInputLayout({ { 0, { 0, 1, 2 }}});
-    gInfo.mVertexInputBindings.push_back({0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX});
-
-    mPipeline = new GraphicsPipeline(mDevice, gInfo);
+    CreatePipeline();
 
     mStagingCommandBuffer = mCommandPool.AllocateCommandBuffer(true);
     mStagingBuffer.SetCommandBuffer(mStagingCommandBuffer);
@@ -73,13 +100,18 @@ SceneRenderer::SceneRenderer(Device* device, Swapchain* swapchain, uint32_t widt
 }
 
 SceneRenderer::~SceneRenderer() {
-    for (auto& [id, bufferSet] : mUniformBuffers) {
-        delete bufferSet;
+    for (uint32_t i = 0; i < 2; i++) {
+        AssetManager::RemoveReloadCallback(mShaderSources[i], mReloadCallbacks[i]);
     }
 
     delete mStagingCommandBuffer;
-    delete mPipeline;
+
+    for (Pipeline* pipeline : mPipelines) {
+        delete pipeline;
+    }
+
     delete mPipelineLayout;
+    delete mDescriptorPool;
     delete mRenderpass;
     delete mShader;
 }
@@ -89,9 +121,66 @@ void SceneRenderer::Begin() {
     cmd->Wait();
     cmd->Begin(true);
 
+    if (mShaderOutdated) RebuildPipeline();
+
+    RecycleImageSets();
+
     mStagingBuffer.Begin();
 }
 
+void SceneRenderer::CreatePipeline() {
+    mPipelineLayout = new PipelineLayout(mDevice, mShader->GetDescriptorSetLayouts(), mShader->GetPushConstants());
+
+    GraphicsPipelineInfo gInfo;
+
+    gInfo.mWidth = mWidth;
+    gInfo.mHeight = mHeight;
+    gInfo.mPipelineLayout = mPipelineLayout;
+    gInfo.mRenderpass = mRenderpass;
+    gInfo.mShader = mShader;
+
+    for (uint32_t i = 0; i < (uint32_t)VertexFormat::Count; i++) {
+        VertexFormat format = (VertexFormat)i;
+
+        gInfo.mVertexInputAttributes = mShader->GetVertexInputLayout(0, Mesh::GetVertexAttributes(format));
+        gInfo.mVertexInputBindings = { { 0, Mesh::GetVertexSize(format), VK_VERTEX_INPUT_RATE_VERTEX } };
+
+        mPipelines[i] = new GraphicsPipeline(mDevice, gInfo);
+    }
+
+    mDescriptorPool = new DescriptorPool(mDevice, 1000);
+}
+
+void SceneRenderer::RebuildPipeline() {
+    mShaderOutdated = false;
+
+    // The other frames in flight may still be using the old objects
+    std::vector<Pipeline*> pipelines(mPipelines, mPipelines + (uint32_t)VertexFormat::Count);
+    PipelineLayout* pipelineLayout = mPipelineLayout;
+    DescriptorPool* descriptorPool = mDescriptorPool;
+
+    DeletionQueue::Push([pipelines, pipelineLayout, descriptorPool]() {
+        for (Pipeline* pipeline : pipelines) {
+            delete pipeline;
+        }
+
+        delete pipelineLayout;
+        delete descriptorPool;
+    });
+
+    // Replaces the shader modules and descriptor set layouts, the old layouts are retired the same way
+    mShader->Reload();
+
+    // Every descriptor set was allocated from the old pool with the old layouts
+    mDescriptorMap.clear();
+    mImageSets.clear();
+    mFreeImageSets.clear();
+
+    CreatePipeline();
+
+    GM_LOG_INFO("[SceneRenderer] Rebuilt pipelines after shader reload");
+}
+
 void SceneRenderer::BeginScene(const CameraComponent& cameraComponent, const IdComponent& idComponent) {
     uint32_t frame = mSwapchain->GetCurrentImageIndex();
     const Camera& camera = cameraComponent.mCamera;
@@ -126,10 +215,17 @@ void SceneRenderer::BeginScene(const CameraComponent& cameraComponent, const IdC
     data->mProjection = camera.GetProjection();
     data->mView = camera.GetView();
 
+    mView = camera.GetView();
+    mViewProjection = camera.GetProjection() * camera.GetView();
+    mCameraPosition = mat4::Inverse(camera.GetView()) * vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    mProjectionScale = fabsf(camera.GetProjection()[5]);
+
     CommandBuffer* cmd = mSwapchain->GetRenderCommandBuffer();
 
     const VkViewport& viewport = camera.GetViewport();
 
+    mViewportHeight = viewport.height;
+
     VkRect2D rect;
 
     rect.offset.x = 0;
@@ -141,8 +237,11 @@ void SceneRenderer::BeginScene(const CameraComponent& cameraComponent, const IdC
     vkCmdSetScissor(cmd->GetHandle(), 0, 1, &rect);
 
     Renderer::BeginRenderpass(cmd, mRenderpass);
-    vkCmdBindPipeline(cmd->GetHandle(), VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline->GetHandle());
+    vkCmdBindPipeline(cmd->GetHandle(), VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelines[(uint32_t)VertexFormat::Float]->GetHandle());
     vkCmdBindDescriptorSets(cmd->GetHandle(), VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout->GetHandle(), 0, 1, &set->GetHandle(), 0, 0);
+
+    mBoundImageSet = VK_NULL_HANDLE;
+    mBoundVertexFormat = VertexFormat::Float;
 }
 
 void SceneRenderer::EndScene() {
@@ -154,81 +253,179 @@ void SceneRenderer::End() {
 }
 
 void SceneRenderer::SubmitMesh(const MeshComponent& mesh, const TransformComponent& transform, const MaterialComponent& material) {
+    // Assets that are still streaming in are replaced by their fallbacks instead of stalling the frame
+    Mesh* meshAsset = AssetManager::TryGetAssetOrFallback<Mesh>(mesh.mMesh, AssetType::Mesh);
+    Material* materialAsset = AssetManager::TryGetAssetOrFallback<Material>(material.mMaterial, AssetType::Material);
+
+    if (meshAsset == nullptr || materialAsset == nullptr) return;
+
+    Texture2D* tex = AssetManager::TryGetAssetOrFallback<Texture2D>(materialAsset->mTextureHandle, AssetType::Texture);
+    Sampler* sampler = AssetManager::TryGetAssetOrFallback<Sampler>(materialAsset->mSamplerHandle, AssetType::Sampler);
+
+    if (tex == nullptr || sampler == nullptr) return;
+
+    mat4 trans = transform.GetTransform();
+    // In model space so neither the mesh's nor the meshlets' bounds have to be transformed
+    vec4 planes[6];
+
+    GetFrustumPlanes(mViewProjection * trans, planes);
+
+    if (!IsSphereVisible(planes, &meshAsset->GetBoundsCenter().x, meshAsset->GetBoundsRadius())) return;
+
     CommandBuffer* cmd = mSwapchain->GetRenderCommandBuffer();
     VkCommandBuffer cmdHandle = cmd->GetHandle();
 
-    Mesh* meshAsset = AssetManager::GetAsset<Mesh>(mesh.mMesh);
+    // The pipelines share a layout so the bound descriptor sets stay valid
+    if (meshAsset->GetVertexFormat() != mBoundVertexFormat) {
+        mBoundVertexFormat = meshAsset->GetVertexFormat();
+        vkCmdBindPipeline(cmdHandle, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelines[(uint32_t)mBoundVertexFormat]->GetHandle());
+    }
 
     VkDeviceSize offset = 0;
     vkCmdBindVertexBuffers(cmdHandle, 0, 1, &meshAsset->GetVBOHandle(), &offset);
     vkCmdBindIndexBuffer(cmdHandle, meshAsset->GetIBOHandle(), 0, meshAsset->GetIndexType());
 
-    mat4 trans = transform.GetTransform();
-    vkCmdPushConstants(cmdHandle, mPipelineLayout->GetHandle(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mat4), &trans);
+    // The vertex stage's range covers the fragment stage's material data as well
+    const VkShaderStageFlags sharedStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    uint32_t frame = mSwapchain->GetCurrentImageIndex();
-    DescriptorSet* matSet = GetDescriptorSet(frame, material.mMaterial);
-    Material* materialAsset = AssetManager::GetAsset<Material>(material.mMaterial);
-
-    if (matSet == nullptr) {
-        matSet = AllocateDescriptorSet(frame, mShader->GetDescriptorSetLayout(1), material.mMaterial);
-
-        Texture2D* tex = AssetManager::GetAsset<Texture2D>(materialAsset->mTextureHandle);
-        Sampler* sampler = AssetManager::GetAsset<Sampler>(materialAsset->mSamplerHandle);
-        
-        auto bufferIt = mUniformBuffers.find(material.mMaterial);
-        UniformBufferSet* bufferSet = nullptr;
-
-        if (bufferIt == mUniformBuffers.end()) {
-            bufferSet = new UniformBufferSet(mDevice, mSwapchain->GetFramesInFlight());
-            bufferSet->Create(1, sizeof(vec4));
-            mUniformBuffers[material.mMaterial] = bufferSet;
+    // Compact positions are dequantized by the model matrix
+    mat4 model = trans * meshAsset->GetPositionTransform();
+    vkCmdPushConstants(cmdHandle, mPipelineLayout->GetHandle(), sharedStages, 0, sizeof(mat4), &model);
+
+    MaterialData materialData;
+    materialData.mColor = materialAsset->mAlbedo;
+    materialData.mLayer = tex->GetLayer();
+    vkCmdPushConstants(cmdHandle, mPipelineLayout->GetHandle(), sharedStages, sizeof(mat4), sizeof(MaterialData), &materialData);
+
+    VertexData vertexData;
+    vertexData.mUVTransform = meshAsset->GetUVTransform();
+    vertexData.mOctahedralNormal = meshAsset->GetVertexFormat() == VertexFormat::Compact;
+    vkCmdPushConstants(cmdHandle, mPipelineLayout->GetHandle(), VK_SHADER_STAGE_VERTEX_BIT, VertexDataOffset, sizeof(VertexData), &vertexData);
+
+    if (tex->IsStreamed()) {
+        tex->RequestStreaming(GetScreenSize(meshAsset, trans, transform.mScale));
+    }
+
+    VkDescriptorSet imageSet = GetImageSet(mSwapchain->GetCurrentImageIndex(), tex, sampler);
+
+    if (imageSet != mBoundImageSet) {
+        vkCmdBindDescriptorSets(cmdHandle, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout->GetHandle(), 1, 1, &imageSet, 0, 0);
+        mBoundImageSet = imageSet;
+    }
+
+    DrawSubmeshes(cmdHandle, meshAsset, trans, transform.mScale, planes);
+}
+
+void SceneRenderer::DrawSubmeshes(VkCommandBuffer cmd, const Mesh* mesh, const mat4& transform, const vec3& scale, const vec4* planes) const {
+    const std::vector<Util::Meshlet>& meshlets = mesh->GetMeshlets();
+    vec3 camera;
+
+    // Mirroring turns the triangles around, the rasterizer's culling doesn't take that into account either
+    bool coneCulling = scale.x * scale.y * scale.z > 0.0f;
+
+    if (!meshlets.empty()) camera = mat4::Inverse(transform) * vec4(mCameraPosition, 1.0f);
+
+    for (const Submesh& submesh : mesh->GetSubmeshes()) {
+        if (submesh.mMeshletCount == 0) {
+            vkCmdDrawIndexed(cmd, submesh.mIndexCount, 1, submesh.mFirstIndex, submesh.mVertexOffset, 0);
+            continue;
+        }
+
+        uint32_t first = 0;
+        uint32_t count = 0;
+
+        for (uint32_t i = submesh.mFirstMeshlet; i < submesh.mFirstMeshlet + submesh.mMeshletCount; i++) {
+            const Util::Meshlet& meshlet = meshlets[i];
+
+            if (!IsSphereVisible(planes, meshlet.mCenter, meshlet.mRadius)) continue;
+            if (coneCulling && Util::IsMeshletBackFacing(meshlet, &camera.x)) continue;
+
+            if (count > 0 && first + count == meshlet.mFirstIndex) {
+                count += meshlet.mIndexCount;
+                continue;
+            }
+
+            if (count > 0) vkCmdDrawIndexed(cmd, count, 1, first, submesh.mVertexOffset, 0);
+
+            first = meshlet.mFirstIndex;
+            count = meshlet.mIndexCount;
+        }
+
+        if (count > 0) vkCmdDrawIndexed(cmd, count, 1, first, submesh.mVertexOffset, 0);
+    }
+}
+
+VkDescriptorSet SceneRenderer::GetImageSet(uint32_t frame, const Texture2D* texture, const Sampler* sampler) {
+    const Texture* source = texture->GetArray() ? (const Texture*)texture->GetArray() : texture;
+    ImageSet& imageSet = mImageSets[{ texture->GetImageViewHandle(), sampler->GetHandle(), frame }];
+
+    if (imageSet.mSet.GetHandle() == VK_NULL_HANDLE) {
+        if (mFreeImageSets.empty()) {
+            imageSet.mSet = mDescriptorPool->AllocateDescriptorSet(mShader->GetDescriptorSetLayout(1));
         } else {
-            bufferSet = mUniformBuffers.at(material.mMaterial);
+            imageSet.mSet = mFreeImageSets.back();
+            mFreeImageSets.pop_back();
         }
+    }
 
-        UniformBuffer* buffer = bufferSet->Get(frame, 1);
+    imageSet.mLastUsedFrame = AssetManager::GetFrameIndex();
 
-        VkDescriptorBufferInfo bInfo;
-        bInfo.buffer = buffer->GetHandle();
-        bInfo.offset = 0;
-        bInfo.range = buffer->GetSize();
+    // Written again when the view handle has been reused by another texture or another image of the same texture.
+    // The set for this frame isn't in use since the render command buffer has been waited on.
+    if (imageSet.mTexture != source || imageSet.mTextureLoadCount != source->GetLoadCount() || imageSet.mTextureViewVersion != source->GetViewVersion()) {
+        imageSet.mTexture = source;
+        imageSet.mTextureLoadCount = source->GetLoadCount();
+        imageSet.mTextureViewVersion = source->GetViewVersion();
 
         VkDescriptorImageInfo iInfo;
 
         iInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        iInfo.imageView = tex->GetImageViewHandle();
+        iInfo.imageView = texture->GetImageViewHandle();
         iInfo.sampler = sampler->GetHandle();
 
-        VkWriteDescriptorSet write[2];
-        write[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        write[0].pNext = nullptr;
-        write[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        write[0].descriptorCount = 1;
-        write[0].dstArrayElement = 0;
-        write[0].dstBinding = 0;
-        write[0].dstSet = matSet->GetHandle();
-        write[0].pImageInfo = &iInfo;
-
-        write[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        write[1].pNext = nullptr;
-        write[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        write[1].descriptorCount = 1;
-        write[1].dstArrayElement = 0;
-        write[1].dstBinding = 1;
-        write[1].dstSet = matSet->GetHandle();
-        write[1].pBufferInfo = &bInfo;
-
-        vkUpdateDescriptorSets(mDevice->GetHandle(), 2, write, 0, 0);
+        VkWriteDescriptorSet write;
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.pNext = nullptr;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.descriptorCount = 1;
+        write.dstArrayElement = 0;
+        write.dstBinding = 0;
+        write.dstSet = imageSet.mSet.GetHandle();
+        write.pImageInfo = &iInfo;
 
+        vkUpdateDescriptorSets(mDevice->GetHandle(), 1, &write, 0, 0);
     }
 
-    vkCmdBindDescriptorSets(cmdHandle, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout->GetHandle(), 1, 1, &matSet->GetHandle(), 0, 0);
+    return imageSet.mSet.GetHandle();
+}
+
+void SceneRenderer::RecycleImageSets() {
+    uint64_t frame = AssetManager::GetFrameIndex();
+    // Every frame that could have used the set has been waited on by then
+    uint64_t unusedFrames = mSwapchain->GetFramesInFlight() + 1;
+
+    if (frame < unusedFrames) return;
+
+    for (auto it = mImageSets.begin(); it != mImageSets.end();) {
+        if (it->second.mLastUsedFrame + unusedFrames > frame) {
+            it++;
+            continue;
+        }
+
+        mFreeImageSets.push_back(it->second.mSet);
+        it = mImageSets.erase(it);
+    }
+}
+
+float SceneRenderer::GetScreenSize(const Mesh* mesh, const mat4& transform, const vec3& scale) const {
+    vec4 center = mView * (transform * vec4(mesh->GetBoundsCenter(), 1.0f));
+    float radius = mesh->GetBoundsRadius() * std::max(std::max(fabsf(scale.x), fabsf(scale.y)), fabsf(scale.z));
+    float distance = sqrtf(center.x * center.x + center.y * center.y + center.z * center.z);
 
-    UniformBuffer* buffer = mUniformBuffers[material.mMaterial]->Get(frame, 1);
-    memcpy(mStagingBuffer.Allocate(sizeof(vec4), buffer), &materialAsset->mAlbedo, sizeof(vec4));
+    // The camera is inside the sphere
+    if (distance <= radius) return mViewportHeight;
 
-    vkCmdDrawIndexed(cmdHandle, meshAsset->GetIndexCount(), 1, 0, 0, 0);
+    return radius / distance * mProjectionScale * mViewportHeight;
 }
 
 DescriptorSet* SceneRenderer::GetDescriptorSet(uint32_t frame, UUID id) {
@@ -245,7 +442,7 @@ DescriptorSet* SceneRenderer::AllocateDescriptorSet(uint32_t frame, DescriptorSe
     id.m0 += frame;
     GM_ASSERT_MSG(mDescriptorMap.find(id) == mDescriptorMap.end(), "DescriptorSet already allocated for this UUID and frame");
 
-    mDescriptorMap[id] = mDescriptorPool.AllocateDescriptorSet(layout);
+    mDescriptorMap[id] = mDescriptorPool->AllocateDescriptorSet(layout);
 
     return &mDescriptorMap[id];
 }
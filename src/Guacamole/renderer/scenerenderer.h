@@ -32,6 +32,7 @@ SOFTWARE.
 
 #include <Guacamole/vulkan/shader/descriptor.h>
 #include <Guacamole/vulkan/shader/sampler.h>
+#include <Guacamole/vulkan/shader/texture.h>
 #include <Guacamole/vulkan/buffer/stagingbuffer.h>
 #include <Guacamole/vulkan/buffer/buffer.h>
 #include <Guacamole/vulkan/buffer/uniformbufferset.h>
@@ -48,6 +49,47 @@ struct SceneData {
     mat4 mView;
 };
 
+// Pushed after the model matrix
+struct MaterialData {
+    vec4 mColor;
+    uint32_t mLayer;
+};
+
+// Pushed after the material data, vertex stage only
+struct VertexData {
+    vec4 mUVTransform;
+    uint32_t mOctahedralNormal;
+};
+
+static constexpr uint32_t VertexDataOffset = 96;
+
+struct ImageSetKey {
+    VkImageView mImageView;
+    VkSampler mSampler;
+    uint32_t mFrame;
+
+    bool operator==(const ImageSetKey& other) const {
+        return mImageView == other.mImageView && mSampler == other.mSampler && mFrame == other.mFrame;
+    }
+};
+
+struct ImageSetKeyHash {
+    size_t operator()(const ImageSetKey& key) const {
+        size_t hash = std::hash<uint64_t>()((uint64_t)key.mImageView);
+        hash ^= std::hash<uint64_t>()((uint64_t)key.mSampler) + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+        return hash ^ key.mFrame;
+    }
+};
+
+struct ImageSet {
+    DescriptorSet mSet;
+    // An evicted, reloaded or streamed texture can get the same view handle back
+    const Texture* mTexture = nullptr;
+    uint32_t mTextureLoadCount = 0;
+    uint32_t mTextureViewVersion = 0;
+    uint64_t mLastUsedFrame = 0;
+};
+
 public:
     SceneRenderer(Device* device, Swapchain* swapchain, uint32_t width, uint32_t height);
     ~SceneRenderer();
@@ -59,22 +101,54 @@ public:
 
     void SubmitMesh(const MeshComponent& mesh, const TransformComponent& transform, const MaterialComponent& material);
 private:
+    // Creates the pipeline layout, one pipeline per vertex format and the descriptor pool from the current shader reflection
+    void CreatePipeline();
+    // Called at the start of a frame after one of the shader sources has been hot reloaded
+    void RebuildPipeline();
+
     DescriptorSet* GetDescriptorSet(uint32_t frame, UUID id);
     DescriptorSet* AllocateDescriptorSet(uint32_t frame, DescriptorSetLayout* layout, UUID id);
+    // Returns the set 1 descriptor set for a texture and sampler, textures in the same TextureArray share one
+    VkDescriptorSet GetImageSet(uint32_t frame, const Texture2D* texture, const Sampler* sampler);
+    // Sets of views that are gone (streamed, evicted or deleted textures) are reused once no frame can use them
+    void RecycleImageSets();
+    // Diameter in pixels of the mesh's bounding sphere, used to pick the texture levels to stream in
+    float GetScreenSize(const Mesh* mesh, const mat4& transform, const vec3& scale) const;
+    // Draws the visible meshlets of each submesh, neighbouring ones in a single draw. Submeshes without meshlets are drawn whole
+    void DrawSubmeshes(VkCommandBuffer cmd, const Mesh* mesh, const mat4& transform, const vec3& scale, const vec4* planes) const;
 
     std::unordered_map<UUID, DescriptorSet> mDescriptorMap;
-    std::unordered_map<UUID, UniformBufferSet*> mUniformBuffers;
+    std::unordered_map<ImageSetKey, ImageSet, ImageSetKeyHash> mImageSets;
+    std::vector<DescriptorSet> mFreeImageSets;
+    // Set 1 bound by the previous draw in the current scene
+    VkDescriptorSet mBoundImageSet;
 private:
     Device* mDevice;
     Swapchain* mSwapchain;
     Shader* mShader;
     PipelineLayout* mPipelineLayout;
-    Pipeline* mPipeline;
+    // Indexed by VertexFormat, they share mPipelineLayout
+    Pipeline* mPipelines[(uint32_t)VertexFormat::Count];
+    // Of the pipeline bound by the previous draw in the current scene
+    VertexFormat mBoundVertexFormat;
     Renderpass* mRenderpass;
+    uint32_t mWidth;
+    uint32_t mHeight;
+
+    AssetHandle mShaderSources[2];
+    uint64_t mReloadCallbacks[2];
+    bool mShaderOutdated;
 
     UniformBufferSet mSceneUniformSet;
 
-    DescriptorPool mDescriptorPool;
+    // Of the current scene's camera
+    mat4 mView;
+    mat4 mViewProjection;
+    vec3 mCameraPosition;
+    float mProjectionScale;
+    float mViewportHeight;
+
+    DescriptorPool* mDescriptorPool;
     CommandPool mCommandPool;
     CommandBuffer* mStagingCommandBuffer;
     StagingBuffer mStagingBuffer;
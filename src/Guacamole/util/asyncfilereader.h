@@ -0,0 +1,97 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include <filesystem>
+#include <atomic>
+
+namespace Guacamole {
+
+// A whole file read into a heap buffer in the background
+class FileRead {
+public:
+    ~FileRead();
+
+    FileRead(const FileRead&) = delete;
+    FileRead& operator=(const FileRead&) = delete;
+
+    // Blocks until the read is done, returns false if it failed
+    bool Wait();
+    inline bool IsDone() const { return mDone.load(std::memory_order_acquire); }
+
+    // Only valid once the read is done
+    inline const uint8_t* GetData() const { return mData; }
+    inline uint64_t GetSize() const { return mSize; }
+
+private:
+    FileRead() = default;
+
+    uint8_t* mData = nullptr;
+    uint64_t mSize = 0;
+    uint64_t mOffset = 0; // Bytes read so far, reads may complete in several pieces
+#if defined(GM_WINDOWS)
+    void* mFile = nullptr;
+#else
+    int mFile = -1;
+#endif
+    bool mFailed = false;
+    std::atomic<bool> mDone { false };
+
+    friend class AsyncFileReader;
+};
+
+// Batched asynchronous whole file reads. Uses io_uring when the kernel supports it
+// and falls back to a small pool of threads doing blocking reads otherwise.
+class AsyncFileReader {
+public:
+    static void Init(uint32_t queueDepth = 64);
+    // Waits for reads that are in flight, reads that haven't been waited on must be deleted by the caller
+    static void Shutdown();
+
+    // Opens the file and queues the read, nothing is read until Submit is called.
+    // Returns nullptr if the file can't be opened. Safe to call from any thread
+    static FileRead* Read(const std::filesystem::path& path);
+    // Submits every queued read in a single batch
+    static void Submit();
+
+    static bool IsInitialized();
+    // False if io_uring isn't available and the thread pool is used
+    static bool IsUsingIoUring();
+
+private:
+    // Thread pool fallback, reads one file at a time with blocking reads
+    static void WorkerThread();
+    static void Complete(FileRead* read, bool failed);
+
+#if defined(GM_LINUX)
+    static void CompletionThread();
+    // Moves queued reads into the submission ring, the queue lock must be held
+    static void FillRing();
+#endif
+};
+
+}
@@ -0,0 +1,829 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "bc.h"
+
+#include <thread>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+namespace Guacamole { namespace Util {
+
+// 4x4 texels as floats, planar so the index search handles 4 texels per instruction
+struct Block {
+    alignas(16) float mChannels[4][16];
+};
+
+// Palette entries are decoded exactly like the hardware would, the error is measured against what's displayed
+struct Palette {
+    float mEntries[16][4];
+    uint32_t mSize;
+};
+
+struct BitWriter {
+    uint8_t* mData;
+    uint32_t mOffset;
+
+    void Write(uint32_t value, uint32_t bits) {
+        for (uint32_t i = 0; i < bits; i++, mOffset++) {
+            mData[mOffset >> 3] |= ((value >> i) & 1) << (mOffset & 7);
+        }
+    }
+};
+
+struct BitReader {
+    const uint8_t* mData;
+    uint32_t mOffset;
+
+    uint32_t Read(uint32_t bits) {
+        uint32_t value = 0;
+
+        for (uint32_t i = 0; i < bits; i++, mOffset++) {
+            value |= ((mData[mOffset >> 3] >> (mOffset & 7)) & 1) << i;
+        }
+
+        return value;
+    }
+};
+
+static const uint32_t sBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static inline uint8_t Clamp8(float value) {
+    return (uint8_t)std::min(std::max(value + 0.5f, 0.0f), 255.0f);
+}
+
+static void LoadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block* block) {
+    for (uint32_t y = 0; y < 4; y++) {
+        const uint8_t* row = rgba + (uint64_t)std::min(blockY * 4 + y, height - 1) * width * 4;
+
+        for (uint32_t x = 0; x < 4; x++) {
+            const uint8_t* texel = row + std::min(blockX * 4 + x, width - 1) * 4;
+
+            for (uint32_t c = 0; c < 4; c++) {
+                block->mChannels[c][y * 4 + x] = texel[c];
+            }
+        }
+    }
+}
+
+// Picks the closest palette entry for every texel over channels [first, first + count), returns the squared error
+static float FindIndices(const Block& block, uint32_t first, uint32_t count, const Palette& palette, uint8_t* indices) {
+    __m128 total = _mm_setzero_ps();
+
+    for (uint32_t i = 0; i < 16; i += 4) {
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i bestIndex = _mm_setzero_si128();
+
+        for (uint32_t p = 0; p < palette.mSize; p++) {
+            __m128 dist = _mm_setzero_ps();
+
+            for (uint32_t c = first; c < first + count; c++) {
+                __m128 d = _mm_sub_ps(_mm_load_ps(&block.mChannels[c][i]), _mm_set1_ps(palette.mEntries[p][c]));
+                dist = _mm_add_ps(dist, _mm_mul_ps(d, d));
+            }
+
+            __m128i less = _mm_castps_si128(_mm_cmplt_ps(dist, best));
+
+            best = _mm_min_ps(dist, best);
+            bestIndex = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi32(p)), _mm_andnot_si128(less, bestIndex));
+        }
+
+        alignas(16) int32_t out[4];
+        _mm_store_si128((__m128i*)out, bestIndex);
+
+        for (uint32_t j = 0; j < 4; j++) {
+            indices[i + j] = (uint8_t)out[j];
+        }
+
+        total = _mm_add_ps(total, best);
+    }
+
+    alignas(16) float sum[4];
+    _mm_store_ps(sum, total);
+
+    return sum[0] + sum[1] + sum[2] + sum[3];
+}
+
+// Endpoints along the principal axis of the texels, spanning the projection of every texel
+static void FitEndpoints(const Block& block, uint32_t first, uint32_t count, BCQuality quality, float* e0, float* e1) {
+    float mean[4] = {};
+    float axis[4] = {};
+    float covariance[4][4] = {};
+
+    for (uint32_t c = first; c < first + count; c++) {
+        float minValue = 255.0f;
+        float maxValue = 0.0f;
+
+        for (uint32_t i = 0; i < 16; i++) {
+            mean[c] += block.mChannels[c][i];
+            minValue = std::min(minValue, block.mChannels[c][i]);
+            maxValue = std::max(maxValue, block.mChannels[c][i]);
+        }
+
+        mean[c] /= 16.0f;
+        // Bounding box diagonal as the starting guess
+        axis[c] = maxValue - minValue;
+    }
+
+    for (uint32_t i = 0; i < 16; i++) {
+        for (uint32_t a = first; a < first + count; a++) {
+            for (uint32_t b = first; b < first + count; b++) {
+                covariance[a][b] += (block.mChannels[a][i] - mean[a]) * (block.mChannels[b][i] - mean[b]);
+            }
+        }
+    }
+
+    uint32_t iterations = quality == BCQuality::Best ? 8 : 3;
+
+    for (uint32_t n = 0; n < iterations; n++) {
+        float next[4] = {};
+        float length = 0.0f;
+
+        for (uint32_t a = first; a < first + count; a++) {
+            for (uint32_t b = first; b < first + count; b++) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+
+            length = std::max(length, std::abs(next[a]));
+        }
+
+        if (length < 1e-6f) break;
+
+        for (uint32_t c = first; c < first + count; c++) {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    float minT = FLT_MAX;
+    float maxT = -FLT_MAX;
+
+    for (uint32_t i = 0; i < 16; i++) {
+        float t = 0.0f;
+
+        for (uint32_t c = first; c < first + count; c++) {
+            t += (block.mChannels[c][i] - mean[c]) * axis[c];
+        }
+
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+
+    float lengthSq = 0.0f;
+
+    for (uint32_t c = first; c < first + count; c++) {
+        lengthSq += axis[c] * axis[c];
+    }
+
+    if (lengthSq < 1e-12f) {
+        minT = maxT = 0.0f;
+        lengthSq = 1.0f;
+    }
+
+    for (uint32_t c = first; c < first + count; c++) {
+        e0[c] = std::min(std::max(mean[c] + axis[c] * minT / lengthSq, 0.0f), 255.0f);
+        e1[c] = std::min(std::max(mean[c] + axis[c] * maxT / lengthSq, 0.0f), 255.0f);
+    }
+}
+
+// Least squares endpoints for fixed indices, weights[index] is how far along e0 -> e1 the index is
+static bool RefineEndpoints(const Block& block, uint32_t first, uint32_t count, const uint8_t* indices, const float* weights, float* e0, float* e1) {
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float ax[4] = {};
+    float bx[4] = {};
+
+    for (uint32_t i = 0; i < 16; i++) {
+        float b = weights[indices[i]];
+        float a = 1.0f - b;
+
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+
+        for (uint32_t c = first; c < first + count; c++) {
+            ax[c] += a * block.mChannels[c][i];
+            bx[c] += b * block.mChannels[c][i];
+        }
+    }
+
+    float det = aa * bb - ab * ab;
+
+    if (std::abs(det) < 1e-6f) return false;
+
+    for (uint32_t c = first; c < first + count; c++) {
+        e0[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) / det, 0.0f), 255.0f);
+        e1[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) / det, 0.0f), 255.0f);
+    }
+
+    return true;
+}
+
+static inline uint16_t PackRGB565(const float* color) {
+    uint32_t r = Clamp8(color[0] * 31.0f / 255.0f);
+    uint32_t g = Clamp8(color[1] * 63.0f / 255.0f);
+    uint32_t b = Clamp8(color[2] * 31.0f / 255.0f);
+
+    return (uint16_t)((std::min(r, 31u) << 11) | (std::min(g, 63u) << 5) | std::min(b, 31u));
+}
+
+static inline void UnpackRGB565(uint16_t color, uint32_t* rgb) {
+    uint32_t r = (color >> 11) & 31;
+    uint32_t g = (color >> 5) & 63;
+    uint32_t b = color & 31;
+
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void GetBC1Palette(uint16_t color0, uint16_t color1, uint8_t palette[4][4]) {
+    uint32_t c0[3];
+    uint32_t c1[3];
+
+    UnpackRGB565(color0, c0);
+    UnpackRGB565(color1, c1);
+
+    for (uint32_t c = 0; c < 3; c++) {
+        palette[0][c] = c0[c];
+        palette[1][c] = c1[c];
+
+        if (color0 > color1) {
+            palette[2][c] = (2 * c0[c] + c1[c] + 1) / 3;
+            palette[3][c] = (c0[c] + 2 * c1[c] + 1) / 3;
+        } else {
+            palette[2][c] = (c0[c] + c1[c] + 1) / 2;
+            palette[3][c] = 0;
+        }
+    }
+
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    palette[3][3] = color0 > color1 ? 255 : 0;
+}
+
+static void GetBC4Palette(uint8_t value0, uint8_t value1, uint8_t palette[8]) {
+    palette[0] = value0;
+    palette[1] = value1;
+
+    if (value0 > value1) {
+        for (uint32_t i = 2; i < 8; i++) {
+            palette[i] = (uint8_t)(((8 - i) * value0 + (i - 1) * value1 + 3) / 7);
+        }
+    } else {
+        for (uint32_t i = 2; i < 6; i++) {
+            palette[i] = (uint8_t)(((6 - i) * value0 + (i - 1) * value1 + 2) / 5);
+        }
+
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static float EvaluateBC1(const Block& block, const float* e0, const float* e1, uint16_t* color0, uint16_t* color1, uint8_t* indices) {
+    *color0 = PackRGB565(e0);
+    *color1 = PackRGB565(e1);
+
+    // 4 color mode needs color0 > color1, the punch through alpha mode is never used
+    if (*color0 < *color1) std::swap(*color0, *color1);
+
+    uint8_t colors[4][4];
+    GetBC1Palette(*color0, *color1, colors);
+
+    Palette palette;
+    palette.mSize = *color0 == *color1 ? 1 : 4;
+
+    for (uint32_t p = 0; p < palette.mSize; p++) {
+        for (uint32_t c = 0; c < 3; c++) {
+            palette.mEntries[p][c] = colors[p][c];
+        }
+    }
+
+    return FindIndices(block, 0, 3, palette, indices);
+}
+
+static void EncodeBC1(const Block& block, BCQuality quality, uint8_t* dst) {
+    static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    float e0[4];
+    float e1[4];
+    uint16_t color0;
+    uint16_t color1;
+    uint8_t indices[16];
+
+    FitEndpoints(block, 0, 3, quality, e0, e1);
+    float error = EvaluateBC1(block, e0, e1, &color0, &color1, indices);
+
+    for (uint32_t n = 0; quality == BCQuality::Best && n < 2 && color0 != color1; n++) {
+        uint16_t refined0;
+        uint16_t refined1;
+        uint8_t refinedIndices[16];
+
+        if (!RefineEndpoints(block, 0, 3, indices, weights, e0, e1)) break;
+
+        float refinedError = EvaluateBC1(block, e0, e1, &refined0, &refined1, refinedIndices);
+
+        if (refinedError >= error) break;
+
+        error = refinedError;
+        color0 = refined0;
+        color1 = refined1;
+        memcpy(indices, refinedIndices, sizeof(indices));
+    }
+
+    uint32_t bits = 0;
+
+    for (uint32_t i = 0; i < 16; i++) {
+        bits |= (uint32_t)indices[i] << (i * 2);
+    }
+
+    memcpy(dst, &color0, 2);
+    memcpy(dst + 2, &color1, 2);
+    memcpy(dst + 4, &bits, 4);
+}
+
+static float EvaluateBC4(const Block& block, uint32_t channel, uint8_t value0, uint8_t value1, uint8_t* indices) {
+    uint8_t values[8];
+    GetBC4Palette(value0, value1, values);
+
+    Palette palette;
+    palette.mSize = value0 == value1 ? 1 : 8;
+
+    for (uint32_t p = 0; p < palette.mSize; p++) {
+        palette.mEntries[p][channel] = values[p];
+    }
+
+    return FindIndices(block, channel, 1, palette, indices);
+}
+
+static void EncodeBC4(const Block& block, uint32_t channel, BCQuality quality, uint8_t* dst) {
+    static const float weights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+
+    float minValue = 255.0f;
+    float maxValue = 0.0f;
+    // Range without the extremes, the 6 value mode has exact 0 and 255
+    float minInner = 255.0f;
+    float maxInner = 0.0f;
+
+    for (uint32_t i = 0; i < 16; i++) {
+        float value = block.mChannels[channel][i];
+
+        minValue = std::min(minValue, value);
+        maxValue = std::max(maxValue, value);
+
+        if (value > 0.0f && value < 255.0f) {
+            minInner = std::min(minInner, value);
+            maxInner = std::max(maxInner, value);
+        }
+    }
+
+    uint8_t value0 = (uint8_t)maxValue;
+    uint8_t value1 = (uint8_t)minValue;
+    uint8_t indices[16];
+    float error = EvaluateBC4(block, channel, value0, value1, indices);
+
+    if (quality == BCQuality::Best && value0 != value1) {
+        float e0[4];
+        float e1[4];
+
+        e0[channel] = value0;
+        e1[channel] = value1;
+
+        if (RefineEndpoints(block, channel, 1, indices, weights, e0, e1)) {
+            uint8_t refined0 = std::max(Clamp8(e0[channel]), Clamp8(e1[channel]));
+            uint8_t refined1 = std::min(Clamp8(e0[channel]), Clamp8(e1[channel]));
+            uint8_t refinedIndices[16];
+
+            if (refined0 != refined1) {
+                float refinedError = EvaluateBC4(block, channel, refined0, refined1, refinedIndices);
+
+                if (refinedError < error) {
+                    error = refinedError;
+                    value0 = refined0;
+                    value1 = refined1;
+                    memcpy(indices, refinedIndices, sizeof(indices));
+                }
+            }
+        }
+
+        if (minInner < maxInner) {
+            uint8_t inner0 = (uint8_t)minInner;
+            uint8_t inner1 = (uint8_t)maxInner;
+            uint8_t innerIndices[16];
+            float innerError = EvaluateBC4(block, channel, inner0, inner1, innerIndices);
+
+            if (innerError < error) {
+                value0 = inner0;
+                value1 = inner1;
+                memcpy(indices, innerIndices, sizeof(indices));
+            }
+        }
+    }
+
+    uint64_t bits = 0;
+
+    for (uint32_t i = 0; i < 16; i++) {
+        bits |= (uint64_t)indices[i] << (i * 3);
+    }
+
+    dst[0] = value0;
+    dst[1] = value1;
+
+    for (uint32_t i = 0; i < 6; i++) {
+        dst[2 + i] = (uint8_t)(bits >> (i * 8));
+    }
+}
+
+// Mode 6 endpoints are 7 bits per channel plus a shared lsb (p-bit) per endpoint
+static inline uint32_t QuantizeBC7(float value, uint32_t pbit) {
+    return (uint32_t)std::min(std::max((int32_t)std::floor((value - pbit) / 2.0f + 0.5f), 0), 127);
+}
+
+static float EvaluateBC7(const Block& block, const float* e0, const float* e1, uint32_t pbit0, uint32_t pbit1, uint32_t* q0, uint32_t* q1, uint8_t* indices) {
+    Palette palette;
+    palette.mSize = 16;
+
+    for (uint32_t c = 0; c < 4; c++) {
+        q0[c] = QuantizeBC7(e0[c], pbit0);
+        q1[c] = QuantizeBC7(e1[c], pbit1);
+
+        uint32_t v0 = (q0[c] << 1) | pbit0;
+        uint32_t v1 = (q1[c] << 1) | pbit1;
+
+        for (uint32_t p = 0; p < 16; p++) {
+            palette.mEntries[p][c] = (float)(((64 - sBC7Weights[p]) * v0 + sBC7Weights[p] * v1 + 32) >> 6);
+        }
+    }
+
+    return FindIndices(block, 0, 4, palette, indices);
+}
+
+// p-bit that loses the least precision when the endpoint is quantized
+static uint32_t ChooseBC7PBit(const float* endpoint) {
+    float error[2] = {};
+
+    for (uint32_t p = 0; p < 2; p++) {
+        for (uint32_t c = 0; c < 4; c++) {
+            float d = endpoint[c] - (float)((QuantizeBC7(endpoint[c], p) << 1) | p);
+            error[p] += d * d;
+        }
+    }
+
+    return error[1] < error[0] ? 1 : 0;
+}
+
+static void EncodeBC7(const Block& block, BCQuality quality, uint8_t* dst) {
+    float weights[16];
+
+    for (uint32_t i = 0; i < 16; i++) {
+        weights[i] = sBC7Weights[i] / 64.0f;
+    }
+
+    float e0[4];
+    float e1[4];
+    uint32_t q0[4];
+    uint32_t q1[4];
+    uint32_t pbit0 = 0;
+    uint32_t pbit1 = 0;
+    uint8_t indices[16];
+    float error = FLT_MAX;
+
+    FitEndpoints(block, 0, 4, quality, e0, e1);
+
+    uint32_t passes = quality == BCQuality::Best ? 2 : 1;
+
+    for (uint32_t n = 0; n < passes; n++) {
+        bool improved = false;
+
+        for (uint32_t p = 0; p < 4; p++) {
+            uint32_t candidate0 = p & 1;
+            uint32_t candidate1 = p >> 1;
+
+            if (quality == BCQuality::Fast) {
+                candidate0 = ChooseBC7PBit(e0);
+                candidate1 = ChooseBC7PBit(e1);
+            }
+
+            uint32_t candidateQ0[4];
+            uint32_t candidateQ1[4];
+            uint8_t candidateIndices[16];
+            float candidateError = EvaluateBC7(block, e0, e1, candidate0, candidate1, candidateQ0, candidateQ1, candidateIndices);
+
+            if (candidateError < error) {
+                error = candidateError;
+                pbit0 = candidate0;
+                pbit1 = candidate1;
+                memcpy(q0, candidateQ0, sizeof(q0));
+                memcpy(q1, candidateQ1, sizeof(q1));
+                memcpy(indices, candidateIndices, sizeof(indices));
+                improved = true;
+            }
+
+            if (quality == BCQuality::Fast) break;
+        }
+
+        if (!improved || n + 1 == passes || !RefineEndpoints(block, 0, 4, indices, weights, e0, e1)) break;
+    }
+
+    // The msb of the first index is implied 0, flipping the endpoints mirrors the indices
+    if (indices[0] & 8) {
+        std::swap(pbit0, pbit1);
+
+        for (uint32_t c = 0; c < 4; c++) {
+            std::swap(q0[c], q1[c]);
+        }
+
+        for (uint32_t i = 0; i < 16; i++) {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(dst, 0, 16);
+
+    BitWriter writer = { dst, 0 };
+
+    writer.Write(1 << 6, 7);
+
+    for (uint32_t c = 0; c < 4; c++) {
+        writer.Write(q0[c], 7);
+        writer.Write(q1[c], 7);
+    }
+
+    writer.Write(pbit0, 1);
+    writer.Write(pbit1, 1);
+    writer.Write(indices[0], 3);
+
+    for (uint32_t i = 1; i < 16; i++) {
+        writer.Write(indices[i], 4);
+    }
+}
+
+static void EncodeBlock(const Block& block, BCFormat format, BCQuality quality, uint8_t* dst) {
+    switch (format) {
+        case BCFormat::BC1:
+            EncodeBC1(block, quality, dst);
+            break;
+        case BCFormat::BC3:
+            EncodeBC4(block, 3, quality, dst);
+            EncodeBC1(block, quality, dst + 8);
+            break;
+        case BCFormat::BC4:
+            EncodeBC4(block, 0, quality, dst);
+            break;
+        case BCFormat::BC5:
+            EncodeBC4(block, 0, quality, dst);
+            EncodeBC4(block, 1, quality, dst + 8);
+            break;
+        case BCFormat::BC7:
+            EncodeBC7(block, quality, dst);
+            break;
+    }
+}
+
+static void DecodeBC1(const uint8_t* src, uint8_t texels[16][4]) {
+    uint16_t color0;
+    uint16_t color1;
+    uint32_t bits;
+    uint8_t palette[4][4];
+
+    memcpy(&color0, src, 2);
+    memcpy(&color1, src + 2, 2);
+    memcpy(&bits, src + 4, 4);
+
+    GetBC1Palette(color0, color1, palette);
+
+    for (uint32_t i = 0; i < 16; i++) {
+        memcpy(texels[i], palette[(bits >> (i * 2)) & 3], 4);
+    }
+}
+
+static void DecodeBC4(const uint8_t* src, uint32_t channel, uint8_t texels[16][4]) {
+    uint8_t palette[8];
+    uint64_t bits = 0;
+
+    GetBC4Palette(src[0], src[1], palette);
+
+    for (uint32_t i = 0; i < 6; i++) {
+        bits |= (uint64_t)src[2 + i] << (i * 8);
+    }
+
+    for (uint32_t i = 0; i < 16; i++) {
+        texels[i][channel] = palette[(bits >> (i * 3)) & 7];
+    }
+}
+
+static void DecodeBC7(const uint8_t* src, uint8_t texels[16][4]) {
+    BitReader reader = { src, 0 };
+
+    if (reader.Read(7) != (1 << 6)) {
+        GM_LOG_WARNING("[BC] Only BC7 mode 6 can be decoded");
+        memset(texels, 0, 64);
+        return;
+    }
+
+    uint32_t q[2][4];
+
+    for (uint32_t c = 0; c < 4; c++) {
+        q[0][c] = reader.Read(7);
+        q[1][c] = reader.Read(7);
+    }
+
+    uint32_t pbit0 = reader.Read(1);
+    uint32_t pbit1 = reader.Read(1);
+
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t index = reader.Read(i == 0 ? 3 : 4);
+
+        for (uint32_t c = 0; c < 4; c++) {
+            uint32_t v0 = (q[0][c] << 1) | pbit0;
+            uint32_t v1 = (q[1][c] << 1) | pbit1;
+
+            texels[i][c] = (uint8_t)(((64 - sBC7Weights[index]) * v0 + sBC7Weights[index] * v1 + 32) >> 6);
+        }
+    }
+}
+
+ImageChannels GetImageChannels(const uint8_t* rgba, uint32_t width, uint32_t height) {
+    uint64_t count = (uint64_t)width * height;
+    uint64_t i = 0;
+
+    const __m128i byteMask = _mm_set1_epi32(0xFF);
+    const __m128i opaque = _mm_set1_epi32(0xFF);
+    __m128i gray = _mm_set1_epi32(-1);
+    __m128i alpha = _mm_set1_epi32(-1);
+    __m128i blue = _mm_set1_epi32(-1);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i texels = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+        __m128i r = _mm_and_si128(texels, byteMask);
+        __m128i g = _mm_and_si128(_mm_srli_epi32(texels, 8), byteMask);
+        __m128i b = _mm_and_si128(_mm_srli_epi32(texels, 16), byteMask);
+        __m128i a = _mm_srli_epi32(texels, 24);
+
+        gray = _mm_and_si128(gray, _mm_and_si128(_mm_cmpeq_epi32(r, g), _mm_cmpeq_epi32(r, b)));
+        alpha = _mm_and_si128(alpha, _mm_cmpeq_epi32(a, opaque));
+        blue = _mm_and_si128(blue, _mm_cmpeq_epi32(b, _mm_setzero_si128()));
+    }
+
+    bool isGray = _mm_movemask_epi8(gray) == 0xFFFF;
+    bool isOpaque = _mm_movemask_epi8(alpha) == 0xFFFF;
+    bool noBlue = _mm_movemask_epi8(blue) == 0xFFFF;
+
+    for (; i < count; i++) {
+        const uint8_t* texel = rgba + i * 4;
+
+        isGray &= texel[0] == texel[1] && texel[0] == texel[2];
+        isOpaque &= texel[3] == 255;
+        noBlue &= texel[2] == 0;
+    }
+
+    if (isGray) return isOpaque ? ImageChannels::Gray : ImageChannels::GrayAlpha;
+    if (!isOpaque) return ImageChannels::RGBA;
+
+    return noBlue ? ImageChannels::RG : ImageChannels::RGB;
+}
+
+const char* GetBCFormatName(BCFormat format) {
+    switch (format) {
+        case BCFormat::BC1: return "BC1";
+        case BCFormat::BC3: return "BC3";
+        case BCFormat::BC4: return "BC4";
+        case BCFormat::BC5: return "BC5";
+        case BCFormat::BC7: return "BC7";
+    }
+
+    return "Unknown";
+}
+
+uint32_t GetBCBlockSize(BCFormat format) {
+    return format == BCFormat::BC1 || format == BCFormat::BC4 ? 8 : 16;
+}
+
+uint64_t GetBCImageSize(uint32_t width, uint32_t height, BCFormat format) {
+    return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * GetBCBlockSize(format);
+}
+
+void CompressBC(const uint8_t* rgba, uint32_t width, uint32_t height, BCFormat format, BCQuality quality, uint8_t* dst, uint32_t threadCount) {
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    uint32_t blockSize = GetBCBlockSize(format);
+
+    std::atomic<uint32_t> nextRow = 0;
+
+    auto worker = [&]() {
+        Block block;
+
+        for (uint32_t y = nextRow++; y < blocksY; y = nextRow++) {
+            uint8_t* out = dst + (uint64_t)y * blocksX * blockSize;
+
+            for (uint32_t x = 0; x < blocksX; x++) {
+                LoadBlock(rgba, width, height, x, y, &block);
+                EncodeBlock(block, format, quality, out + x * blockSize);
+            }
+        }
+    };
+
+    if (threadCount == 0) threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // Threads aren't worth starting for the small mips
+    threadCount = std::min(threadCount, std::max((uint32_t)((uint64_t)blocksX * blocksY / 1024), 1u));
+
+    std::vector<std::thread> threads;
+
+    for (uint32_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+
+    worker();
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void DecompressBC(const uint8_t* src, uint32_t width, uint32_t height, BCFormat format, uint8_t* rgba) {
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    uint32_t blockSize = GetBCBlockSize(format);
+
+    for (uint32_t by = 0; by < blocksY; by++) {
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            const uint8_t* block = src + ((uint64_t)by * blocksX + bx) * blockSize;
+            uint8_t texels[16][4] = {};
+
+            for (uint32_t i = 0; i < 16; i++) {
+                texels[i][3] = 255;
+            }
+
+            switch (format) {
+                case BCFormat::BC1:
+                    DecodeBC1(block, texels);
+                    break;
+                case BCFormat::BC3:
+                    DecodeBC1(block + 8, texels);
+                    DecodeBC4(block, 3, texels);
+                    break;
+                case BCFormat::BC4:
+                    DecodeBC4(block, 0, texels);
+                    break;
+                case BCFormat::BC5:
+                    DecodeBC4(block, 0, texels);
+                    DecodeBC4(block + 8, 1, texels);
+                    break;
+                case BCFormat::BC7:
+                    DecodeBC7(block, texels);
+                    break;
+            }
+
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++) {
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++) {
+                    memcpy(rgba + ((uint64_t)(by * 4 + y) * width + bx * 4 + x) * 4, texels[y * 4 + x], 4);
+                }
+            }
+        }
+    }
+}
+
+double ComputePSNR(const uint8_t* a, const uint8_t* b, uint32_t width, uint32_t height, uint32_t channelCount) {
+    uint64_t count = (uint64_t)width * height;
+    uint64_t error = 0;
+
+    for (uint64_t i = 0; i < count; i++) {
+        for (uint32_t c = 0; c < channelCount; c++) {
+            int32_t d = (int32_t)a[i * 4 + c] - b[i * 4 + c];
+            error += d * d;
+        }
+    }
+
+    if (error == 0) return INFINITY;
+
+    double mse = (double)error / (count * channelCount);
+
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+}
+}
@@ -0,0 +1,69 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+namespace Guacamole { namespace Util {
+
+enum class BCFormat {
+    BC1, // RGB, 8 bytes per block
+    BC3, // RGBA, BC1 color + BC4 alpha
+    BC4, // R
+    BC5, // RG, two BC4 blocks
+    BC7  // RGBA, only mode 6 is encoded
+};
+
+enum class BCQuality {
+    Fast, // Principal axis endpoints
+    Best  // Refines the endpoints with least squares and searches all BC7 p-bits
+};
+
+// Which channels of an RGBA8 image carry information, this is what the BC format is picked from
+enum class ImageChannels {
+    Gray,      // R == G == B, opaque
+    GrayAlpha, // R == G == B
+    RG,        // B == 0, opaque
+    RGB,       // Opaque
+    RGBA
+};
+
+ImageChannels GetImageChannels(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+const char* GetBCFormatName(BCFormat format);
+uint32_t GetBCBlockSize(BCFormat format);
+uint64_t GetBCImageSize(uint32_t width, uint32_t height, BCFormat format);
+
+// Compresses an RGBA8 image, partial blocks at the edges repeat the last row/column.
+// BC4 encodes R and BC5 RG. Large images are split across threadCount threads, 0 = hardware threads
+void CompressBC(const uint8_t* rgba, uint32_t width, uint32_t height, BCFormat format, BCQuality quality, uint8_t* dst, uint32_t threadCount = 0);
+// Decodes back to RGBA8, channels the format doesn't have are 0 and alpha is 255. BC7 only decodes mode 6
+void DecompressBC(const uint8_t* src, uint32_t width, uint32_t height, BCFormat format, uint8_t* rgba);
+
+// PSNR in dB over the first channelCount channels of two RGBA8 images, infinity if they're equal
+double ComputePSNR(const uint8_t* a, const uint8_t* b, uint32_t width, uint32_t height, uint32_t channelCount = 4);
+
+}
+}
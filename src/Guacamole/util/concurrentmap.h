@@ -0,0 +1,133 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include <unordered_map>
+#include <shared_mutex>
+
+namespace Guacamole {
+
+// Hash map split into independently locked shards. Lookups only take a shared lock
+// on one shard so readers never block each other, and writers only contend when
+// they hash to the same shard.
+template<typename K, typename V, uint32_t ShardCount = 32, typename Hash = std::hash<K>>
+class ConcurrentMap {
+public:
+    static_assert((ShardCount & (ShardCount - 1)) == 0, "ShardCount must be a power of two");
+
+    // Returns false and leaves the map untouched if the key already exist
+    bool Insert(const K& key, const V& value) {
+        Shard& shard = GetShard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mMutex);
+
+        return shard.mMap.emplace(key, value).second;
+    }
+
+    void Set(const K& key, const V& value) {
+        Shard& shard = GetShard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mMutex);
+
+        shard.mMap[key] = value;
+    }
+
+    bool Erase(const K& key) {
+        Shard& shard = GetShard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mMutex);
+
+        return shard.mMap.erase(key) != 0;
+    }
+
+    bool Find(const K& key, V* value) const {
+        const Shard& shard = GetShard(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mMutex);
+
+        auto it = shard.mMap.find(key);
+
+        if (it == shard.mMap.end()) return false;
+
+        *value = it->second;
+
+        return true;
+    }
+
+    bool Contains(const K& key) const {
+        const Shard& shard = GetShard(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mMutex);
+
+        return shard.mMap.find(key) != shard.mMap.end();
+    }
+
+    // func(const K&, const V&) is called with the shard locked, it must not modify the map
+    template<typename F>
+    void ForEach(F func) const {
+        for (const Shard& shard : mShards) {
+            std::shared_lock<std::shared_mutex> lock(shard.mMutex);
+
+            for (const auto& [key, value] : shard.mMap) {
+                func(key, value);
+            }
+        }
+    }
+
+    void Clear() {
+        for (Shard& shard : mShards) {
+            std::unique_lock<std::shared_mutex> lock(shard.mMutex);
+            shard.mMap.clear();
+        }
+    }
+
+    uint64_t Size() const {
+        uint64_t size = 0;
+
+        for (const Shard& shard : mShards) {
+            std::shared_lock<std::shared_mutex> lock(shard.mMutex);
+            size += shard.mMap.size();
+        }
+
+        return size;
+    }
+
+private:
+    // Each shard on it's own cache line to avoid false sharing between the locks
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mMutex;
+        std::unordered_map<K, V, Hash> mMap;
+    };
+
+    inline uint32_t GetShardIndex(const K& key) const {
+        // Fibonacci hashing so keys that are already hashes or sequential ids spread evenly
+        uint64_t hash = (uint64_t)Hash()(key) * 0x9E3779B97F4A7C15ULL;
+        return (uint32_t)(hash >> 32) & (ShardCount - 1);
+    }
+
+    inline Shard& GetShard(const K& key) { return mShards[GetShardIndex(key)]; }
+    inline const Shard& GetShard(const K& key) const { return mShards[GetShardIndex(key)]; }
+
+    Shard mShards[ShardCount];
+};
+
+}
@@ -0,0 +1,63 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include <filesystem>
+
+namespace Guacamole {
+
+// Read only memory mapping of a whole file
+class FileView {
+public:
+    FileView();
+    ~FileView();
+
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+
+    // populate faults in the whole file up front, for files that are about to be read in full
+    bool Open(const std::filesystem::path& path, bool populate = false);
+    void Close();
+
+    // Hints the OS to start reading part of the view in the background
+    void Prefetch(const uint8_t* data, uint64_t size) const;
+
+    inline const uint8_t* GetData() const { return mData; }
+    inline uint64_t GetSize() const { return mSize; }
+    inline bool IsOpen() const { return mData != nullptr; }
+
+private:
+    uint8_t* mData;
+    uint64_t mSize;
+
+#if defined(GM_WINDOWS)
+    void* mFileHandle;
+    void* mMappingHandle;
+#endif
+};
+
+}
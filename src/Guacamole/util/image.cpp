@@ -0,0 +1,175 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "image.h"
+
+namespace Guacamole { namespace Util {
+
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t size = std::max(width, height);
+    uint32_t levels = 1;
+
+    while (size > 1) {
+        size >>= 1;
+        levels++;
+    }
+
+    return levels;
+}
+
+uint64_t GetMipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t texelSize) {
+    uint64_t size = 0;
+
+    for (uint32_t i = 0; i < mipLevels; i++) {
+        size += (uint64_t)GetMipDimension(width, i) * GetMipDimension(height, i) * texelSize;
+    }
+
+    return size;
+}
+
+// Vertical sums of 16 source bytes as words, lo holds the first 8 bytes and hi the last 8
+static inline void SumRows(const uint8_t* row0, const uint8_t* row1, __m128i* lo, __m128i* hi) {
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i a = _mm_loadu_si128((const __m128i*)row0);
+    __m128i b = _mm_loadu_si128((const __m128i*)row1);
+
+    *lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+    *hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+}
+
+// 16 source bytes per row make 8 output bytes
+static inline void DownsampleBlock(const uint8_t* row0, const uint8_t* row1, uint32_t texelSize, uint8_t* out) {
+    const __m128i round = _mm_set1_epi16(2);
+
+    __m128i lo;
+    __m128i hi;
+    __m128i sum;
+
+    SumRows(row0, row1, &lo, &hi);
+
+    // Add the horizontal neighbours, then gather the sums of every 2x2 block into 8 words
+    switch (texelSize) {
+        case 1: {
+            const __m128i mask = _mm_set1_epi32(0xFFFF);
+
+            lo = _mm_and_si128(_mm_add_epi16(lo, _mm_srli_epi32(lo, 16)), mask);
+            hi = _mm_and_si128(_mm_add_epi16(hi, _mm_srli_epi32(hi, 16)), mask);
+            sum = _mm_packs_epi32(lo, hi);
+            break;
+        }
+        case 2:
+            lo = _mm_shuffle_epi32(_mm_add_epi16(lo, _mm_srli_epi64(lo, 32)), _MM_SHUFFLE(2, 0, 2, 0));
+            hi = _mm_shuffle_epi32(_mm_add_epi16(hi, _mm_srli_epi64(hi, 32)), _MM_SHUFFLE(2, 0, 2, 0));
+            sum = _mm_unpacklo_epi64(lo, hi);
+            break;
+        default:
+            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+            sum = _mm_unpacklo_epi64(lo, hi);
+            break;
+    }
+
+    sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+    _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(sum, sum));
+}
+
+void DownsampleImage(const uint8_t* src, uint32_t width, uint32_t height, uint32_t texelSize, uint8_t* dst) {
+    GM_ASSERT(texelSize == 1 || texelSize == 2 || texelSize == 4);
+
+    uint32_t dstWidth = GetMipDimension(width, 1);
+    uint32_t dstHeight = GetMipDimension(height, 1);
+    uint64_t srcPitch = (uint64_t)width * texelSize;
+    // Both source columns are available unless the image is 1 texel wide
+    uint32_t columnStep = width > 1 ? texelSize : 0;
+    uint32_t blockTexels = 8 / texelSize;
+
+    for (uint32_t y = 0; y < dstHeight; y++) {
+        const uint8_t* row0 = src + (uint64_t)y * 2 * srcPitch;
+        const uint8_t* row1 = height > 1 ? row0 + srcPitch : row0;
+        uint8_t* out = dst + (uint64_t)y * dstWidth * texelSize;
+        uint32_t x = 0;
+
+        // 16 source bytes per row at a time
+        if (columnStep) {
+            for (; x + blockTexels <= dstWidth; x += blockTexels) {
+                DownsampleBlock(row0 + x * 2 * texelSize, row1 + x * 2 * texelSize, texelSize, out + x * texelSize);
+            }
+        }
+
+        for (; x < dstWidth; x++) {
+            const uint8_t* a = row0 + x * 2 * texelSize;
+            const uint8_t* b = row1 + x * 2 * texelSize;
+
+            for (uint32_t c = 0; c < texelSize; c++) {
+                out[x * texelSize + c] = (uint8_t)((a[c] + a[c + columnStep] + b[c] + b[c + columnStep] + 2) >> 2);
+            }
+        }
+    }
+}
+
+void GenerateMipChain(uint8_t* chain, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t texelSize) {
+    uint8_t* src = chain;
+
+    for (uint32_t i = 1; i < mipLevels; i++) {
+        uint32_t srcWidth = GetMipDimension(width, i - 1);
+        uint32_t srcHeight = GetMipDimension(height, i - 1);
+        uint8_t* dst = src + (uint64_t)srcWidth * srcHeight * texelSize;
+
+        DownsampleImage(src, srcWidth, srcHeight, texelSize, dst);
+
+        src = dst;
+    }
+}
+
+void ExpandRGBToRGBA(const uint8_t* src, uint8_t* dst, uint64_t count) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(0xFF000000);
+
+    uint64_t i = 0;
+
+    // 4 texels per iteration. The load reads 4 bytes past the 12 it uses, the last texels are left for the scalar loop.
+    // In place the store never reaches the source bytes the next iteration loads, it ends at 4 * i + 16 <= count + 3 * i + 12
+    for (; i + 6 <= count; i += 4) {
+        __m128i rgb = _mm_loadu_si128((const __m128i*)(src + i * 3));
+
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+    }
+
+    for (; i < count; i++) {
+        uint8_t r = src[i * 3 + 0];
+        uint8_t g = src[i * 3 + 1];
+        uint8_t b = src[i * 3 + 2];
+
+        dst[i * 4 + 0] = r;
+        dst[i * 4 + 1] = g;
+        dst[i * 4 + 2] = b;
+        dst[i * 4 + 3] = 255;
+    }
+}
+
+}
+}
@@ -0,0 +1,47 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+namespace Guacamole { namespace Util {
+
+// Number of levels in a full mip chain, down to 1x1
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+inline uint32_t GetMipDimension(uint32_t size, uint32_t mip) { return std::max(size >> mip, 1u); }
+// Size in bytes of the levels [0, mipLevels) stored back to back
+uint64_t GetMipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t texelSize);
+
+// 2x2 box filter over 1, 2 or 4 byte texels, dst is GetMipDimension(width, 1) x GetMipDimension(height, 1).
+// The last row/column of odd sized images is dropped, 1 texel wide images reuse the same texel
+void DownsampleImage(const uint8_t* src, uint32_t width, uint32_t height, uint32_t texelSize, uint8_t* dst);
+// Level 0 must already be at the start of chain, fills in the rest of the levels after it
+void GenerateMipChain(uint8_t* chain, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t texelSize);
+
+// Appends an opaque alpha to every texel. Can expand in place if src is at dst + count, the back quarter of dst
+void ExpandRGBToRGBA(const uint8_t* src, uint8_t* dst, uint64_t count);
+
+}
+}
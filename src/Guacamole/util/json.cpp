@@ -0,0 +1,245 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "json.h"
+
+namespace Guacamole { namespace Util {
+
+const JsonValue JsonValue::sNull;
+
+const JsonValue& JsonValue::operator[](std::string_view key) const {
+    for (uint64_t i = 0; i < mKeys.size(); i++) {
+        if (mKeys[i] == key) return mChildren[i];
+    }
+
+    return sNull;
+}
+
+class JsonParser {
+public:
+    JsonParser(const char* text, uint64_t size, std::deque<std::string>* strings)
+        : mCurrent(text), mEnd(text + size), mStrings(strings) {}
+
+    bool ParseValue(JsonValue* value, uint32_t depth) {
+        if (depth > MaxDepth) return false;
+
+        SkipWhitespace();
+
+        if (mCurrent == mEnd) return false;
+
+        switch (*mCurrent) {
+            case '{':
+                return ParseObject(value, depth);
+            case '[':
+                return ParseArray(value, depth);
+            case '"':
+                value->mType = JsonValue::Type::String;
+                return ParseString(&value->mString);
+            case 't':
+                value->mType = JsonValue::Type::Bool;
+                value->mNumber = 1.0;
+                return Expect("true");
+            case 'f':
+                value->mType = JsonValue::Type::Bool;
+                return Expect("false");
+            case 'n':
+                return Expect("null");
+            default:
+                value->mType = JsonValue::Type::Number;
+                return ParseNumber(&value->mNumber);
+        }
+    }
+
+    bool IsAtEnd() {
+        SkipWhitespace();
+
+        return mCurrent == mEnd;
+    }
+
+private:
+    static constexpr uint32_t MaxDepth = 256;
+
+    void SkipWhitespace() {
+        while (mCurrent < mEnd && (*mCurrent == ' ' || *mCurrent == '\t' || *mCurrent == '\n' || *mCurrent == '\r')) mCurrent++;
+    }
+
+    bool Consume(char c) {
+        SkipWhitespace();
+
+        if (mCurrent == mEnd || *mCurrent != c) return false;
+
+        mCurrent++;
+
+        return true;
+    }
+
+    bool Expect(const char* literal) {
+        uint64_t length = strlen(literal);
+
+        if ((uint64_t)(mEnd - mCurrent) < length || memcmp(mCurrent, literal, length) != 0) return false;
+
+        mCurrent += length;
+
+        return true;
+    }
+
+    bool ParseObject(JsonValue* value, uint32_t depth) {
+        value->mType = JsonValue::Type::Object;
+        mCurrent++;
+
+        if (Consume('}')) return true;
+
+        do {
+            std::string_view key;
+
+            SkipWhitespace();
+
+            if (mCurrent == mEnd || *mCurrent != '"' || !ParseString(&key) || !Consume(':')) return false;
+
+            value->mKeys.push_back(key);
+            value->mChildren.emplace_back();
+
+            if (!ParseValue(&value->mChildren.back(), depth + 1)) return false;
+        } while (Consume(','));
+
+        return Consume('}');
+    }
+
+    bool ParseArray(JsonValue* value, uint32_t depth) {
+        value->mType = JsonValue::Type::Array;
+        mCurrent++;
+
+        if (Consume(']')) return true;
+
+        do {
+            value->mChildren.emplace_back();
+
+            if (!ParseValue(&value->mChildren.back(), depth + 1)) return false;
+        } while (Consume(','));
+
+        return Consume(']');
+    }
+
+    bool ParseString(std::string_view* str) {
+        const char* start = ++mCurrent;
+        bool escaped = false;
+
+        while (mCurrent < mEnd && *mCurrent != '"') {
+            if (*mCurrent == '\\') {
+                escaped = true;
+                mCurrent++;
+            }
+
+            mCurrent++;
+        }
+
+        if (mCurrent >= mEnd) return false;
+
+        *str = std::string_view(start, mCurrent - start);
+        mCurrent++;
+
+        if (!escaped) return true;
+
+        std::string& unescaped = mStrings->emplace_back();
+
+        for (uint64_t i = 0; i < str->size(); i++) {
+            char c = (*str)[i];
+
+            if (c != '\\') {
+                unescaped += c;
+                continue;
+            }
+
+            switch (c = (*str)[++i]) {
+                case 'b': unescaped += '\b'; break;
+                case 'f': unescaped += '\f'; break;
+                case 'n': unescaped += '\n'; break;
+                case 'r': unescaped += '\r'; break;
+                case 't': unescaped += '\t'; break;
+                case 'u': {
+                    if (i + 4 >= str->size()) return false;
+
+                    uint32_t codepoint = (uint32_t)strtoul(std::string(str->substr(i + 1, 4)).c_str(), nullptr, 16);
+                    i += 4;
+
+                    // Surrogate pairs aren't combined, glTF names and URIs are practically never outside the BMP
+                    if (codepoint < 0x80) {
+                        unescaped += (char)codepoint;
+                    } else if (codepoint < 0x800) {
+                        unescaped += (char)(0xC0 | (codepoint >> 6));
+                        unescaped += (char)(0x80 | (codepoint & 0x3F));
+                    } else {
+                        unescaped += (char)(0xE0 | (codepoint >> 12));
+                        unescaped += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+                        unescaped += (char)(0x80 | (codepoint & 0x3F));
+                    }
+
+                    break;
+                }
+                default: unescaped += c; break;
+            }
+        }
+
+        *str = unescaped;
+
+        return true;
+    }
+
+    bool ParseNumber(double* number) {
+        // strtod needs a terminated string and the text isn't, numbers are short so copy them out
+        char buffer[64];
+        uint64_t length = 0;
+
+        while (mCurrent < mEnd && length < sizeof(buffer) - 1 && strchr("+-0123456789.eE", *mCurrent) && *mCurrent != '\0') {
+            buffer[length++] = *mCurrent++;
+        }
+
+        if (length == 0) return false;
+
+        buffer[length] = '\0';
+
+        char* end;
+        *number = strtod(buffer, &end);
+
+        return end == buffer + length;
+    }
+
+    const char* mCurrent;
+    const char* mEnd;
+    std::deque<std::string>* mStrings;
+};
+
+bool JsonValue::Parse(const char* text, uint64_t size, JsonValue* value) {
+    *value = JsonValue();
+    value->mStrings = std::make_shared<std::deque<std::string>>();
+
+    JsonParser parser(text, size, value->mStrings.get());
+
+    return parser.ParseValue(value, 0) && parser.IsAtEnd();
+}
+
+}
+}
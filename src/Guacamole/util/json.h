@@ -0,0 +1,83 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include <string_view>
+#include <deque>
+
+namespace Guacamole { namespace Util {
+
+// Minimal read only JSON DOM, enough for glTF. Strings point into the parsed text unless they had escapes
+class JsonValue {
+public:
+    enum class Type : uint8_t {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    JsonValue() : mType(Type::Null), mNumber(0.0) {}
+
+    inline Type GetType() const { return mType; }
+    inline bool IsNull() const { return mType == Type::Null; }
+    inline bool IsNumber() const { return mType == Type::Number; }
+    inline bool IsString() const { return mType == Type::String; }
+    inline bool IsArray() const { return mType == Type::Array; }
+    inline bool IsObject() const { return mType == Type::Object; }
+
+    inline double GetNumber(double fallback = 0.0) const { return mType == Type::Number ? mNumber : fallback; }
+    inline bool GetBool(bool fallback = false) const { return mType == Type::Bool ? mNumber != 0.0 : fallback; }
+    inline std::string_view GetString() const { return mType == Type::String ? mString : std::string_view(); }
+
+    // Array elements or object values
+    inline uint64_t GetSize() const { return mChildren.size(); }
+    inline const JsonValue& operator[](uint64_t index) const { return index < mChildren.size() ? mChildren[index] : sNull; }
+    // Returns a null value if the key doesn't exist or this isn't an object
+    const JsonValue& operator[](std::string_view key) const;
+
+    // Returns false on malformed input, the text must outlive the value
+    static bool Parse(const char* text, uint64_t size, JsonValue* value);
+
+private:
+    Type mType;
+    double mNumber;
+    std::string_view mString;
+    std::vector<JsonValue> mChildren;
+    std::vector<std::string_view> mKeys; // Parallel to mChildren for objects
+    // Owns unescaped strings, only the root's is used
+    std::shared_ptr<std::deque<std::string>> mStrings;
+
+    static const JsonValue sNull;
+
+    friend class JsonParser;
+};
+
+}
+}
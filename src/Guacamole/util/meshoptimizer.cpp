@@ -0,0 +1,528 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "meshoptimizer.h"
+
+#include <cfloat>
+
+namespace Guacamole { namespace Util {
+
+// A vertex is cached if fewer than cacheSize misses happened since it was loaded. Returns the triangle's misses
+static inline uint32_t UpdateCache(const uint32_t* triangle, uint32_t cacheSize, uint32_t* timestamps, uint32_t* time) {
+    uint32_t misses = 0;
+
+    for (uint32_t i = 0; i < 3; i++) {
+        uint32_t vertex = triangle[i];
+
+        if (*time - timestamps[vertex] > cacheSize) {
+            timestamps[vertex] = (*time)++;
+            misses++;
+        }
+    }
+
+    return misses;
+}
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, uint64_t indexCount, uint64_t vertexCount, uint32_t cacheSize) {
+    VertexCacheStats stats = {};
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<uint8_t> used(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    uint64_t misses = 0;
+    uint64_t usedCount = 0;
+
+    for (uint64_t i = 0; i + 2 < indexCount; i += 3) {
+        misses += UpdateCache(indices + i, cacheSize, timestamps.data(), &time);
+
+        for (uint32_t j = 0; j < 3; j++) {
+            usedCount += used[indices[i + j]] == 0;
+            used[indices[i + j]] = 1;
+        }
+    }
+
+    if (indexCount >= 3) stats.mACMR = (float)((double)misses / (indexCount / 3));
+    if (usedCount > 0) stats.mATVR = (float)((double)misses / usedCount);
+
+    return stats;
+}
+
+void OptimizeVertexCache(uint32_t* indices, uint64_t indexCount, uint64_t vertexCount, uint32_t cacheSize) {
+    uint64_t triangleCount = indexCount / 3;
+
+    if (triangleCount == 0) return;
+
+    // Triangles using each vertex, and how many of them are still to be emitted
+    std::vector<uint32_t> liveCounts(vertexCount, 0);
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+
+    for (uint64_t i = 0; i < triangleCount * 3; i++) {
+        liveCounts[indices[i]]++;
+    }
+
+    for (uint64_t i = 0; i < vertexCount; i++) {
+        offsets[i + 1] = offsets[i] + liveCounts[i];
+    }
+
+    std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+
+    for (uint64_t i = 0; i < triangleCount * 3; i++) {
+        adjacency[cursors[indices[i]]++] = (uint32_t)(i / 3);
+    }
+
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output(triangleCount * 3);
+    uint64_t written = 0;
+    uint32_t time = cacheSize + 1;
+    uint64_t nextVertex = 0;
+    int64_t fan = -1;
+
+    while (nextVertex < vertexCount && liveCounts[nextVertex] == 0) nextVertex++;
+
+    if (nextVertex < vertexCount) fan = (int64_t)nextVertex;
+
+    while (fan >= 0) {
+        candidates.clear();
+
+        // Emits every remaining triangle around the fan vertex
+        for (uint32_t i = offsets[fan]; i < offsets[fan + 1]; i++) {
+            uint32_t triangle = adjacency[i];
+
+            if (emitted[triangle]) continue;
+
+            for (uint32_t j = 0; j < 3; j++) {
+                uint32_t vertex = indices[triangle * 3 + j];
+
+                output[written++] = vertex;
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveCounts[vertex]--;
+
+                if (time - timestamps[vertex] > cacheSize) timestamps[vertex] = time++;
+            }
+
+            emitted[triangle] = 1;
+        }
+
+        // The next fan is the oldest neighbour that stays cached while its remaining triangles are emitted,
+        // or any neighbour that still has triangles
+        int64_t best = -1;
+        int64_t bestPriority = -1;
+
+        for (uint32_t vertex : candidates) {
+            if (liveCounts[vertex] == 0) continue;
+
+            int64_t priority = 0;
+            int64_t age = time - timestamps[vertex];
+
+            if (age + 2 * (int64_t)liveCounts[vertex] <= cacheSize) priority = age;
+
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = vertex;
+            }
+        }
+
+        // Dead end, back off to a recently used vertex and then to the next one in input order
+        while (best == -1 && !deadEnds.empty()) {
+            uint32_t vertex = deadEnds.back();
+            deadEnds.pop_back();
+
+            if (liveCounts[vertex] > 0) best = vertex;
+        }
+
+        while (best == -1 && nextVertex < vertexCount) {
+            if (liveCounts[nextVertex] > 0) best = (int64_t)nextVertex;
+            else nextVertex++;
+        }
+
+        fan = best;
+    }
+
+    GM_ASSERT(written == triangleCount * 3);
+
+    memcpy(indices, output.data(), written * sizeof(uint32_t));
+}
+
+void OptimizeOverdraw(uint32_t* indices, uint64_t indexCount, const float* positions, uint64_t vertexCount, float threshold, uint32_t cacheSize) {
+    uint64_t triangleCount = indexCount / 3;
+
+    if (triangleCount == 0) return;
+
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<uint32_t> hardBoundaries;
+    std::vector<uint32_t> clusters;
+    uint32_t time = cacheSize + 1;
+
+    // A triangle that misses on every vertex starts a new patch
+    for (uint64_t i = 0; i < triangleCount; i++) {
+        if (UpdateCache(indices + i * 3, cacheSize, timestamps.data(), &time) == 3 || i == 0) hardBoundaries.push_back((uint32_t)i);
+    }
+
+    // Patches are cut further wherever the triangles so far are already within threshold of the patch's
+    // ACMR, so the extra cache misses from reordering the pieces stay bounded
+    for (uint64_t i = 0; i < hardBoundaries.size(); i++) {
+        uint64_t start = hardBoundaries[i];
+        uint64_t end = i + 1 < hardBoundaries.size() ? hardBoundaries[i + 1] : triangleCount;
+        uint64_t misses = 0;
+
+        time += cacheSize + 1;
+
+        for (uint64_t j = start; j < end; j++) {
+            misses += UpdateCache(indices + j * 3, cacheSize, timestamps.data(), &time);
+        }
+
+        float target = threshold * (float)misses / (float)(end - start);
+        uint64_t runningMisses = 0;
+        uint64_t runningTriangles = 0;
+
+        clusters.push_back((uint32_t)start);
+        time += cacheSize + 1;
+
+        for (uint64_t j = start; j < end; j++) {
+            runningMisses += UpdateCache(indices + j * 3, cacheSize, timestamps.data(), &time);
+            runningTriangles++;
+
+            if ((float)runningMisses / (float)runningTriangles <= target) {
+                clusters.push_back((uint32_t)(j + 1));
+                time += cacheSize + 1;
+                runningMisses = 0;
+                runningTriangles = 0;
+            }
+        }
+
+        // The last cut either leaves an empty cluster or a tail that didn't reach the target, both go back into the previous cluster
+        if (clusters.back() != start) clusters.pop_back();
+    }
+
+    struct Cluster {
+        uint32_t mStart;
+        uint32_t mEnd;
+        float mSortKey;
+    };
+
+    std::vector<Cluster> sorted(clusters.size());
+    std::vector<float> centroids(clusters.size() * 3);
+    std::vector<float> normals(clusters.size() * 3);
+    double meshCentroid[3] = {};
+    double meshArea = 0.0;
+
+    for (uint64_t i = 0; i < clusters.size(); i++) {
+        Cluster& cluster = sorted[i];
+        float* centroid = &centroids[i * 3];
+        float* normal = &normals[i * 3];
+        float clusterArea = 0.0f;
+
+        cluster.mStart = clusters[i];
+        cluster.mEnd = i + 1 < clusters.size() ? clusters[i + 1] : (uint32_t)triangleCount;
+
+        for (uint32_t j = cluster.mStart; j < cluster.mEnd; j++) {
+            const float* p0 = positions + (uint64_t)indices[j * 3] * 3;
+            const float* p1 = positions + (uint64_t)indices[j * 3 + 1] * 3;
+            const float* p2 = positions + (uint64_t)indices[j * 3 + 2] * 3;
+            float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            // e1 x e0 faces out of clockwise triangles
+            float n[3] = { e1[1] * e0[2] - e1[2] * e0[1], e1[2] * e0[0] - e1[0] * e0[2], e1[0] * e0[1] - e1[1] * e0[0] };
+            float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (uint32_t k = 0; k < 3; k++) {
+                centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * area;
+                normal[k] += n[k];
+            }
+
+            clusterArea += area;
+        }
+
+        for (uint32_t k = 0; k < 3; k++) {
+            meshCentroid[k] += centroid[k];
+            centroid[k] /= std::max(clusterArea, FLT_MIN);
+        }
+
+        meshArea += clusterArea;
+    }
+
+    for (uint32_t k = 0; k < 3; k++) {
+        meshCentroid[k] /= std::max(meshArea, (double)FLT_MIN);
+    }
+
+    // Clusters facing away from the center are on the outside, drawn first they occlude the inner ones
+    for (uint64_t i = 0; i < sorted.size(); i++) {
+        const float* centroid = &centroids[i * 3];
+        const float* normal = &normals[i * 3];
+        float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float key = 0.0f;
+
+        for (uint32_t k = 0; k < 3; k++) {
+            key += (centroid[k] - (float)meshCentroid[k]) * normal[k];
+        }
+
+        sorted[i].mSortKey = length > 0.0f ? key / length : 0.0f;
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.mSortKey > b.mSortKey; });
+
+    std::vector<uint32_t> output(triangleCount * 3);
+    uint32_t* out = output.data();
+
+    for (const Cluster& cluster : sorted) {
+        uint64_t count = (uint64_t)(cluster.mEnd - cluster.mStart) * 3;
+
+        memcpy(out, indices + (uint64_t)cluster.mStart * 3, count * sizeof(uint32_t));
+        out += count;
+    }
+
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+uint64_t OptimizeVertexFetch(uint32_t* indices, uint64_t indexCount, uint64_t vertexCount, uint32_t* remap) {
+    uint32_t next = 0;
+
+    for (uint64_t i = 0; i < vertexCount; i++) {
+        remap[i] = UINT32_MAX;
+    }
+
+    for (uint64_t i = 0; i < indexCount; i++) {
+        uint32_t& vertex = remap[indices[i]];
+
+        if (vertex == UINT32_MAX) vertex = next++;
+
+        indices[i] = vertex;
+    }
+
+    return next;
+}
+
+void BuildMeshlets(uint32_t* indices, uint64_t indexCount, const float* positions, uint64_t vertexCount, std::vector<Meshlet>* meshlets, uint32_t maxVertices, uint32_t maxTriangles) {
+    GM_ASSERT(maxVertices >= 3 && maxTriangles > 0);
+
+    uint64_t triangleCount = indexCount / 3;
+
+    // Triangles using each vertex
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+
+    for (uint64_t i = 0; i < triangleCount * 3; i++) {
+        offsets[indices[i] + 1]++;
+    }
+
+    for (uint64_t i = 0; i < vertexCount; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+
+    for (uint64_t i = 0; i < triangleCount * 3; i++) {
+        adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+    }
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    // Meshlet the vertex was last added to
+    std::vector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX);
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    // Unit normals of the current meshlet's non degenerate triangles
+    std::vector<float> normals;
+    // The current meshlet's vertices
+    std::vector<uint32_t> local;
+    uint64_t seed = 0;
+    uint32_t id = 0;
+
+    output.reserve(triangleCount * 3);
+
+    while (output.size() < triangleCount * 3) {
+        uint64_t first = output.size();
+        uint32_t vertices = 0;
+        uint32_t triangles = 0;
+
+        candidates.clear();
+
+        while (triangles < maxTriangles) {
+            uint64_t best = UINT64_MAX;
+            uint32_t bestAdded = 4;
+            uint64_t kept = 0;
+
+            // Drops the emitted candidates while looking for the one adding the fewest vertices
+            for (uint64_t i = 0; i < candidates.size(); i++) {
+                uint32_t triangle = candidates[i];
+
+                if (emitted[triangle]) continue;
+
+                const uint32_t* corners = indices + (uint64_t)triangle * 3;
+                uint32_t added = (vertexMeshlet[corners[0]] != id) + 
+                                 (vertexMeshlet[corners[1]] != id && corners[1] != corners[0]) + 
+                                 (vertexMeshlet[corners[2]] != id && corners[2] != corners[0] && corners[2] != corners[1]);
+
+                if (added < bestAdded) {
+                    best = kept;
+                    bestAdded = added;
+                }
+
+                candidates[kept++] = triangle;
+            }
+
+            candidates.resize(kept);
+
+            // The connected triangles ran out, carries on with the next one in order which is usually close by
+            if (best == UINT64_MAX) {
+                while (seed < triangleCount && emitted[seed]) seed++;
+
+                if (seed == triangleCount) break;
+
+                best = candidates.size();
+                bestAdded = 3;
+                candidates.push_back((uint32_t)seed);
+            }
+
+            if (vertices + bestAdded > maxVertices) break;
+
+            uint32_t triangle = candidates[best];
+            const uint32_t* corners = indices + (uint64_t)triangle * 3;
+
+            emitted[triangle] = 1;
+            triangles++;
+
+            for (uint32_t j = 0; j < 3; j++) {
+                uint32_t vertex = corners[j];
+
+                output.push_back(vertex);
+
+                if (vertexMeshlet[vertex] == id) continue;
+
+                vertexMeshlet[vertex] = id;
+                vertices++;
+
+                for (uint32_t k = offsets[vertex]; k < offsets[vertex + 1]; k++) {
+                    if (!emitted[adjacency[k]]) candidates.push_back(adjacency[k]);
+                }
+            }
+        }
+
+        // Growing by fewest new vertices loses the cache order, it's restored within the meshlet on local indices
+        uint32_t* meshletIndices = output.data() + first;
+        uint64_t meshletIndexCount = output.size() - first;
+
+        local.clear();
+
+        for (uint64_t i = 0; i < meshletIndexCount; i++) {
+            uint32_t& vertex = meshletIndices[i];
+            uint32_t index = (uint32_t)(std::find(local.begin(), local.end(), vertex) - local.begin());
+
+            if (index == local.size()) local.push_back(vertex);
+
+            vertex = index;
+        }
+
+        OptimizeVertexCache(meshletIndices, meshletIndexCount, local.size());
+
+        for (uint64_t i = 0; i < meshletIndexCount; i++) {
+            meshletIndices[i] = local[meshletIndices[i]];
+        }
+
+        Meshlet meshlet;
+        float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        float axis[3] = {};
+
+        meshlet.mFirstIndex = (uint32_t)first;
+        meshlet.mIndexCount = (uint32_t)(output.size() - first);
+
+        for (uint64_t i = first; i < output.size(); i++) {
+            const float* p = positions + (uint64_t)output[i] * 3;
+
+            for (uint32_t k = 0; k < 3; k++) {
+                min[k] = std::min(min[k], p[k]);
+                max[k] = std::max(max[k], p[k]);
+            }
+        }
+
+        for (uint32_t k = 0; k < 3; k++) {
+            meshlet.mCenter[k] = (min[k] + max[k]) * 0.5f;
+        }
+
+        float radiusSq = 0.0f;
+
+        normals.clear();
+
+        for (uint64_t i = first; i < output.size(); i += 3) {
+            const float* p0 = positions + (uint64_t)output[i] * 3;
+            const float* p1 = positions + (uint64_t)output[i + 1] * 3;
+            const float* p2 = positions + (uint64_t)output[i + 2] * 3;
+            float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e0[2] - e1[2] * e0[1], e1[2] * e0[0] - e1[0] * e0[2], e1[0] * e0[1] - e1[1] * e0[0] };
+            float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (const float* p : { p0, p1, p2 }) {
+                float d[3] = { p[0] - meshlet.mCenter[0], p[1] - meshlet.mCenter[1], p[2] - meshlet.mCenter[2] };
+
+                radiusSq = std::max(radiusSq, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            }
+
+            if (length <= 0.0f) continue;
+
+            for (uint32_t k = 0; k < 3; k++) {
+                normals.push_back(n[k] / length);
+                axis[k] += n[k] / length;
+            }
+        }
+
+        meshlet.mRadius = sqrtf(radiusSq);
+
+        float axisLength = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        float minDot = axisLength > 0.0f ? 1.0f : -1.0f;
+
+        for (uint32_t k = 0; k < 3; k++) {
+            meshlet.mConeAxis[k] = axisLength > 0.0f ? axis[k] / axisLength : 0.0f;
+        }
+
+        for (uint64_t i = 0; i < normals.size(); i += 3) {
+            minDot = std::min(minDot, normals[i] * meshlet.mConeAxis[0] + normals[i + 1] * meshlet.mConeAxis[1] + normals[i + 2] * meshlet.mConeAxis[2]);
+        }
+
+        // A cone of 90 degrees or more always has a triangle facing the camera
+        meshlet.mConeCutoff = minDot > 0.0f ? sqrtf(1.0f - minDot * minDot) : 1.0f;
+
+        meshlets->push_back(meshlet);
+        id++;
+    }
+
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+bool IsMeshletBackFacing(const Meshlet& meshlet, const float* camera) {
+    float d[3] = { meshlet.mCenter[0] - camera[0], meshlet.mCenter[1] - camera[1], meshlet.mCenter[2] - camera[2] };
+    float distance = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+
+    // Every point in the sphere sees the cone's normals from behind, at least 90 degrees minus the cone's half angle off the axis
+    return d[0] * meshlet.mConeAxis[0] + d[1] * meshlet.mConeAxis[1] + d[2] * meshlet.mConeAxis[2] - meshlet.mRadius > meshlet.mConeCutoff * (distance + meshlet.mRadius);
+}
+
+}
+}
@@ -0,0 +1,73 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+namespace Guacamole { namespace Util {
+
+// Simulated FIFO post-transform cache, the model the optimizations below target
+struct VertexCacheStats {
+    float mACMR; // Average cache miss ratio, vertex shader invocations per triangle. 0.5 is ideal for large regular meshes
+    float mATVR; // Average transformed vertex ratio, invocations per used vertex. 1.0 is ideal
+};
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, uint64_t indexCount, uint64_t vertexCount, uint32_t cacheSize = 16);
+
+// Tipsify (Sander et al. 2007), reorders triangles so their vertices are reused while they're still in the cache.
+// Every triangle keeps its corner order so the winding doesn't change
+void OptimizeVertexCache(uint32_t* indices, uint64_t indexCount, uint64_t vertexCount, uint32_t cacheSize = 16);
+
+// Run after OptimizeVertexCache. Splits the triangles into clusters at cache restarts and wherever a cluster is
+// within threshold of the cache efficiency of its surroundings, then sorts the clusters so the ones facing away from the
+// center draw first and occlude the rest. Front faces are clockwise like the rest of the engine, positions are tightly packed xyz
+void OptimizeOverdraw(uint32_t* indices, uint64_t indexCount, const float* positions, uint64_t vertexCount, float threshold = 1.05f, uint32_t cacheSize = 16);
+
+// A contiguous range of triangles with the bounds to cull it as a whole
+struct Meshlet {
+    uint32_t mFirstIndex;
+    uint32_t mIndexCount;
+    float mCenter[3];
+    float mRadius;
+    // Every triangle's normal is within the cone around mConeAxis. mConeCutoff is the sine of its half angle, 1 if the
+    // triangles face too many ways to ever be back facing together
+    float mConeAxis[3];
+    float mConeCutoff;
+};
+
+// Run after OptimizeOverdraw. Groups the triangles into meshlets of at most maxVertices vertices and maxTriangles triangles,
+// each grown over neighbouring triangles from the first one left in the current order, and reorders the indices so
+// every meshlet is contiguous. Appends to meshlets, front faces are clockwise and positions are tightly packed xyz
+void BuildMeshlets(uint32_t* indices, uint64_t indexCount, const float* positions, uint64_t vertexCount, std::vector<Meshlet>* meshlets, uint32_t maxVertices = 64, uint32_t maxTriangles = 124);
+
+// True if every triangle in the meshlet is back facing from camera, all in the same space as the meshlet's bounds
+bool IsMeshletBackFacing(const Meshlet& meshlet, const float* camera);
+
+// Renumbers the vertices in the order the indices first use them so vertex fetches walk the buffer forward, unused
+// vertices are dropped. Rewrites the indices, remap[old] = new or UINT32_MAX if unused. Returns the new vertex count
+uint64_t OptimizeVertexFetch(uint32_t* indices, uint64_t indexCount, uint64_t vertexCount, uint32_t* remap);
+
+}
+}
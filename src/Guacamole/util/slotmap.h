@@ -0,0 +1,201 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include <atomic>
+#include <mutex>
+
+namespace Guacamole {
+
+// Generational slot map storing pointers. Slots live in fixed size pages that never move
+// so Get is lock free, a couple of atomic loads and a generation compare. Insert and Remove
+// are serialized by a mutex. Removed slots get their generation bumped so old keys go stale.
+// Key must be constructible from (uint32_t index, uint32_t generation) and expose mIndex and mGeneration,
+// generation 0 is reserved for null keys.
+template<typename Key, typename T>
+class SlotMap {
+public:
+    static constexpr uint32_t PageShift = 10;
+    static constexpr uint32_t PageSize = 1 << PageShift;
+    static constexpr uint32_t MaxPages = 4096; // 4M slots
+
+    SlotMap() : mFreeHead(~0u), mSlotCount(0), mSize(0) {
+        for (uint32_t i = 0; i < MaxPages; i++) {
+            mPages[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~SlotMap() {
+        for (uint32_t i = 0; i < MaxPages; i++) {
+            delete[] mPages[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    Key Insert(T* value) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        uint32_t index;
+
+        if (mFreeHead != ~0u) {
+            index = mFreeHead;
+            mFreeHead = GetSlot(index).mNextFree;
+        } else {
+            index = mSlotCount++;
+
+            uint32_t page = index >> PageShift;
+
+            GM_VERIFY_MSG(page < MaxPages, "SlotMap full");
+
+            if (mPages[page].load(std::memory_order_relaxed) == nullptr) {
+                Slot* slots = new Slot[PageSize];
+
+                for (uint32_t i = 0; i < PageSize; i++) {
+                    slots[i].mGeneration.store(1, std::memory_order_relaxed);
+                    slots[i].mValue.store(nullptr, std::memory_order_relaxed);
+                    slots[i].mNextFree = ~0u;
+                }
+
+                mPages[page].store(slots, std::memory_order_release);
+            }
+        }
+
+        Slot& slot = GetSlot(index);
+        slot.mValue.store(value, std::memory_order_release);
+
+        mSize++;
+
+        return Key(index, slot.mGeneration.load(std::memory_order_relaxed));
+    }
+
+    // Returns false if the key is stale
+    bool Remove(const Key& key) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        Slot* slot = FindSlot(key);
+
+        if (slot == nullptr) return false;
+
+        uint32_t generation = key.mGeneration + 1;
+
+        slot->mValue.store(nullptr, std::memory_order_release);
+        slot->mGeneration.store(generation == 0 ? 1 : generation, std::memory_order_release);
+        slot->mNextFree = mFreeHead;
+        mFreeHead = key.mIndex;
+
+        mSize--;
+
+        return true;
+    }
+
+    // Replaces the value of a live slot, returns the previous value or nullptr if the key is stale
+    T* Replace(const Key& key, T* value) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        Slot* slot = FindSlot(key);
+
+        if (slot == nullptr) return nullptr;
+
+        return slot->mValue.exchange(value, std::memory_order_acq_rel);
+    }
+
+    // Lock free, returns nullptr if the key is null or stale
+    inline T* Get(const Key& key) const {
+        const Slot* slot = FindSlot(key);
+
+        if (slot == nullptr) return nullptr;
+
+        return slot->mValue.load(std::memory_order_acquire);
+    }
+
+    // func(const Key&, T*), must not insert or remove
+    template<typename F>
+    void ForEach(F func) const {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        for (uint32_t i = 0; i < mSlotCount; i++) {
+            const Slot& slot = GetSlot(i);
+            T* value = slot.mValue.load(std::memory_order_acquire);
+
+            if (value) func(Key(i, slot.mGeneration.load(std::memory_order_relaxed)), value);
+        }
+    }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        for (uint32_t i = 0; i < mSlotCount; i++) {
+            Slot& slot = GetSlot(i);
+
+            if (slot.mValue.load(std::memory_order_relaxed) == nullptr) continue;
+
+            uint32_t generation = slot.mGeneration.load(std::memory_order_relaxed) + 1;
+
+            slot.mValue.store(nullptr, std::memory_order_release);
+            slot.mGeneration.store(generation == 0 ? 1 : generation, std::memory_order_release);
+            slot.mNextFree = mFreeHead;
+            mFreeHead = i;
+        }
+
+        mSize = 0;
+    }
+
+    inline uint32_t Size() const { return mSize; }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> mGeneration;
+        std::atomic<T*> mValue;
+        uint32_t mNextFree; // Guarded by mMutex
+    };
+
+    inline Slot& GetSlot(uint32_t index) const {
+        return mPages[index >> PageShift].load(std::memory_order_acquire)[index & (PageSize - 1)];
+    }
+
+    inline Slot* FindSlot(const Key& key) const {
+        if (key.mGeneration == 0 || (key.mIndex >> PageShift) >= MaxPages) return nullptr;
+
+        Slot* page = mPages[key.mIndex >> PageShift].load(std::memory_order_acquire);
+
+        if (page == nullptr) return nullptr;
+
+        Slot* slot = &page[key.mIndex & (PageSize - 1)];
+
+        if (slot->mGeneration.load(std::memory_order_acquire) != key.mGeneration) return nullptr;
+
+        return slot;
+    }
+
+    std::atomic<Slot*> mPages[MaxPages];
+
+    mutable std::mutex mMutex;
+    uint32_t mFreeHead;
+    uint32_t mSlotCount;
+    std::atomic<uint32_t> mSize;
+};
+
+}
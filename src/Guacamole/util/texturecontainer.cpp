@@ -0,0 +1,347 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "texturecontainer.h"
+#include "image.h"
+
+#include <Guacamole/vulkan/util.h>
+
+namespace Guacamole { namespace Util {
+
+static const uint8_t sDDSMagic[4] = { 'D', 'D', 'S', ' ' };
+static const uint8_t sKTX2Magic[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+#define GM_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+enum {
+    DDSFlag_MipMapCount = 0x20000,
+    DDSFlag_Depth = 0x800000,
+    DDSPixelFlag_AlphaPixels = 0x1,
+    DDSPixelFlag_FourCC = 0x4,
+    DDSPixelFlag_RGB = 0x40,
+    DDSPixelFlag_Luminance = 0x20000,
+    DDSCaps2_CubeMap = 0x200,
+    DDSMisc_TextureCube = 0x4,
+    DDSDimension_Texture2D = 3
+};
+
+struct DDSPixelFormat {
+    uint32_t mSize;
+    uint32_t mFlags;
+    uint32_t mFourCC;
+    uint32_t mRGBBitCount;
+    uint32_t mRBitMask;
+    uint32_t mGBitMask;
+    uint32_t mBBitMask;
+    uint32_t mABitMask;
+};
+
+struct DDSHeader {
+    uint32_t mSize;
+    uint32_t mFlags;
+    uint32_t mHeight;
+    uint32_t mWidth;
+    uint32_t mPitchOrLinearSize;
+    uint32_t mDepth;
+    uint32_t mMipMapCount;
+    uint32_t mReserved1[11];
+    DDSPixelFormat mPixelFormat;
+    uint32_t mCaps;
+    uint32_t mCaps2;
+    uint32_t mCaps3;
+    uint32_t mCaps4;
+    uint32_t mReserved2;
+};
+
+struct DDSHeaderDX10 {
+    uint32_t mDXGIFormat;
+    uint32_t mResourceDimension;
+    uint32_t mMiscFlag;
+    uint32_t mArraySize;
+    uint32_t mMiscFlags2;
+};
+
+struct KTX2Header {
+    uint8_t mIdentifier[12];
+    uint32_t mVkFormat;
+    uint32_t mTypeSize;
+    uint32_t mPixelWidth;
+    uint32_t mPixelHeight;
+    uint32_t mPixelDepth;
+    uint32_t mLayerCount;
+    uint32_t mFaceCount;
+    uint32_t mLevelCount;
+    uint32_t mSupercompressionScheme;
+    uint32_t mDFDByteOffset;
+    uint32_t mDFDByteLength;
+    uint32_t mKVDByteOffset;
+    uint32_t mKVDByteLength;
+    uint64_t mSGDByteOffset;
+    uint64_t mSGDByteLength;
+};
+
+struct KTX2Level {
+    uint64_t mByteOffset;
+    uint64_t mByteLength;
+    uint64_t mUncompressedByteLength;
+};
+
+static_assert(sizeof(DDSHeader) == 124, "DDSHeader must match the file layout");
+static_assert(sizeof(KTX2Header) == 80, "KTX2Header must match the file layout");
+
+// Formats that can be uploaded without conversion
+static bool IsSupportedFormat(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8_UNORM:
+        case VK_FORMAT_R8G8_UNORM:
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            return true;
+        default:
+            return IsBlockCompressedFormat(format);
+    }
+}
+
+static VkFormat DXGIToVkFormat(uint32_t format) {
+    switch (format) {
+        case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+        case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+        case 49: return VK_FORMAT_R8G8_UNORM;
+        case 61: return VK_FORMAT_R8_UNORM;
+        case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+        case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+        case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+        case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+        case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+        case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+        case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+        case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+        case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+        case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+        case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+        case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+        case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+        case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+// Pre DX10 files describe the format with a FourCC or bit masks
+static VkFormat DDSPixelFormatToVkFormat(const DDSPixelFormat& format, VkComponentMapping* swizzle) {
+    if (format.mFlags & DDSPixelFlag_FourCC) {
+        switch (format.mFourCC) {
+            case GM_FOURCC('D', 'X', 'T', '1'): return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            case GM_FOURCC('D', 'X', 'T', '2'):
+            case GM_FOURCC('D', 'X', 'T', '3'): return VK_FORMAT_BC2_UNORM_BLOCK;
+            case GM_FOURCC('D', 'X', 'T', '4'):
+            case GM_FOURCC('D', 'X', 'T', '5'): return VK_FORMAT_BC3_UNORM_BLOCK;
+            case GM_FOURCC('A', 'T', 'I', '1'):
+            case GM_FOURCC('B', 'C', '4', 'U'): return VK_FORMAT_BC4_UNORM_BLOCK;
+            case GM_FOURCC('B', 'C', '4', 'S'): return VK_FORMAT_BC4_SNORM_BLOCK;
+            case GM_FOURCC('A', 'T', 'I', '2'):
+            case GM_FOURCC('B', 'C', '5', 'U'): return VK_FORMAT_BC5_UNORM_BLOCK;
+            case GM_FOURCC('B', 'C', '5', 'S'): return VK_FORMAT_BC5_SNORM_BLOCK;
+        }
+
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    if ((format.mFlags & DDSPixelFlag_RGB) && format.mRGBBitCount == 32) {
+        bool alpha = (format.mFlags & DDSPixelFlag_AlphaPixels) && format.mABitMask == 0xFF000000;
+
+        if (!alpha) swizzle->a = VK_COMPONENT_SWIZZLE_ONE;
+
+        if (format.mRBitMask == 0x000000FF && format.mGBitMask == 0x0000FF00 && format.mBBitMask == 0x00FF0000) return VK_FORMAT_R8G8B8A8_UNORM;
+        if (format.mRBitMask == 0x00FF0000 && format.mGBitMask == 0x0000FF00 && format.mBBitMask == 0x000000FF) return VK_FORMAT_B8G8R8A8_UNORM;
+    }
+
+    if ((format.mFlags & DDSPixelFlag_Luminance) && format.mRGBBitCount == 8) {
+        *swizzle = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+
+        return VK_FORMAT_R8_UNORM;
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+static bool ParseDDS(const uint8_t* data, uint64_t size, TextureContainer* container) {
+    if (size < sizeof(sDDSMagic) + sizeof(DDSHeader)) {
+        GM_LOG_CRITICAL("[TextureContainer] DDS file is truncated");
+        return false;
+    }
+
+    const DDSHeader* header = (const DDSHeader*)(data + sizeof(sDDSMagic));
+    uint64_t offset = sizeof(sDDSMagic) + sizeof(DDSHeader);
+
+    if (header->mSize != sizeof(DDSHeader) || header->mPixelFormat.mSize != sizeof(DDSPixelFormat)) {
+        GM_LOG_CRITICAL("[TextureContainer] DDS header is invalid");
+        return false;
+    }
+
+    if ((header->mCaps2 & DDSCaps2_CubeMap) || ((header->mFlags & DDSFlag_Depth) && header->mDepth > 1)) {
+        GM_LOG_CRITICAL("[TextureContainer] Only 2D DDS textures are supported");
+        return false;
+    }
+
+    container->mSwizzle = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+
+    if ((header->mPixelFormat.mFlags & DDSPixelFlag_FourCC) && header->mPixelFormat.mFourCC == GM_FOURCC('D', 'X', '1', '0')) {
+        if (size < offset + sizeof(DDSHeaderDX10)) {
+            GM_LOG_CRITICAL("[TextureContainer] DDS file is truncated");
+            return false;
+        }
+
+        const DDSHeaderDX10* dx10 = (const DDSHeaderDX10*)(data + offset);
+        offset += sizeof(DDSHeaderDX10);
+
+        if (dx10->mResourceDimension != DDSDimension_Texture2D || dx10->mArraySize > 1 || (dx10->mMiscFlag & DDSMisc_TextureCube)) {
+            GM_LOG_CRITICAL("[TextureContainer] Only 2D DDS textures are supported");
+            return false;
+        }
+
+        container->mFormat = DXGIToVkFormat(dx10->mDXGIFormat);
+    } else {
+        container->mFormat = DDSPixelFormatToVkFormat(header->mPixelFormat, &container->mSwizzle);
+    }
+
+    container->mWidth = header->mWidth;
+    container->mHeight = header->mHeight;
+    container->mMipLevels = (header->mFlags & DDSFlag_MipMapCount) ? std::max(header->mMipMapCount, 1u) : 1;
+
+    if (container->mFormat == VK_FORMAT_UNDEFINED) {
+        GM_LOG_CRITICAL("[TextureContainer] DDS pixel format isn't supported");
+        return false;
+    }
+
+    if (container->mWidth == 0 || container->mHeight == 0 || container->mMipLevels > TextureContainer::MaxLevels ||
+        container->mMipLevels > GetMipLevelCount(container->mWidth, container->mHeight)) {
+        GM_LOG_CRITICAL("[TextureContainer] DDS has an invalid size {}x{} with {} mips", container->mWidth, container->mHeight, container->mMipLevels);
+        return false;
+    }
+
+    // The levels are stored back to back, largest first
+    for (uint32_t mip = 0; mip < container->mMipLevels; mip++) {
+        uint64_t levelSize = GetImageSize(container->mFormat, GetMipDimension(container->mWidth, mip), GetMipDimension(container->mHeight, mip));
+
+        if (offset + levelSize > size) {
+            GM_LOG_CRITICAL("[TextureContainer] DDS file is truncated");
+            return false;
+        }
+
+        container->mLevels[mip] = data + offset;
+        container->mLevelSizes[mip] = levelSize;
+        offset += levelSize;
+    }
+
+    return true;
+}
+
+static bool ParseKTX2(const uint8_t* data, uint64_t size, TextureContainer* container) {
+    if (size < sizeof(KTX2Header)) {
+        GM_LOG_CRITICAL("[TextureContainer] KTX2 file is truncated");
+        return false;
+    }
+
+    const KTX2Header* header = (const KTX2Header*)data;
+
+    if (header->mSupercompressionScheme != 0) {
+        GM_LOG_CRITICAL("[TextureContainer] Supercompressed KTX2 files aren't supported");
+        return false;
+    }
+
+    if (header->mPixelHeight == 0 || header->mPixelDepth > 1 || header->mLayerCount > 1 || header->mFaceCount != 1) {
+        GM_LOG_CRITICAL("[TextureContainer] Only 2D KTX2 textures are supported");
+        return false;
+    }
+
+    container->mFormat = (VkFormat)header->mVkFormat;
+    container->mSwizzle = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+    container->mWidth = header->mPixelWidth;
+    container->mHeight = header->mPixelHeight;
+    // 0 asks the loader to generate the mips, only level 0 is stored
+    container->mMipLevels = std::max(header->mLevelCount, 1u);
+
+    if (!IsSupportedFormat(container->mFormat)) {
+        GM_LOG_CRITICAL("[TextureContainer] KTX2 format {} isn't supported", header->mVkFormat);
+        return false;
+    }
+
+    if (container->mWidth == 0 || container->mMipLevels > TextureContainer::MaxLevels ||
+        container->mMipLevels > GetMipLevelCount(container->mWidth, container->mHeight)) {
+        GM_LOG_CRITICAL("[TextureContainer] KTX2 has an invalid size {}x{} with {} mips", container->mWidth, container->mHeight, container->mMipLevels);
+        return false;
+    }
+
+    if (size < sizeof(KTX2Header) + container->mMipLevels * sizeof(KTX2Level)) {
+        GM_LOG_CRITICAL("[TextureContainer] KTX2 file is truncated");
+        return false;
+    }
+
+    // Level index is ordered from level 0, the data itself is stored smallest level first
+    const KTX2Level* levels = (const KTX2Level*)(data + sizeof(KTX2Header));
+
+    for (uint32_t mip = 0; mip < container->mMipLevels; mip++) {
+        uint64_t levelSize = GetImageSize(container->mFormat, GetMipDimension(container->mWidth, mip), GetMipDimension(container->mHeight, mip));
+
+        if (levels[mip].mByteLength != levelSize || levels[mip].mByteOffset > size || levelSize > size - levels[mip].mByteOffset) {
+            GM_LOG_CRITICAL("[TextureContainer] KTX2 level {} is invalid", mip);
+            return false;
+        }
+
+        container->mLevels[mip] = data + levels[mip].mByteOffset;
+        container->mLevelSizes[mip] = levelSize;
+    }
+
+    return true;
+}
+
+bool IsTextureContainer(const uint8_t* data, uint64_t size) {
+    if (size >= sizeof(sKTX2Magic) && memcmp(data, sKTX2Magic, sizeof(sKTX2Magic)) == 0) return true;
+
+    return size >= sizeof(sDDSMagic) && memcmp(data, sDDSMagic, sizeof(sDDSMagic)) == 0;
+}
+
+bool ParseTextureContainer(const uint8_t* data, uint64_t size, TextureContainer* container) {
+    GM_ASSERT(container);
+
+    if (size >= sizeof(sKTX2Magic) && memcmp(data, sKTX2Magic, sizeof(sKTX2Magic)) == 0) {
+        return ParseKTX2(data, size, container);
+    }
+
+    if (size >= sizeof(sDDSMagic) && memcmp(data, sDDSMagic, sizeof(sDDSMagic)) == 0) {
+        return ParseDDS(data, size, container);
+    }
+
+    return false;
+}
+
+}
+}
@@ -0,0 +1,51 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+namespace Guacamole { namespace Util {
+
+// GPU ready texture in a DDS or KTX2 file, the levels point into the file data and are uploaded as is
+struct TextureContainer {
+    static constexpr uint32_t MaxLevels = 16;
+
+    VkFormat mFormat;
+    VkComponentMapping mSwizzle;
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mMipLevels;
+    const uint8_t* mLevels[MaxLevels]; // Level 0 is the largest
+    uint64_t mLevelSizes[MaxLevels];
+};
+
+// Only checks the magic, a file that passes should never go through stb_image
+bool IsTextureContainer(const uint8_t* data, uint64_t size);
+// Validates the header and that every level is inside the data. Only single 2D images are supported,
+// arrays, cube maps, volumes and supercompressed (Basis/zstd) KTX2 files are rejected
+bool ParseTextureContainer(const uint8_t* data, uint64_t size, TextureContainer* container);
+
+}
+}
@@ -26,11 +26,17 @@ SOFTWARE.
 
 #include <fstream>
 
-// Apparently there's an issue with some SIMD intrinsics on GCC so 
-// SIMD is disabled in stb for the moment :(
-#ifdef GM_LINUX
-#define STBI_NO_SIMD
-#endif
+// stb only enables its SSE2 paths (JPEG IDCT and color conversion) on GCC when __SSE2__ is defined,
+// which is always the case on x64, so there's no need to turn them off
+
+// Lets DecodeImage hand stb the destination buffer as its output allocation
+static void* DecodeMalloc(size_t size);
+static void* DecodeRealloc(void* ptr, size_t size);
+static void DecodeFree(void* ptr);
+
+#define STBI_MALLOC(size) DecodeMalloc(size)
+#define STBI_REALLOC(ptr, size) DecodeRealloc(ptr, size)
+#define STBI_FREE(ptr) DecodeFree(ptr)
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -40,6 +46,46 @@ SOFTWARE.
 
 #define MAKE_CASE(name) case name: return #name
 
+struct DecodeTarget {
+    void* mData;
+    size_t mSize;
+    bool mUsed;
+};
+
+static thread_local DecodeTarget sDecodeTarget = { nullptr, 0, false };
+
+// stb allocates the output last for the formats we use, but a scratch buffer of the same size
+// may grab the target first. That's fine, the result is copied into the target in that case
+static void* DecodeMalloc(size_t size) {
+    DecodeTarget& target = sDecodeTarget;
+
+    if (target.mData && !target.mUsed && size == target.mSize) {
+        target.mUsed = true;
+        return target.mData;
+    }
+
+    return malloc(size);
+}
+
+static void* DecodeRealloc(void* ptr, size_t size) {
+    DecodeTarget& target = sDecodeTarget;
+
+    if (ptr == nullptr || ptr != target.mData) return realloc(ptr, size);
+
+    // The target can't grow, move it to the heap
+    void* mem = malloc(size);
+
+    if (mem) memcpy(mem, ptr, std::min(size, target.mSize));
+
+    return mem;
+}
+
+static void DecodeFree(void* ptr) {
+    if (ptr == nullptr || ptr == sDecodeTarget.mData) return;
+
+    free(ptr);
+}
+
 namespace Guacamole { namespace Util {
 
 const char* vkEnumToString(VkPhysicalDeviceType type) {
@@ -117,6 +163,41 @@ bool ReadFile(const std::filesystem::path& file, uint64_t bytesToRead, void* dst
     return ReadFileInternal(file, fileSize, bytesToRead, bytesToRead, dstBuffer);
 }
 
+bool DecodeImage(const uint8_t* data, uint64_t size, int32_t desiredChannels, void* dst, uint64_t dstSize) {
+    GM_ASSERT(data);
+    GM_ASSERT(dst);
+
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+
+    sDecodeTarget = { dst, (size_t)dstSize, false };
+
+    uint8_t* pixels = stbi_load_from_memory(data, (int32_t)size, &width, &height, &channels, desiredChannels);
+
+    sDecodeTarget = { nullptr, 0, false };
+
+    if (pixels == nullptr) {
+        GM_LOG_CRITICAL("[Util] Failed to decode image: {}", stbi_failure_reason());
+        return false;
+    }
+
+    uint64_t pixelSize = (uint64_t)width * height * desiredChannels;
+
+    if (pixelSize != dstSize) {
+        GM_LOG_CRITICAL("[Util] Decoded image is {} bytes, expected {}", pixelSize, dstSize);
+        if (pixels != dst) free(pixels);
+        return false;
+    }
+
+    if (pixels != dst) {
+        memcpy(dst, pixels, pixelSize);
+        free(pixels);
+    }
+
+    return true;
+}
+
 VkFormat SPIRTypeToVkFormat(spirv_cross::SPIRType type) {
 
     using namespace spirv_cross;
@@ -173,5 +254,106 @@ VkFormat SPIRTypeToVkFormat(spirv_cross::SPIRType type) {
     return VK_FORMAT_UNDEFINED;
 }
 
+static constexpr uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+static constexpr uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t Rotl64(uint64_t x, uint32_t r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t Read64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t Read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t XXH64Round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    acc = Rotl64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t XXH64MergeRound(uint64_t acc, uint64_t val) {
+    acc ^= XXH64Round(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+uint64_t Hash64(const void* data, uint64_t size, uint64_t seed) {
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        const uint8_t* limit = end - 32;
+
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+
+        do {
+            v1 = XXH64Round(v1, Read64(p)); p += 8;
+            v2 = XXH64Round(v2, Read64(p)); p += 8;
+            v3 = XXH64Round(v3, Read64(p)); p += 8;
+            v4 = XXH64Round(v4, Read64(p)); p += 8;
+        } while (p <= limit);
+
+        h = Rotl64(v1, 1) + Rotl64(v2, 7) + Rotl64(v3, 12) + Rotl64(v4, 18);
+        h = XXH64MergeRound(h, v1);
+        h = XXH64MergeRound(h, v2);
+        h = XXH64MergeRound(h, v3);
+        h = XXH64MergeRound(h, v4);
+    } else {
+        h = seed + XXH_PRIME64_5;
+    }
+
+    h += size;
+
+    while (p + 8 <= end) {
+        h ^= XXH64Round(0, Read64(p));
+        h = Rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+
+    if (p + 4 <= end) {
+        h ^= (uint64_t)Read32(p) * XXH_PRIME64_1;
+        h = Rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+
+    while (p < end) {
+        h ^= (*p) * XXH_PRIME64_5;
+        h = Rotl64(h, 11) * XXH_PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+std::filesystem::path NormalizePath(const std::filesystem::path& path) {
+    return std::filesystem::path(path.lexically_normal().generic_string());
+}
+
+uint64_t HashPath(const std::filesystem::path& path) {
+    std::string str = path.lexically_normal().generic_string();
+
+    return Hash64(str.data(), str.size());
+}
+
+}
 }
-}
\ No newline at end of file
@@ -37,6 +37,16 @@ const char* vkEnumToString(VkPhysicalDeviceType type);
 uint8_t* ReadFile(const std::filesystem::path& file, uint64_t* fileSize);
 bool ReadFile(const std::filesystem::path& file, uint64_t bytesToRead, void* dstBuffer);
 VkFormat SPIRTypeToVkFormat(spirv_cross::SPIRType type);
+// Decodes a JPEG/PNG/etc. with stb_image, stb's output allocation is redirected to dst so there's usually no copy.
+// dstSize must be width * height * desiredChannels, use stbi_info_from_memory to get the size first
+bool DecodeImage(const uint8_t* data, uint64_t size, int32_t desiredChannels, void* dst, uint64_t dstSize);
+
+// XXH64
+uint64_t Hash64(const void* data, uint64_t size, uint64_t seed = 0);
+// Lexically normalized with generic separators, doesn't touch the filesystem
+std::filesystem::path NormalizePath(const std::filesystem::path& path);
+// Hash of the normalized path, equal paths hash the same regardless of how they're spelled
+uint64_t HashPath(const std::filesystem::path& path);
 
 }
 }
\ No newline at end of file
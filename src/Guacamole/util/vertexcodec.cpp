@@ -0,0 +1,95 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "vertexcodec.h"
+
+namespace Guacamole { namespace Util {
+
+VertexQuantization ComputeVertexQuantization(const float* positionMin, const float* positionMax, const float* uvMin, const float* uvMax) {
+    VertexQuantization quantization;
+
+    for (uint32_t i = 0; i < 3; i++) {
+        float halfExtent = (positionMax[i] - positionMin[i]) * 0.5f;
+
+        // A flat axis has nothing to scale, anything non zero avoids dividing by zero
+        quantization.mPositionScale[i] = halfExtent > 0.0f ? halfExtent : 1.0f;
+        quantization.mPositionOffset[i] = (positionMax[i] + positionMin[i]) * 0.5f;
+    }
+
+    for (uint32_t i = 0; i < 2; i++) {
+        float extent = uvMax[i] - uvMin[i];
+
+        quantization.mUVScale[i] = extent > 0.0f ? extent : 1.0f;
+        quantization.mUVOffset[i] = uvMin[i];
+    }
+
+    return quantization;
+}
+
+int16_t EncodeSnorm16(float value) {
+    return (int16_t)lroundf(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+uint16_t EncodeUnorm16(float value) {
+    return (uint16_t)lroundf(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f);
+}
+
+void EncodeOctahedral(const float* normal, int16_t* out) {
+    float sum = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    float x = sum > 0.0f ? normal[0] / sum : 0.0f;
+    float y = sum > 0.0f ? normal[1] / sum : 0.0f;
+
+    if (normal[2] < 0.0f) {
+        float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+
+        x = foldedX;
+        y = foldedY;
+    }
+
+    out[0] = EncodeSnorm16(x);
+    out[1] = EncodeSnorm16(y);
+}
+
+void DecodeOctahedral(const int16_t* in, float* normal) {
+    float x = DecodeSnorm16(in[0]);
+    float y = DecodeSnorm16(in[1]);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    float t = std::max(-z, 0.0f);
+
+    // Same as scene.vert
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+
+    float length = sqrtf(x * x + y * y + z * z);
+
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+}
+}
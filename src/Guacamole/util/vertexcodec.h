@@ -0,0 +1,53 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+namespace Guacamole { namespace Util {
+
+// Maps a mesh's positions to [-1, 1] and its UVs to [0, 1] for the compact vertex format, decoding is value * scale + offset
+struct VertexQuantization {
+    float mPositionScale[3];
+    float mPositionOffset[3];
+    float mUVScale[2];
+    float mUVOffset[2];
+};
+
+VertexQuantization ComputeVertexQuantization(const float* positionMin, const float* positionMax, const float* uvMin, const float* uvMax);
+
+// Round to nearest, out of range values are clamped
+int16_t EncodeSnorm16(float value);
+uint16_t EncodeUnorm16(float value);
+// Matches the GPU's SNORM/UNORM conversion
+inline float DecodeSnorm16(int16_t value) { return std::max(value / 32767.0f, -1.0f); }
+inline float DecodeUnorm16(uint16_t value) { return value / 65535.0f; }
+
+// Unit vector to two SNORM16 by folding the octahedron's lower half over the upper one, the max error is under 0.005 degrees
+void EncodeOctahedral(const float* normal, int16_t* out);
+void DecodeOctahedral(const int16_t* in, float* normal);
+
+}
+}
@@ -108,23 +108,31 @@ uint32_t Buffer::GetMemoryIndex(const VkPhysicalDeviceMemoryProperties props, ui
 }
 
 IndexBuffer::IndexBuffer(Device* device, uint32_t count, VkIndexType type) : Buffer(), mCount(count), mIndexType(type) {
-    uint64_t size = count;
+    GM_VERIFY_MSG(type != VK_INDEX_TYPE_UINT8_EXT || (device->GetFeatures() & Device::FeatureIndexTypeUint8), "VK_INDEX_TYPE_UINT8_EXT used without VK_EXT_index_type_uint8");
 
+    Create(device, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, (uint64_t)count * GetIndexSize(type), mBufferFlags);
+}
+
+VkIndexType IndexBuffer::GetIndexType(const Device* device, uint64_t vertexCount) {
+    if (vertexCount <= 256 && (device->GetFeatures() & Device::FeatureIndexTypeUint8)) return VK_INDEX_TYPE_UINT8_EXT;
+    if (vertexCount <= 65536) return VK_INDEX_TYPE_UINT16;
+
+    return VK_INDEX_TYPE_UINT32;
+}
+
+uint32_t IndexBuffer::GetIndexSize(VkIndexType type) {
     switch (type) {
         case VK_INDEX_TYPE_UINT32:
-            size *= 4;
-            break;
+            return 4;
         case VK_INDEX_TYPE_UINT16:
-            size *= 2;
-            break;
+            return 2;
         case VK_INDEX_TYPE_UINT8_EXT:
-            GM_VERIFY_MSG(false, "Unsupported VkIndexType");
-            break;
+            return 1;
         default:
             GM_VERIFY_MSG(false, "Unsupported VkIndexType");
     }
 
-    Create(device, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, size, mBufferFlags);
+    return 0;
 }
 
 }
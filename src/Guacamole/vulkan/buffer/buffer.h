@@ -89,6 +89,10 @@ public:
 
     inline uint32_t GetCount() const { return mCount; }
     inline VkIndexType GetIndexType() const { return mIndexType; }
+
+    // Narrowest type that can address vertexCount vertices, UINT8 only if the device enabled VK_EXT_index_type_uint8
+    static VkIndexType GetIndexType(const Device* device, uint64_t vertexCount);
+    static uint32_t GetIndexSize(VkIndexType type);
 private:
     uint32_t mCount;
     VkIndexType mIndexType;
@@ -27,13 +27,17 @@ SOFTWARE.
 #include "stagingbuffer.h"
 
 #include <Guacamole/vulkan/util.h>
+#include <Guacamole/vulkan/device.h>
+#include <Guacamole/vulkan/semaphore.h>
 
 namespace Guacamole {
 
 StagingBuffer::StagingBuffer(Device* device, uint64_t size, CommandBuffer* commandBuffer) 
     : mAllocated(0),
       mBuffer(device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
-      mCommandBuffer(commandBuffer) 
+      mCommandBuffer(commandBuffer),
+      mSubmitted(false),
+      mCollectionCancelled(false)
 {
 
     mMemory = (uint8_t*)mBuffer.Map();
@@ -44,6 +48,9 @@ StagingBuffer::~StagingBuffer() {
 }
 
 void StagingBuffer::Begin() {
+    // The memory and command buffer can't be reused until the previous submission has been picked up
+    if (!StagingManager::WaitForCollection(this)) return;
+
     mCommandBuffer->Wait();
     mCommandBuffer->Begin(true);
 }
@@ -71,14 +78,13 @@ void* StagingBuffer::Allocate(uint64_t size, Buffer* buffer, uint64_t bufferOffs
 }
 
 void* StagingBuffer::AllocateImage(VkImageLayout oldLayout, VkImageLayout newLayout, Texture* texture, uint32_t mip) {
-    uint64_t size = texture->GetImageBufferSize();
-    GM_ASSERT_MSG(size + mAllocated <= GetSize(), "Buffer size exceeded");
+    uint64_t size = texture->GetImageBufferSize(mip);
+
+    // Align to 16 bytes, a multiple of every texel and block size the textures use.
+    // Rounding up has to cover the whole previous allocation, otherwise they can overlap
+    mAllocated = (mAllocated + 15) & ~15ULL;
 
-    uint64_t texelSize = GetFormatSize(texture->GetViewInfo().format);
-    uint64_t mask = ~15ULL;
-    
-    // Align to 16 bytes to make sure it's always a multiple of texel size
-    mAllocated = (mAllocated + texelSize) & mask;
+    GM_ASSERT_MSG(size + mAllocated <= GetSize(), "Buffer size exceeded");
 
     uint8_t* mem = mMemory + mAllocated;
 
@@ -90,15 +96,16 @@ void* StagingBuffer::AllocateImage(VkImageLayout oldLayout, VkImageLayout newLay
     copy.bufferImageHeight = 0;
     copy.bufferRowLength = 0;
     copy.imageSubresource.aspectMask = viewInfo.subresourceRange.aspectMask;
-    copy.imageSubresource.baseArrayLayer = viewInfo.subresourceRange.baseArrayLayer;
-    copy.imageSubresource.layerCount = viewInfo.subresourceRange.layerCount;
+    copy.imageSubresource.baseArrayLayer = texture->GetLayer();
+    copy.imageSubresource.layerCount = 1;
     copy.imageSubresource.mipLevel = mip;
     copy.imageOffset = {};
-    copy.imageExtent = texture->GetImageInfo().extent;
+    copy.imageExtent = texture->GetMipExtent(mip);
 
-    texture->Transition(oldLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mCommandBuffer);
+    // Only the uploaded level, every level is transitioned on its own
+    texture->Transition(oldLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mCommandBuffer, mip, 1);
     vkCmdCopyBufferToImage(mCommandBuffer->GetHandle(), mBuffer.GetHandle(), texture->GetImageHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
-    texture->Transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, newLayout, mCommandBuffer);
+    texture->Transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, newLayout, mCommandBuffer, mip, 1);
 
     mAllocated += size;
 
@@ -109,24 +116,36 @@ void StagingBuffer::Reset() {
     mAllocated = 0;
 }
 
+std::mutex StagingManager::mMutex;
+std::condition_variable StagingManager::mCollectedCondition;
+bool StagingManager::mCollectionCancelled = false;
 std::unordered_map<std::thread::id, std::pair<StagingBuffer*, CommandPool*>> StagingManager::mCommonStagingBuffers;
-std::vector<StagingBufferSubmitInfo> StagingManager::mSubmittedStagingBuffers;
+std::vector<std::pair<StagingBuffer*, VkPipelineStageFlags>> StagingManager::mSubmittedStagingBuffers;
 
 void StagingManager::AllocateCommonStagingBuffer(Device* device, std::thread::id id, uint64_t size, bool beginCommandBuffer) {
+    std::unique_lock<std::mutex> lock(mMutex);
+
     auto it = mCommonStagingBuffers.find(id);
 
     if (it != mCommonStagingBuffers.end()) {
         // Buffer already exist
-        StagingBuffer*& buffer = it->second.first;
+        StagingBuffer* buffer = it->second.first;
 
         if (size > buffer->GetSize()) {
             // Only reallocate if size requested is larger
+            lock.unlock();
+            WaitForCollection(buffer);
+
             CommandBuffer* cmd = buffer->GetCommandBuffer();
             cmd->Wait();
             delete buffer;
             
             buffer = new StagingBuffer(device, size, cmd);
 
+            lock.lock();
+            mCommonStagingBuffers[id].first = buffer;
+            lock.unlock();
+
             if (beginCommandBuffer)
                 buffer->Begin();
         }
@@ -139,11 +158,15 @@ void StagingManager::AllocateCommonStagingBuffer(Device* device, std::thread::id
 
     mCommonStagingBuffers[id] = {buffer, pool};
 
+    lock.unlock();
+
     if (beginCommandBuffer)
         buffer->Begin();
 }
 
 void StagingManager::Shutdown() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
     for (auto [id, buf] : mCommonStagingBuffers) {
         buf.first->GetCommandBuffer()->Wait();
         delete buf.first->GetCommandBuffer();
@@ -152,6 +175,7 @@ void StagingManager::Shutdown() {
     }
 
     mCommonStagingBuffers.clear();
+    mSubmittedStagingBuffers.clear();
 }
 
 void StagingManager::SubmitStagingBuffer(StagingBuffer* buffer, VkPipelineStageFlags stageFlags) {
@@ -162,21 +186,123 @@ void StagingManager::SubmitStagingBuffer(StagingBuffer* buffer, VkPipelineStageF
         return;
     }
 
-    StagingBufferSubmitInfo& buf = mSubmittedStagingBuffers.emplace_back();
+    std::lock_guard<std::mutex> lock(mMutex);
 
-    buf.mCommandBuffer = buffer->GetCommandBuffer();
-    buf.mStageFlags = stageFlags;
+    GM_ASSERT(!buffer->mSubmitted);
+
+    mSubmittedStagingBuffers.emplace_back(buffer, stageFlags);
+    buffer->mSubmitted = true;
 
     buffer->Reset();
 }
 
+std::vector<StagingBufferSubmitInfo> StagingManager::GetSubmittedStagingBuffers() {
+    std::vector<StagingBufferSubmitInfo> ret;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
 
-std::vector<StagingBufferSubmitInfo> StagingManager::GetSubmittedStagingBuffers(bool clear) {
-    std::vector<StagingBufferSubmitInfo> ret = mSubmittedStagingBuffers;
+        ret.reserve(mSubmittedStagingBuffers.size());
 
-    if (clear) mSubmittedStagingBuffers.clear();
+        for (auto [buffer, stageFlags] : mSubmittedStagingBuffers) {
+            CommandBuffer* cmd = buffer->GetCommandBuffer();
+            cmd->End();
+
+            StagingBufferSubmitInfo& info = ret.emplace_back();
+            info.mCommandBuffer = cmd;
+            info.mStageFlags = stageFlags;
+            info.mSignalValue = ((SemaphoreTimeline*)cmd->GetSemaphore())->IncrementSignalCounter();
+
+            buffer->mSubmitted = false;
+        }
+
+        mSubmittedStagingBuffers.clear();
+    }
+
+    mCollectedCondition.notify_all();
 
     return ret;
 }
 
+void StagingManager::SubmitPendingStagingBuffers(Device* device) {
+    std::vector<StagingBufferSubmitInfo> buffers = GetSubmittedStagingBuffers();
+
+    if (buffers.empty()) return;
+
+    std::vector<VkTimelineSemaphoreSubmitInfoKHR> semaphoreSubmits(buffers.size());
+    std::vector<VkSubmitInfo> submits(buffers.size());
+
+    for (size_t i = 0; i < buffers.size(); i++) {
+        SemaphoreTimeline* sem = (SemaphoreTimeline*)buffers[i].mCommandBuffer->GetSemaphore();
+
+        VkTimelineSemaphoreSubmitInfoKHR& semInfo = semaphoreSubmits[i];
+        semInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        semInfo.pNext = nullptr;
+        semInfo.waitSemaphoreValueCount = 0;
+        semInfo.pWaitSemaphoreValues = nullptr;
+        semInfo.signalSemaphoreValueCount = 1;
+        semInfo.pSignalSemaphoreValues = &buffers[i].mSignalValue;
+
+        VkSubmitInfo& submitInfo = submits[i];
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &semInfo;
+        submitInfo.waitSemaphoreCount = 0;
+        submitInfo.pWaitSemaphores = nullptr;
+        submitInfo.pWaitDstStageMask = nullptr;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &buffers[i].mCommandBuffer->GetHandle();
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &sem->GetHandle();
+    }
+
+    VK(vkQueueSubmit(device->GetGraphicsQueue(), (uint32_t)submits.size(), submits.data(), nullptr));
+
+    // The next Present doesn't know about these, so it can't wait for them
+    for (const StagingBufferSubmitInfo& buffer : buffers) {
+        buffer.mCommandBuffer->Wait();
+    }
+}
+
+StagingBuffer* StagingManager::GetCommonStagingBuffer() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    return mCommonStagingBuffers[std::this_thread::get_id()].first;
+}
+
+bool StagingManager::WaitForCollection(StagingBuffer* buffer) {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    mCollectedCondition.wait(lock, [buffer]() { return !buffer->mSubmitted || mCollectionCancelled || buffer->mCollectionCancelled; });
+
+    return !buffer->mSubmitted;
+}
+
+void StagingManager::CancelCollectionWaits() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCollectionCancelled = true;
+    }
+
+    mCollectedCondition.notify_all();
+}
+
+void StagingManager::CancelCollectionWaits(StagingBuffer* buffer) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        buffer->mCollectionCancelled = true;
+    }
+
+    mCollectedCondition.notify_all();
+}
+
+bool StagingManager::FlushStagingBuffer(StagingBuffer* buffer, VkPipelineStageFlags stageFlags) {
+    SubmitStagingBuffer(buffer, stageFlags);
+
+    if (!WaitForCollection(buffer)) return false;
+
+    buffer->Begin();
+
+    return true;
+}
+
 }
\ No newline at end of file
@@ -31,6 +31,8 @@ SOFTWARE.
 #include <Guacamole/vulkan/shader/texture.h>
 
 #include <thread>
+#include <mutex>
+#include <condition_variable>
 
 namespace Guacamole {
 
@@ -58,11 +60,18 @@ private:
     uint8_t* mMemory;
     CommandBuffer* mCommandBuffer;
 
+    // Set when submitted and cleared when the render thread has picked it up, guarded by StagingManager::mMutex
+    bool mSubmitted;
+    bool mCollectionCancelled;
+
+private:
+    friend class StagingManager;
 };
 
 struct StagingBufferSubmitInfo {
     CommandBuffer* mCommandBuffer;
     VkPipelineStageFlags mStageFlags;
+    uint64_t mSignalValue;
 };
 
 class StagingManager {
@@ -72,15 +81,29 @@ public:
     static void Shutdown();
 
     static void SubmitStagingBuffer(StagingBuffer* buffer, VkPipelineStageFlags stageFlags);
-    static std::vector<StagingBufferSubmitInfo> GetSubmittedStagingBuffers(bool clear = true);
-    static StagingBuffer* GetCommonStagingBuffer() { return mCommonStagingBuffers[std::this_thread::get_id()].first; }
-
+    // Ends all submitted command buffers, the caller must submit them and signal mSignalValue
+    static std::vector<StagingBufferSubmitInfo> GetSubmittedStagingBuffers();
+    // Collects and submits everything that's been submitted and waits until the GPU is done with it. Main thread only,
+    // for waits that would otherwise block the Present that collects them
+    static void SubmitPendingStagingBuffers(Device* device);
+    static StagingBuffer* GetCommonStagingBuffer();
+
+    // Blocks until the buffer has been picked up by GetSubmittedStagingBuffers, returns false if the wait was cancelled
+    static bool WaitForCollection(StagingBuffer* buffer);
+    // Wakes up and cancels all current and future WaitForCollection calls, used when shutting down loader threads
+    static void CancelCollectionWaits();
+    // Same for a single buffer, so one thread can be stopped while the others keep uploading
+    static void CancelCollectionWaits(StagingBuffer* buffer);
+    // Submits the buffer and begins it again once it's been collected, for uploads that don't fit in one go.
+    // Waits on the render thread so never call it on the main thread, returns false if the wait was cancelled
+    static bool FlushStagingBuffer(StagingBuffer* buffer, VkPipelineStageFlags stageFlags);
 
 private:
+    static std::mutex mMutex;
+    static std::condition_variable mCollectedCondition;
+    static bool mCollectionCancelled;
     static std::unordered_map<std::thread::id, std::pair<StagingBuffer*, CommandPool*>> mCommonStagingBuffers;
-    static std::vector<StagingBufferSubmitInfo> mSubmittedStagingBuffers;
-
-    
+    static std::vector<std::pair<StagingBuffer*, VkPipelineStageFlags>> mSubmittedStagingBuffers;
 };
 
 }
\ No newline at end of file
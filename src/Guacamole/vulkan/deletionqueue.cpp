@@ -0,0 +1,78 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "deletionqueue.h"
+
+namespace Guacamole {
+
+std::mutex DeletionQueue::mMutex;
+std::deque<std::pair<uint64_t, std::function<void()>>> DeletionQueue::mQueue;
+uint64_t DeletionQueue::mFrameIndex;
+uint32_t DeletionQueue::mFrameDelay;
+
+void DeletionQueue::Init(uint32_t frameDelay) {
+    mFrameIndex = 0;
+    mFrameDelay = frameDelay;
+}
+
+void DeletionQueue::Shutdown() {
+    std::deque<std::pair<uint64_t, std::function<void()>>> queue;
+
+    mMutex.lock();
+    queue = std::move(mQueue);
+    mQueue.clear();
+    mMutex.unlock();
+
+    for (auto& [frame, func] : queue) {
+        func();
+    }
+}
+
+void DeletionQueue::Push(std::function<void()> func) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueue.emplace_back(mFrameIndex, std::move(func));
+}
+
+void DeletionQueue::Update() {
+    std::vector<std::function<void()>> expired;
+
+    mMutex.lock();
+    mFrameIndex++;
+
+    // Entries are pushed in frame order
+    while (!mQueue.empty() && mQueue.front().first + mFrameDelay <= mFrameIndex) {
+        expired.push_back(std::move(mQueue.front().second));
+        mQueue.pop_front();
+    }
+
+    mMutex.unlock();
+
+    for (std::function<void()>& func : expired) {
+        func();
+    }
+}
+
+}
@@ -0,0 +1,58 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include <deque>
+#include <mutex>
+#include <functional>
+
+namespace Guacamole {
+
+// Defers destruction of GPU objects until no frame in flight can reference them anymore,
+// so resources can be replaced at a frame boundary without waiting for the queue to go idle
+class DeletionQueue {
+public:
+    // frameDelay must be larger than the number of frames in flight
+    static void Init(uint32_t frameDelay);
+    // Runs everything that's left, the device must be idle
+    static void Shutdown();
+
+    // Thread safe
+    static void Push(std::function<void()> func);
+    // Called once per frame on the main thread
+    static void Update();
+
+    inline static uint32_t GetFrameDelay() { return mFrameDelay; }
+
+private:
+    static std::mutex mMutex;
+    static std::deque<std::pair<uint64_t, std::function<void()>>> mQueue;
+    static uint64_t mFrameIndex;
+    static uint32_t mFrameDelay;
+};
+
+}
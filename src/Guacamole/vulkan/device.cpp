@@ -71,18 +71,36 @@ Device::Device(PhysicalDevice* physicalDevice) : mParent(physicalDevice), mEnabl
 
     VkPhysicalDeviceFeatures2 features2 = {};
     VkPhysicalDeviceVulkan12Features features12 = {};
+    VkPhysicalDeviceIndexTypeUint8FeaturesEXT featuresUint8 = {};
 
     features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
     features2.pNext = &features12;
     features2.features.samplerAnisotropy = mParent->IsFeatureSupported(FeatureAnisotropicSampling);
 
+    features2.features.textureCompressionBC = mParent->IsFeatureSupported(FeatureTextureCompressionBC);
+
     if (features2.features.samplerAnisotropy) 
         mEnabledFeatures |= FeatureAnisotropicSampling;
+
+    if (features2.features.textureCompressionBC)
+        mEnabledFeatures |= FeatureTextureCompressionBC;
     
     features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     features12.pNext = nullptr;
     features12.timelineSemaphore = true;
 
+    // Optional, meshes fall back to 16 bit indices without it
+    if (mParent->IsFeatureSupported(FeatureIndexTypeUint8)) {
+        extensions.push_back(VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME);
+
+        featuresUint8.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INDEX_TYPE_UINT8_FEATURES_EXT;
+        featuresUint8.pNext = nullptr;
+        featuresUint8.indexTypeUint8 = true;
+        features12.pNext = &featuresUint8;
+
+        mEnabledFeatures |= FeatureIndexTypeUint8;
+    }
+
     VkDeviceCreateInfo info;
 
     info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -34,7 +34,9 @@ class Device {
 public:
 enum  {
     FeatureTimelineSemaphore = 0x01,
-    FeatureAnisotropicSampling = 0x02
+    FeatureAnisotropicSampling = 0x02,
+    FeatureTextureCompressionBC = 0x04,
+    FeatureIndexTypeUint8 = 0x08
 };
 
 public:
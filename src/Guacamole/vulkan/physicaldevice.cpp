@@ -171,6 +171,7 @@ std::vector<VkPresentModeKHR> PhysicalDevice::GetPresentModes(VkSurfaceKHR surfa
 bool PhysicalDevice::IsFeatureSupported(uint32_t feature) {
     VkPhysicalDeviceFeatures2 f2;
     VkPhysicalDeviceVulkan12Features f12;
+    VkPhysicalDeviceIndexTypeUint8FeaturesEXT fUint8;
 
     f2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
     f2.pNext = nullptr;
@@ -178,11 +179,18 @@ bool PhysicalDevice::IsFeatureSupported(uint32_t feature) {
     f12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     f12.pNext = nullptr;
 
+    fUint8.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INDEX_TYPE_UINT8_FEATURES_EXT;
+    fUint8.pNext = nullptr;
+
     switch (feature)
     {
     case Device::FeatureTimelineSemaphore:
         f2.pNext = &f12;
         break;
+    case Device::FeatureIndexTypeUint8:
+        if (!IsExtensionSupported(VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME)) return false;
+        f2.pNext = &fUint8;
+        break;
     }
 
     vkGetPhysicalDeviceFeatures2(mDeviceHandle, &f2);
@@ -193,6 +201,10 @@ bool PhysicalDevice::IsFeatureSupported(uint32_t feature) {
             break;
         case Device::FeatureAnisotropicSampling:
             return f2.features.samplerAnisotropy;
+        case Device::FeatureTextureCompressionBC:
+            return f2.features.textureCompressionBC;
+        case Device::FeatureIndexTypeUint8:
+            return fUint8.indexTypeUint8;
     }
 
     return false;
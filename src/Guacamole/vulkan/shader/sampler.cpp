@@ -44,7 +44,7 @@ Sampler::~Sampler() {
 }
 
 
-BasicSampler::BasicSampler(Device* device, VkFilter magFilter, VkFilter minFilter, VkSamplerAddressMode addressMode) : Sampler(device) {
+BasicSampler::BasicSampler(Device* device, VkFilter magFilter, VkFilter minFilter, VkSamplerAddressMode addressMode, float maxLod) : Sampler(device) {
     VkSamplerCreateInfo sInfo;
 
     sInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -62,7 +62,7 @@ BasicSampler::BasicSampler(Device* device, VkFilter magFilter, VkFilter minFilte
     sInfo.compareEnable = false;
     sInfo.compareOp = VK_COMPARE_OP_EQUAL;
     sInfo.minLod = 0;
-    sInfo.maxLod = 0;
+    sInfo.maxLod = maxLod;
     sInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
     sInfo.unnormalizedCoordinates = false;
 
@@ -50,7 +50,8 @@ private:
 
 class BasicSampler : public Sampler {
 public:
-    BasicSampler(Device* device, VkFilter magFilter = VK_FILTER_LINEAR, VkFilter minFilter = VK_FILTER_LINEAR, VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+    // maxLod clamps the mip levels that can be sampled, the default allows the whole chain
+    BasicSampler(Device* device, VkFilter magFilter = VK_FILTER_LINEAR, VkFilter minFilter = VK_FILTER_LINEAR, VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, float maxLod = VK_LOD_CLAMP_NONE);
 
 };
 
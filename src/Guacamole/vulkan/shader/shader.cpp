@@ -27,8 +27,11 @@ SOFTWARE.
 #include "shader.h"
 
 #include <Guacamole/asset/assetmanager.h>
+#include <Guacamole/asset/assetcache.h>
 
 #include <Guacamole/vulkan/device.h>
+#include <Guacamole/vulkan/deletionqueue.h>
+#include <Guacamole/vulkan/util.h>
 #include <Guacamole/util/util.h>
 
 #include <shaderc/shaderc.hpp>
@@ -70,44 +73,323 @@ static VkShaderStageFlags ShaderStageToVkShaderStage(ShaderStage stage) {
     return VK_SHADER_STAGE_ALL_GRAPHICS; // Should never be reached
 }
 
+// The cached reflection is a flat list of 32 bit values, strings are length prefixed
+static void WriteValue(std::vector<uint8_t>* data, uint32_t value) {
+    data->insert(data->end(), (const uint8_t*)&value, (const uint8_t*)&value + sizeof(uint32_t));
+}
+
+static void WriteString(std::vector<uint8_t>* data, const std::string& str) {
+    WriteValue(data, (uint32_t)str.size());
+    data->insert(data->end(), str.begin(), str.end());
+}
+
+class ReflectionReader {
+public:
+    ReflectionReader(const uint8_t* data, uint64_t size) : mData(data), mSize(size), mOffset(0) {}
+
+    uint32_t Read() {
+        uint32_t value = 0;
+
+        if (!IsValid() || mSize - mOffset < sizeof(uint32_t)) {
+            mOffset = mSize + 1;
+            return 0;
+        }
+
+        memcpy(&value, mData + mOffset, sizeof(uint32_t));
+        mOffset += sizeof(uint32_t);
+
+        return value;
+    }
+
+    std::string ReadString() {
+        uint32_t length = Read();
+
+        if (!IsValid() || mSize - mOffset < length) {
+            mOffset = mSize + 1;
+            return std::string();
+        }
+
+        std::string str((const char*)mData + mOffset, length);
+        mOffset += length;
+
+        return str;
+    }
+
+    // Counts are checked against what's left so a corrupt one can't make the caller reserve gigabytes
+    uint32_t ReadCount(uint32_t minElementSize) {
+        uint32_t count = Read();
+
+        if (IsValid() && (uint64_t)count * minElementSize > mSize - mOffset) mOffset = mSize + 1;
+
+        return IsValid() ? count : 0;
+    }
+
+    // Everything read so far was in range
+    inline bool IsValid() const { return mOffset <= mSize; }
+    inline bool IsAtEnd() const { return mOffset == mSize; }
+
+private:
+    const uint8_t* mData;
+    uint64_t mSize;
+    uint64_t mOffset;
+};
+
+void Shader::Reflection::Reflect(const uint32_t* code, uint32_t size, ShaderStage stage) {
+    Clear();
+
+    spirv_cross::Compiler compiler(code, size / 4);
+    spirv_cross::ShaderResources resources = compiler.get_shader_resources();
+    
+    if (stage == ShaderStage::Vertex) {
+        for (auto& input : resources.stage_inputs) {
+            uint32_t location = compiler.get_decoration(input.id, spv::DecorationLocation);
+            spirv_cross::SPIRType type = compiler.get_type(input.type_id);
+            bool scalar = type.basetype == spirv_cross::SPIRType::Float || type.basetype == spirv_cross::SPIRType::Int || type.basetype == spirv_cross::SPIRType::UInt;
+
+            // Only the types SPIRTypeToVkFormat knows, the rest fail when they're used in a vertex layout
+            VkFormat format = VK_FORMAT_UNDEFINED;
+
+            if (scalar && type.width == 32 && type.columns == 1 && type.vecsize >= 1 && type.vecsize <= 4) {
+                format = Util::SPIRTypeToVkFormat(type);
+            }
+
+            mStageInputs.push_back({ location, format, type.vecsize * (type.width / 8) });
+        }
+    }
+    
+    for (auto& uniform : resources.uniform_buffers) {
+        uint32_t set = compiler.get_decoration(uniform.id, spv::DecorationDescriptorSet);
+        uint32_t binding = compiler.get_decoration(uniform.id, spv::DecorationBinding);
+        spirv_cross::SPIRType type = compiler.get_type(uniform.type_id);
+
+        GM_VERIFY(type.basetype == spirv_cross::SPIRType::Struct);
+
+        uint32_t size = (uint32_t)compiler.get_declared_struct_size(type);
+
+        std::vector<UniformBufferType::Member> members;
+
+        uint32_t index = 0;
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < type.member_types.size(); i++) {
+            spirv_cross::TypeID id = type.member_types[i];
+            spirv_cross::SPIRType memberType = compiler.get_type(id);
+            UniformBufferType::Member member;
+
+            uint32_t memberSize = (uint32_t)compiler.get_declared_struct_member_size(type, index++);
+
+            member.Name = compiler.get_member_name(id, i);
+            member.Size = memberSize;
+            member.Offset = offset;
+
+            offset += member.Size;
+
+            members.push_back(member);
+        }
+
+        mUniformBuffers.emplace_back(compiler.get_name(uniform.id), stage, set, binding, size, std::move(members));
+    }
+
+    for (auto& image : resources.sampled_images) {
+        uint32_t set = compiler.get_decoration(image.id, spv::DecorationDescriptorSet);
+        uint32_t binding = compiler.get_decoration(image.id, spv::DecorationBinding);
+        spirv_cross::SPIRType type = compiler.get_type(image.type_id);
+        uint32_t count = type.array.empty() ? 1 : type.array[0];
+
+        mSampledImages.emplace_back(compiler.get_name(image.id), stage, set, binding, count, type.image);
+    }
+
+    for (auto& push : resources.push_constant_buffers) {
+        spirv_cross::SPIRType type = compiler.get_type(push.type_id);
+        uint32_t size = (uint32_t)compiler.get_declared_struct_size(type);
+
+        mPushConstants.push_back({ShaderStageToVkShaderStage(stage), 0, size});
+    }
+}
+
+void Shader::Reflection::Serialize(std::vector<uint8_t>* data) const {
+    WriteValue(data, (uint32_t)mStageInputs.size());
+
+    for (const StageInput& input : mStageInputs) {
+        WriteValue(data, input.mLocation);
+        WriteValue(data, (uint32_t)input.mFormat);
+        WriteValue(data, input.mSize);
+    }
+
+    WriteValue(data, (uint32_t)mUniformBuffers.size());
+
+    for (const UniformBufferType& buffer : mUniformBuffers) {
+        WriteString(data, buffer.mName);
+        WriteValue(data, buffer.mSet);
+        WriteValue(data, buffer.mBinding);
+        WriteValue(data, buffer.mSize);
+        WriteValue(data, (uint32_t)buffer.mMembers.size());
+
+        for (const UniformBufferType::Member& member : buffer.mMembers) {
+            WriteString(data, member.Name);
+            WriteValue(data, member.Size);
+            WriteValue(data, member.Offset);
+        }
+    }
+
+    WriteValue(data, (uint32_t)mSampledImages.size());
+
+    for (const SampledImageType& image : mSampledImages) {
+        WriteString(data, image.mName);
+        WriteValue(data, image.mSet);
+        WriteValue(data, image.mBinding);
+        WriteValue(data, image.mArrayCount);
+        WriteValue(data, (uint32_t)image.mImage.dim);
+        WriteValue(data, image.mImage.depth);
+        WriteValue(data, image.mImage.arrayed);
+        WriteValue(data, image.mImage.ms);
+        WriteValue(data, image.mImage.sampled);
+        WriteValue(data, (uint32_t)image.mImage.format);
+        WriteValue(data, (uint32_t)image.mImage.access);
+    }
+
+    WriteValue(data, (uint32_t)mPushConstants.size());
+
+    for (const VkPushConstantRange& range : mPushConstants) {
+        WriteValue(data, range.stageFlags);
+        WriteValue(data, range.offset);
+        WriteValue(data, range.size);
+    }
+}
+
+bool Shader::Reflection::Deserialize(const uint8_t* data, uint64_t size, ShaderStage stage) {
+    Clear();
+
+    ReflectionReader reader(data, size);
+
+    uint32_t inputCount = reader.ReadCount(12);
+
+    for (uint32_t i = 0; i < inputCount; i++) {
+        uint32_t location = reader.Read();
+        VkFormat format = (VkFormat)reader.Read();
+        uint32_t inputSize = reader.Read();
+
+        mStageInputs.push_back({ location, format, inputSize });
+    }
+
+    uint32_t bufferCount = reader.ReadCount(20);
+
+    for (uint32_t i = 0; i < bufferCount && reader.IsValid(); i++) {
+        std::string name = reader.ReadString();
+        uint32_t set = reader.Read();
+        uint32_t binding = reader.Read();
+        uint32_t bufferSize = reader.Read();
+        uint32_t memberCount = reader.ReadCount(12);
+
+        std::vector<UniformBufferType::Member> members(memberCount);
+
+        for (UniformBufferType::Member& member : members) {
+            member.Name = reader.ReadString();
+            member.Size = reader.Read();
+            member.Offset = reader.Read();
+        }
+
+        mUniformBuffers.emplace_back(name, stage, set, binding, bufferSize, std::move(members));
+    }
+
+    uint32_t imageCount = reader.ReadCount(44);
+
+    for (uint32_t i = 0; i < imageCount && reader.IsValid(); i++) {
+        std::string name = reader.ReadString();
+        uint32_t set = reader.Read();
+        uint32_t binding = reader.Read();
+        uint32_t arrayCount = reader.Read();
+
+        spirv_cross::SPIRType::ImageType image = {};
+
+        image.dim = (spv::Dim)reader.Read();
+        image.depth = reader.Read() != 0;
+        image.arrayed = reader.Read() != 0;
+        image.ms = reader.Read() != 0;
+        image.sampled = reader.Read();
+        image.format = (spv::ImageFormat)reader.Read();
+        image.access = (spv::AccessQualifier)reader.Read();
+
+        mSampledImages.emplace_back(name, stage, set, binding, arrayCount, image);
+    }
+
+    uint32_t pushCount = reader.ReadCount(12);
+
+    for (uint32_t i = 0; i < pushCount; i++) {
+        VkPushConstantRange range;
+
+        range.stageFlags = reader.Read();
+        range.offset = reader.Read();
+        range.size = reader.Read();
+
+        mPushConstants.push_back(range);
+    }
+
+    return reader.IsValid() && reader.IsAtEnd();
+}
+
+void Shader::Reflection::Clear() {
+    mStageInputs.clear();
+    mUniformBuffers.clear();
+    mSampledImages.clear();
+    mPushConstants.clear();
+}
+
 Shader::Source::Source(const std::filesystem::path& file, bool spirv, ShaderStage stage) : Asset(file, AssetType::ShaderSource),
         mIsSpirv(spirv), mStage(stage), mShaderSource(nullptr), mShaderSourceSize(0) {
 }
 
 Shader::Source::~Source() {
-    delete mShaderSource;
+    delete[] mShaderSource;
 }
 
 bool Shader::Source::Load() {
     Unload();
-    uint64_t size;
-    uint8_t* data = Util::ReadFile(mFilePath, &size);
 
-    GM_VERIFY(data);
+    AssetData data;
+
+    // Hot reload can read the file while it's being saved, the previous version stays in use
+    if (!AssetManager::ReadAssetData(mFilePath, &data) || data.GetSize() == 0) {
+        GM_LOG_WARNING("[Shader] Can't read \"{}\"", GetPathAsString().c_str());
+        return false;
+    }
+
+    uint64_t size = data.GetSize();
+
+    // Everything that changes the compiled output
+    struct CompileParams {
+        ShaderStage mStage;
+        shaderc_env_version mEnvVersion;
+        shaderc_optimization_level mOptimizationLevel;
+        uint32_t mDebugInfo;
+        uint32_t mIsSpirv;
+    } params = { mStage, shaderc_env_version_vulkan_1_2, shaderc_optimization_level_performance, 1, mIsSpirv };
+
+    uint64_t cacheKey = AssetCache::IsEnabled() ? AssetCache::MakeKey(data.GetData(), size, &params, sizeof(CompileParams)) : 0;
+
+    AssetData cached;
+
+    if (cacheKey != 0 && AssetCache::Load(cacheKey, &cached) && LoadCached(cached.GetData(), cached.GetSize())) {
+        mFlags |= AssetFlag_Loaded;
+
+        return false;
+    }
 
     if (mIsSpirv) {
-        if (size & 0x03) {
-            // Size is not a multiple of 4 so allocate new buffer that is
-            mShaderSourceSize = (size + 4) & 0x03;
-            mShaderSource = new uint32_t[mShaderSourceSize / 4];       
-            memcpy(mShaderSource, data, size);
-            memset(mShaderSource+size, 0, mShaderSourceSize-size);
-            delete data;     
-        } else {
-            mShaderSource = (uint32_t*)data;
-            mShaderSourceSize = (uint32_t)size;
-        }
+        // The mapping is read only and may not be a multiple of 4 bytes so the code is copied out
+        mShaderSourceSize = (uint32_t)((size + 3) & ~3ull);
+        mShaderSource = new uint32_t[mShaderSourceSize / 4];
+        mShaderSource[mShaderSourceSize / 4 - 1] = 0;
+        memcpy(mShaderSource, data.GetData(), size);
     } else {
         shaderc::Compiler compiler;
         shaderc::CompileOptions options;
 
-        options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
-        options.SetOptimizationLevel(shaderc_optimization_level_performance);
-        options.SetGenerateDebugInfo();
-
-        shaderc::CompilationResult result = compiler.CompileGlslToSpv((const char*)data, size, ShaderStageToShaderC(mStage), mFilePath.string().c_str(), options);
+        options.SetTargetEnvironment(shaderc_target_env_vulkan, params.mEnvVersion);
+        options.SetOptimizationLevel(params.mOptimizationLevel);
+        
+        if (params.mDebugInfo) options.SetGenerateDebugInfo();
 
-        delete data;
+        shaderc::CompilationResult result = compiler.CompileGlslToSpv((const char*)data.GetData(), size, ShaderStageToShaderC(mStage), mFilePath.string().c_str(), options);
 
         if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
             GM_LOG_CRITICAL(result.GetErrorMessage());
@@ -121,19 +403,59 @@ bool Shader::Source::Load() {
         memcpy(mShaderSource, (uint32_t*)spirv.data(), mShaderSourceSize);
     }
 
+    mReflection.Reflect(mShaderSource, mShaderSourceSize, mStage);
+
+    if (cacheKey != 0) {
+        std::vector<uint8_t> reflection;
+
+        mReflection.Serialize(&reflection);
+
+        CacheHeader header = { mShaderSourceSize, (uint32_t)reflection.size() };
+
+        AssetCache::Store(cacheKey, { { &header, sizeof(CacheHeader) }, { mShaderSource, mShaderSourceSize }, { reflection.data(), reflection.size() } });
+    }
+
     mFlags |= AssetFlag_Loaded;
 
     return false;
 }
 
+bool Shader::Source::LoadCached(const uint8_t* data, uint64_t size) {
+    if (size < sizeof(CacheHeader)) return false;
+
+    CacheHeader header;
+    memcpy(&header, data, sizeof(CacheHeader));
+
+    if (header.mCodeSize == 0 || (header.mCodeSize & 0x03) != 0 || size - sizeof(CacheHeader) != (uint64_t)header.mCodeSize + header.mReflectionSize) return false;
+
+    const uint8_t* code = data + sizeof(CacheHeader);
+
+    if (!mReflection.Deserialize(code + header.mCodeSize, header.mReflectionSize, mStage)) {
+        mReflection.Clear();
+        return false;
+    }
+
+    mShaderSourceSize = header.mCodeSize;
+    mShaderSource = new uint32_t[mShaderSourceSize / 4];
+    memcpy(mShaderSource, code, mShaderSourceSize);
+
+    return true;
+}
+
+Asset* Shader::Source::CreateReloadInstance() const {
+    return new Source(mFilePath, mIsSpirv, mStage);
+}
+
 void Shader::Source::Unload() {
-    delete mShaderSource;
+    delete[] mShaderSource;
+    mShaderSource = nullptr;
     mShaderSourceSize = 0;
+    mReflection.Clear();
     mFlags &= ~AssetFlag_Loaded;
 }
 
 Shader::ShaderModule::ShaderModule(AssetHandle source, ShaderStage stage) 
-    : mModuleHandle(VK_NULL_HANDLE), mSource(AssetManager::GetAsset<Source>(source)), mStage(stage) {
+    : mModuleHandle(VK_NULL_HANDLE), mSourceHandle(source), mStage(stage) {
 }
 
 Shader::ShaderModule::~ShaderModule() {
@@ -141,17 +463,13 @@ Shader::ShaderModule::~ShaderModule() {
 }
 
 void Shader::ShaderModule::Reload() {
-    GM_ASSERT_MSG(mSource->mStage == mStage, "ShaderStage missmatch!");
-
-    if (!mSource->IsLoaded()) {
-        GM_LOG_WARNING("[ShaderModule] source asset not loaded!");
-        if (!mSource->IsLoading()) {
-            mSource->Load();
-        } else {
-            while (mSource->IsLoading()); // Wait for it to be loaded
-        }
-    }
+    // Blocks until the source is loaded
+    Source* source = AssetManager::GetAsset<Source>(mSourceHandle);
+
+    GM_VERIFY(source);
+    GM_ASSERT_MSG(source->mStage == mStage, "ShaderStage missmatch!");
 
+    // Safe to destroy right away, pipelines don't reference their modules after creation
     vkDestroyShaderModule(mDevice->GetHandle(), mModuleHandle, nullptr);
 
     VkShaderModuleCreateInfo mInfo;
@@ -159,12 +477,24 @@ void Shader::ShaderModule::Reload() {
     mInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     mInfo.pNext = nullptr;
     mInfo.flags = 0;
-    mInfo.codeSize = mSource->mShaderSourceSize;
-    mInfo.pCode = mSource->mShaderSource;
+    mInfo.codeSize = source->mShaderSourceSize;
+    mInfo.pCode = source->mShaderSource;
 
     VK(vkCreateShaderModule(mDevice->GetHandle(), &mInfo, nullptr, &mModuleHandle));
 }
 
+const uint32_t* Shader::ShaderModule::GetSourceCode() const {
+    return AssetManager::GetAsset<Source>(mSourceHandle)->mShaderSource;
+}
+
+uint32_t Shader::ShaderModule::GetSourceSize() const {
+    return AssetManager::GetAsset<Source>(mSourceHandle)->mShaderSourceSize;
+}
+
+const Shader::Reflection& Shader::ShaderModule::GetReflection() const {
+    return AssetManager::GetAsset<Source>(mSourceHandle)->mReflection;
+}
+
 Shader::Shader(Device* device) : mDevice(device) {
     
 }
@@ -179,10 +509,16 @@ void Shader::Reload() {
         shader.Reload();
     }
 
-    for (auto& [set, layout] : mDescriptorSetLayouts)
-        delete layout;
+    // Descriptor sets allocated from the old layouts may still be used by frames in flight
+    for (auto& [set, layout] : mDescriptorSetLayouts) {
+        DeletionQueue::Push([layout = layout]() { delete layout; });
+    }
 
     mDescriptorSetLayouts.clear();
+    mStageInputs.clear();
+    mUniformBuffers.clear();
+    mSampledImages.clear();
+    mPushConstants.clear();
 
     ReflectStages();
     CreateDescriptorSetLayouts();
@@ -233,11 +569,11 @@ std::vector<VkVertexInputAttributeDescription> Shader::GetVertexInputLayout(std:
             info.format = VK_FORMAT_UNDEFINED;
 
             for (auto& input : mStageInputs) {
-                if (input.Location == info.location) {
-                    info.format = Util::SPIRTypeToVkFormat(input.Type);
+                if (input.mLocation == info.location) {
+                    info.format = input.mFormat;
                     result.push_back(info);
 
-                    info.offset += input.Type.vecsize * (input.Type.width / 8);
+                    info.offset += input.mSize;
 
                     break;
                 }
@@ -251,6 +587,29 @@ std::vector<VkVertexInputAttributeDescription> Shader::GetVertexInputLayout(std:
     return result;
 }
 
+std::vector<VkVertexInputAttributeDescription> Shader::GetVertexInputLayout(uint32_t binding, const std::vector<std::pair<uint32_t, VkFormat>>& locations) const {
+    std::vector<VkVertexInputAttributeDescription> result;
+    uint32_t offset = 0;
+
+    for (auto& [location, format] : locations) {
+        bool found = false;
+
+        for (auto& input : mStageInputs) {
+            if (input.mLocation == location) {
+                found = true;
+                break;
+            }
+        }
+
+        GM_VERIFY(found);
+
+        result.push_back({ location, binding, format, offset });
+        offset += (uint32_t)GetFormatSize(format);
+    }
+
+    return result;
+}
+
 DescriptorSetLayout* Shader::GetDescriptorSetLayout(uint32_t set) const {
     GM_ASSERT(set < mDescriptorSetLayouts.size());
 
@@ -275,68 +634,13 @@ std::vector<DescriptorSetLayout*> Shader::GetDescriptorSetLayouts() const {
 }
 
 void Shader::ReflectStages() {
-    
     for (ShaderModule& shader : mModules) {
-        spirv_cross::Compiler compiler(shader.GetSourceCode(), shader.GetSourceSize() / 4);
-        spirv_cross::ShaderResources resources = compiler.get_shader_resources();
-        
-        if (shader.mStage == ShaderStage::Vertex) {
-            for (auto& input : resources.stage_inputs) {
-                uint32_t location = compiler.get_decoration(input.id, spv::DecorationLocation);
-                spirv_cross::SPIRType type = compiler.get_type(input.type_id);
+        const Reflection& reflection = shader.GetReflection();
 
-                mStageInputs.emplace_back(location, type);
-            }
-        }
-        
-        for (auto& uniform : resources.uniform_buffers) {
-            uint32_t set = compiler.get_decoration(uniform.id, spv::DecorationDescriptorSet);
-            uint32_t binding = compiler.get_decoration(uniform.id, spv::DecorationBinding);
-            spirv_cross::SPIRType type = compiler.get_type(uniform.type_id);
-
-            GM_VERIFY(type.basetype == spirv_cross::SPIRType::Struct);
-
-            uint32_t size = (uint32_t)compiler.get_declared_struct_size(type);
-
-            std::vector<UniformBufferType::Member> members;
-
-            uint32_t index = 0;
-            uint32_t offset = 0;
-            for (uint32_t i = 0; i < type.member_types.size(); i++) {
-                spirv_cross::TypeID id = type.member_types[i];
-                spirv_cross::SPIRType memberType = compiler.get_type(id);
-                UniformBufferType::Member member;
-
-                uint32_t memberSize = (uint32_t)compiler.get_declared_struct_member_size(type, index++);
-
-                member.Name = compiler.get_member_name(id, i);
-                member.Size = memberSize;
-                member.Offset = offset;
-
-                offset += member.Size;
-
-                members.push_back(member);
-            }
-
-            mUniformBuffers.emplace_back(compiler.get_name(uniform.id), shader.mStage, set, binding, size, std::move(members));
-        }
-
-        for (auto& image : resources.sampled_images) {
-            uint32_t set = compiler.get_decoration(image.id, spv::DecorationDescriptorSet);
-            uint32_t binding = compiler.get_decoration(image.id, spv::DecorationBinding);
-            spirv_cross::SPIRType type = compiler.get_type(image.type_id);
-            uint32_t count = type.array.empty() ? 1 : type.array[0];
-
-
-            mSampledImages.emplace_back(compiler.get_name(image.id), shader.mStage, set, binding, count, type.image);
-        }
-
-        for (auto& push : resources.push_constant_buffers) {
-            spirv_cross::SPIRType type = compiler.get_type(push.type_id);
-            uint32_t size = (uint32_t)compiler.get_declared_struct_size(type);
-
-            mPushConstants.push_back({ShaderStageToVkShaderStage(shader.mStage), 0, size});
-        }
+        mStageInputs.insert(mStageInputs.end(), reflection.mStageInputs.begin(), reflection.mStageInputs.end());
+        mUniformBuffers.insert(mUniformBuffers.end(), reflection.mUniformBuffers.begin(), reflection.mUniformBuffers.end());
+        mSampledImages.insert(mSampledImages.end(), reflection.mSampledImages.begin(), reflection.mSampledImages.end());
+        mPushConstants.insert(mPushConstants.end(), reflection.mPushConstants.begin(), reflection.mPushConstants.end());
     }
 }
 
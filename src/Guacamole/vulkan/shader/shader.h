@@ -35,6 +35,27 @@ namespace Guacamole {
 class Device;
 class Shader {
 public:
+    // What Shader needs to know about one stage. Extracted with spirv-cross when the source is loaded and
+    // cached next to the compiled SPIR-V
+    struct Reflection {
+        struct StageInput {
+            uint32_t mLocation;
+            VkFormat mFormat; // VK_FORMAT_UNDEFINED if the type can't be a vertex attribute
+            uint32_t mSize;
+        };
+
+        std::vector<StageInput> mStageInputs; // Vertex stage only
+        std::vector<UniformBufferType> mUniformBuffers;
+        std::vector<SampledImageType> mSampledImages;
+        std::vector<VkPushConstantRange> mPushConstants;
+
+        void Reflect(const uint32_t* code, uint32_t size, ShaderStage stage);
+        void Serialize(std::vector<uint8_t>* data) const;
+        // Returns false if the data is truncated or malformed
+        bool Deserialize(const uint8_t* data, uint64_t size, ShaderStage stage);
+        void Clear();
+    };
+
     class ShaderModule;
     class Source : public Asset {
     public:
@@ -43,15 +64,26 @@ public:
 
         bool Load() override;
         void Unload() override;
+        Asset* CreateReloadInstance() const override;
 
         inline ShaderStage GetStage() const { return mStage; }
+        inline const Reflection& GetReflection() const { return mReflection; }
 
     private:
+        // Cache entries are a CacheHeader, the SPIR-V and the serialized Reflection
+        struct CacheHeader {
+            uint32_t mCodeSize;
+            uint32_t mReflectionSize;
+        };
+
+        bool LoadCached(const uint8_t* data, uint64_t size);
+
         ShaderStage mStage;
         bool mIsSpirv;
 
         uint32_t mShaderSourceSize;
         uint32_t* mShaderSource;
+        Reflection mReflection;
 
         friend class ShaderModule;
     };
@@ -65,12 +97,14 @@ public:
 
         inline VkShaderModule GetHandle() const { return mModuleHandle; }
         inline ShaderStage GetStage() const { return mStage; }
-        inline const uint32_t* GetSourceCode() const { return mSource->mShaderSource; }
-        inline uint32_t GetSourceSize() const { return mSource->mShaderSourceSize; }
+        const uint32_t* GetSourceCode() const;
+        uint32_t GetSourceSize() const;
+        const Reflection& GetReflection() const;
 
     private:
         VkShaderModule mModuleHandle;
-        Source* mSource;
+        // Resolved on every use, the source asset is replaced on hot reload
+        AssetHandle mSourceHandle;
         ShaderStage mStage;
         Device* mDevice;
 
@@ -88,6 +122,9 @@ public:
     VkShaderModule GetHandle(ShaderStage stage) const;
 
     std::vector<VkVertexInputAttributeDescription> GetVertexInputLayout(std::vector<std::pair<uint32_t, std::vector<uint32_t>>> locations) const;
+    // For packed vertex buffers whose formats differ from what the inputs' types imply, e.g. SNORM16 into a vec3.
+    // locations are (location, format) in buffer order, the offsets follow from the format sizes
+    std::vector<VkVertexInputAttributeDescription> GetVertexInputLayout(uint32_t binding, const std::vector<std::pair<uint32_t, VkFormat>>& locations) const;
     DescriptorSetLayout* GetDescriptorSetLayout(uint32_t set) const;
     const std::vector<VkPushConstantRange>& GetPushConstants() const { return mPushConstants; }
     std::vector<DescriptorSetLayout*> GetDescriptorSetLayouts() const;
@@ -95,14 +132,7 @@ public:
 private:
     std::vector<ShaderModule> mModules;
 
-    struct StageInput {
-        StageInput(uint8_t location, spirv_cross::SPIRType type) : Location(location), Type(type) {}
-
-        uint8_t Location;
-        spirv_cross::SPIRType Type;
-    };
-
-    std::vector<StageInput> mStageInputs;
+    std::vector<Reflection::StageInput> mStageInputs;
     std::vector<UniformBufferType> mUniformBuffers;
     std::vector<SampledImageType> mSampledImages;
     std::vector<VkPushConstantRange> mPushConstants;
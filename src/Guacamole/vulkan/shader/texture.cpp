@@ -29,18 +29,167 @@ SOFTWARE.
 
 #include <Guacamole/vulkan/device.h>
 #include <Guacamole/util/util.h>
+#include <Guacamole/util/image.h>
+#include <Guacamole/util/bc.h>
+#include <Guacamole/util/texturecontainer.h>
+#include <Guacamole/vulkan/shader/texturepool.h>
+#include <Guacamole/vulkan/shader/texturestreamer.h>
 #include <Guacamole/vulkan/util.h>
 #include <Guacamole/vulkan/buffer/stagingbuffer.h>
+#include <Guacamole/asset/assetmanager.h>
+#include <Guacamole/asset/assetcache.h>
 
 #include <stb_image.h>
 
+#include <chrono>
+
 namespace Guacamole {
 
+// Layout of a cooked texture in the AssetCache, followed by the texels or blocks of every mip
+struct CookedTextureHeader {
+    uint32_t mWidth;
+    uint32_t mHeight;
+    VkFormat mFormat;
+    uint32_t mMipLevels;
+    VkComponentMapping mSwizzle;
+};
+
+// Everything that changes the decoded output
+struct TextureCookParams {
+    uint32_t mKeepSourceChannels;
+    uint32_t mGenerateMips;
+    TextureCompression mCompression;
+};
+
+static const TextureCookParams sTextureCookParams = { 1, 1, TextureCompression::None };
+
+// Format the decoded texels are uploaded as, the swizzle makes shaders see RGBA either way.
+// There's no widely supported 3 byte format so RGB is expanded to RGBA
+static VkFormat GetUncompressedFormat(uint32_t channels, VkComponentMapping* swizzle) {
+    switch (channels) {
+        case 1:
+            *swizzle = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+            return VK_FORMAT_R8_UNORM;
+        case 2:
+            *swizzle = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G };
+            return VK_FORMAT_R8G8_UNORM;
+        default:
+            *swizzle = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+            return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+// Decodes texelCount texels with the given channel count into dst. RGB is decoded into the back of dst
+// and expanded to RGBA in place, stb's own expansion is one texel at a time
+static bool DecodeTexels(const uint8_t* data, uint64_t size, uint32_t channels, uint8_t* dst, uint64_t texelCount) {
+    if (channels != 3) return Util::DecodeImage(data, size, channels, dst, texelCount * channels);
+
+    uint8_t* rgb = dst + texelCount;
+
+    if (!Util::DecodeImage(data, size, 3, rgb, texelCount * 3)) return false;
+
+    Util::ExpandRGBToRGBA(rgb, dst, texelCount);
+
+    return true;
+}
+
+static bool IsCookedFormat(VkFormat format) {
+    return format == VK_FORMAT_R8_UNORM || format == VK_FORMAT_R8G8_UNORM || format == VK_FORMAT_R8G8B8A8_UNORM || IsBlockCompressedFormat(format);
+}
+
+static uint64_t GetChainSize(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) {
+    uint64_t size = 0;
+
+    for (uint32_t mip = 0; mip < mipLevels; mip++) {
+        size += GetImageSize(format, Util::GetMipDimension(width, mip), Util::GetMipDimension(height, mip));
+    }
+
+    return size;
+}
+
+// Points levels at every level of a tightly packed chain
+static void GetChainLevels(const uint8_t* chain, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, const uint8_t** levels) {
+    for (uint32_t mip = 0; mip < mipLevels; mip++) {
+        levels[mip] = chain;
+        chain += GetImageSize(format, Util::GetMipDimension(width, mip), Util::GetMipDimension(height, mip));
+    }
+}
+
+static bool IsCookedImageValid(const uint8_t* data, uint64_t size) {
+    const CookedTextureHeader* header = (const CookedTextureHeader*)data;
+
+    return size >= sizeof(CookedTextureHeader) && IsCookedFormat(header->mFormat) && header->mMipLevels != 0 && 
+           header->mMipLevels <= std::min(Util::GetMipLevelCount(header->mWidth, header->mHeight), Texture2D::MaxMipLevels) &&
+           size - sizeof(CookedTextureHeader) == GetChainSize(header->mFormat, header->mWidth, header->mHeight, header->mMipLevels);
+}
+
+// Compresses every level of an RGBA8 chain, the BC format is picked from the channels level 0 uses.
+// Returns the compressed chain, format and swizzle say how it's sampled so shaders still see RGBA
+static uint8_t* CompressMipChain(uint8_t* chain, uint32_t width, uint32_t height, uint32_t mipLevels, TextureCompression compression, VkFormat* format, VkComponentMapping* swizzle, uint64_t* size) {
+    Util::BCQuality quality = compression == TextureCompression::Best ? Util::BCQuality::Best : Util::BCQuality::Fast;
+    Util::ImageChannels channels = Util::GetImageChannels(chain, width, height);
+    Util::BCFormat bcFormat;
+
+    *swizzle = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+
+    switch (channels) {
+        case Util::ImageChannels::Gray:
+            bcFormat = Util::BCFormat::BC4;
+            *format = VK_FORMAT_BC4_UNORM_BLOCK;
+            *swizzle = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+            break;
+        case Util::ImageChannels::GrayAlpha: {
+            // Gray in R and alpha in G
+            uint64_t chainSize = Util::GetMipChainSize(width, height, mipLevels, 4);
+
+            for (uint64_t i = 0; i < chainSize; i += 4) {
+                chain[i + 1] = chain[i + 3];
+            }
+
+            bcFormat = Util::BCFormat::BC5;
+            *format = VK_FORMAT_BC5_UNORM_BLOCK;
+            *swizzle = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G };
+            break;
+        }
+        case Util::ImageChannels::RG:
+            bcFormat = Util::BCFormat::BC5;
+            *format = VK_FORMAT_BC5_UNORM_BLOCK;
+            *swizzle = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_ZERO, VK_COMPONENT_SWIZZLE_ONE };
+            break;
+        case Util::ImageChannels::RGB:
+            bcFormat = quality == Util::BCQuality::Best ? Util::BCFormat::BC7 : Util::BCFormat::BC1;
+            *format = quality == Util::BCQuality::Best ? VK_FORMAT_BC7_UNORM_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+            break;
+        default:
+            bcFormat = quality == Util::BCQuality::Best ? Util::BCFormat::BC7 : Util::BCFormat::BC3;
+            *format = quality == Util::BCQuality::Best ? VK_FORMAT_BC7_UNORM_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+            break;
+    }
+
+    *size = GetChainSize(*format, width, height, mipLevels);
+
+    uint8_t* compressed = new uint8_t[*size];
+    const uint8_t* src = chain;
+    uint8_t* dst = compressed;
+
+    for (uint32_t mip = 0; mip < mipLevels; mip++) {
+        uint32_t mipWidth = Util::GetMipDimension(width, mip);
+        uint32_t mipHeight = Util::GetMipDimension(height, mip);
+
+        Util::CompressBC(src, mipWidth, mipHeight, bcFormat, quality, dst);
+
+        src += (uint64_t)mipWidth * mipHeight * 4;
+        dst += Util::GetBCImageSize(mipWidth, mipHeight, bcFormat);
+    }
+
+    return compressed;
+}
+
 Texture::Texture(Device* device, const std::filesystem::path& path) 
     : Asset(path, AssetType::Texture),
-    mImageMemory(VK_NULL_HANDLE), mImageHandle(VK_NULL_HANDLE), mImageViewHandle(VK_NULL_HANDLE), mDevice(device) {}
+    mImageMemory(VK_NULL_HANDLE), mImageHandle(VK_NULL_HANDLE), mImageViewHandle(VK_NULL_HANDLE), mLayer(0), mViewVersion(0), mDevice(device) {}
 
-void Texture::CreateImage(VkImageUsageFlags usage, VkExtent3D extent, VkImageType imageType, VkFormat format, VkSampleCountFlagBits samples, VkImageLayout initialLayout) {
+void Texture::CreateImage(VkImageUsageFlags usage, VkExtent3D extent, VkImageType imageType, VkFormat format, VkSampleCountFlagBits samples, VkImageLayout initialLayout, uint32_t mipLevels, uint32_t arrayLayers) {
     VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL;
     VkImageFormatProperties prop;
 
@@ -65,8 +214,8 @@ void Texture::CreateImage(VkImageUsageFlags usage, VkExtent3D extent, VkImageTyp
     mImageInfo.imageType = imageType;
     mImageInfo.format = format;
     mImageInfo.extent = extent;
-    mImageInfo.mipLevels = 1;
-    mImageInfo.arrayLayers = 1;
+    mImageInfo.mipLevels = mipLevels;
+    mImageInfo.arrayLayers = arrayLayers;
     mImageInfo.samples = samples;
     mImageInfo.tiling = tiling;
     mImageInfo.usage = usage;
@@ -89,15 +238,26 @@ void Texture::CreateImage(VkImageUsageFlags usage, VkExtent3D extent, VkImageTyp
 
     VK(vkAllocateMemory(mDevice->GetHandle(), &aInfo, nullptr, &mImageMemory));
     VK(vkBindImageMemory(mDevice->GetHandle(), mImageHandle, mImageMemory, 0));
+
+    mMemoryUsage = memReq.size;
 }
 
-Texture::~Texture() {
+void Texture::DestroyImage() {
     vkFreeMemory(mDevice->GetHandle(), mImageMemory, nullptr);
     vkDestroyImage(mDevice->GetHandle(), mImageHandle, nullptr);
     vkDestroyImageView(mDevice->GetHandle(), mImageViewHandle, nullptr);
+
+    mImageMemory = VK_NULL_HANDLE;
+    mImageHandle = VK_NULL_HANDLE;
+    mImageViewHandle = VK_NULL_HANDLE;
+    mMemoryUsage = 0;
 }
 
-void Texture::Transition(VkImageLayout oldLayout, VkImageLayout newLayout, CommandBuffer* commandBuffer) {
+Texture::~Texture() {
+    DestroyImage();
+}
+
+void Texture::Transition(VkImageLayout oldLayout, VkImageLayout newLayout, CommandBuffer* commandBuffer, uint32_t baseMip, uint32_t mipCount) {
 
     VkImageMemoryBarrier bar;
 
@@ -111,9 +271,9 @@ void Texture::Transition(VkImageLayout oldLayout, VkImageLayout newLayout, Comma
     bar.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     bar.image = mImageHandle;
     bar.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    bar.subresourceRange.baseMipLevel = 0;
-    bar.subresourceRange.levelCount = 1;
-    bar.subresourceRange.baseArrayLayer = 0;
+    bar.subresourceRange.baseMipLevel = baseMip;
+    bar.subresourceRange.levelCount = mipCount;
+    bar.subresourceRange.baseArrayLayer = mLayer;
     bar.subresourceRange.layerCount = 1;
 
     VkPipelineStageFlags src = VK_PIPELINE_STAGE_NONE;
@@ -128,6 +288,10 @@ void Texture::Transition(VkImageLayout oldLayout, VkImageLayout newLayout, Comma
             src = VK_PIPELINE_STAGE_TRANSFER_BIT;
             bar.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
             break;
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            src = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            bar.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            break;
         case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
             src = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
             bar.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
@@ -146,6 +310,10 @@ void Texture::Transition(VkImageLayout oldLayout, VkImageLayout newLayout, Comma
             dst = VK_PIPELINE_STAGE_TRANSFER_BIT;
             bar.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
             break;
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            dst = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            bar.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            break;
         default:
             GM_ASSERT_MSG(false, "Transition not implemented");
             break;
@@ -155,39 +323,57 @@ void Texture::Transition(VkImageLayout oldLayout, VkImageLayout newLayout, Comma
     
 }
 
-uint64_t Texture::GetImageBufferSize() const {
-    return GetWidth() * GetHeight() * GetFormatSize(mImageInfo.format);
+uint64_t Texture::GetImageBufferSize(uint32_t mip) const {
+    VkExtent3D extent = GetMipExtent(mip);
+
+    return GetImageSize(mImageInfo.format, extent.width, extent.height) * extent.depth;
 }
 
+VkExtent3D Texture::GetMipExtent(uint32_t mip) const {
+    GM_ASSERT(mip < mImageInfo.mipLevels);
+
+    const VkExtent3D& extent = mImageInfo.extent;
+
+    return { Util::GetMipDimension(extent.width, mip), Util::GetMipDimension(extent.height, mip), Util::GetMipDimension(extent.depth, mip) };
+}
 
-void Texture2D::CreateImageView(VkFormat format) {
+
+void Texture::CreateImageView(VkFormat format, VkComponentMapping swizzle) {
     mViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     mViewInfo.pNext = nullptr;
     mViewInfo.flags = 0;
     mViewInfo.image = mImageHandle;
-    mViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    mViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
     mViewInfo.format = format;
-    mViewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+    mViewInfo.components = swizzle;
     mViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     mViewInfo.subresourceRange.baseMipLevel = 0;
-    mViewInfo.subresourceRange.levelCount = 1;
+    mViewInfo.subresourceRange.levelCount = mImageInfo.mipLevels;
     mViewInfo.subresourceRange.baseArrayLayer = 0;
-    mViewInfo.subresourceRange.layerCount = 1;
+    mViewInfo.subresourceRange.layerCount = mImageInfo.arrayLayers;
 
     VK(vkCreateImageView(mDevice->GetHandle(), &mViewInfo, nullptr, &mImageViewHandle));
 }
 
-Texture2D::Texture2D(Device* device, uint32_t width, uint32_t height, VkFormat format) : Texture(device, "") {
+TextureCompression Texture2D::mCompression = TextureCompression::None;
+
+Texture2D::Texture2D(Device* device, uint32_t width, uint32_t height, VkFormat format) 
+    : Texture(device, ""), mArray(nullptr), mStreamSource(), mStreamId(0), mResidentMip(0), mTailMip(0), mFirstStreamableMip(0), mStreamPending(false), mStreamPriority(0.0f) {
     CreateImage(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, { width, height, 1 }, VK_IMAGE_TYPE_2D, format, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
     CreateImageView(format);
 
     mFlags |= AssetFlag_Loaded;
 }
 
-Texture2D::Texture2D(Device* device, const std::filesystem::path& path) : Texture(device, path) {
+Texture2D::Texture2D(Device* device, const std::filesystem::path& path) 
+    : Texture(device, path), mArray(nullptr), mStreamSource(), mStreamId(0), mResidentMip(0), mTailMip(0), mFirstStreamableMip(0), mStreamPending(false), mStreamPriority(0.0f) {
 
 }
 
+Texture2D::~Texture2D() {
+    ReleaseStorage();
+}
+
 bool Texture2D::Load() {
     GM_ASSERT_MSG(!(mFlags & AssetFlag_Loaded), "Texture already loaded");
 
@@ -197,35 +383,276 @@ bool Texture2D::Load() {
 }
 
 void Texture2D::Unload() {
+    ReleaseStorage();
+
     mFlags &= ~AssetFlag_Loaded;
 }
 
-void Texture2D::LoadImageFromMemory(uint8_t* data, uint64_t size) {
+Asset* Texture2D::CreateReloadInstance() const {
+    return new Texture2D(mDevice, mFilePath);
+}
+
+void Texture2D::SetCompression(TextureCompression compression) {
+    mCompression = compression;
+}
+
+void Texture2D::CreateStorage(uint32_t width, uint32_t height, VkFormat format, uint32_t mipLevels, VkComponentMapping swizzle, uint32_t residentMip) {
+    GM_ASSERT(mipLevels <= MaxMipLevels && residentMip < mipLevels);
+
+    mResidentMip = residentMip;
+    // Layers can't change their level count, so streamed textures always get their own image
+    mArray = residentMip == 0 ? TexturePool::Allocate(mDevice, width, height, format, mipLevels, swizzle, &mLayer) : nullptr;
+
+    if (mArray == nullptr) {
+        VkExtent3D extent = { Util::GetMipDimension(width, residentMip), Util::GetMipDimension(height, residentMip), 1 };
+
+        CreateImage(VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, extent, VK_IMAGE_TYPE_2D, format, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, mipLevels - residentMip);
+        CreateImageView(format, swizzle);
+        return;
+    }
+
+    // Shares the image and view, uploads go to mLayer. The pool counts the whole array against the budget, the
+    // layer alone frees nothing so the texture reports no memory and is never evicted
+    mImageHandle = mArray->GetImageHandle();
+    mImageViewHandle = mArray->GetImageViewHandle();
+    mImageInfo = mArray->GetImageInfo();
+    mViewInfo = mArray->GetViewInfo();
+    mMemoryUsage = 0;
+}
+
+void Texture2D::ReleaseStorage() {
+    if (mStreamId != 0) TextureStreamer::Unregister(this);
+
+    mResidentMip = 0;
+
+    if (mArray == nullptr) {
+        DestroyImage();
+        return;
+    }
+
+    TexturePool::Free(mArray, mLayer);
+
+    mArray = nullptr;
+    mLayer = 0;
+    mImageHandle = VK_NULL_HANDLE;
+    mImageViewHandle = VK_NULL_HANDLE;
+    mMemoryUsage = 0;
+}
+
+bool Texture2D::CheckStagingSpace(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t residentMip) const {
+    StagingBuffer* stagingBuffer = StagingManager::GetCommonStagingBuffer();
+    bool flush = !AssetManager::IsMainThread();
+    uint64_t needed = 0;
+
+    for (uint32_t mip = residentMip; mip < mipLevels; mip++) {
+        // The 16 covers the alignment AllocateImage adds
+        uint64_t mipSize = GetImageSize(format, Util::GetMipDimension(width, mip), Util::GetMipDimension(height, mip)) + 16;
+
+        needed = flush ? std::max(needed, mipSize) : needed + mipSize;
+    }
+
+    uint64_t available = stagingBuffer->GetSize() - (flush ? 0 : stagingBuffer->GetAllocated());
+
+    if (needed <= available) return true;
+
+    GM_LOG_CRITICAL("[Texture2D] \"{}\" {}x{} needs {:.2f}MB of staging, {:.2f}MB is available{}", GetPathAsString().c_str(), width, height, 
+        needed / 1000000.0, available / 1000000.0, flush ? "" : ", load it on a loader thread");
+
+    return false;
+}
+
+bool Texture2D::UploadLevels(const uint8_t* const* levels, bool flush) {
+    StagingBuffer* stagingBuffer = StagingManager::GetCommonStagingBuffer();
+
+    for (uint32_t mip = 0; mip < mImageInfo.mipLevels; mip++) {
+        uint64_t mipSize = GetImageBufferSize(mip);
+
+        // The 16 covers the alignment AllocateImage adds
+        if (stagingBuffer->GetAllocated() + mipSize + 16 > stagingBuffer->GetSize()) {
+            // CheckStagingSpace is called before the storage is created, this is only hit if it wasn't
+            if (!flush || mipSize + 16 > stagingBuffer->GetSize()) {
+                GM_LOG_CRITICAL("[Texture2D] \"{}\" doesn't fit in the staging buffer", GetPathAsString().c_str());
+                return false;
+            }
+
+            if (!StagingManager::FlushStagingBuffer(stagingBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT)) return false;
+        }
+
+        memcpy(stagingBuffer->AllocateImage(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, this, mip), levels[mResidentMip + mip], mipSize);
+    }
+
+    return true;
+}
+
+void Texture2D::GenerateMips(CommandBuffer* commandBuffer) {
+    for (uint32_t mip = 1; mip < mImageInfo.mipLevels; mip++) {
+        VkExtent3D srcExtent = GetMipExtent(mip - 1);
+        VkExtent3D dstExtent = GetMipExtent(mip);
+
+        VkImageBlit blit;
+
+        blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - 1, mLayer, 1 };
+        blit.srcOffsets[0] = { 0, 0, 0 };
+        blit.srcOffsets[1] = { (int32_t)srcExtent.width, (int32_t)srcExtent.height, 1 };
+        blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, mLayer, 1 };
+        blit.dstOffsets[0] = { 0, 0, 0 };
+        blit.dstOffsets[1] = { (int32_t)dstExtent.width, (int32_t)dstExtent.height, 1 };
+
+        // Linear filtering at half size averages 2x2 texels, the same box filter the CPU chains use
+        Transition(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, commandBuffer, mip, 1);
+        vkCmdBlitImage(commandBuffer->GetHandle(), mImageHandle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mImageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+        Transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, commandBuffer, mip, 1);
+    }
+
+    Transition(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, commandBuffer, 0, mImageInfo.mipLevels);
+}
+
+void Texture2D::SetStreamSource(const TextureStreamSource& source) {
+    if (mResidentMip == 0) return;
+
+    mStreamSource = source;
+
+    TextureStreamer::Register(this);
+}
+
+void Texture2D::RequestStreaming(float screenSize) {
+    if (mStreamId == 0) return;
+
+    uint32_t extent = std::max(mStreamSource.mWidth, mStreamSource.mHeight);
+    uint32_t mip = mTailMip;
+
+    // Aims for a texel per pixel, as if the texture is mapped across the whole mesh once
+    if (screenSize >= 1.0f) {
+        mip = std::min((uint32_t)std::max(std::log2((float)extent / screenSize), 0.0f), mTailMip);
+    }
+
+    mip = std::max(mip, mFirstStreamableMip);
+
+    // 0 means never requested
+    mMipRequestFrames[mip] = AssetManager::GetFrameIndex() + 1;
+    mStreamPriority = std::max(mStreamPriority, screenSize);
+}
+
+uint32_t Texture2D::GetWantedMip(uint64_t frame, uint64_t unusedFrames) const {
+    for (uint32_t mip = mFirstStreamableMip; mip < mTailMip; mip++) {
+        uint64_t requested = mMipRequestFrames[mip];
+
+        if (requested != 0 && requested - 1 + unusedFrames > frame) return mip;
+    }
+
+    return mTailMip;
+}
+
+bool Texture2D::LoadStreamedLevels(const TextureStreamSource& source, uint32_t residentMip) {
+    AssetData data;
+    const uint8_t* levels[MaxMipLevels];
+
+    if (source.mCacheKey != 0) {
+        bool valid = AssetCache::Load(source.mCacheKey, &data) && IsCookedImageValid(data.GetData(), data.GetSize());
+        const CookedTextureHeader* header = (const CookedTextureHeader*)data.GetData();
+
+        if (!valid || header->mWidth != source.mWidth || header->mHeight != source.mHeight || header->mFormat != source.mFormat || header->mMipLevels != source.mMipLevels) {
+            GM_LOG_WARNING("[Texture2D] Cooked data for a streamed texture is missing or changed");
+            return false;
+        }
+
+        GetChainLevels(data.GetData() + sizeof(CookedTextureHeader), source.mFormat, source.mWidth, source.mHeight, source.mMipLevels, levels);
+    } else {
+        Util::TextureContainer container;
+
+        if (!AssetManager::ReadAssetData(source.mPath, &data) || !Util::ParseTextureContainer(data.GetData(), data.GetSize(), &container) ||
+            container.mWidth != source.mWidth || container.mHeight != source.mHeight || container.mFormat != source.mFormat || container.mMipLevels != source.mMipLevels) {
+            GM_LOG_WARNING("[Texture2D] \"{}\" is missing or changed, can't stream its levels", source.mPath.string().c_str());
+            return false;
+        }
+
+        for (uint32_t mip = 0; mip < container.mMipLevels; mip++) {
+            levels[mip] = container.mLevels[mip];
+        }
+    }
+
+    CreateStorage(source.mWidth, source.mHeight, source.mFormat, source.mMipLevels, source.mSwizzle, residentMip);
+
+    return UploadLevels(levels, true);
+}
+
+void Texture2D::SwapStorage(Texture2D* other) {
+    GM_ASSERT(mArray == nullptr && other->mArray == nullptr);
+
+    std::swap(mImageHandle, other->mImageHandle);
+    std::swap(mImageMemory, other->mImageMemory);
+    std::swap(mImageViewHandle, other->mImageViewHandle);
+    std::swap(mImageInfo, other->mImageInfo);
+    std::swap(mViewInfo, other->mViewInfo);
+    std::swap(mResidentMip, other->mResidentMip);
+
+    uint64_t memoryUsage = mMemoryUsage;
+    mMemoryUsage = other->mMemoryUsage;
+    other->mMemoryUsage = memoryUsage;
+
+    mViewVersion++;
+}
+
+TextureCompression Texture2D::GetEffectiveCompression() const {
+    if (mCompression != TextureCompression::None && !(mDevice->GetFeatures() & Device::FeatureTextureCompressionBC)) {
+        return TextureCompression::None;
+    }
+
+    return mCompression;
+}
+
+void Texture2D::LoadImageFromMemory(const uint8_t* data, uint64_t size) {
     GM_ASSERT(data);
     GM_ASSERT(size);
 
-    LoadImageInternal(data, size);
+    bool loaded = Util::IsTextureContainer(data, size) ? LoadContainer(data, size, "") : LoadImageInternal(data, size, 0);
 
-    mFlags |= AssetFlag_Loaded;
+    if (loaded) {
+        mFlags |= AssetFlag_Loaded;
+    }
 }
 
 void Texture2D::LoadImageFromFile(const std::filesystem::path& path) {
     GM_ASSERT(path.empty() == false);
 
-    uint64_t fileSize = 0;
+    AssetData data;
 
-    uint8_t* data = Util::ReadFile(path, &fileSize);
+    if (!AssetManager::ReadAssetData(path, &data)) return;
 
-    if (data == nullptr) return;
+    // Already GPU ready, there's nothing to cook
+    if (Util::IsTextureContainer(data.GetData(), data.GetSize())) {
+        if (LoadContainer(data.GetData(), data.GetSize(), path)) {
+            mFlags |= AssetFlag_Loaded;
+        }
 
-    LoadImageInternal(data, fileSize);
+        return;
+    }
 
-    mFlags |= AssetFlag_Loaded;
+    uint64_t cacheKey = 0;
+
+    if (AssetCache::IsEnabled()) {
+        TextureCookParams params = sTextureCookParams;
+        params.mCompression = GetEffectiveCompression();
+
+        cacheKey = AssetCache::MakeKey(data.GetData(), data.GetSize(), &params, sizeof(TextureCookParams));
+
+        AssetData cooked;
+
+        if (AssetCache::Load(cacheKey, &cooked) && LoadCookedImage(cooked.GetData(), cooked.GetSize(), cacheKey)) {
+            mFlags |= AssetFlag_Loaded;
+            return;
+        }
+
+        // The cooked data was fine but the upload was cancelled, the storage can't be created again
+        if (mImageHandle != VK_NULL_HANDLE) return;
+    }
 
-    delete data;
+    if (LoadImageInternal(data.GetData(), data.GetSize(), cacheKey)) {
+        mFlags |= AssetFlag_Loaded;
+    }
 }
 
-void Texture2D::LoadImageInternal(uint8_t* data, uint64_t size) {
+bool Texture2D::LoadImageInternal(const uint8_t* data, uint64_t size, uint64_t cacheKey) {
     GM_ASSERT(data);
     GM_ASSERT(size);
 
@@ -233,19 +660,175 @@ void Texture2D::LoadImageInternal(uint8_t* data, uint64_t size) {
     int32_t height;
     int32_t channels;
 
-    uint8_t* pixels = stbi_load_from_memory(data, (int32_t)size, &width, &height, &channels, 4);
+    // Only parses the header, the image is created before decoding so it can be decoded straight into staging
+    if (!stbi_info_from_memory(data, (int32_t)size, &width, &height, &channels)) {
+        GM_LOG_CRITICAL("[Texture2D] \"{}\" isn't a supported image: {}", GetPathAsString().c_str(), stbi_failure_reason());
+        return false;
+    }
 
-    if (pixels == nullptr) {
-        GM_LOG_CRITICAL("stbi_load_from_memory({0}, {1}, {2}, {3}, {4}, {5}) failed", uint64_t(data), size, width, height, channels, 4);
-        return;
+    TextureCompression compression = GetEffectiveCompression();
+    // The BC encoder takes RGBA and picks the format from what the channels contain
+    uint32_t decodeChannels = compression != TextureCompression::None && channels < 3 ? 4 : channels;
+    VkComponentMapping swizzle;
+    VkFormat format = GetUncompressedFormat(decodeChannels, &swizzle);
+    uint32_t texelSize = (uint32_t)GetFormatSize(format);
+    uint32_t mipLevels = sTextureCookParams.mGenerateMips ? Util::GetMipLevelCount(width, height) : 1;
+    uint64_t texelCount = (uint64_t)width * height;
+    uint64_t pixelSize = texelCount * texelSize;
+    uint64_t chainSize = Util::GetMipChainSize(width, height, mipLevels, texelSize);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Staging memory is slow to read back, so when the image is uploaded as is level 0 is decoded straight into staging
+    // and the GPU blits the smaller levels from it. Compressing and caching need the whole chain in a heap buffer.
+    // RGB is expanded in place, which reads the decoded texels back. Level 0 has to fit in what's left of the staging
+    // buffer, otherwise the heap chain is uploaded a level at a time (or rejected if a level is larger than the buffer)
+    StagingBuffer* stagingBuffer = StagingManager::GetCommonStagingBuffer();
+    // The 16 covers the alignment AllocateImage adds
+    bool fitsInStaging = stagingBuffer->GetAllocated() + pixelSize + 16 <= stagingBuffer->GetSize();
+
+    if (cacheKey == 0 && compression == TextureCompression::None && decodeChannels != 3 && fitsInStaging) {
+        CreateStorage(width, height, format, mipLevels, swizzle);
+
+        // R8, R8G8 and R8G8B8A8 UNORM must support linear blits, there's nothing to check
+        void* staging = stagingBuffer->AllocateImage(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, this, 0);
+
+        GenerateMips(stagingBuffer->GetCommandBuffer());
+
+        if (!DecodeTexels(data, size, decodeChannels, (uint8_t*)staging, texelCount)) {
+            // The copy is already recorded and the staging buffer may be submitted anyway (sync loads on the main thread),
+            // so the image has to stay alive. It's destroyed with the texture
+            memset(staging, 0, pixelSize);
+            return false;
+        }
+
+        auto decoded = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration_cast<std::chrono::microseconds>(decoded - start).count() / 1000000.0;
+
+        GM_LOG_DEBUG("[Texture2D] Decoded \"{}\" {}x{}x{} in {:.2f}ms ({:.1f}MB/s) into staging, {} mips", GetPathAsString().c_str(), width, height, channels, 
+            seconds * 1000.0, pixelSize / 1000000.0 / seconds, mipLevels);
+
+        return true;
+    }
+
+    uint8_t* chain = new uint8_t[chainSize];
+
+    if (!DecodeTexels(data, size, decodeChannels, chain, texelCount)) {
+        delete[] chain;
+        return false;
+    }
+
+    auto decoded = std::chrono::high_resolution_clock::now();
+
+    Util::GenerateMipChain(chain, width, height, mipLevels, texelSize);
+
+    auto mipped = std::chrono::high_resolution_clock::now();
+
+    // The image format depends on what the compressor picks, so the image is created after it's done
+    uint8_t* texels = chain;
+    uint64_t texelsSize = chainSize;
+
+    if (compression != TextureCompression::None) {
+        texels = CompressMipChain(chain, width, height, mipLevels, compression, &format, &swizzle, &texelsSize);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    double decodeSeconds = std::chrono::duration_cast<std::chrono::microseconds>(decoded - start).count() / 1000000.0;
+    double mipSeconds = std::chrono::duration_cast<std::chrono::microseconds>(mipped - decoded).count() / 1000000.0;
+    double compressSeconds = std::chrono::duration_cast<std::chrono::microseconds>(end - mipped).count() / 1000000.0;
+
+    GM_LOG_DEBUG("[Texture2D] Decoded \"{}\" {}x{}x{} in {:.2f}ms ({:.1f}MB/s), {} mips in {:.2f}ms, compressed to {:.2f}MB in {:.2f}ms", GetPathAsString().c_str(), width, height, channels, 
+        decodeSeconds * 1000.0, pixelSize / 1000000.0 / decodeSeconds, mipLevels, mipSeconds * 1000.0, texelsSize / 1000000.0, compressSeconds * 1000.0);
+
+    bool cached = false;
+
+    if (cacheKey != 0) {
+        CookedTextureHeader header = { (uint32_t)width, (uint32_t)height, format, mipLevels, swizzle };
+
+        cached = AssetCache::Store(cacheKey, { { &header, sizeof(CookedTextureHeader) }, { texels, texelsSize } });
+    }
+
+    // Only what's cached can be streamed back in later
+    uint32_t residentMip = cached ? TextureStreamer::GetInitialMip(width, height, mipLevels) : 0;
+    const uint8_t* levels[MaxMipLevels];
+
+    if (!CheckStagingSpace(format, width, height, mipLevels, residentMip)) {
+        if (texels != chain) delete[] texels;
+        delete[] chain;
+        return false;
+    }
+
+    CreateStorage(width, height, format, mipLevels, swizzle, residentMip);
+    GetChainLevels(texels, format, width, height, mipLevels, levels);
+
+    bool uploaded = UploadLevels(levels, !AssetManager::IsMainThread());
+
+    if (uploaded) SetStreamSource({ "", cacheKey, (uint32_t)width, (uint32_t)height, mipLevels, format, swizzle });
+
+    if (texels != chain) delete[] texels;
+    delete[] chain;
+
+    return uploaded;
+}
+
+bool Texture2D::LoadCookedImage(const uint8_t* data, uint64_t size, uint64_t cacheKey) {
+    if (!IsCookedImageValid(data, size)) {
+        GM_LOG_WARNING("[Texture2D] Cooked data for \"{}\" is invalid", GetPathAsString().c_str());
+        return false;
     }
 
-    CreateImage(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, { (uint32_t)width, (uint32_t)height, 1 }, VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
-    CreateImageView(VK_FORMAT_R8G8B8A8_UNORM);
+    const CookedTextureHeader* header = (const CookedTextureHeader*)data;
+    uint32_t residentMip = TextureStreamer::GetInitialMip(header->mWidth, header->mHeight, header->mMipLevels);
+    const uint8_t* levels[MaxMipLevels];
+
+    if (!CheckStagingSpace(header->mFormat, header->mWidth, header->mHeight, header->mMipLevels, residentMip)) return false;
+
+    CreateStorage(header->mWidth, header->mHeight, header->mFormat, header->mMipLevels, header->mSwizzle, residentMip);
+    GetChainLevels(data + sizeof(CookedTextureHeader), header->mFormat, header->mWidth, header->mHeight, header->mMipLevels, levels);
+
+    if (!UploadLevels(levels, !AssetManager::IsMainThread())) return false;
+
+    SetStreamSource({ "", cacheKey, header->mWidth, header->mHeight, header->mMipLevels, header->mFormat, header->mSwizzle });
+
+    return true;
+}
+
+bool Texture2D::LoadContainer(const uint8_t* data, uint64_t size, const std::filesystem::path& path) {
+    Util::TextureContainer container;
+
+    if (!Util::ParseTextureContainer(data, size, &container) || container.mMipLevels > MaxMipLevels) {
+        GM_LOG_CRITICAL("[Texture2D] \"{}\" isn't a supported DDS/KTX2 file", GetPathAsString().c_str());
+        return false;
+    }
+
+    if (IsBlockCompressedFormat(container.mFormat) && !(mDevice->GetFeatures() & Device::FeatureTextureCompressionBC)) {
+        GM_LOG_CRITICAL("[Texture2D] \"{}\" is block compressed but the device doesn't support BC formats", GetPathAsString().c_str());
+        return false;
+    }
+
+    // Levels can only be streamed back in from a file
+    uint32_t residentMip = path.empty() ? 0 : TextureStreamer::GetInitialMip(container.mWidth, container.mHeight, container.mMipLevels);
+
+    if (!CheckStagingSpace(container.mFormat, container.mWidth, container.mHeight, container.mMipLevels, residentMip)) return false;
+
+    CreateStorage(container.mWidth, container.mHeight, container.mFormat, container.mMipLevels, container.mSwizzle, residentMip);
+
+    uint64_t totalSize = 0;
+
+    for (uint32_t mip = 0; mip < GetMipLevels(); mip++) {
+        GM_ASSERT(GetImageBufferSize(mip) == container.mLevelSizes[residentMip + mip]);
+
+        totalSize += container.mLevelSizes[residentMip + mip];
+    }
+
+    if (!UploadLevels(container.mLevels, !AssetManager::IsMainThread())) return false;
+
+    SetStreamSource({ path, 0, container.mWidth, container.mHeight, container.mMipLevels, container.mFormat, container.mSwizzle });
 
-    memcpy(StagingManager::GetCommonStagingBuffer()->AllocateImage(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, this), pixels, width * height * 4);
+    GM_LOG_DEBUG("[Texture2D] Uploaded \"{}\" {}x{} with {} of {} mips, {:.2f}MB", GetPathAsString().c_str(), container.mWidth, container.mHeight, 
+        GetMipLevels(), container.mMipLevels, totalSize / 1000000.0);
 
-    free(pixels);
+    return true;
 }
 
 DepthTexture::DepthTexture(Device* device, VkFormat format, uint32_t width, uint32_t height) : Texture(device, "") {
@@ -34,27 +34,45 @@ SOFTWARE.
 
 namespace Guacamole {
 
+// Block compression applied when textures are cooked, ignored if the device doesn't support BC formats
+enum class TextureCompression {
+    None,
+    Fast,
+    Best
+};
+
 class Device;
 class Texture : public Asset {
 protected:
     Texture(Device* device, const std::filesystem::path& path);
 
-    void CreateImage(VkImageUsageFlags usage, VkExtent3D extent, VkImageType imageType, VkFormat format, VkSampleCountFlagBits samples, VkImageLayout initialLayout);
+    void CreateImage(VkImageUsageFlags usage, VkExtent3D extent, VkImageType imageType, VkFormat format, VkSampleCountFlagBits samples, VkImageLayout initialLayout, uint32_t mipLevels = 1, uint32_t arrayLayers = 1);
+    // Color textures are viewed as arrays covering every layer and mip, so the scene shader samples
+    // pooled and standalone textures the same way
+    void CreateImageView(VkFormat format, VkComponentMapping swizzle = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A });
+    void DestroyImage();
 
 public:
     virtual ~Texture();
 
-    void Transition(VkImageLayout oldLayout, VkImageLayout newLayout, CommandBuffer* commandBuffer);
-    uint64_t GetImageBufferSize() const;
+    // Transitions mipCount levels starting at baseMip of the texture's layer, all of them by default
+    void Transition(VkImageLayout oldLayout, VkImageLayout newLayout, CommandBuffer* commandBuffer, uint32_t baseMip = 0, uint32_t mipCount = VK_REMAINING_MIP_LEVELS);
+    uint64_t GetImageBufferSize(uint32_t mip = 0) const;
+    VkExtent3D GetMipExtent(uint32_t mip) const;
 
     inline uint32_t GetWidth() const { return mImageInfo.extent.width; }
     inline uint32_t GetHeight() const { return mImageInfo.extent.height; }
+    inline uint32_t GetMipLevels() const { return mImageInfo.mipLevels; }
+    // Layer of the image the texture is stored in, only pooled textures use other layers than 0
+    inline uint32_t GetLayer() const { return mLayer; }
 
     inline VkImage GetImageHandle() const { return mImageHandle; }
     inline VkImageView GetImageViewHandle() const { return mImageViewHandle; }
 
     inline const VkImageCreateInfo& GetImageInfo() const { return mImageInfo; }
     inline const VkImageViewCreateInfo& GetViewInfo() const { return mViewInfo; }
+    // Changes when the image and view are replaced while the asset stays loaded, i.e when streamed mips come and go
+    inline uint32_t GetViewVersion() const { return mViewVersion; }
 protected:
     VkImage mImageHandle;
     VkDeviceMemory mImageMemory;
@@ -62,24 +80,102 @@ protected:
 
     VkImageCreateInfo mImageInfo;
     VkImageViewCreateInfo mViewInfo;
+    uint32_t mLayer;
+    uint32_t mViewVersion;
 
     Device* mDevice;
 };
 
+class TextureArray;
+
+// Where a streamed texture's levels are read from when they're made resident
+struct TextureStreamSource {
+    std::filesystem::path mPath; // DDS/KTX2 file, only used if mCacheKey is 0
+    uint64_t mCacheKey; // Cooked AssetCache entry
+    // The full chain
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mMipLevels;
+    VkFormat mFormat;
+    VkComponentMapping mSwizzle;
+};
+
 class Texture2D : public Texture {
 public:
+    static constexpr uint32_t MaxMipLevels = 16;
+
     Texture2D(Device* device,uint32_t width, uint32_t height, VkFormat format);
     Texture2D(Device* device,const std::filesystem::path& path);
+    ~Texture2D();
 
     bool Load() override;
     void Unload() override;
+    Asset* CreateReloadInstance() const override;
 
-    void LoadImageFromMemory(uint8_t* data, uint64_t size);
+    void LoadImageFromMemory(const uint8_t* data, uint64_t size);
     void LoadImageFromFile(const std::filesystem::path& path);
+
+    // Affects textures loaded after the call, cooked textures with a different setting are cooked again
+    static void SetCompression(TextureCompression compression);
+    inline static TextureCompression GetCompression() { return mCompression; }
+
+    // Set if the texture is stored in a layer of a shared TextureArray
+    inline TextureArray* GetArray() const { return mArray; }
+
+    // Called for every draw with the size in pixels the texture covers on screen. Picks the level of the full chain
+    // the draw needs, the TextureStreamer makes it resident and keeps it until it hasn't been requested for a while
+    void RequestStreaming(float screenSize);
+    inline bool IsStreamed() const { return mStreamId != 0; }
+    // Level of the full chain that's level 0 of the image, the image only holds the levels from there down
+    inline uint32_t GetResidentMip() const { return mResidentMip; }
+    inline const TextureStreamSource& GetStreamSource() const { return mStreamSource; }
+private:
+    // Decodes and uploads the image, stores the decoded texels in the AssetCache if cacheKey isn't 0
+    bool LoadImageInternal(const uint8_t* data, uint64_t size, uint64_t cacheKey);
+    bool LoadCookedImage(const uint8_t* data, uint64_t size, uint64_t cacheKey);
+    // DDS/KTX2, the levels are copied from data straight into staging. Streamed if path isn't empty
+    bool LoadContainer(const uint8_t* data, uint64_t size, const std::filesystem::path& path);
+    TextureCompression GetEffectiveCompression() const;
+    // Takes a layer from the TexturePool if the texture is small enough, otherwise creates its own image.
+    // The dimensions are of the full chain, the image only holds the levels from residentMip down
+    void CreateStorage(uint32_t width, uint32_t height, VkFormat format, uint32_t mipLevels, VkComponentMapping swizzle, uint32_t residentMip = 0);
+    void ReleaseStorage();
+    // Logs an error and returns false if the levels from residentMip down can't be staged. Loader threads flush
+    // whenever the staging buffer runs full, so only the largest level has to fit. The main thread has to fit all of them
+    bool CheckStagingSpace(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t residentMip) const;
+    // Copies every resident level into staging, levels holds every level of the full chain.
+    // flush submits the staging buffer whenever it runs full, only used off the main thread. Fails if a level
+    // doesn't fit, the copies recorded so far keep the image alive until the texture is destroyed
+    bool UploadLevels(const uint8_t* const* levels, bool flush);
+    // Blits every level from the one above, level 0 must be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL.
+    // Leaves every level in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    void GenerateMips(CommandBuffer* commandBuffer);
+    // Registers the texture with the TextureStreamer if only part of the chain is resident
+    void SetStreamSource(const TextureStreamSource& source);
+
+    // Streaming, only used by the TextureStreamer and on the main thread
+    // Reads the levels from residentMip down into new storage, called on the streaming thread
+    bool LoadStreamedLevels(const TextureStreamSource& source, uint32_t residentMip);
+    // Exchanges the image with other's, the old image is released with other
+    void SwapStorage(Texture2D* other);
+    // Finest level requested in the last unusedFrames frames
+    uint32_t GetWantedMip(uint64_t frame, uint64_t unusedFrames) const;
+
+    TextureArray* mArray;
+
+    TextureStreamSource mStreamSource;
+    uint64_t mStreamId; // 0 if the texture isn't streamed, set by TextureStreamer::Register
+    uint32_t mResidentMip;
+    uint32_t mTailMip; // Always resident
+    uint32_t mFirstStreamableMip; // Finer levels don't fit in the streaming staging buffer
+    bool mStreamPending;
+    float mStreamPriority; // Largest screen size requested since the last TextureStreamer::Update
+    uint64_t mMipRequestFrames[MaxMipLevels];
+
+    friend class TextureStreamer;
+
 private:
-    void CreateImageView(VkFormat format);
-    void LoadImageInternal(uint8_t* data, uint64_t size);
-    
+    static TextureCompression mCompression;
 };
 
 class DepthTexture : public Texture {
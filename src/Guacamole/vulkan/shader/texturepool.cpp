@@ -0,0 +1,143 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "texturepool.h"
+
+#include <Guacamole/vulkan/deletionqueue.h>
+#include <Guacamole/asset/assetmanager.h>
+
+namespace Guacamole {
+
+static bool operator==(const VkComponentMapping& a, const VkComponentMapping& b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+TextureArray::TextureArray(Device* device, uint32_t width, uint32_t height, VkFormat format, uint32_t mipLevels, VkComponentMapping swizzle, uint32_t layerCount) 
+    : Texture(device, ""), mLayerSize(0) {
+    // Transfer source for the mips Texture2D blits on the GPU
+    CreateImage(VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, { width, height, 1 }, VK_IMAGE_TYPE_2D, format, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, mipLevels, layerCount);
+    CreateImageView(format, swizzle);
+
+    for (uint32_t mip = 0; mip < mipLevels; mip++) {
+        mLayerSize += GetImageBufferSize(mip);
+    }
+
+    // Handed out from the back, lowest layer first
+    for (uint32_t i = layerCount; i > 0; i--) {
+        mFreeLayers.push_back(i - 1);
+    }
+
+    mFlags |= AssetFlag_Loaded;
+}
+
+bool TextureArray::IsCompatible(uint32_t width, uint32_t height, VkFormat format, uint32_t mipLevels, VkComponentMapping swizzle) const {
+    return mImageInfo.extent.width == width && mImageInfo.extent.height == height && mImageInfo.format == format && 
+           mImageInfo.mipLevels == mipLevels && mViewInfo.components == swizzle;
+}
+
+std::mutex TexturePool::mMutex;
+std::vector<TextureArray*> TexturePool::mArrays;
+uint32_t TexturePool::mMaxExtent = 0;
+uint32_t TexturePool::mMaxLayersPerArray = 0;
+uint32_t TexturePool::mNextViewVersion = 0;
+
+void TexturePool::Init(uint32_t maxExtent, uint32_t maxLayersPerArray) {
+    mMaxExtent = maxExtent;
+    mMaxLayersPerArray = std::max(maxLayersPerArray, 1u);
+}
+
+void TexturePool::Shutdown() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (TextureArray* array : mArrays) {
+        GM_ASSERT_MSG(array->GetFreeLayerCount() == array->GetLayerCount(), "TextureArray still has layers in use");
+        AssetManager::AddMemoryUsage(array, -(int64_t)array->GetMemoryUsage());
+        delete array;
+    }
+
+    mArrays.clear();
+    mMaxExtent = 0;
+}
+
+TextureArray* TexturePool::Allocate(Device* device, uint32_t width, uint32_t height, VkFormat format, uint32_t mipLevels, VkComponentMapping swizzle, uint32_t* layer) {
+    GM_ASSERT(layer);
+
+    if (width > mMaxExtent || height > mMaxExtent) return nullptr;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    uint32_t layerCount = 1;
+
+    for (TextureArray* array : mArrays) {
+        if (!array->IsCompatible(width, height, format, mipLevels, swizzle)) continue;
+
+        if (array->mFreeLayers.empty()) {
+            layerCount = std::max(layerCount, std::min(array->GetLayerCount() * 2, mMaxLayersPerArray));
+            continue;
+        }
+
+        *layer = array->mFreeLayers.back();
+        array->mFreeLayers.pop_back();
+
+        return array;
+    }
+
+    TextureArray* array = new TextureArray(device, width, height, format, mipLevels, swizzle, layerCount);
+
+    // A new array can get the address and view handle of a released one, the SceneRenderer tells them apart by the version
+    array->mViewVersion = ++mNextViewVersion;
+
+    GM_LOG_DEBUG("[TexturePool] Created {}x{} array with {} layers, {:.2f}MB", width, height, layerCount, array->GetMemoryUsage() / 1000000.0);
+
+    // The whole array is resident no matter how many layers are used
+    AssetManager::AddMemoryUsage(array, array->GetMemoryUsage());
+
+    *layer = array->mFreeLayers.back();
+    array->mFreeLayers.pop_back();
+    mArrays.push_back(array);
+
+    return array;
+}
+
+void TexturePool::Free(TextureArray* array, uint32_t layer) {
+    DeletionQueue::Push([array, layer]() {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        array->mFreeLayers.push_back(layer);
+
+        if (array->GetFreeLayerCount() < array->GetLayerCount()) return;
+
+        // No frame can sample the array anymore, the layer was the last one in use
+        GM_LOG_DEBUG("[TexturePool] Released {}x{} array with {} layers", array->GetWidth(), array->GetHeight(), array->GetLayerCount());
+
+        mArrays.erase(std::find(mArrays.begin(), mArrays.end(), array));
+        AssetManager::AddMemoryUsage(array, -(int64_t)array->GetMemoryUsage());
+
+        delete array;
+    });
+}
+
+}
@@ -0,0 +1,81 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include "texture.h"
+
+#include <mutex>
+
+namespace Guacamole {
+
+// Equally sized textures sharing one image, each texture is a layer. Layers are exactly the size of the
+// textures so UVs, wrapping and mips work like they do for a standalone texture
+class TextureArray : public Texture {
+public:
+    TextureArray(Device* device, uint32_t width, uint32_t height, VkFormat format, uint32_t mipLevels, VkComponentMapping swizzle, uint32_t layerCount);
+
+    bool IsCompatible(uint32_t width, uint32_t height, VkFormat format, uint32_t mipLevels, VkComponentMapping swizzle) const;
+
+    inline uint32_t GetLayerCount() const { return mImageInfo.arrayLayers; }
+    inline uint32_t GetFreeLayerCount() const { return (uint32_t)mFreeLayers.size(); }
+    // Bytes of every mip of one layer
+    inline uint64_t GetLayerSize() const { return mLayerSize; }
+
+private:
+    std::vector<uint32_t> mFreeLayers;
+    uint64_t mLayerSize;
+
+    friend class TexturePool;
+};
+
+// Packs small textures into shared TextureArrays, so scenes with many small textures bind a few
+// images instead of one per texture. Texture2D asks for a layer when it's loaded.
+// The first array of a size and format has a single layer and every one after it twice the layers of the largest so far,
+// so at most about half of the pooled memory is unused. Arrays are released once all their layers are free
+class TexturePool {
+public:
+    // Textures up to maxExtent in both dimensions are pooled, 0 disables pooling. Arrays grow to at most maxLayersPerArray
+    static void Init(uint32_t maxExtent, uint32_t maxLayersPerArray = 64);
+    // Must be called after the DeletionQueue is flushed, every layer has to be freed
+    static void Shutdown();
+
+    // Returns the array and layer the texture should be uploaded to, or nullptr if it isn't pooled. Thread safe
+    static TextureArray* Allocate(Device* device, uint32_t width, uint32_t height, VkFormat format, uint32_t mipLevels, VkComponentMapping swizzle, uint32_t* layer);
+    // The layer is reused once no frame in flight can sample it anymore. Thread safe
+    static void Free(TextureArray* array, uint32_t layer);
+
+    inline static uint32_t GetMaxExtent() { return mMaxExtent; }
+
+private:
+    static std::mutex mMutex;
+    static std::vector<TextureArray*> mArrays;
+    static uint32_t mMaxExtent;
+    static uint32_t mMaxLayersPerArray;
+    static uint32_t mNextViewVersion;
+};
+
+}
@@ -0,0 +1,255 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include "texturestreamer.h"
+#include "texturepool.h"
+
+#include <Guacamole/asset/assetmanager.h>
+#include <Guacamole/vulkan/deletionqueue.h>
+#include <Guacamole/vulkan/buffer/stagingbuffer.h>
+#include <Guacamole/vulkan/util.h>
+#include <Guacamole/util/image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+
+namespace Guacamole {
+
+Device* TextureStreamer::mDevice;
+uint32_t TextureStreamer::mResidentExtent = 0;
+uint64_t TextureStreamer::mUnusedFrames;
+uint64_t TextureStreamer::mNextStreamId;
+std::thread TextureStreamer::mWorker;
+std::atomic<bool> TextureStreamer::mShouldStop;
+std::mutex TextureStreamer::mMutex;
+std::condition_variable TextureStreamer::mCondition;
+StagingBuffer* TextureStreamer::mStagingBuffer = nullptr;
+std::unordered_set<Texture2D*> TextureStreamer::mTextures;
+std::vector<TextureStreamer::Job> TextureStreamer::mQueue;
+std::vector<TextureStreamer::Job> TextureStreamer::mFinished;
+
+void TextureStreamer::Init(Device* device, uint32_t residentExtent, uint64_t unusedFrames) {
+    mDevice = device;
+    mResidentExtent = residentExtent;
+    mUnusedFrames = unusedFrames;
+    mNextStreamId = 1;
+    mShouldStop = false;
+
+    if (!IsEnabled()) return;
+
+    mWorker = std::thread(&TextureStreamer::Worker);
+
+    GM_LOG_DEBUG("[TextureStreamer] Streaming levels larger than {}, dropped after {} unused frames", residentExtent, unusedFrames);
+}
+
+void TextureStreamer::Shutdown() {
+    if (!mWorker.joinable()) return;
+
+    mMutex.lock();
+    mShouldStop = true;
+    StagingBuffer* stagingBuffer = mStagingBuffer;
+    mMutex.unlock();
+    mCondition.notify_all();
+
+    // The worker may be waiting for an upload to be picked up by a frame that never comes.
+    // Only its own buffer, the loader threads are still running
+    if (stagingBuffer) StagingManager::CancelCollectionWaits(stagingBuffer);
+
+    mWorker.join();
+
+    // The device is idle and nothing submitted is collected anymore
+    for (Job& job : mFinished) {
+        delete job.mStorage;
+    }
+
+    mQueue.clear();
+    mFinished.clear();
+    mTextures.clear();
+    mStagingBuffer = nullptr;
+    mResidentExtent = 0;
+}
+
+uint32_t TextureStreamer::GetInitialMip(uint32_t width, uint32_t height, uint32_t mipLevels) {
+    // Pooled textures are small and their layers can't change the level count
+    if (!IsEnabled() || (width <= TexturePool::GetMaxExtent() && height <= TexturePool::GetMaxExtent())) return 0;
+
+    uint32_t mip = 0;
+
+    while (mip + 1 < mipLevels && std::max(Util::GetMipDimension(width, mip), Util::GetMipDimension(height, mip)) > mResidentExtent) {
+        mip++;
+    }
+
+    return mip;
+}
+
+void TextureStreamer::Register(Texture2D* texture) {
+    const TextureStreamSource& source = texture->mStreamSource;
+    uint32_t firstMip = 0;
+
+    while (firstMip < texture->mResidentMip && 
+           GetImageSize(source.mFormat, Util::GetMipDimension(source.mWidth, firstMip), Util::GetMipDimension(source.mHeight, firstMip)) + 16 > StagingBufferSize) {
+        firstMip++;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    texture->mStreamId = mNextStreamId++;
+    texture->mTailMip = texture->mResidentMip;
+    texture->mFirstStreamableMip = firstMip;
+    texture->mStreamPending = false;
+    texture->mStreamPriority = 0.0f;
+
+    memset(texture->mMipRequestFrames, 0, sizeof(texture->mMipRequestFrames));
+
+    mTextures.insert(texture);
+}
+
+void TextureStreamer::Unregister(Texture2D* texture) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    texture->mStreamId = 0;
+
+    mTextures.erase(texture);
+}
+
+void TextureStreamer::Update() {
+    if (!IsEnabled()) return;
+
+    uint64_t frame = AssetManager::GetFrameIndex();
+
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    std::vector<Job> finished = std::move(mFinished);
+    mFinished.clear();
+
+    for (Job& job : finished) {
+        Texture2D* texture = job.mTexture;
+        bool current = mTextures.find(texture) != mTextures.end() && texture->mStreamId == job.mStreamId;
+
+        if (current) {
+            texture->mStreamPending = false;
+
+            if (!job.mLoaded) {
+                // Stop asking for levels that can't be read
+                texture->mFirstStreamableMip = texture->mTailMip;
+            } else if (texture->IsLoaded() && !texture->IsLoading()) {
+                uint64_t memoryUsage = texture->GetMemoryUsage();
+
+                texture->SwapStorage(job.mStorage);
+
+                AssetManager::AddMemoryUsage(texture, (int64_t)texture->GetMemoryUsage() - (int64_t)memoryUsage);
+            }
+        }
+
+        // Holds the previous image if it was swapped, frames in flight may still sample it
+        Texture2D* storage = job.mStorage;
+        DeletionQueue::Push([storage]() { delete storage; });
+    }
+
+    uint32_t queued = 0;
+
+    for (Texture2D* texture : mTextures) {
+        float priority = texture->mStreamPriority;
+        texture->mStreamPriority = 0.0f;
+
+        if (texture->mStreamPending || !texture->IsLoaded() || texture->IsLoading()) continue;
+
+        uint32_t wanted = texture->GetWantedMip(frame, mUnusedFrames);
+
+        if (wanted == texture->mResidentMip) continue;
+
+        Job& job = mQueue.emplace_back();
+
+        job.mTexture = texture;
+        job.mStreamId = texture->mStreamId;
+        job.mSource = texture->mStreamSource;
+        job.mResidentMip = wanted;
+        // Dropping levels frees memory and only reads the small levels, it goes first
+        job.mPriority = wanted > texture->mResidentMip ? FLT_MAX : priority;
+        job.mStorage = nullptr;
+        job.mLoaded = false;
+
+        texture->mStreamPending = true;
+        queued++;
+    }
+
+    lock.unlock();
+
+    if (queued > 0) mCondition.notify_one();
+}
+
+void TextureStreamer::Worker() {
+    StagingManager::AllocateCommonStagingBuffer(mDevice, std::this_thread::get_id(), StagingBufferSize, false);
+    StagingBuffer* buf = StagingManager::GetCommonStagingBuffer();
+
+    mMutex.lock();
+    mStagingBuffer = buf;
+    mMutex.unlock();
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        mCondition.wait(lock, []() { return mShouldStop || !mQueue.empty(); });
+
+        if (mShouldStop) break;
+
+        auto next = std::max_element(mQueue.begin(), mQueue.end(), [](const Job& a, const Job& b) { return a.mPriority < b.mPriority; });
+        Job job = std::move(*next);
+
+        mQueue.erase(next);
+        lock.unlock();
+
+        // Blocks until the previous upload has been picked up by the render thread
+        buf->Begin();
+
+        if (mShouldStop) break;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        job.mStorage = new Texture2D(mDevice, job.mSource.mPath);
+        job.mLoaded = job.mStorage->LoadStreamedLevels(job.mSource, job.mResidentMip);
+
+        uint64_t stagedBytes = buf->GetAllocated();
+
+        StagingManager::SubmitStagingBuffer(buf, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+
+        if (job.mLoaded) {
+            auto end = std::chrono::high_resolution_clock::now();
+            double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+            GM_LOG_DEBUG("[TextureStreamer] {}x{} texture now at level {}, {:.2f}MB staged in {:.2f}ms", job.mSource.mWidth, job.mSource.mHeight, 
+                job.mResidentMip, stagedBytes / 1000000.0, seconds * 1000.0);
+        }
+
+        lock.lock();
+        mFinished.push_back(std::move(job));
+    }
+
+    GM_LOG_DEBUG("[TextureStreamer] Streaming thread stopped");
+}
+
+}
@@ -0,0 +1,98 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Guacamole.h>
+
+#include "texture.h"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <unordered_set>
+
+namespace Guacamole {
+
+class StagingBuffer;
+
+// Streams the finer levels of large textures in and out. They're loaded with only the levels up to the resident
+// extent, draws request the levels they need with Texture2D::RequestStreaming and a background thread builds a new
+// image with the levels from the source. The largest textures on screen are served first. Levels that haven't been
+// requested for a while are dropped the same way, so texture memory follows what's visible
+class TextureStreamer {
+public:
+    // Textures too large for the TexturePool start out with the levels up to residentExtent, 0 disables streaming.
+    // Levels that haven't been requested for unusedFrames frames are dropped
+    static void Init(Device* device, uint32_t residentExtent, uint64_t unusedFrames = 120);
+    // Must be called before the AssetManager is shut down, the streaming thread reads files through it
+    static void Shutdown();
+    // Main thread, once per frame after AssetManager::Update. Swaps finished images in and queues the textures
+    // whose wanted levels changed
+    static void Update();
+
+    // Level of the full chain a texture starts out at, 0 if it isn't streamed
+    static uint32_t GetInitialMip(uint32_t width, uint32_t height, uint32_t mipLevels);
+
+    // Called by Texture2D, thread safe
+    static void Register(Texture2D* texture);
+    static void Unregister(Texture2D* texture);
+
+    inline static bool IsEnabled() { return mResidentExtent != 0; }
+
+private:
+    struct Job {
+        Texture2D* mTexture;
+        uint64_t mStreamId; // Detects textures that were unloaded while the job ran
+        TextureStreamSource mSource;
+        uint32_t mResidentMip;
+        float mPriority;
+        // Holds the new image, swapped into mTexture on the main thread
+        Texture2D* mStorage;
+        bool mLoaded;
+    };
+
+    static void Worker();
+
+    // Levels larger than this are never streamed, they'd need more than one submission
+    static constexpr uint64_t StagingBufferSize = 32000000; // 32MB
+
+    static Device* mDevice;
+    static uint32_t mResidentExtent;
+    static uint64_t mUnusedFrames;
+    static uint64_t mNextStreamId;
+    static std::thread mWorker;
+    static std::atomic<bool> mShouldStop;
+    static std::mutex mMutex;
+    static std::condition_variable mCondition;
+    static StagingBuffer* mStagingBuffer;
+
+    // Guarded by mMutex
+    static std::unordered_set<Texture2D*> mTextures;
+    static std::vector<Job> mQueue;
+    static std::vector<Job> mFinished;
+};
+
+}
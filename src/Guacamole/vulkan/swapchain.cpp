@@ -307,25 +307,28 @@ void Swapchain::Present() {
     std::vector<VkSemaphore> otherSemaphores;
     std::vector<VkTimelineSemaphoreSubmitInfoKHR> semaphoreSubmits;
     std::vector<uint64_t> semaphoreWaitValues;
-    semaphoreSubmits.reserve(32);
-    semaphoreWaitValues.reserve(32);
-    otherSemaphores.reserve(32);
-
-    semaphoreWaitValues.push_back(0);
-
     { // staging buffer submission
         std::vector<StagingBufferSubmitInfo> stagingBuffers = StagingManager::GetSubmittedStagingBuffers();
 
+        // The submits point into these, they must never reallocate. One entry per staging buffer, the image wait and the render submit
+        submits.reserve(stagingBuffers.size() + 1);
+        semaphoreSubmits.reserve(stagingBuffers.size() + 1);
+        semaphoreWaitValues.reserve(stagingBuffers.size() + 1);
+        renderWaitSemaphores.reserve(stagingBuffers.size() + 1);
+        renderWaitStageFlags.reserve(stagingBuffers.size() + 1);
+
+        semaphoreWaitValues.push_back(0);
+
         for (StagingBufferSubmitInfo& buf : stagingBuffers) {
+            // Already ended by the StagingManager
             CommandBuffer* bufCmd = buf.mCommandBuffer;
-            bufCmd->End();
 
             SemaphoreTimeline* sem = (SemaphoreTimeline*)bufCmd->GetSemaphore();
 
             renderWaitSemaphores.push_back(sem->GetHandle());
             renderWaitStageFlags.push_back(buf.mStageFlags);
 
-            semaphoreWaitValues.push_back(sem->IncrementSignalCounter());
+            semaphoreWaitValues.push_back(buf.mSignalValue);
 
             VkTimelineSemaphoreSubmitInfoKHR& semInfo = semaphoreSubmits.emplace_back();
             semInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
@@ -63,6 +63,8 @@ uint64_t GetFormatSize(VkFormat format) {
         case VK_FORMAT_R8G8B8A8_UINT:
         case VK_FORMAT_R8G8B8A8_UNORM:
         case VK_FORMAT_R8G8B8A8_USCALED:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
             return 4;
 
         // 16 bit formats
@@ -116,6 +118,26 @@ uint64_t GetFormatSize(VkFormat format) {
         case VK_FORMAT_R32G32B32A32_UINT:
         case VK_FORMAT_R32G32B32A32_SFLOAT:
             return 16;
+
+        // Block compressed formats, size of a 4x4 block
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            return 8;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return 16;
         default:
             GM_ASSERT_MSG(false, "Format not implemented");
     }
@@ -123,6 +145,18 @@ uint64_t GetFormatSize(VkFormat format) {
     return 0;
 }
 
+bool IsBlockCompressedFormat(VkFormat format) {
+    return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+uint64_t GetImageSize(VkFormat format, uint32_t width, uint32_t height) {
+    if (IsBlockCompressedFormat(format)) {
+        return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * GetFormatSize(format);
+    }
+
+    return (uint64_t)width * height * GetFormatSize(format);
+}
+
 #define YEET(res) case res: return #res
 
 const char* GetVkResultString(VkResult result) {
@@ -28,7 +28,11 @@ SOFTWARE.
 
 namespace Guacamole {
 
+// Bytes per texel, or per 4x4 block for block compressed formats
 uint64_t GetFormatSize(VkFormat format);
+bool IsBlockCompressedFormat(VkFormat format);
+// Size of a tightly packed width x height image, partial blocks count as whole blocks
+uint64_t GetImageSize(VkFormat format, uint32_t width, uint32_t height);
 const char* GetVkResultString(VkResult result);
 
 class Device;
@@ -0,0 +1,57 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include <Guacamole/asset/assetarchive.h>
+
+using namespace Guacamole;
+
+// Usage: AssetPacker <output.gmpk> <file or directory>...
+// Assets are stored under the path they're passed with, so run it from the directory the engine runs from.
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        GM_LOG_CRITICAL("Usage: {} <output.gmpk> <file or directory>...", argv[0]);
+        return 1;
+    }
+
+    AssetArchiveWriter writer;
+
+    for (int i = 2; i < argc; i++) {
+        std::filesystem::path input(argv[i]);
+
+        if (std::filesystem::is_directory(input)) {
+            for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(input)) {
+                if (entry.is_regular_file()) writer.AddFile(entry.path(), entry.path());
+            }
+        } else if (std::filesystem::is_regular_file(input)) {
+            writer.AddFile(input, input);
+        } else {
+            GM_LOG_CRITICAL("\"{}\" doesn't exist", argv[i]);
+            return 1;
+        }
+    }
+
+    return writer.Write(argv[1]) ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include <Guacamole/util/util.h>
+#include <Guacamole/util/bc.h>
+#include <Guacamole/util/fileview.h>
+
+#include <stb_image.h>
+
+#include <chrono>
+
+using namespace Guacamole;
+
+static const Util::BCFormat sFormats[] = { Util::BCFormat::BC1, Util::BCFormat::BC3, Util::BCFormat::BC4, Util::BCFormat::BC5, Util::BCFormat::BC7 };
+// Channels each format stores, the PSNR is measured over these
+static const uint32_t sFormatChannels[] = { 3, 4, 1, 2, 4 };
+
+struct Result {
+    double mSeconds = 0.0;
+    double mPSNR = 0.0;
+};
+
+// Usage: BCBench <file or directory>... [-t threads] [-f format]
+// Compresses every image with every BC format at both quality levels and reports quality (PSNR) and throughput
+int main(int argc, char** argv) {
+    std::vector<std::filesystem::path> paths;
+    uint32_t threadCount = 0;
+    std::string onlyFormat;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+
+        if (arg == "-t" && i + 1 < argc) {
+            threadCount = std::max(atoi(argv[++i]), 1);
+        } else if (arg == "-f" && i + 1 < argc) {
+            onlyFormat = argv[++i];
+        } else if (std::filesystem::is_directory(arg)) {
+            for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(arg)) {
+                if (entry.is_regular_file()) paths.push_back(entry.path());
+            }
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty()) {
+        GM_LOG_CRITICAL("Usage: {} <file or directory>... [-t threads] [-f BC1|BC3|BC4|BC5|BC7]", argv[0]);
+        return 1;
+    }
+
+    // Totals per quality and format
+    Result totals[2][5];
+    uint64_t totalTexels = 0;
+    uint32_t imageCount = 0;
+
+    for (const std::filesystem::path& path : paths) {
+        FileView view;
+        int32_t width;
+        int32_t height;
+        int32_t channels;
+
+        if (!view.Open(path)) continue;
+        if (!stbi_info_from_memory(view.GetData(), (int32_t)view.GetSize(), &width, &height, &channels)) continue;
+
+        std::vector<uint8_t> rgba((uint64_t)width * height * 4);
+        std::vector<uint8_t> decoded(rgba.size());
+
+        if (!Util::DecodeImage(view.GetData(), view.GetSize(), 4, rgba.data(), rgba.size())) {
+            GM_LOG_CRITICAL("Failed to decode \"{}\"", path.string().c_str());
+            continue;
+        }
+
+        GM_LOG_INFO("{} {}x{}, channels: {}", path.string().c_str(), width, height, (uint32_t)Util::GetImageChannels(rgba.data(), width, height));
+
+        for (uint32_t quality = 0; quality < 2; quality++) {
+            for (uint32_t f = 0; f < 5; f++) {
+                Util::BCFormat format = sFormats[f];
+
+                if (!onlyFormat.empty() && onlyFormat != Util::GetBCFormatName(format)) continue;
+
+                std::vector<uint8_t> compressed(Util::GetBCImageSize(width, height, format));
+
+                auto start = std::chrono::high_resolution_clock::now();
+                Util::CompressBC(rgba.data(), width, height, format, (Util::BCQuality)quality, compressed.data(), threadCount);
+                auto end = std::chrono::high_resolution_clock::now();
+
+                Util::DecompressBC(compressed.data(), width, height, format, decoded.data());
+
+                double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+                double psnr = Util::ComputePSNR(rgba.data(), decoded.data(), width, height, sFormatChannels[f]);
+
+                GM_LOG_INFO("    {} {}: {:.2f}dB {:.2f}ms {:.1f}MTexels/s", Util::GetBCFormatName(format), quality ? "Best" : "Fast", psnr, 
+                    seconds * 1000.0, (uint64_t)width * height / 1000000.0 / seconds);
+
+                totals[quality][f].mSeconds += seconds;
+                totals[quality][f].mPSNR += psnr;
+            }
+        }
+
+        totalTexels += (uint64_t)width * height;
+        imageCount++;
+    }
+
+    if (imageCount == 0) {
+        GM_LOG_CRITICAL("No images found");
+        return 1;
+    }
+
+    GM_LOG_INFO("{} images, {:.2f}MTexels, average:", imageCount, totalTexels / 1000000.0);
+
+    for (uint32_t quality = 0; quality < 2; quality++) {
+        for (uint32_t f = 0; f < 5; f++) {
+            const Result& result = totals[quality][f];
+
+            if (result.mSeconds == 0.0) continue;
+
+            GM_LOG_INFO("    {} {}: {:.2f}dB {:.1f}MTexels/s", Util::GetBCFormatName(sFormats[f]), quality ? "Best" : "Fast", 
+                result.mPSNR / imageCount, totalTexels / 1000000.0 / result.mSeconds);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include <Guacamole/util/util.h>
+#include <Guacamole/util/fileview.h>
+
+#include <stb_image.h>
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+using namespace Guacamole;
+
+struct Image {
+    std::filesystem::path mPath;
+    FileView mView;
+    uint64_t mPixelSize;
+};
+
+// Decodes every image iterations times on threadCount threads, returns the time it took in seconds
+static double Decode(const std::vector<Image*>& images, uint32_t threadCount, uint32_t iterations) {
+    uint64_t maxPixelSize = 0;
+
+    for (const Image* image : images) {
+        maxPixelSize = std::max(maxPixelSize, image->mPixelSize);
+    }
+
+    std::atomic<uint64_t> next = 0;
+    uint64_t total = images.size() * iterations;
+
+    auto worker = [&]() {
+        // Like the loader threads every thread decodes into its own buffer
+        uint8_t* pixels = new uint8_t[maxPixelSize];
+
+        for (uint64_t i = next++; i < total; i = next++) {
+            const Image* image = images[i % images.size()];
+
+            if (!Util::DecodeImage(image->mView.GetData(), image->mView.GetSize(), 4, pixels, image->mPixelSize)) {
+                GM_LOG_CRITICAL("Failed to decode \"{}\"", image->mPath.string().c_str());
+            }
+        }
+
+        delete[] pixels;
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads;
+
+    for (uint32_t i = 0; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+}
+
+// Usage: DecodeBench <file or directory>... [-i iterations] [-t threads]
+// Measures RGBA8 decode throughput, single threaded and spread over threads like the asset loader does it.
+int main(int argc, char** argv) {
+    std::vector<std::filesystem::path> paths;
+    uint32_t iterations = 3;
+    uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+
+        if (arg == "-i" && i + 1 < argc) {
+            iterations = std::max(atoi(argv[++i]), 1);
+        } else if (arg == "-t" && i + 1 < argc) {
+            threadCount = std::max(atoi(argv[++i]), 1);
+        } else if (std::filesystem::is_directory(arg)) {
+            for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(arg)) {
+                if (entry.is_regular_file()) paths.push_back(entry.path());
+            }
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty()) {
+        GM_LOG_CRITICAL("Usage: {} <file or directory>... [-i iterations] [-t threads]", argv[0]);
+        return 1;
+    }
+
+    // FileView can't be moved, the storage is sized up front
+    std::vector<Image> storage(paths.size());
+    std::vector<Image*> images;
+    uint64_t inputSize = 0;
+    uint64_t outputSize = 0;
+
+    for (const std::filesystem::path& path : paths) {
+        Image& image = storage[images.size()];
+        int32_t width;
+        int32_t height;
+        int32_t channels;
+
+        if (!image.mView.Open(path, true)) continue;
+
+        // Skips everything that isn't an image
+        if (!stbi_info_from_memory(image.mView.GetData(), (int32_t)image.mView.GetSize(), &width, &height, &channels)) {
+            image.mView.Close();
+            continue;
+        }
+
+        image.mPath = path;
+        image.mPixelSize = (uint64_t)width * height * 4;
+        inputSize += image.mView.GetSize();
+        outputSize += image.mPixelSize;
+        images.push_back(&image);
+    }
+
+    if (images.empty()) {
+        GM_LOG_CRITICAL("No images found");
+        return 1;
+    }
+
+    GM_LOG_INFO("{} images, {:.2f}MB compressed, {:.2f}MB decoded, {} iterations", images.size(), inputSize / 1000000.0, outputSize / 1000000.0, iterations);
+
+    double input = inputSize * (double)iterations / 1000000.0;
+    double output = outputSize * (double)iterations / 1000000.0;
+
+    double single = Decode(images, 1, iterations);
+    GM_LOG_INFO("1 thread: {:.2f}s {:.1f}MB/s in {:.1f}MB/s out", single, input / single, output / single);
+
+    if (threadCount > 1) {
+        double parallel = Decode(images, threadCount, iterations);
+        GM_LOG_INFO("{} threads: {:.2f}s {:.1f}MB/s in {:.1f}MB/s out ({:.2f}x)", threadCount, parallel, input / parallel, output / parallel, single / parallel);
+    }
+
+    return 0;
+}
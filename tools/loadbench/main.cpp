@@ -0,0 +1,337 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include <Guacamole/core/application.h>
+#include <Guacamole/asset/assetmanager.h>
+#include <Guacamole/renderer/mesh.h>
+#include <Guacamole/scene/scene.h>
+#include <Guacamole/scene/entity.h>
+#include <Guacamole/vulkan/shader/texture.h>
+
+#include <chrono>
+
+using namespace Guacamole;
+
+static bool IsTexture(const std::filesystem::path& path) {
+    std::string ext = path.extension().string();
+
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".bmp" || ext == ".dds" || ext == ".ktx2";
+}
+
+static bool IsMesh(const std::filesystem::path& path) {
+    std::string ext = path.extension().string();
+
+    return ext == ".obj" || ext == ".gltf" || ext == ".glb";
+}
+
+// Stands in for a real asset so registration can be timed without any file IO
+class EmptyAsset : public Asset {
+public:
+    EmptyAsset(const std::filesystem::path& path) : Asset(path, AssetType::Binary) {}
+
+    bool Load() override {
+        mFlags |= AssetFlag_Loaded;
+        return false;
+    }
+};
+
+// Queues every file on the loader threads and reports once the last one is done
+class LoadBench : public Application {
+public:
+    LoadBench(ApplicationSpec& spec, uint32_t workerCount, const std::vector<std::filesystem::path>& paths, uint32_t registerCount, 
+        const std::filesystem::path& cacheDirectory, std::chrono::high_resolution_clock::time_point processStart) 
+        : Application(spec), mWorkerCount(workerCount), mPaths(paths), mRegisterCount(registerCount), mCacheDirectory(cacheDirectory), 
+          mProcessStart(processStart), mScene(nullptr), mDone(false) {}
+
+    void OnInit() override {
+        WindowSpec windowSpec;
+
+        windowSpec.Width = 640;
+        windowSpec.Height = 360;
+        windowSpec.Windowed = true;
+        windowSpec.Title = "LoadBench";
+
+        // Nothing that would make runs differ, every run decodes and uploads everything. Startup runs cook like the
+        // sample app does so the cache has something to skip
+        AppInitSpec initSpec;
+
+        initSpec.appName = "LoadBench";
+        initSpec.deviceIndex = ~0;
+        initSpec.assetWorkerCount = mWorkerCount;
+        initSpec.assetCacheDirectory = mCacheDirectory;
+        initSpec.assetHotReload = false;
+        initSpec.textureCompression = mCacheDirectory.empty() ? TextureCompression::None : TextureCompression::Best;
+        initSpec.texturePoolMaxExtent = 0;
+        initSpec.textureStreamingExtent = 0;
+
+        Init(windowSpec, initSpec);
+
+        // Frames have to keep running, they submit the uploads the workers wait on
+        mScene = new Scene(this);
+
+        Entity cam = mScene->CreateEntity("Camera");
+        Camera camera;
+
+        camera.SetPerspective(70.0f, (float)windowSpec.Width / windowSpec.Height, 0.001f, 100.0f);
+        camera.SetViewport((float)windowSpec.Width, (float)windowSpec.Height);
+
+        cam.AddComponent<CameraComponent>(camera, true);
+        cam.AddComponent<TransformComponent>(vec3(0, 0, 1));
+
+        if (mRegisterCount > 0) {
+            Register();
+            mDone = true;
+            mWindow->Close();
+            return;
+        }
+
+        mStart = std::chrono::high_resolution_clock::now();
+        mFileSize = 0;
+
+        // The scene renderer has compiled its shaders by now
+        mInitSeconds = std::chrono::duration_cast<std::chrono::microseconds>(mStart - mProcessStart).count() / 1000000.0;
+
+        for (const std::filesystem::path& path : mPaths) {
+            mFileSize += std::filesystem::file_size(path);
+
+            if (IsTexture(path)) {
+                mHandles.push_back(AssetManager::AddAsset(new Texture2D(mMainDevice, path), true));
+            } else {
+                mHandles.push_back(AssetManager::AddAsset(new Mesh(mMainDevice, path), true));
+            }
+        }
+    }
+
+    void OnUpdate(float ts) override {
+        if (mDone) return;
+
+        uint32_t failed = 0;
+
+        for (AssetHandle handle : mHandles) {
+            AssetFuture<> future = AssetManager::GetAssetFuture(handle);
+
+            if (!future.IsReady() && !future.HasFailed()) return;
+            if (future.HasFailed()) failed++;
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - mStart).count() / 1000000.0;
+        double megabytes = mFileSize / 1000000.0;
+        uint64_t resident = AssetManager::GetMemoryUsage(AssetMemoryType::Texture) + AssetManager::GetMemoryUsage(AssetMemoryType::Mesh);
+
+        if (!mCacheDirectory.empty()) {
+            double total = std::chrono::duration_cast<std::chrono::microseconds>(end - mProcessStart).count() / 1000000.0;
+
+            GM_LOG_INFO("Init {:.2f}ms (window, device, shaders), {} assets ({} failed) loaded after {:.2f}ms", mInitSeconds * 1000.0, 
+                mHandles.size(), failed, total * 1000.0);
+        } else GM_LOG_INFO("{} workers: {} assets ({} failed) {:.2f}MB in {:.2f}ms, {:.1f} assets/s {:.2f}MB/s, {:.2f}MB resident", AssetManager::GetWorkerCount(), 
+            mHandles.size(), failed, megabytes, seconds * 1000.0, mHandles.size() / seconds, megabytes / seconds, resident / 1000000.0);
+
+        mDone = true;
+        mWindow->Close();
+    }
+
+    void OnRender() override {
+        mScene->OnRender();
+    }
+
+    void OnShutdown() override {
+        delete mScene;
+    }
+
+    bool OnKeyPressed(KeyPressedEvent* e) override { return false; }
+    bool OnKeyReleased(KeyReleasedEvent* e) override { return false; }
+    bool OnButtonPressed(ButtonPressedEvent* e) override { return false; }
+    bool OnButtonReleased(ButtonReleasedEvent* e) override { return false; }
+    bool OnMouseMoved(MouseMovedEvent* e) override { return false; }
+
+private:
+    // Adds mRegisterCount assets with made up paths, then looks every path up again. The first and last tenth are
+    // reported separately, with an O(1) index they take about the same time
+    void Register() {
+        uint32_t tenth = std::max(mRegisterCount / 10, 1u);
+        std::vector<std::filesystem::path> paths;
+
+        paths.reserve(mRegisterCount);
+
+        for (uint32_t i = 0; i < mRegisterCount; i++) {
+            paths.push_back("bench/folder" + std::to_string(i % 100) + "/asset" + std::to_string(i) + ".bin");
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        auto firstTenth = start;
+        auto lastTenth = start;
+
+        for (uint32_t i = 0; i < mRegisterCount; i++) {
+            if (i == tenth) firstTenth = std::chrono::high_resolution_clock::now();
+            if (i == mRegisterCount - tenth) lastTenth = std::chrono::high_resolution_clock::now();
+
+            AssetManager::AddAsset(new EmptyAsset(paths[i]), false);
+        }
+
+        auto registered = std::chrono::high_resolution_clock::now();
+        uint32_t found = 0;
+
+        for (const std::filesystem::path& path : paths) {
+            if (!AssetManager::GetAssetHandleFromPath(path).IsNull()) found++;
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+
+        auto ns = [](std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end, uint32_t count) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / (double)count;
+        };
+
+        GM_LOG_INFO("Registered {} assets in {:.2f}ms, {:.0f}ns each (first tenth {:.0f}ns, last tenth {:.0f}ns)", mRegisterCount, 
+            std::chrono::duration_cast<std::chrono::microseconds>(registered - start).count() / 1000.0, ns(start, registered, mRegisterCount), 
+            ns(start, firstTenth, tenth), ns(lastTenth, registered, tenth));
+        GM_LOG_INFO("Looked up {} paths ({} found) in {:.2f}ms, {:.0f}ns each", mRegisterCount, found, 
+            std::chrono::duration_cast<std::chrono::microseconds>(end - registered).count() / 1000.0, ns(registered, end, mRegisterCount));
+    }
+
+private:
+    uint32_t mWorkerCount;
+    std::vector<std::filesystem::path> mPaths;
+    uint32_t mRegisterCount;
+    std::filesystem::path mCacheDirectory;
+    std::chrono::high_resolution_clock::time_point mProcessStart;
+    double mInitSeconds;
+    std::vector<AssetHandle> mHandles;
+    Scene* mScene;
+    bool mDone;
+    std::chrono::high_resolution_clock::time_point mStart;
+    uint64_t mFileSize;
+};
+
+// Runs LoadBench again in a new process with the given arguments
+static bool RunSelf(const char* exe, const std::string& args) {
+    std::string command = "\"" + std::string(exe) + "\"" + args;
+
+#if defined(GM_WINDOWS)
+    // cmd strips the outer pair of quotes
+    command = "\"" + command + "\"";
+#endif
+
+    if (std::system(command.c_str()) != 0) {
+        GM_LOG_CRITICAL("\"{}\" failed", command.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Usage: LoadBench <file or directory>... [-w workers]
+//        LoadBench <file or directory>... -s [-c cache directory]
+//        LoadBench -r count
+// Loads every texture and mesh through the AssetManager and reports assets/s and MB/s of source files.
+// Without -w it runs itself once per worker count: 1, 2, 4 and the default for the machine (0), each in a fresh
+// process so nothing stays resident between runs. The first run is a warm-up that gets the files into the page cache.
+// -s compares a cold start, with the asset cache cleared, to a warm one that reuses it. The time covers everything
+// from main to the last asset being ready, textures are cooked to BC like the sample app does.
+// -r registers count empty assets instead and reports how long registering and looking up their paths takes
+int main(int argc, char** argv) {
+    auto processStart = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::filesystem::path> paths;
+    std::string pathArgs;
+    std::filesystem::path cacheDirectory;
+    int32_t workerCount = -1;
+    uint32_t registerCount = 0;
+    bool startup = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+
+        if (arg == "-w" && i + 1 < argc) {
+            workerCount = std::max(atoi(argv[++i]), 0);
+            continue;
+        } else if (arg == "-r" && i + 1 < argc) {
+            registerCount = std::max(atoi(argv[++i]), 1);
+            continue;
+        } else if (arg == "-c" && i + 1 < argc) {
+            cacheDirectory = argv[++i];
+            continue;
+        } else if (arg == "-s") {
+            startup = true;
+            continue;
+        }
+
+        pathArgs += " \"" + arg + "\"";
+
+        if (std::filesystem::is_directory(arg)) {
+            for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(arg)) {
+                if (entry.is_regular_file() && (IsTexture(entry.path()) || IsMesh(entry.path()))) paths.push_back(entry.path());
+            }
+        } else if (IsTexture(arg) || IsMesh(arg)) {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty() && registerCount == 0) {
+        GM_LOG_CRITICAL("Usage: {} <file or directory>... [-w workers] | -s [-c cache directory] | -r count", argv[0]);
+        return 1;
+    }
+
+    if (startup) {
+        if (cacheDirectory.empty()) cacheDirectory = "loadbench_cache";
+
+        std::string args = " -w 0 -c \"" + cacheDirectory.string() + "\"" + pathArgs;
+
+        std::filesystem::remove_all(cacheDirectory);
+
+        GM_LOG_INFO("Cold start:");
+        if (!RunSelf(argv[0], args)) return 1;
+
+        GM_LOG_INFO("Warm start:");
+        if (!RunSelf(argv[0], args)) return 1;
+
+        return 0;
+    }
+
+    if (workerCount < 0 && registerCount == 0) {
+        const int32_t counts[] = { 0, 1, 2, 4, 0 };
+
+        for (uint32_t i = 0; i < sizeof(counts) / sizeof(int32_t); i++) {
+            if (i == 0) GM_LOG_INFO("Warm-up run:");
+
+            if (!RunSelf(argv[0], " -w " + std::to_string(counts[i]) + pathArgs)) return 1;
+        }
+
+        return 0;
+    }
+
+    spdlog::set_level(spdlog::level::info);
+
+    ApplicationSpec appSpec;
+
+    appSpec.mName = "LoadBench";
+
+    LoadBench app(appSpec, (uint32_t)std::max(workerCount, 0), paths, registerCount, cacheDirectory, processStart);
+
+    app.Run();
+
+    return 0;
+}
@@ -0,0 +1,295 @@
+/*
+MIT License
+
+Copyright (c) 2022 Jesper
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Guacamole.h>
+
+#include <Guacamole/renderer/meshimporter.h>
+#include <Guacamole/util/fileview.h>
+#include <Guacamole/util/vertexcodec.h>
+
+#include <chrono>
+#include <cfloat>
+
+using namespace Guacamole;
+
+// Vertices are written in pieces of this size like the loader threads' staging buffers
+static constexpr uint64_t StagingSize = 24000000;
+
+// Largest decode error of the compact vertex format, each relative to its tolerance so anything above 1 is a failure
+struct CompactError {
+    float mPosition = 0.0f;
+    float mNormalDegrees = 0.0f;
+    float mUV = 0.0f;
+};
+
+// Half a quantization step plus the float rounding of the scale and offset
+static float GetTolerance(float scale, float offset, float steps) {
+    return scale / steps * 0.5f + (fabsf(offset) + fabsf(scale)) * FLT_EPSILON * 2.0f;
+}
+
+// Encodes the vertices the same way Mesh does for VertexFormat::Compact and decodes them like scene.vert
+static void CheckCompactVertices(const Vertex* vertices, uint64_t count, const Util::VertexQuantization& q, CompactError* error) {
+    static constexpr float MaxNormalDegrees = 0.005f;
+
+    for (uint64_t i = 0; i < count; i++) {
+        const Vertex& vertex = vertices[i];
+        const float* position = &vertex.Position.x;
+        const float* normal = &vertex.Normal.x;
+        const float* uv = &vertex.UV.x;
+
+        for (uint32_t j = 0; j < 3; j++) {
+            float decoded = Util::DecodeSnorm16(Util::EncodeSnorm16((position[j] - q.mPositionOffset[j]) / q.mPositionScale[j])) * q.mPositionScale[j] + q.mPositionOffset[j];
+            float tolerance = GetTolerance(q.mPositionScale[j], q.mPositionOffset[j], 32767.0f);
+
+            error->mPosition = std::max(error->mPosition, fabsf(decoded - position[j]) / tolerance);
+        }
+
+        for (uint32_t j = 0; j < 2; j++) {
+            float decoded = Util::DecodeUnorm16(Util::EncodeUnorm16((uv[j] - q.mUVOffset[j]) / q.mUVScale[j])) * q.mUVScale[j] + q.mUVOffset[j];
+            float tolerance = GetTolerance(q.mUVScale[j], q.mUVOffset[j], 65535.0f);
+
+            error->mUV = std::max(error->mUV, fabsf(decoded - uv[j]) / tolerance);
+        }
+
+        float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+        // Degenerate triangles can leave a zero normal, there is no direction to compare against
+        if (length < 0.5f) continue;
+
+        int16_t encoded[2];
+        float decoded[3];
+
+        Util::EncodeOctahedral(normal, encoded);
+        Util::DecodeOctahedral(encoded, decoded);
+
+        // atan2 of the cross and dot products stays accurate for tiny angles unlike acos
+        double cx = (double)normal[1] * decoded[2] - (double)normal[2] * decoded[1];
+        double cy = (double)normal[2] * decoded[0] - (double)normal[0] * decoded[2];
+        double cz = (double)normal[0] * decoded[1] - (double)normal[1] * decoded[0];
+        double dot = (double)normal[0] * decoded[0] + (double)normal[1] * decoded[1] + (double)normal[2] * decoded[2];
+        double degrees = atan2(sqrt(cx * cx + cy * cy + cz * cz), dot / length) * 180.0 / 3.14159265358979323846;
+
+        error->mNormalDegrees = std::max(error->mNormalDegrees, (float)degrees / MaxNormalDegrees);
+    }
+}
+
+static double GetSeconds(std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+}
+
+// Usage: MeshBench <file or directory>... [-t threads] [-o] [-m] [-c]
+// Imports every OBJ/glTF/GLB and reports the time spent reading, parsing and writing the vertices and indices.
+// -o also runs the vertex cache/overdraw/fetch optimization and reports the simulated cache efficiency
+// -m also builds meshlets (implies -o) and reports how many triangles their cones cull seen from the six axes
+// -c also checks that the compact vertex format decodes within tolerance, the exit code is non zero if it doesn't
+int main(int argc, char** argv) {
+    std::vector<std::filesystem::path> paths;
+    uint32_t threadCount = 0;
+    bool optimize = false;
+    bool meshlets = false;
+    bool checkCompact = false;
+    bool compactFailed = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+
+        if (arg == "-t" && i + 1 < argc) {
+            threadCount = std::max(atoi(argv[++i]), 1);
+        } else if (arg == "-o") {
+            optimize = true;
+        } else if (arg == "-m") {
+            optimize = true;
+            meshlets = true;
+        } else if (arg == "-c") {
+            checkCompact = true;
+        } else if (std::filesystem::is_directory(arg)) {
+            for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(arg)) {
+                if (entry.is_regular_file()) paths.push_back(entry.path());
+            }
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty()) {
+        GM_LOG_CRITICAL("Usage: {} <file or directory>... [-t threads] [-o] [-m] [-c]", argv[0]);
+        return 1;
+    }
+
+    double totalReadSeconds = 0.0;
+    double totalImportSeconds = 0.0;
+    uint64_t totalTriangles = 0;
+    uint64_t totalBytes = 0;
+    uint32_t meshCount = 0;
+    std::vector<uint8_t> staging(StagingSize);
+
+    for (const std::filesystem::path& path : paths) {
+        MeshImporter* importer = MeshImporter::Create(path);
+
+        if (importer == nullptr) continue;
+
+        std::vector<FileView*> files;
+
+        MeshFileReader reader = [&files](const std::filesystem::path& file, uint64_t* size) -> const uint8_t* {
+            FileView* view = files.emplace_back(new FileView);
+
+            if (!view->Open(file, true)) return nullptr;
+
+            *size = view->GetSize();
+
+            return view->GetData();
+        };
+
+        FileView view;
+
+        // Populating faults the whole file in, which is the I/O the import would otherwise wait on
+        auto start = std::chrono::high_resolution_clock::now();
+        bool opened = view.Open(path, true);
+        auto read = std::chrono::high_resolution_clock::now();
+        bool parsed = opened && importer->Parse(path, view.GetData(), view.GetSize(), reader, threadCount);
+        auto parse = std::chrono::high_resolution_clock::now();
+        Util::VertexCacheStats before = {};
+        Util::VertexCacheStats after = {};
+
+        if (parsed && optimize) importer->Optimize(&before, &after, meshlets);
+
+        auto optimized = std::chrono::high_resolution_clock::now();
+
+        if (parsed) {
+            // Like Mesh without a device, so never UINT8
+            VkIndexType indexType = importer->GetVertexCount() <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+            uint64_t originalVertexCount = importer->GetVertexCount();
+            std::vector<Submesh> submeshes;
+
+            if (indexType == VK_INDEX_TYPE_UINT32 && importer->SplitSubmeshes(sizeof(Vertex), &submeshes)) {
+                indexType = VK_INDEX_TYPE_UINT16;
+            }
+
+            uint64_t vertexCount = importer->GetVertexCount();
+            uint64_t indexCount = importer->GetIndexCount();
+            uint64_t indexSize = indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+
+            for (uint64_t first = 0; first < vertexCount; first += StagingSize / sizeof(Vertex)) {
+                importer->WriteVertices((Vertex*)staging.data(), first, std::min(StagingSize / sizeof(Vertex), vertexCount - first));
+            }
+
+            for (uint64_t first = 0; first < indexCount; first += StagingSize / indexSize) {
+                importer->WriteIndices(staging.data(), indexType, first, std::min(StagingSize / indexSize, indexCount - first));
+            }
+
+            auto end = std::chrono::high_resolution_clock::now();
+
+            double readSeconds = GetSeconds(start, read);
+            double parseSeconds = GetSeconds(read, parse);
+            double optimizeSeconds = GetSeconds(parse, optimized);
+            double writeSeconds = GetSeconds(optimized, end);
+            uint64_t triangles = indexCount / 3;
+
+            GM_LOG_INFO("{} {:.2f}MB, {} triangles, {} vertices: read {:.2f}ms parse {:.2f}ms write {:.2f}ms, {:.2f}MTriangles/s", path.string().c_str(), 
+                view.GetSize() / 1000000.0, triangles, vertexCount, readSeconds * 1000.0, parseSeconds * 1000.0, writeSeconds * 1000.0, 
+                triangles / 1000000.0 / (parseSeconds + writeSeconds));
+
+            if (optimize) {
+                GM_LOG_INFO("    optimize {:.2f}ms, ACMR: {:.3f} -> {:.3f}, ATVR: {:.3f} -> {:.3f}", optimizeSeconds * 1000.0, before.mACMR, after.mACMR, 
+                    before.mATVR, after.mATVR);
+            }
+
+            if (meshlets) {
+                const std::vector<Util::Meshlet>& built = importer->GetMeshlets();
+                vec3 center = (importer->GetBoundsMin() + importer->GetBoundsMax()) * vec3(0.5f);
+                vec3 extent = importer->GetBoundsMax() - importer->GetBoundsMin();
+                float distance = std::max(std::max(extent.x, extent.y), extent.z);
+                uint64_t culled = 0;
+
+                for (uint32_t axis = 0; axis < 6; axis++) {
+                    vec3 camera = center;
+
+                    (&camera.x)[axis / 2] += axis % 2 ? -distance : distance;
+
+                    for (const Util::Meshlet& meshlet : built) {
+                        if (Util::IsMeshletBackFacing(meshlet, &camera.x)) culled += meshlet.mIndexCount / 3;
+                    }
+                }
+
+                GM_LOG_INFO("    {} meshlets, {:.1f} triangles each, cone culling {:.1f}% of the triangles", built.size(), (double)triangles / built.size(), 
+                    culled * 100.0 / (triangles * 6.0));
+            }
+
+            if (!submeshes.empty()) {
+                GM_LOG_INFO("    split into {} submeshes for 16 bit indices, {} duplicated vertices, {} -> {} bytes", submeshes.size(), 
+                    vertexCount - originalVertexCount, (indexCount * 4 + originalVertexCount * sizeof(Vertex)), indexCount * 2 + vertexCount * sizeof(Vertex));
+            }
+
+            // Outside the timed part, it writes the vertices a second time
+            if (checkCompact) {
+                vec3 boundsMin = importer->GetBoundsMin();
+                vec3 boundsMax = importer->GetBoundsMax();
+                vec2 uvMin = importer->GetUVBoundsMin();
+                vec2 uvMax = importer->GetUVBoundsMax();
+                Util::VertexQuantization quantization = Util::ComputeVertexQuantization(&boundsMin.x, &boundsMax.x, &uvMin.x, &uvMax.x);
+                CompactError error;
+
+                for (uint64_t first = 0; first < vertexCount; first += StagingSize / sizeof(Vertex)) {
+                    uint64_t count = std::min(StagingSize / sizeof(Vertex), vertexCount - first);
+
+                    importer->WriteVertices((Vertex*)staging.data(), first, count);
+                    CheckCompactVertices((const Vertex*)staging.data(), count, quantization, &error);
+                }
+
+                bool passed = error.mPosition <= 1.0f && error.mNormalDegrees <= 1.0f && error.mUV <= 1.0f;
+
+                GM_LOG_INFO("    compact {} -> {} bytes, max error/tolerance: position {:.3f} normal {:.3f} uv {:.3f} {}", vertexCount * sizeof(Vertex), 
+                    vertexCount * sizeof(CompactVertex), error.mPosition, error.mNormalDegrees, error.mUV, passed ? "ok" : "FAILED");
+
+                compactFailed |= !passed;
+            }
+
+            totalReadSeconds += readSeconds;
+            totalImportSeconds += parseSeconds + writeSeconds;
+            totalTriangles += triangles;
+            totalBytes += view.GetSize();
+            meshCount++;
+        } else {
+            GM_LOG_CRITICAL("Failed to import \"{}\"", path.string().c_str());
+        }
+
+        for (FileView* file : files) {
+            delete file;
+        }
+
+        delete importer;
+    }
+
+    if (meshCount == 0) {
+        GM_LOG_CRITICAL("No meshes found");
+        return 1;
+    }
+
+    // Import slower than reading means parsing is the bottleneck
+    GM_LOG_INFO("{} meshes, {:.2f}MB, {:.2f}MTriangles: import {:.2f}MTriangles/s {:.2f}MB/s, read {:.2f}MB/s", meshCount, totalBytes / 1000000.0, 
+        totalTriangles / 1000000.0, totalTriangles / 1000000.0 / totalImportSeconds, totalBytes / 1000000.0 / totalImportSeconds, 
+        totalBytes / 1000000.0 / totalReadSeconds);
+
+    return compactFailed ? 1 : 0;
+}